@@ -29,79 +29,251 @@
 
 #include "Lfit.h"
 #include "XRFconstants.h"
+#include "XRFcontrols.h"
 #include <math.h>
+#include <algorithm>
+#include <atomic>
 
 //  Adapted from "Numerical Recipes in C"
 //  Modified May 27, 2017
 //      Added check for not-a-number and infinity to lowerUpperSubst
 //      to prevent fit from returning unusable results
 //      (should probably switch to using singular value decomposition)
+//  Modified Oct. 16, 2026
+//      Normal equations summed a component row at a time over tiles of channels (same results, much faster)
+//      Add Cholesky solver in double precision (selected by lfitCholesky, default LFIT_CHOLESKY in XRFcontrols.h)
+//      Optional non-zero channel band for each function, sums only include the channels where both functions are non-zero
+//  Modified Oct. 17, 2026
+//      Diagonal of the inverse from the Cholesky factor keeps one column of inv(L) instead of the whole matrix
 
 using namespace std;
 
+static atomic <bool> use_cholesky( LFIT_CHOLESKY );
+
+void lfitCholesky( const bool use_cholesky_in ) {
+	use_cholesky = use_cholesky_in;
+};
+
+bool lfitCholesky() {
+	return use_cholesky;
+};
+
+//  Weighted sums for the normal equations, alpha = A'WA (lower triangle only) and beta = A'Wy
+//      Done one component row at a time so the basis functions are read contiguously, with the channels
+//      in tiles that stay in cache and several columns accumulated at once.  Each element is still summed
+//      over the channels in the same order as the original loop, so the float version gives identical results.
+//      Only the channels inside the bands of both basis functions are summed (the rest of the terms are zero).
+static const int LFIT_CHANNEL_TILE = 512;
+
+template <typename T>
+static void lfitNormalEquations( const vector <float> &y, const vector <float> &sig2i, const vector <float> &funcs,
+        const int np, const int ma, const vector <int> &band_start, const vector <int> &band_end,
+        vector <T> &alpha, vector <T> &beta ) {
+	int ndat = y.size();
+	alpha.assign( ma*ma, 0 );
+	beta.assign( ma, 0 );
+	vector <float> wt( ndat );	//	weighted basis function for the current row, indexed by channel
+	int i0;
+	for ( i0=0; i0<ndat; i0+=LFIT_CHANNEL_TILE ) {
+		int i1 = i0 + LFIT_CHANNEL_TILE;
+		if ( i1 > ndat ) i1 = ndat;
+		int i,j,k;
+		for ( j=0; j<ma; j++ ) {
+			int js = max( i0, band_start[j] );
+			int je = min( i1, band_end[j] );
+			if ( js >= je ) continue;
+			const float *fj = &funcs[j*np];
+			for ( i=js; i<je; i++ ) wt[i] = fj[i]*sig2i[i];
+			T b = beta[j];
+			for ( i=js; i<je; i++ ) b += y[i]*wt[i];
+			beta[j] = b;
+			T *row = &alpha[j*ma];
+			for ( k=0; k+3<=j; k+=4 ) {
+				int ks = max( js, min( min( band_start[k], band_start[k+1] ), min( band_start[k+2], band_start[k+3] ) ) );
+				int ke = min( je, max( max( band_end[k], band_end[k+1] ), max( band_end[k+2], band_end[k+3] ) ) );
+				if ( ks >= ke ) continue;
+				const float *f0 = &funcs[k*np];
+				const float *f1 = f0 + np;
+				const float *f2 = f1 + np;
+				const float *f3 = f2 + np;
+				T s0 = row[k], s1 = row[k+1], s2 = row[k+2], s3 = row[k+3];
+				for ( i=ks; i<ke; i++ ) {
+					s0 += wt[i]*f0[i];
+					s1 += wt[i]*f1[i];
+					s2 += wt[i]*f2[i];
+					s3 += wt[i]*f3[i];
+				}
+				row[k] = s0;	row[k+1] = s1;	row[k+2] = s2;	row[k+3] = s3;
+			}
+			for ( ; k<=j; k++ ) {
+				int ks = max( js, band_start[k] );
+				int ke = min( je, band_end[k] );
+				const float *fk = &funcs[k*np];
+				T s = row[k];
+				for ( i=ks; i<ke; i++ ) s += wt[i]*fk[i];
+				row[k] = s;
+			}
+		}
+	}
+};
+
+
 int lfit( const vector <float> &y, const vector <float> &sig, vector <float> &a,
 	vector <float> &var, float &chisq, const vector <float> &funcs, const int np ) {
+	vector <int> band_start( a.size(), 0 );
+	vector <int> band_end( a.size(), y.size() );
+	return lfit( y, sig, a, var, chisq, funcs, np, band_start, band_end );
+};
+
+
+int lfit( const vector <float> &y, const vector <float> &sig, vector <float> &a,
+	vector <float> &var, float &chisq, const vector <float> &funcs, const int np,
+	const vector <int> &band_start_in, const vector <int> &band_end_in ) {
 	int i,j,k;
-	float ym,wt,sum,sig2i;
 	int ma = a.size();
-	vector <float> beta(ma);
-	vector <float> afunc(ma);
-	vector <float> covar(ma*ma);
 	int ndat = y.size();
-//		zero covariance and right-hand-side matrices (covar used to store alpha)
-	for (j=0;j<ma;j++) {
-		for (k=0;k<ma;k++) covar[j*ma+k]=0.0;
-		beta[j]=0.0;
-	}
-//		load matrices with weighted sums
+	vector <float> sig2i(ndat);
+	bool all_finite = true;
 	for (i=0;i<ndat;i++) {
-		int ia;
-//			move basis function values at x[i] to short vector
-		for ( ia=0; ia<ma; ia++ ) afunc[ia] = funcs[ia*np+i];
-		ym=y[i];	//	measured value
-		sig2i=1.0/(sig[i]*sig[i]);	//	standard deviation of measured value
+		sig2i[i]=1.0/(sig[i]*sig[i]);	//	inverse variance of measured value
+		if ( ! isfinite( y[i] ) || ! isfinite( sig2i[i] ) ) all_finite = false;
+	}
+//		bands are only used if skipping the zeros can't change anything (no inf*0 or nan)
+	vector <int> band_start( ma, 0 );
+	vector <int> band_end( ma, ndat );
+	if ( all_finite && band_start_in.size() >= ma && band_end_in.size() >= ma ) {
 		for (j=0;j<ma;j++) {
-			wt=afunc[j]*sig2i;
-			for (k=0;k<=j;k++)
-				covar[j*ma+k] += wt*afunc[k];
-			beta[j] += ym*wt;
+			band_start[j] = max( 0, band_start_in[j] );
+			band_end[j] = max( band_start[j], min( ndat, band_end_in[j] ) );
+		}
+	}
+	bool solved = false;
+	if ( use_cholesky ) {
+//		normal equations and Cholesky decomposition in double precision
+		vector <double> alpha;
+		vector <double> beta;
+		lfitNormalEquations( y, sig2i, funcs, np, ma, band_start, band_end, alpha, beta );
+		if ( choleskyDecomp( alpha, ma ) == 0 ) {
+			choleskySubst( alpha, ma, beta );
+			for (j=0;j<ma;j++) a[j]=beta[j];
+//			variances of fit coefficients are the diagonal of the inverse
+			vector <double> inv_diag;
+			choleskyInverseDiagonal( alpha, ma, inv_diag );
+			for (j=0;j<ma;j++) var[j]=inv_diag[j];
+			solved = true;
 		}
+		//  Not positive definite (to rounding), fall back to the pivoted LU solution
+	}
+	if ( ! solved ) {
+		vector <float> covar;
+		vector <float> beta;
+//			load matrices with weighted sums (covar used to store alpha)
+		lfitNormalEquations( y, sig2i, funcs, np, ma, band_start, band_end, covar, beta );
+//			fill in other half by symmetry
+		for (j=1;j<ma;j++)
+			for (k=0;k<j;k++)
+				covar[k*ma+j]=covar[j*ma+k];
+//			use Lower-Upper decomposition to find solution
+		vector <int> index(ma);
+		float d;
+		int err = lowerUpperDecomp( covar, ma, index, d, ma );
+		if ( err != 0 ) return err;
+		lowerUpperSubst( covar, ma, index, beta, ma );
+//			fill in output vector with fit coefficients
+		for (j=0;j<ma;j++) a[j]=beta[j];
+//			calculate variances of fit coefficients
+		for (j=0;j<ma;j++) {
+			for (k=0;k<ma;k++) beta[k]=0.0;
+			beta[j] = 1;
+//				use lowerUpperSubst to find one column of the inverse of original covar matrix
+			lowerUpperSubst( covar, ma, index, beta, ma );
+//				put diagonal element into coefficient variance
+			var[j] = beta[j];
+		};
+	}
+//		calculate chi squared (fit summed over components in the same order for each channel)
+	vector <float> fit( ndat, 0.0f );
+	for (j=0;j<ma;j++) {
+		const float *fj = &funcs[j*np];
+		float aj = a[j];
+		int is = band_start[j];
+		int ie = band_end[j];
+		if ( ! isfinite( aj ) ) {
+			is = 0;
+			ie = ndat;
+		}
+		for (i=is;i<ie;i++) fit[i] += aj*fj[i];
 	}
-//		fill in other half by symmetry
-	for (j=1;j<ma;j++)
-		for (k=0;k<j;k++)
-			covar[k*ma+j]=covar[j*ma+k];
-//		use Lower-Upper decomposition to find solution
-	vector <int> index(ma);
-	float d;
-	int err = lowerUpperDecomp( covar, ma, index, d, ma );
-	if ( err != 0 ) return err;
-	lowerUpperSubst( covar, ma, index, beta, ma );
-//		fill in output vector with fit coefficients
-	for (j=0;j<ma;j++) a[j]=beta[j];
-//		calculate chi squared
 	chisq=0.0;
 	for (i=0;i<ndat;i++) {
-		int ia;
-		for ( ia=0; ia<ma; ia++ ) afunc[ia] = funcs[ia*np+i];
-		sum = 0;
-		for ( j=0;j<ma;j++) sum += a[j]*afunc[j];
-		float diff = (y[i]-sum)/sig[i];
+		float diff = (y[i]-fit[i])/sig[i];
 		chisq += diff*diff;
 	}
-//		calculate variances of fit coefficients
-	for (j=0;j<ma;j++) {
-		for (k=0;k<ma;k++) beta[k]=0.0;
-		beta[j] = 1;
-//			use lowerUpperSubst to find one column of the inverse of original covar matrix
-		lowerUpperSubst( covar, ma, index, beta, ma );
-//			put diagonal element into coefficient variance
-		var[j] = beta[j];
-	};
 	return 0;
 };
 
 
+//  Cholesky decomposition of a symmetric positive definite matrix, lower triangle (including the
+//      diagonal) is replaced by L where a = L L'  (only the lower triangle of the input is used)
+int choleskyDecomp( vector <double> &a, const int n ) {
+	int i,j,k;
+	for (j=0;j<n;j++) {
+		double *rj = &a[j*n];
+		double d = rj[j];
+		for (k=0;k<j;k++) d -= rj[k]*rj[k];
+		if ( ! ( d > 0 ) ) return -1;
+		d = sqrt( d );
+		rj[j] = d;
+		for (i=j+1;i<n;i++) {
+			double *ri = &a[i*n];
+			double sum = ri[j];
+			for (k=0;k<j;k++) sum -= ri[k]*rj[k];
+			ri[j] = sum / d;
+		}
+	}
+	return 0;
+};
+
+
+void choleskySubst( const vector <double> &l, const int n, vector <double> &rhs ) {
+	int i,k;
+//		forward substitution with L
+	for (i=0;i<n;i++) {
+		double sum = rhs[i];
+		for (k=0;k<i;k++) sum -= l[i*n+k]*rhs[k];
+		rhs[i] = sum / l[i*n+i];
+	}
+//		back substitution with L'
+	for (i=n-1;i>=0;i--) {
+		double sum = rhs[i];
+		for (k=i+1;k<n;k++) sum -= l[k*n+i]*rhs[k];
+		rhs[i] = sum / l[i*n+i];
+		if( isnan( rhs[i] ) || isinf( rhs[i] ) ) rhs[i] = 0;
+	}
+};
+
+
+void choleskyInverseDiagonal( const vector <double> &l, const int n, vector <double> &diag ) {
+//		inverse of a = L L' is inv(L)' inv(L), so its diagonal is the column sums of squares of inv(L)
+//		each column of inv(L) is found by forward substitution and summed as soon as it is complete,
+//		so only one column is stored (about n^3/6 multiplies, the same as the decomposition itself)
+	vector <double> col( n );
+	diag.assign( n, 0.0 );
+	int i,j,k;
+	for (j=0;j<n;j++) {
+		col[j] = 1.0 / l[j*n+j];
+		for (i=j+1;i<n;i++) {
+			double sum = 0;
+			for (k=j;k<i;k++) sum -= l[i*n+k]*col[k];
+			col[i] = sum / l[i*n+i];
+		}
+		double sum = 0;
+		for (i=j;i<n;i++) sum += col[i]*col[i];
+		diag[j] = sum;
+	}
+};
+
+
 int lowerUpperDecomp ( vector <float> &a, int n, vector <int> &index, float &d, const int np )
 {
 	int i,imax,j,k;
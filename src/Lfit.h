@@ -49,9 +49,24 @@ int lfit( const std::vector <float> &y, const std::vector <float> &sig, std::vec
 //			index of funcs is i * np + j, where i is index into a (and var) and j is index into y
 //	np		physical size of 1st dimension of funcs vector (usually also the physical dimension of y and sig)
 
+//	Same as above, but function i is only non-zero for band_start[i] <= j < band_end[i] (sums skip the other channels)
+int lfit( const std::vector <float> &y, const std::vector <float> &sig, std::vector <float> &a,
+	std::vector <float> &var, float &chisq, const std::vector <float> &funcs, const int np,
+	const std::vector <int> &band_start, const std::vector <int> &band_end );
+
+//	select the double precision Cholesky solver for the normal equations instead of LU (-L option)
+//		if the matrix is not positive definite lfit still falls back to LU
+void lfitCholesky( const bool use_cholesky_in );
+bool lfitCholesky();
+
 //	matrix solvers
 int lowerUpperDecomp( std::vector <float> &a, int n, std::vector <int> &index, float &d, const int np );
 void lowerUpperSubst( std::vector <float> &a, int n, std::vector <int> &index, std::vector <float> &rhs, const int np );
+//	symmetric positive definite matrices (n x n, no separate physical dimension), returns -1 if not positive definite
+int choleskyDecomp( std::vector <double> &a, const int n );
+void choleskySubst( const std::vector <double> &l, const int n, std::vector <double> &rhs );
+//	diagonal of the inverse of the original matrix, from its Cholesky factor
+void choleskyInverseDiagonal( const std::vector <double> &l, const int n, std::vector <double> &diag );
 
 
 
@@ -0,0 +1,519 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "MSA_spectrum_pack.h"
+
+#include <fstream>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "read_EMSA_PIXL.h"
+#include "upper_trim.h"
+#include "XRFconstants.h"
+#include "XRFutilities.h"
+
+using namespace std;
+
+static const char MSA_PACK_MAGIC[8] = { 'P', 'Q', 'M', 'S', 'A', 'P', 'K', 0 };
+static const uint32_t MSA_PACK_BYTE_ORDER = 0x01020304;
+
+static uint64_t alignSection(uint64_t offset)
+{
+    return (offset + 7) & ~uint64_t(7);
+}
+
+// Size and modification time of a file, size -1 if it doesn't exist
+static void fileStamp(const std::string &pathName, int64_t &size, int64_t &modifiedTime)
+{
+    struct stat st;
+    if(stat(pathName.c_str(), &st) != 0)
+    {
+        size = -1;
+        modifiedTime = 0;
+        return;
+    }
+    size = st.st_size;
+    modifiedTime = st.st_mtime;
+}
+
+MSASpectrumPack::MSASpectrumPack() :
+    _entries(0),
+    _detectors(0),
+    _texts(0),
+    _conditions(0),
+    _channels(0),
+    _strings(0)
+{
+    memset(&_header, 0, sizeof(_header));
+    memcpy(_header.magic, MSA_PACK_MAGIC, sizeof(_header.magic));
+    _header.version = MSA_PACK_VERSION;
+    _header.byteOrder = MSA_PACK_BYTE_ORDER;
+    _header.conditionsPerEntry = XRF_PARAMETER_LAST;
+}
+
+MSAPackString MSASpectrumPack::addString(const std::string &s)
+{
+    MSAPackString result;
+    result.offset = _ownedStrings.size();
+    result.length = s.length();
+    _ownedStrings.insert(_ownedStrings.end(), s.begin(), s.end());
+    return result;
+}
+
+void MSASpectrumPack::addEntry(const std::string &pathName, int readResult, const XRFconditionsInput &conditions, const std::vector <XraySpectrum> &spectra)
+{
+    MSAPackEntry entry;
+    memset(&entry, 0, sizeof(entry));
+
+    entry.path = addString(pathName);
+    entry.readResult = readResult;
+    fileStamp(pathName, entry.fileSize, entry.modifiedTime);
+
+    // Always the same number of conditions per entry, so they can be found from the entry index when reading
+    entry.firstCondition = _ownedConditions.size();
+    _ownedConditions.resize(entry.firstCondition + _header.conditionsPerEntry, 0);
+    for(size_t c = 0; c < conditions.conditionsVector.size() && c < _header.conditionsPerEntry; c++)
+    {
+        _ownedConditions[entry.firstCondition+c] = conditions.conditionsVector[c];
+    }
+    entry.optic_file_name = addString(conditions.optic_file_name);
+    entry.tube_file_name = addString(conditions.tube_file_name);
+    entry.anode_element_list = addString(conditions.anode_element_list);
+
+    entry.firstDetector = _ownedDetectors.size();
+    entry.firstText = _ownedTexts.size();
+
+    // A file that couldn't be read is only kept for its error code
+    if(readResult == 0 && spectra.size() > 0)
+    {
+        const Spec_Aux_Info &aux = spectra[0].aux_info();
+        entry.date = addString(aux.date);
+        entry.time = addString(aux.time);
+        entry.owner = addString(aux.owner);
+        entry.det_ID = addString(aux.det_ID);
+        for(size_t c = 0; c < aux.titles.size(); c++)
+        {
+            _ownedTexts.push_back(addString(aux.titles[c]));
+        }
+        for(size_t c = 0; c < aux.comments.size(); c++)
+        {
+            _ownedTexts.push_back(addString(aux.comments[c]));
+        }
+        entry.titleCount = aux.titles.size();
+        entry.commentCount = aux.comments.size();
+        entry.x = aux.x;
+        entry.y = aux.y;
+        entry.z = aux.z;
+        entry.i = aux.i;
+        entry.j = aux.j;
+        entry.sclk = aux.sclk;
+        entry.rtt = aux.rtt;
+        entry.usn = aux.usn;
+        entry.dpc = aux.dpc;
+        entry.pmc = aux.pmc;
+
+        for(size_t c = 0; c < spectra.size(); c++)
+        {
+            const XraySpectrum &spectrum = spectra[c];
+            const Spec_Header_Info &header = spectrum.header_info();
+
+            MSAPackDetector detector;
+            memset(&detector, 0, sizeof(detector));
+            detector.firstChannel = _ownedChannels.size();
+            detector.channelCount = spectrum.meas().size();
+            detector.energyStart = spectrum.calibration().energyStart();
+            detector.energyPerChannel = spectrum.calibration().energyPerChannel();
+            detector.quad = spectrum.calibration().quad();
+            detector.liveTime = spectrum.live_time();
+            detector.realTime = spectrum.real_time();
+            detector.live_time_DSPC = header.live_time_DSPC;
+            detector.events = header.events;
+            detector.triggers = header.triggers;
+            detector.overflows = header.overflows;
+            detector.underflows = header.underflows;
+            detector.baseline_samples = header.baseline_samples;
+            detector.preamp_resets = header.preamp_resets;
+            detector.saturates = header.saturates;
+            _ownedChannels.insert(_ownedChannels.end(), spectrum.meas().begin(), spectrum.meas().end());
+            _ownedDetectors.push_back(detector);
+        }
+        entry.detectorCount = spectra.size();
+    }
+
+    _ownedEntries.push_back(entry);
+}
+
+int MSASpectrumPack::finish(std::ostream &termOutFile, const std::string &pathName)
+{
+    _header.entryCount = _ownedEntries.size();
+    _header.detectorCount = _ownedDetectors.size();
+    _header.textCount = _ownedTexts.size();
+    _header.conditionCount = _ownedConditions.size();
+    _header.channelCount = _ownedChannels.size();
+    _header.stringBytes = _ownedStrings.size();
+
+    _entries = _ownedEntries.data();
+    _detectors = _ownedDetectors.data();
+    _texts = _ownedTexts.data();
+    _conditions = _ownedConditions.data();
+    _channels = _ownedChannels.data();
+    _strings = _ownedStrings.data();
+
+    return check(termOutFile, pathName);
+}
+
+uint32_t MSASpectrumPack::checkSourceFiles(std::ostream &termOutFile, const std::string &pathName) const
+{
+    //  Only the first few are listed, a whole data set copied again would otherwise fill the log
+    const uint32_t maxListed = 10;
+    uint32_t changedCount = 0;
+    for(uint32_t c = 0; c < _header.entryCount; c++)
+    {
+        const MSAPackEntry &entry = _entries[c];
+        int64_t size = 0;
+        int64_t modifiedTime = 0;
+        fileStamp(str(entry.path), size, modifiedTime);
+        if(size == entry.fileSize && modifiedTime == entry.modifiedTime)
+        {
+            continue;
+        }
+        if(changedCount < maxListed)
+        {
+            termOutFile << "Warning: spectrum file " << str(entry.path) << (size < 0 ? " no longer exists" : " has changed") << " since it was packed" << endl;
+        }
+        changedCount++;
+    }
+    if(changedCount > 0)
+    {
+        termOutFile << "Warning: " << changedCount << " of " << _header.entryCount << " spectrum files in MSA spectrum pack " << pathName << " have changed, the packed spectra are used (pack the spectrum list again)" << endl;
+    }
+    return changedCount;
+}
+
+int MSASpectrumPack::read(uint32_t idx, std::vector <XraySpectrum> &spectra, XRFconditionsInput &conditions) const
+{
+    const MSAPackEntry &entry = _entries[idx];
+
+    const float *entryConditions = _conditions+entry.firstCondition;
+    conditions.conditionsVector.assign(entryConditions, entryConditions+_header.conditionsPerEntry);
+    conditions.optic_file_name = str(entry.optic_file_name);
+    conditions.tube_file_name = str(entry.tube_file_name);
+    conditions.anode_element_list = str(entry.anode_element_list);
+
+    Spec_Aux_Info aux;
+    aux.date = str(entry.date);
+    aux.time = str(entry.time);
+    aux.owner = str(entry.owner);
+    aux.det_ID = str(entry.det_ID);
+    for(uint32_t c = 0; c < entry.titleCount; c++)
+    {
+        aux.titles.push_back(str(_texts[entry.firstText+c]));
+    }
+    for(uint32_t c = 0; c < entry.commentCount; c++)
+    {
+        aux.comments.push_back(str(_texts[entry.firstText+entry.titleCount+c]));
+    }
+    aux.x = entry.x;
+    aux.y = entry.y;
+    aux.z = entry.z;
+    aux.i = entry.i;
+    aux.j = entry.j;
+    aux.sclk = entry.sclk;
+    aux.rtt = entry.rtt;
+    aux.usn = entry.usn;
+    aux.dpc = entry.dpc;
+    aux.pmc = entry.pmc;
+
+    // Same order as read_EMSA_PIXL, the calibration has to be set before the channels so the region counts come out the same
+    spectra.clear();
+    spectra.resize(entry.detectorCount);
+    for(uint32_t c = 0; c < entry.detectorCount; c++)
+    {
+        const MSAPackDetector &detector = _detectors[entry.firstDetector+c];
+        XraySpectrum &spectrum = spectra[c];
+
+        spectrum.live_time(detector.liveTime);
+        spectrum.real_time(detector.realTime);
+        Spec_Header_Info &header = spectrum.header_info_change();
+        header.live_time_DSPC = detector.live_time_DSPC;
+        header.events = detector.events;
+        header.triggers = detector.triggers;
+        header.overflows = detector.overflows;
+        header.underflows = detector.underflows;
+        header.baseline_samples = detector.baseline_samples;
+        header.preamp_resets = detector.preamp_resets;
+        header.saturates = detector.saturates;
+
+        spectrum.calibration(detector.energyStart, detector.energyPerChannel, detector.quad);
+        spectrum.aux_info_replace(aux);
+
+        if(detector.channelCount > 0)
+        {
+            const float *channels = _channels+detector.firstChannel;
+            vector <float> counts(channels, channels+detector.channelCount);
+            spectrum.meas(counts);
+        }
+    }
+
+    return entry.readResult;
+}
+
+// Everything in a pack file is checked once when it's opened, so reading spectra from it needs no checks
+int MSASpectrumPack::check(std::ostream &termOutFile, const std::string &pathName) const
+{
+    auto stringOK = [this](const MSAPackString &s)
+    {
+        return uint64_t(s.offset)+s.length <= _header.stringBytes;
+    };
+
+    const char *problem = 0;
+    if(_header.conditionCount != uint64_t(_header.entryCount)*_header.conditionsPerEntry)
+    {
+        problem = "conditions out of range";
+    }
+    for(uint32_t c = 0; c < _header.entryCount && !problem; c++)
+    {
+        const MSAPackEntry &entry = _entries[c];
+        if(entry.firstCondition+_header.conditionsPerEntry > _header.conditionCount ||
+           uint64_t(entry.firstDetector)+entry.detectorCount > _header.detectorCount ||
+           uint64_t(entry.firstText)+entry.titleCount+entry.commentCount > _header.textCount)
+        {
+            problem = "spectrum file entry out of range";
+        }
+        else if(!stringOK(entry.path) || !stringOK(entry.optic_file_name) || !stringOK(entry.tube_file_name) ||
+                !stringOK(entry.anode_element_list) || !stringOK(entry.date) || !stringOK(entry.time) ||
+                !stringOK(entry.owner) || !stringOK(entry.det_ID))
+        {
+            problem = "spectrum file text out of range";
+        }
+    }
+    for(uint32_t c = 0; c < _header.textCount && !problem; c++)
+    {
+        if(!stringOK(_texts[c]))
+        {
+            problem = "title or comment out of range";
+        }
+    }
+    for(uint32_t c = 0; c < _header.detectorCount && !problem; c++)
+    {
+        if(_detectors[c].firstChannel+_detectors[c].channelCount > _header.channelCount)
+        {
+            problem = "detector spectrum out of range";
+        }
+    }
+
+    if(problem)
+    {
+        termOutFile << "MSA spectrum pack: " << pathName << " is not valid, " << problem << endl;
+        return -1;
+    }
+    return 0;
+}
+
+int MSASpectrumPack::write(std::ostream &termOutFile, const std::string &pathName) const
+{
+    MSAPackHeader header = _header;
+    header.entryOffset = alignSection(sizeof(header));
+    header.detectorOffset = alignSection(header.entryOffset + header.entryCount*sizeof(MSAPackEntry));
+    header.textOffset = alignSection(header.detectorOffset + header.detectorCount*sizeof(MSAPackDetector));
+    header.conditionOffset = alignSection(header.textOffset + header.textCount*sizeof(MSAPackString));
+    header.channelOffset = alignSection(header.conditionOffset + header.conditionCount*sizeof(float));
+    header.stringOffset = alignSection(header.channelOffset + header.channelCount*sizeof(float));
+    header.fileSize = header.stringOffset + header.stringBytes;
+
+    const string tempPathName = pathName+".tmp";
+    {
+        ofstream fout(tempPathName.c_str(), ios::out | ios::binary | ios::trunc);
+        if(!fout)
+        {
+            termOutFile << "Can't open MSA spectrum pack file for writing: " << tempPathName << endl;
+            return -1;
+        }
+
+        uint64_t written = 0;
+        auto writeSection = [&fout, &written](uint64_t offset, const void *data, uint64_t bytes)
+        {
+            static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+            fout.write(zeros, offset-written);
+            if(bytes > 0)
+            {
+                fout.write(static_cast<const char *>(data), bytes);
+            }
+            written = offset+bytes;
+        };
+
+        writeSection(0, &header, sizeof(header));
+        writeSection(header.entryOffset, _entries, header.entryCount*sizeof(MSAPackEntry));
+        writeSection(header.detectorOffset, _detectors, header.detectorCount*sizeof(MSAPackDetector));
+        writeSection(header.textOffset, _texts, header.textCount*sizeof(MSAPackString));
+        writeSection(header.conditionOffset, _conditions, header.conditionCount*sizeof(float));
+        writeSection(header.channelOffset, _channels, header.channelCount*sizeof(float));
+        writeSection(header.stringOffset, _strings, header.stringBytes);
+
+        if(!fout)
+        {
+            termOutFile << "Failed to write MSA spectrum pack file: " << tempPathName << endl;
+            return -2;
+        }
+    }
+
+    return replaceWithTempFile(termOutFile, tempPathName, pathName, "MSA spectrum pack");
+}
+
+int MSASpectrumPack::open(std::ostream &termOutFile, const std::string &pathName, std::shared_ptr<const MSASpectrumPack> &out_pack)
+{
+    out_pack.reset();
+    std::shared_ptr<MSASpectrumPack> pack = std::make_shared<MSASpectrumPack>();
+
+    if(pack->_file.open(termOutFile, pathName, "MSA spectrum pack") != 0)
+    {
+        return -1;
+    }
+    const char *base = pack->_file.data();
+    const uint64_t size = pack->_file.size();
+
+    if(size < sizeof(MSAPackHeader))
+    {
+        termOutFile << "MSA spectrum pack file: " << pathName << " is too short" << endl;
+        return -2;
+    }
+    MSAPackHeader &header = pack->_header;
+    memcpy(&header, base, sizeof(header));
+    if(memcmp(header.magic, MSA_PACK_MAGIC, sizeof(header.magic)) != 0)
+    {
+        termOutFile << "File: " << pathName << " is not a PIQUANT MSA spectrum pack" << endl;
+        return -2;
+    }
+    if(header.byteOrder != MSA_PACK_BYTE_ORDER)
+    {
+        termOutFile << "MSA spectrum pack file: " << pathName << " was written on a machine with a different byte order" << endl;
+        return -2;
+    }
+    if(header.version != MSA_PACK_VERSION || header.conditionsPerEntry != XRF_PARAMETER_LAST)
+    {
+        termOutFile << "MSA spectrum pack file: " << pathName << " was written by a different version of PIQUANT (pack the spectrum list again)" << endl;
+        return -2;
+    }
+
+    // Each section must be aligned and fit in the file
+    bool sectionsOK = header.fileSize == size;
+    auto section = [base, size, &sectionsOK](uint64_t offset, uint64_t count, size_t itemSize) -> const void *
+    {
+        if(offset % 8 != 0 || offset > size || count > (size-offset)/itemSize)
+        {
+            sectionsOK = false;
+            return 0;
+        }
+        return base+offset;
+    };
+    pack->_entries = static_cast<const MSAPackEntry *>(section(header.entryOffset, header.entryCount, sizeof(MSAPackEntry)));
+    pack->_detectors = static_cast<const MSAPackDetector *>(section(header.detectorOffset, header.detectorCount, sizeof(MSAPackDetector)));
+    pack->_texts = static_cast<const MSAPackString *>(section(header.textOffset, header.textCount, sizeof(MSAPackString)));
+    pack->_conditions = static_cast<const float *>(section(header.conditionOffset, header.conditionCount, sizeof(float)));
+    pack->_channels = static_cast<const float *>(section(header.channelOffset, header.channelCount, sizeof(float)));
+    pack->_strings = static_cast<const char *>(section(header.stringOffset, header.stringBytes, 1));
+    if(!sectionsOK)
+    {
+        termOutFile << "MSA spectrum pack file: " << pathName << " is truncated or damaged" << endl;
+        return -2;
+    }
+
+    if(pack->check(termOutFile, pathName) != 0)
+    {
+        return -3;
+    }
+
+    out_pack = pack;
+    return 0;
+}
+
+int pack_MSA_list(std::ostream &termOutFile, const std::string &listPathName, const std::string &packPathName)
+{
+    //  Names in the list without a path get the path of the list file, as for map and sum
+    string listFileName;
+    string listPath;
+    extract_path(listPathName, listPath, listFileName);
+
+    ifstream listFile(listPathName.c_str(), ios::in);
+    if(!listFile)
+    {
+        termOutFile << "Can't open list of spectrum file names from file " << listFileName << endl;
+        return -1;
+    }
+
+    MSASpectrumPack pack;
+    int failedCount = 0;
+    string spectrumPathName;
+    while(getline(listFile, spectrumPathName))
+    {
+        //  Skip blank lines and comments
+        string line_check = upper_trim(spectrumPathName);
+        if(line_check.length() < 2 || line_check.substr(0, 2) == COMMENT_STRING) continue;
+        string maybe_path;
+        string spectrumFileName;
+        if(!extract_path(spectrumPathName, maybe_path, spectrumFileName))
+        {
+            spectrumPathName = listPath + spectrumPathName;
+        }
+
+        if(!check_file_extension(spectrumPathName, "MSA"))
+        {
+            termOutFile << "Only EMSA (.msa) spectrum files can be packed, list has " << spectrumPathName << endl;
+            return -2;
+        }
+
+        XRFconditionsInput conditions;
+        vector <XraySpectrum> spectra;
+        int result = read_EMSA_PIXL(spectrumPathName, conditions, spectra);
+        if(result != 0)
+        {
+            termOutFile << "Can't read spectrum file " << spectrumPathName << ", result = " << result << " (it will be reported as an error when the pack is used)" << endl;
+            failedCount++;
+        }
+        pack.addEntry(spectrumPathName, result, conditions, spectra);
+    }
+
+    if(pack.finish(termOutFile, packPathName) != 0)
+    {
+        return -3;
+    }
+    int result = pack.write(termOutFile, packPathName);
+    if(result != 0)
+    {
+        return -10 + result;
+    }
+
+    termOutFile << "Wrote MSA spectrum pack: " << packPathName << " with " << pack.entryCount() << " spectrum files";
+    if(failedCount > 0)
+    {
+        termOutFile << " (" << failedCount << " could not be read)";
+    }
+    termOutFile << endl;
+    return 0;
+}
@@ -0,0 +1,197 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include "XraySpectrum.h"
+#include "XRFconditions.h"
+#include "mapped_file.h"
+
+// The spectrum files named in a map or sum list (.txt) read once and written to a single MSA spectrum pack file,
+// so map and sum don't have to open and parse one EMSA text file per spectrum. Each entry holds what read_EMSA_PIXL
+// produced for the file (conditions vector, Spec_Aux_Info, and for each detector the energy calibration, times,
+// Spec_Header_Info and channels), so the spectra rebuilt from the pack are exactly the ones the file would give.
+// Files that could not be read are kept with their error code and fail in the same way when the pack is used.
+// The size and modification time of each file are saved so a pack can warn when its files have changed since.
+//
+// File layout (native byte order, checked on open): MSAPackHeader, then each section at the offset given in
+// the header, 8-byte aligned. The file is memory-mapped read-only when used
+
+#define MSA_PACK_EXTENSION ".pqm"
+
+const uint32_t MSA_PACK_VERSION = 2;
+
+// Offset and length of a string in the string section (not zero terminated)
+struct MSAPackString
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct MSAPackHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+
+    uint32_t entryCount;
+    uint32_t detectorCount;
+    uint32_t textCount;
+    uint32_t conditionsPerEntry;
+    uint64_t conditionCount;
+    uint64_t channelCount;
+    uint64_t stringBytes;
+
+    uint64_t entryOffset;
+    uint64_t detectorOffset;
+    uint64_t textOffset;
+    uint64_t conditionOffset;
+    uint64_t channelOffset;
+    uint64_t stringOffset;
+    uint64_t fileSize;
+};
+
+// One spectrum file from the list
+struct MSAPackEntry
+{
+    uint64_t firstCondition;
+
+    MSAPackString path;     // As used to read it (with the path of the list file added if it had none)
+    MSAPackString optic_file_name;
+    MSAPackString tube_file_name;
+    MSAPackString anode_element_list;
+
+    //  Spec_Aux_Info, the same for all detectors (titles then comments are in the text section)
+    MSAPackString date;
+    MSAPackString time;
+    MSAPackString owner;
+    MSAPackString det_ID;
+
+    int32_t readResult;
+    uint32_t firstDetector;
+    uint32_t detectorCount;
+    uint32_t firstText;
+    uint32_t titleCount;
+    uint32_t commentCount;
+
+    float x;
+    float y;
+    float z;
+    float i;
+    float j;
+    uint32_t sclk;
+    uint32_t rtt;
+    uint32_t usn;
+    uint32_t dpc;
+    uint32_t pmc;
+
+    // The spectrum file when it was packed (size -1 if it didn't exist)
+    int64_t fileSize;
+    int64_t modifiedTime;   // seconds since the epoch
+};
+
+// One column (detector) of a spectrum file
+struct MSAPackDetector
+{
+    uint64_t firstChannel;
+    uint32_t channelCount;
+
+    float energyStart;
+    float energyPerChannel;
+    float quad;
+    float liveTime;
+    float realTime;
+
+    //  Spec_Header_Info
+    float live_time_DSPC;
+    int32_t events;
+    int32_t triggers;
+    int32_t overflows;
+    int32_t underflows;
+    int32_t baseline_samples;
+    int32_t preamp_resets;
+    int32_t saturates;
+};
+
+class MSASpectrumPack
+{
+public:
+    MSASpectrumPack();
+
+    // Used while packing, call finish() once every file has been added
+    void addEntry(const std::string &pathName, int readResult, const XRFconditionsInput &conditions, const std::vector <XraySpectrum> &spectra);
+    int finish(std::ostream &termOutFile, const std::string &pathName);
+
+    uint32_t entryCount() const { return _header.entryCount; }
+    std::string path(uint32_t idx) const { return str(_entries[idx].path); }
+
+    // Writes a warning for each spectrum file whose size or modification time has changed since it was packed,
+    // returns the number of changed files
+    uint32_t checkSourceFiles(std::ostream &termOutFile, const std::string &pathName) const;
+
+    // Rebuilds the spectra and conditions read from a file, returns the result read_EMSA_PIXL gave when it was packed
+    int read(uint32_t idx, std::vector <XraySpectrum> &spectra, XRFconditionsInput &conditions) const;
+
+    // Writes the pack file (to a temporary file that is then renamed, so other processes never see part of one)
+    int write(std::ostream &termOutFile, const std::string &pathName) const;
+    // Maps a pack file read-only, checks the header and that everything in it is in range
+    static int open(std::ostream &termOutFile, const std::string &pathName, std::shared_ptr<const MSASpectrumPack> &out_pack);
+
+private:
+    int check(std::ostream &termOutFile, const std::string &pathName) const;
+    MSAPackString addString(const std::string &s);
+    std::string str(const MSAPackString &s) const { return std::string(_strings+s.offset, s.length); }
+
+    MSAPackHeader _header;
+
+    // Sections, pointing into the mapped file or into the vectors below
+    const MSAPackEntry *_entries;
+    const MSAPackDetector *_detectors;
+    const MSAPackString *_texts;
+    const float *_conditions;
+    const float *_channels;
+    const char *_strings;
+
+    std::vector<MSAPackEntry> _ownedEntries;
+    std::vector<MSAPackDetector> _ownedDetectors;
+    std::vector<MSAPackString> _ownedTexts;
+    std::vector<float> _ownedConditions;
+    std::vector<float> _ownedChannels;
+    std::vector<char> _ownedStrings;
+
+    MappedFile _file;
+};
+
+// Reads every spectrum file in a list (.txt, same format as for map and sum) and writes them to an MSA spectrum pack file (pack sub-command)
+int pack_MSA_list(std::ostream &termOutFile, const std::string &listPathName, const std::string &packPathName);
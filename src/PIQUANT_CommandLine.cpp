@@ -113,11 +113,14 @@
 #include "time_code.h"
 #include "debug_stack.h"
 #include "map_threading.h"
+#include "MSA_spectrum_pack.h"
+#include "standards_threading.h"
 #include "setup_spectrum_parameters.h"
 #include <mutex>
 #include <thread>
 #include <chrono>
 #include "fpBeams.h"
+#include "Lfit.h"
 
 #include "version.h"
 
@@ -415,6 +418,14 @@
 //  Modified June 27, 2021  Add command line option to normalize element sum to 100% (or any value)
 //  Modified July 9, 2021   Add command line option to change Fe oxide ratio (-Fe)
 //  Modified July 10, 2021  Add simple pulse pileup calculation
+//  Modified Oct. 16, 2026  Read the calibration file once for map, evaluate, and quantify (quantLoadCalibration)
+//                          Warn if the calibration file can't be read for map, evaluate, or quantify (all ECFs are 1)
+//                          Fit the standards for calibrate and evaluate on the map worker threads (standards_threading.cpp)
+//                          Add pack sub-command to write a PIXLISE dataset as a memory-mapped spectrum store (.pqs)
+//                          Pack a list of MSA files into an MSA spectrum pack (.pqm) that map and sum can read instead of the list
+//                          Read the bulk sum spectra on worker threads with the -t option (added to the sum in list order)
+//                          Select the least-squares solver with the -L option and the tabulated cross sections with -X
+//                          Select Anderson mixing of the quantUnknown iteration updates with the -A option
 
 
 //  Remaining FP anomalies as of June 2021
@@ -475,6 +486,10 @@ try {
         //   OLD   arguments.quant_map_outputs = "xyzP";
     }
     if( arguments.iron_oxide_ratio >= 0 ) XrayMaterial::default_iron_oxide_ratio( arguments.iron_oxide_ratio );
+    lfitCholesky( arguments.lfit_cholesky );
+    quantAndersonMixing( arguments.anderson_depth );
+    //  Must be set before any cross-section tables are constructed
+    XrayXsectTable::tabulated( arguments.xsect_tabulated );
 
     // If we're asked for the version, just print it and return
     if(cmd == PRINT_VERSION) {
@@ -529,6 +544,19 @@ try {
 
     if( !arguments.fit_adjust_energy ) cout << "Adjustment of energy calibration during fits is disabled." << endl;
     if( !arguments.fit_adjust_width ) cout << "Adjustment of peak widths during fits is disabled." << endl;
+    if( arguments.lfit_cholesky ) cout << "Least-squares fits use the Cholesky solver." << endl;
+    if( arguments.anderson_depth > 0 ) cout << "Fit iterations use Anderson mixing of the last " << arguments.anderson_depth << " updates." << endl;
+    if( arguments.xsect_tabulated ) {
+        //  Check the grids against the splines for every element before they are used
+        int n_elements = 0;
+        float max_difference = 0;
+        float max_grid_error = 0;
+        XrayXsectTable::gridCheckAll( n_elements, max_difference, max_grid_error );
+        termOutFile << "Cross sections are tabulated for " << n_elements << " elements, largest difference from the splines ";
+        termOutFile << scientific << setprecision(2) << max_difference << "  (grid error " << max_grid_error << ", tolerance " << XSECT_GRID_TOLERANCE << ")" << endl;
+        termOutFile.setf( ios::fixed, ios::floatfield );
+        termOutFile.precision(2);
+    }
 
 
     //**************************************************************************
@@ -979,160 +1007,76 @@ try {
             fout.open(arguments.cal_eval_file);
             wroteMapHeader = false;
         }
-        //  Loop over all of the standards in the list
+        //  Set up a job for each standard in the list, so they can be fitted on the worker threads if more than one was requested
+        //      The results are applied to the standards list below in the original order
+        vector <unique_ptr<StandardJob>> jobs;
         int istd;
         for( istd=0; istd<standards.size(); istd++ ) {
             if( ( cmd == FIT_ONE_STANDARD ) && istd != standard_index ) continue;    //  only fit one standard so we can plot it and check fit
+            jobs.push_back( unique_ptr<StandardJob>( new StandardJob( cmd, istd, standards[istd], arguments,
+                    condStruct_config, configSpectrum, element_list, element_list_eval_master, oxidesOutput, 0, getVersionString() ) ) );
+        }
+        const bool threaded = arguments.map_threads > 1 && jobs.size() > 1;
+        if( threaded ) {
+            termOutFile << "Using " << arguments.map_threads << " threads to process standards." << endl;
+            runStandardJobs( arguments.map_threads, jobs, termOutFile );
+        }
+        //  Loop over all of the standards in the list
+        unsigned int ijob;
+        for( ijob=0; ijob<jobs.size(); ijob++ ) {
+            StandardJob &job = *jobs[ijob];
+            istd = job.getStandardIndex();
             //  Changed to only one spectrum file for each entry in the list of standards
-            spectrum_vec.clear();
-            string cal_optic_file;
-			XRFconditionsInput condStruct_cal;
-			if( standards[istd].spectrumFileName.length() == 0 ) {
-                termOutFile << "File name missing for standard number " << istd;
-                if( standards[istd].names.size() > 0 ) termOutFile << "   name " << standards[istd].names[0];
-                termOutFile << endl;
-                error = true;
-			} else {
-                result = read_spectrum_file( termOutFile, standards[istd].spectrumFileName,
-                        spectrum_vec, condStruct_cal );
-                if ( result != 0 ) {
-                    termOutFile << "read_spectrum_file failed, result = " << result << "   file " << standards[istd].spectrumFileName << endl;
-                    error = true;
-                    continue;
-                };
-            }
-            //  Set up energy calibration, background parameters, and measurement conditions
-            setup_spectrum_parameters( arguments, configSpectrum.calibration(), spectrum_vec,
-                    condStruct_config, condStruct_cal, cout );
-//                if( spectrum_vec.size() > 0 ) singleSpectrum = spectrum_vec[0];
-            //  Combine the spectrum information from several detectors (or the selected detector) into the variable where they will be used
-            //      NB: quantCombineSpectra modifies the spectra in the input list to match them to a single energy axis
-            //          for proper plotting
-            result = quantCombineSpectra( spectrum_vec, singleSpectrum, arguments.detector_select );
-            if( result < 0 ) {
-                error = true;
-                break;
-            };
-            if( singleSpectrum.live_time() <= 0 ) {
-                termOutFile << "*** Error - live time is bad, can't use this standard for calibration. ***" << endl;
-                error = true; //  Plot can be vs channels, all others are not possible without calibration
-                continue;
+            //  Read the spectrum, set up the conditions and fit it (unless it was already done on a worker thread)
+            if( threaded ) termOutFile << job.getFitLog().str();
+            else job.runFit( termOutFile );
+            if( job.getError() ) error = true;
+            if( job.getFlow() != STANDARD_OK || error ) {
+                job.takeSpectrum( singleSpectrum, spectrum_vec );
+                if( job.getFlow() == STANDARD_RETURN ) return job.getReturnCode();
+                if( job.getFlow() == STANDARD_CONTINUE ) continue;
+                break;  //  Don't write results so error will be at end of putput
             }
-            //  Add the standard name to the spectrum aux info titles (for output in map file if requested using "U")
-            if( standards[istd].names.size() > 0 ) {
-                singleSpectrum.aux_info_change().titles.clear();
-                singleSpectrum.aux_info_change().titles.push_back( standards[istd].names[0] );
-            }
-            //  Set up new instrument measurement conditions
-            XRFconditions calConditions;
-            result = fpSetupConditions ( condStruct_cal, calConditions );
-            if( result < 0 ) {
-                termOutFile << "fpSetupConditions failed, result " << result;
-                termOutFile << "   error in parameter with keyword " << get_EMSA_keyword( -(result+100) ) << endl;
-                error = true;
-                return -500 + result;
-            };
-            termOutFile << endl;
-            //  Input element fit control list overrides the one from standards input
-            vector <ElementListEntry> element_list_std;
-            int i_list;
-            //  Move element list from standards input file
-            for( i_list=0; i_list<standards[istd].element_list.size(); i_list++ )
-                add_element_list_entry( standards[istd].element_list[i_list], element_list_std );
-            //  Append or replace entries using element list from arguments
-            for( i_list=0; i_list<element_list.size(); i_list++ )
-                add_element_list_entry( element_list[i_list], element_list_std );
-            result = quantStandard(fpStorageST, standards[istd].mat, element_list_std, calConditions, singleSpectrum );
-            if ( result < 0 ) {
-                cout << "quantStandard failed, result = " << result << "   file " << standards[istd].spectrumFileName << endl;
-                error = true;
-            };
-            //  Complete list of components in spectrum
-/*            unsigned int ic;
-            cout << "Complete list of components (" << singleSpectrum.numberOfComponents() << "):" << endl;
-            for( ic=0; ic<singleSpectrum.numberOfComponents(); ic++ ) {
-                cout << "        " << componentDescription( singleSpectrum.component(ic) );
-                cout << "  enable " << singleSpectrum.component(ic).enabled;
-                cout << "  fit " << singleSpectrum.component(ic).fit;
-                cout << "  ignore " << singleSpectrum.component(ic).ignore;
-                cout << "  incl " << singleSpectrum.component(ic).included;
-                cout << "  bkg indx " << singleSpectrum.component(ic).bkg_index;
-                cout << "  coeff " << singleSpectrum.component(ic).coefficient;
-                cout << "  matrix " << singleSpectrum.component(ic).matrix;
-                cout << "  non-fit fac " << singleSpectrum.component(ic).non_fit_factor;
-                cout << "  quant " << singleSpectrum.component(ic).quant;
-                cout << endl;
-            }       */
             //  Write results to output file and put results in element list for map and calibration files
             //  This will fill the element list for the standards with the coefficients and other fit results
-            if( error ) break;  //  Don't write results so error will be at end of putput
-            float element_sum = 0;
-            result = quantWriteResults( standards[istd].mat, calConditions.detector, element_list_std,
-                                singleSpectrum, oxidesOutput, termOutFile, element_sum );
+            if( threaded ) termOutFile << job.getResultsLog().str();
+            else job.runResults( termOutFile );
             //  Move expanded element list with results back into standards info list
             //      add_element_list_entry function will automatically select info from appropriate entry
+            const vector <ElementListEntry> &element_list_std = job.getElementListResults();
             int iel;
             for( iel=0; iel<element_list_std.size(); iel++ ) {
                 add_element_list_entry( element_list_std[iel], standards[istd].element_list );
             }
             //  Add spectrum (with coefficients but erased component spectra) to standards list
             if( cmd == CALIBRATE ) {
-                singleSpectrum.clean(); //  No plot, don't need the component spectra, remove to save space
-                standards[istd].spectrum = singleSpectrum;
+                standards[istd].spectrum = job.getSpectrum();
             }
             //  For debugging and evaluation of the calibration, write a synopsis file using the evaluate format
             //      Calibrate does not normally write this, only then the -w option is invoked (which sets the file name)
             if( cmd == CALIBRATE && arguments.cal_eval_file.length() > 0 ) {
-                //  Duplicate the master list (to preserve it with default values)
-                vector <ElementListEntry> element_list_eval_copy;
-                unsigned int iel;
-                for( iel=0; iel<element_list_eval_master.size(); iel++ ) element_list_eval_copy.push_back( element_list_eval_master[iel] );
-                //  Replace the element list entries with quantification results to the copy (for writing to the map file, preserving element order)
-                for( iel=0; iel<element_list_std.size(); iel++ ) {
-                    //  Add coefficient as ECF to this new element list (if weight above threshold)
-                    element_list_std[iel].ecf = element_list_std[iel].coefficient;
-                    if( element_list_std[iel].qualifier == IGNORE
-                            || element_list_std[iel].qualifier == EXCLUDE
-                            || element_list_std[iel].qualifier == MATRIX ) continue;
-                    //  Only include elements that have weight greater then minimum (set in XRFcontrols.h)
-                    if( element_list_std[iel].weight <= arguments.min_wgt_eval ) continue;
-                    //  Replace the entry in the master list copy
-                    int i_copy;
-                    for( i_copy=0; i_copy<element_list_eval_copy.size(); i_copy++ ) {
-                        if( ! ( element_list_eval_copy[i_copy].element == element_list_std[iel].element ) ) continue;
-                        element_list_eval_copy[i_copy] = element_list_std[iel];
-                        break;
-                    }
-                    //termOutFile << "Element list cal  std: " << standards[istd].names[0] << "   s " << XrayMaterial::formula_string( element_list_std[iel].element, element_list_std[iel].stoichiometry ) << "  ";
-                    //termOutFile << "     p " << element_list_std[iel].percent;
-                    //termOutFile << "     u " << element_list_std[iel].uncertainty;
-                    //termOutFile << "     g " << element_list_std[iel].given;
-                    //termOutFile << "     o " << element_list_std[iel].stoichiometry.formula_ratio;
-                    //termOutFile << "     w " << element_list_std[iel].weight;
-                    //termOutFile << "     k " << element_list_std[iel].ecf;
-                    //termOutFile << endl;
-                }
-
                 // Write header if needed
                 if(!wroteMapHeader)
                 {
                     string eval_title = "Debug evaluation file for PIQUANT Calibrate sub-command";
-                    result = quantWriteMapHeader(fout, eval_title, arguments.quant_map_outputs, element_list_eval_copy, oxidesOutput);
+                    result = quantWriteMapHeader(fout, eval_title, arguments.quant_map_outputs, job.getElementListEval(), oxidesOutput);
                     wroteMapHeader = true;
 
                     if ( result != 0 ) {
                         termOutFile << "quantWriteMapHeader failed, result = " << result << endl;
                         error = true;
+                        job.takeSpectrum( singleSpectrum, spectrum_vec );
                         break;
                     }
                 }
 
                 //  Write line to map file
-                quantWriteMapRow(fout, arguments.quant_map_outputs, element_list_eval_copy,
-                                calConditions.detector, singleSpectrum, element_sum);
+                fout << job.getMapRow().str();
 
             }   //  if( cmd == CALIBRATE && arguments.cal_eval_file.length() > 0 )
-        }   //  end for( istd=0; istd<standards.size(); istd++ )
+            job.takeSpectrum( singleSpectrum, spectrum_vec );
+            jobs[ijob].reset();
+        }   //  end for( ijob=0; ijob<jobs.size(); ijob++ )
         //  Write the results to the calibration file
         //  Note that quantWriteResults must be called before this to populate the fit info for the standards
         termOutFile << endl;
@@ -1162,162 +1106,74 @@ try {
     //      Evaluate calibration by processing the spectrum from each standard as an unknown
     //**************************************************************************************
 
+    //  Read the calibration file once for all of the standards (element list is different for each one, so ECFs are not saved)
+    QuantCalibration evalCalibration;
+    if( ( cmd == EVALUATE ) && ( ! error ) ) {
+        vector <ElementListEntry> no_elements;
+        result = quantLoadCalibration( arguments.calibration_file, no_elements, termOutFile, evalCalibration );
+        //  Carry on without ECFs as before (the messages from reading the file are in each standard's log)
+        if( result != 0 ) termOutFile << "*** Warning can't read calibration file, result = " << result << "  for file name " << arguments.calibration_file << "  (all ECFs are 1)" << endl;
+    }
     if( ( cmd == EVALUATE ) && ( ! error ) ) {
         // The stream to the map file we're writing
         std::ofstream fout(arguments.map_file);
         bool wroteMapHeader = false;
+        //  Set up a job for each standard in the list, so they can be quantified on the worker threads if more than one was requested
+        //      The results are written to the map file below in the original order
+        vector <unique_ptr<StandardJob>> jobs;
         unsigned int istd;
-        //  Loop over all of the standards in the list
         for( istd=0; istd<standards.size(); istd++ ) {
             if( arguments.standard_selected && standard_index != istd )continue;
-            //  Read the spectrum file for this entry in the list of standards
-            spectrum_vec.clear();
-            string eval_optic_file;
-			XRFconditionsInput condStruct_eval;
-            result = read_spectrum_file( termOutFile, standards[istd].spectrumFileName,
-                    spectrum_vec, condStruct_eval );
-            if ( result != 0 ) {
-                cout << "read_spectrum_file failed, result = " << result << "   file " << standards[istd].spectrumFileName << endl;
-                error = true;
-                continue;
-            };
-            //  Set up energy calibration, background parameters, and measurement conditions
-            setup_spectrum_parameters( arguments, configSpectrum.calibration(), spectrum_vec,
-                    condStruct_config, condStruct_eval, cout );
-            //  Combine the spectrum information from several detectors (or the selected detector) into the variable where they will be used
-            //      NB: quantCombineSpectra modifies the spectra in the input list to match them to a single energy axis
-            //          for proper plotting
-            result = quantCombineSpectra( spectrum_vec, singleSpectrum, arguments.detector_select );
-            if( result < 0 ) {
-                error = true;
-                break;
-            };
-            //  Check live time
-            if( singleSpectrum.live_time() <= 0 ) {
-                termOutFile << "*** Error - live time is bad, can't use this standard for evaluation. ***" << endl;
-                error = true; //  Plot can be vs channels, all others are not possible without calibration
-                continue;
-            }
-            //Check energy calibration
-            if( ! singleSpectrum.calibration().good() ) {
-                termOutFile << "Bad energy calibration, can't quantify spectrum." << endl;
-                error = true;
-                break;
-            }
-            //  Set up new instrument measurement conditions
-            XRFconditions evalConditions;
-            result = fpSetupConditions ( condStruct_eval, evalConditions );
-            if( result < 0 ) {
-                termOutFile << "fpSetupConditions failed, result " << result;
-                termOutFile << "   error in parameter with keyword " << get_EMSA_keyword( -(result+100) ) << endl;
-                error = true;
-                return -500 + result;
-            };
-            termOutFile << endl;
-            //  Add the standard name to the spectrum aux info titles (for output in map file if requested using "U")
-            if( standards[istd].names.size() > 0 ) {
-                singleSpectrum.aux_info_change().titles.clear();
-                singleSpectrum.aux_info_change().titles.push_back( standards[istd].names[0] );
-            }
-            //  Input element fit control list overrides the one from standards input
-            vector <ElementListEntry> element_list_std_unk;
-            unsigned int i_list;
-            //  Move element list from standards input file
-            for( i_list=0; i_list<standards[istd].element_list.size(); i_list++ ) {
-                //  Only include elements that have positive weight (or are matrix elements)
-                if( standards[istd].element_list[i_list].qualifier != MATRIX && standards[istd].element_list[i_list].weight <= arguments.min_wgt_eval ) continue;
-                ElementListEntry element_list_std_unk_new = standards[istd].element_list[i_list];
-                add_element_list_entry( element_list_std_unk_new, element_list_std_unk );
-            }
-            //  Append or replace entries using element list from arguments if FORCE is chosen
-            for( i_list=0; i_list<element_list.size(); i_list++ ) {
-                if( element_list[i_list].qualifier != FORCE ) continue;
-                add_element_list_entry( element_list[i_list], element_list_std_unk );
-            }
-//            for( i_list=0; i_list<element_list_std_unk.size(); i_list++ )
-//        termOutFile << "Evaluate  Std Unk Element List " << i_list << "  " << (element_list_std_unk[i_list].qualifier == MATRIX?"MATRIX":"Not Marix") << "  " << element_list_std_unk[i_list].element.symbol() << "   " << element_list_std_unk[i_list].percent << endl;
-            //  Start with a fresh material and quantify as unknown using new element list from above
-            XrayMaterial std_unknown;
-            //  Put the names if the being evaluated into the spectrum object (so that it won't be used for making the ECFs)
-            singleSpectrum.std_names( standards[istd].names );
-            result = quantUnknown( std_unknown, element_list_std_unk, evalConditions, singleSpectrum, arguments.calibration_file, termOutFile );
-            if ( result < 0 ) {
-                termOutFile << "quantUnknown failed, result = " << result << "   file " << arguments.spectrum_file << endl;
-                error = true;
+            jobs.push_back( unique_ptr<StandardJob>( new StandardJob( cmd, istd, standards[istd], arguments,
+                    condStruct_config, configSpectrum, element_list, element_list_eval_master, oxidesOutput, &evalCalibration, getVersionString() ) ) );
+        }
+        const bool threaded = arguments.map_threads > 1 && jobs.size() > 1;
+        if( threaded ) {
+            termOutFile << "Using " << arguments.map_threads << " threads to process standards." << endl;
+            runStandardJobs( arguments.map_threads, jobs, termOutFile );
+        }
+        //  Loop over all of the standards in the list
+        unsigned int ijob;
+        for( ijob=0; ijob<jobs.size(); ijob++ ) {
+            StandardJob &job = *jobs[ijob];
+            istd = job.getStandardIndex();
+            //  Read the spectrum file for this entry in the list of standards, set up the conditions and quantify it as an unknown
+            //      (unless it was already done on a worker thread)
+            if( threaded ) termOutFile << job.getFitLog().str();
+            else job.runFit( termOutFile );
+            if( job.getError() ) error = true;
+            if( job.getFlow() != STANDARD_OK || error ) {
+                job.takeSpectrum( singleSpectrum, spectrum_vec );
+                if( job.getFlow() == STANDARD_RETURN ) return job.getReturnCode();
+                if( job.getFlow() == STANDARD_CONTINUE ) continue;
+                break;  //  Don't write results so error will be at end of putput
             }
             //  Write results to output file and put results in element list for map file
             //  This will fill the element list for the standards with the coefficients and other fit results
-            if( error ) break;  //  Don't write results so error will be at end of putput
-            float element_sum = 0;
-            result = quantWriteResults( std_unknown, evalConditions.detector, element_list_std_unk,
-                                singleSpectrum, oxidesOutput, termOutFile, element_sum, true );
-            //  Code to write plot file after evaluate when single standard chosen and -w option used to set file name
-            if( arguments.standard_selected && arguments.cal_eval_file.length() > 0 ) {
-                //  Write a CSV file of plotting information (if only one standard was included in the evaluation)
-                //  **** Hard-coded file name, for debugging only ****
-                termOutFile << endl;
-                termOutFile << "Writing plot to file " << arguments.cal_eval_file;
-                termOutFile << "      " << singleSpectrum.numberOfChannels() << " channels." << endl;
-                result = quantWritePlot( singleSpectrum, arguments.cal_eval_file, cmd, arguments.detector_select, spectrum_vec, getVersionString() );
-            }
-            //  Duplicate the master list (to preserve it with default values)
-            vector <ElementListEntry> element_list_eval_copy;
-            unsigned int iel;
-            for( iel=0; iel<element_list_eval_master.size(); iel++ ) element_list_eval_copy.push_back( element_list_eval_master[iel] );
-            //  Replace the element list entries with quantification results to the copy (for writing to the map file, preserving element order)
-            for( iel=0; iel<element_list_std_unk.size(); iel++ ) {
-                if( element_list_std_unk[iel].given <= 0 ) continue;
-                if( element_list_std_unk[iel].qualifier == IGNORE
-                        || element_list_std_unk[iel].qualifier == EXCLUDE
-                        || element_list_std_unk[iel].qualifier == MATRIX ) continue;
-                //  Replace the entry in the master list copy
-                int i_copy;
-                for( i_copy=0; i_copy<element_list_eval_copy.size(); i_copy++ ) {
-                    if( ! ( element_list_eval_copy[i_copy].element == element_list_std_unk[iel].element ) ) continue;
-                    element_list_eval_copy[i_copy] = element_list_std_unk[iel];
-                    break;
-                }
-                //termOutFile << "Element list std unk  s " << XrayMaterial::formula_string( element_list_std_unk[iel].element, element_list_std_unk[iel].stoichiometry ) << "  ";
-                //termOutFile << "     lv " << element_list_std_unk[iel].quant_level;
-                //termOutFile << "     q " << element_list_std_unk[iel].qualifier;
-                //termOutFile << "     p " << element_list_std_unk[iel].percent;
-                //termOutFile << "     u " << element_list_std_unk[iel].uncertainty;
-                //termOutFile << "     o " << element_list_std_unk[iel].stoichiometry.formula_ratio;
-                //termOutFile << "     w " << element_list_std_unk[iel].weight;
-                //termOutFile << endl;
-            }
-/*            for( iel=0; iel<element_list_eval_copy.size(); iel++ ) {
-                termOutFile << "Element list eval copy  s " << XrayMaterial::formula_string( element_list_eval_copy[iel].element, element_list_eval_copy[iel].stoichiometry ) << "  ";
-                termOutFile << "     lv " << element_list_eval_copy[iel].quant_level;
-                termOutFile << "     q " << element_list_eval_copy[iel].qualifier;
-                termOutFile << "     p " << element_list_eval_copy[iel].percent;
-                termOutFile << "     u " << element_list_eval_copy[iel].uncertainty;
-                termOutFile << "     o " << element_list_eval_copy[iel].stoichiometry.formula_ratio;
-                termOutFile << "     w " << element_list_eval_copy[iel].weight;
-                termOutFile << endl;
-            }
-*/
+            if( threaded ) termOutFile << job.getResultsLog().str();
+            else job.runResults( termOutFile );
             // Write header if needed
             if(!wroteMapHeader)
             {
                 // TIMTIME: What title should go in here???
-                result = quantWriteMapHeader(fout, "Insert Title Here", arguments.quant_map_outputs, element_list_eval_copy, oxidesOutput);
+                result = quantWriteMapHeader(fout, "Insert Title Here", arguments.quant_map_outputs, job.getElementListEval(), oxidesOutput);
                 wroteMapHeader = true;
 
                 if ( result != 0 ) {
                     termOutFile << "quantWriteMapHeader failed, result = " << result << endl;
                     error = true;
+                    job.takeSpectrum( singleSpectrum, spectrum_vec );
                     break;
                 }
             }
 
             //  Write line to map file
-            quantWriteMapRow(fout, arguments.quant_map_outputs, element_list_eval_copy,
-                            evalConditions.detector, singleSpectrum, element_sum);
+            fout << job.getMapRow().str();
 
             //  Add spectrum (with coefficients but erased component spectra) to standards list
-            singleSpectrum.clean(); //  No plot, don't need the component spectra, remove to save space
-            standards[istd].spectrum = singleSpectrum;
+            standards[istd].spectrum = job.getSpectrum();
+            job.takeSpectrum( singleSpectrum, spectrum_vec );
+            jobs[ijob].reset();
         }   //  Loop over all of the standards in the list
 
         if( ! error ) {
@@ -1380,7 +1236,8 @@ try {
         {
             LST_INCREMENTING_FILES,
             LST_MSA_LIST,
-            LST_PIXLISE_FILE
+            LST_PIXLISE_FILE,
+            LST_MSA_PACK
         };
 
         FileListType fileListType = LST_INCREMENTING_FILES;
@@ -1394,6 +1251,9 @@ try {
         else if(check_file_extension( map_spec_file_name, "PMCS")) {
             fileListType = LST_PIXLISE_FILE;
         }
+        else if(check_file_extension( map_spec_file_name, "PQM")) {
+            fileListType = LST_MSA_PACK;
+        }
 
         ifstream map_file_name_list;
         if( fileListType == LST_MSA_LIST ) {
@@ -1417,8 +1277,8 @@ try {
             // Got the file open, get the first line, as this should be the name/path of the PIXLISE binary file
             getline( map_file_pmc_list, map_spec_file );
 
-            if(map_spec_file.length() <= 4 || map_spec_file.substr(map_spec_file.length()-4) != ".bin") {
-                termOutFile << "Did not find PIXLISE binary file name as first line of PMC list file " << pmc_list_file_name << ", read: " << map_spec_file << endl;
+            if( ! is_PIXLISE_dataset_file( map_spec_file ) ) {
+                termOutFile << "Did not find PIXLISE binary file (.bin) or spectrum store (.pqs) name as first line of PMC list file " << pmc_list_file_name << ", read: " << map_spec_file << endl;
                 error = true;
             } else {
                 // Put the path in front
@@ -1428,6 +1288,31 @@ try {
             }
         }
 
+        //  Parse the PIXLISE dataset once here, all map jobs then read their PMCs from this copy
+        std::shared_ptr<const PIXLISEDataset> pixlise_dataset;
+        if( fileListType == LST_PIXLISE_FILE && cmd == MAP && !error ) {
+            result = load_PIXLISE_dataset( termOutFile, map_spec_file, pixlise_dataset );
+            if( result != 0 ) {
+                termOutFile << "Can't load PIXLISE dataset binary file " << map_spec_file << endl;
+                error = true;
+            }
+        }
+
+        //  A list of spectrum files packed by the pack sub-command, mapped once and shared by all map jobs
+        std::shared_ptr<const MSASpectrumPack> msa_pack;
+        uint32_t pack_entry = 0;
+        if( fileListType == LST_MSA_PACK ) {
+            result = MSASpectrumPack::open( termOutFile, map_spec_file, msa_pack );
+            if( result != 0 ) {
+                termOutFile << "Can't open MSA spectrum pack file " << map_spec_file << endl;
+                error = true;
+            } else {
+                termOutFile << "Opened MSA spectrum pack: " << map_spec_file << " with " << msa_pack->entryCount() << " spectrum files" << endl;
+                //  Stale packs are still used (the spectra are the ones packed), but say so
+                msa_pack->checkSourceFiles( termOutFile, map_spec_file );
+            }
+        }
+
         int n_map_spectra = 0;
         //  We only need these for the BULK_SUM_MAX command, but they must be declared at this scope
         vector <float> bulk_sum;
@@ -1443,14 +1328,30 @@ try {
 
         // If we're processing a map command, start the processing threads
         vector<std::thread> processThreads;
+        //  With more than one thread the bulk sum spectra are read on worker threads, they are still added to the sum in list order
+        const bool threadedBulkSum = ( cmd == BULK_SUM_MAX && arguments.map_threads > 1 );
+        if(threadedBulkSum && !error)
+        {
+            startBulkSumJobs(arguments.map_threads);
+
+            termOutFile << "Using " << arguments.map_threads << " threads to read bulk sum spectra." << endl;
+            for(int c = 0; c < arguments.map_threads; c++)
+            {
+                processThreads.push_back(std::thread(processBulkSumJob, c));
+            }
+        }
         if(cmd == MAP && !error)
         {
-            setMapJobRunning(cmd == MAP);
+            //  Read the calibration file once for all of the map spectra (carry on without ECFs as before if it can't be read)
+            result = loadMapCalibration(termOutFile, arguments, element_list);
+            if( result != 0 ) termOutFile << "*** Warning can't read calibration file, result = " << result << "  for file name " << arguments.calibration_file << "  (all ECFs are 1)" << endl;
+
+            startMapJobs(arguments.map_threads, condStruct_config, arguments, oxidesOutput, configSpectrum, element_list);
 
             termOutFile << "Using " << arguments.map_threads << " threads to process maps." << endl;
             for(int c = 0; c < arguments.map_threads; c++)
             {
-                processThreads.push_back(std::thread(processMapJob));
+                processThreads.push_back(std::thread(processMapJob, c));
             }
         }
 
@@ -1469,6 +1370,10 @@ try {
                     maybe_path = map_spec_file_path + map_spec_file;
                     map_spec_file = maybe_path;
                 }
+            } else if(fileListType == LST_MSA_PACK) {
+                if( pack_entry >= msa_pack->entryCount() ) break;
+                map_spec_file = msa_pack->path( pack_entry );
+                pack_entry++;
             } else if(fileListType == LST_PIXLISE_FILE) {
                 // Expecting this next line to contain a PMC to process, so read it as such
                 getline(map_file_pmc_list, pmcLine);
@@ -1503,7 +1408,18 @@ try {
                 }
             }
 
-            if(cmd == BULK_SUM_MAX) {
+            if(cmd == BULK_SUM_MAX && threadedBulkSum) {
+                //  Nothing after a spectrum that failed is added, so stop there as the loop below does
+                if( bulkSumJobsFailed() ) break;
+                queueBulkSumSpectrum(map_spec_file,
+                    condStruct_config,
+                    arguments,
+                    configSpectrum,
+                    sequence_number,
+                    msa_pack,
+                    pack_entry-1);
+            }
+            else if(cmd == BULK_SUM_MAX) {
                 result = spectrumBulkSumMax(map_spec_file,
 
                     condStruct_config,
@@ -1515,6 +1431,8 @@ try {
                     n_map_spectra,
 
                     sequence_number,
+                    msa_pack,
+                    pack_entry-1,
                     bulk_sum,
                     max_value,
                     sum_live_time,
@@ -1528,19 +1446,11 @@ try {
             {
                 // Let it run, results end up in output queue
                 queueMapSpectrum(map_spec_file,
-
-                    condStruct_config,
-
-                    arguments,
-                    oxidesOutput,
-
-                    configSpectrum,
-                    n_map_spectra,
-
-                    element_list,
-
                     sequence_number,
-                    pmcLine);
+                    pmcLine,
+                    pixlise_dataset,
+                    msa_pack,
+                    pack_entry-1);
             }
 
             if(result < -1)
@@ -1563,6 +1473,15 @@ try {
                 }
             }
         }   //  while( n_map_spectra < max_map_spectra )
+        if(threadedBulkSum && !processThreads.empty()) {
+            //  Wait for the remaining spectra to be read and added to the sum
+            finishBulkSumJobs();
+            for(int c = 0; c < processThreads.size(); c++)
+            {
+                processThreads[c].join();
+            }
+            takeBulkSumResults(bulk_sum, max_value, sum_live_time, sum_geometry, geometry_count, singleSpectrum, error);
+        }
         if(cmd == BULK_SUM_MAX ) {
             //  Finish this command by putting results in singleSpectrum for plotting
             singleSpectrum.meas( bulk_sum );
@@ -1576,11 +1495,11 @@ try {
             }
         }
 
-	    if(cmd == MAP)
+	    if(cmd == MAP && !processThreads.empty())
         {
             // Wait for all threads to finish
             termOutFile << "Waiting for process threads to finish..." << endl;
-            setMapJobRunning(false);
+            finishMapJobs();
             for(int c = 0; c < processThreads.size(); c++)
             {
                 processThreads[c].join();
@@ -1590,7 +1509,7 @@ try {
 
             termOutFile << endl << endl;
 
-            outputMapFile(termOutFile, arguments, element_list, oxidesOutput);
+            outputMapFile(termOutFile, arguments);
         }
 
     }   //  if( ( cmd == MAP || cmd == BULK_SUM_MAX ) )
@@ -1618,7 +1537,11 @@ try {
                 return -500 + result;
             };
             XrayMaterial unknown;
-            result = quantUnknown( unknown, element_list, unkConditions, singleSpectrum, arguments.calibration_file, cout );
+            QuantCalibration unkCalibration;
+            result = quantLoadCalibration( arguments.calibration_file, element_list, cout, unkCalibration );
+            //  Carry on without ECFs as before (the messages from reading the file are in the quantUnknown output)
+            if( result != 0 ) termOutFile << "*** Warning can't read calibration file, result = " << result << "  for file name " << arguments.calibration_file << "  (all ECFs are 1)" << endl;
+            result = quantUnknown( unknown, element_list, unkConditions, singleSpectrum, unkCalibration, cout );
             if ( result < 0 ) {
                 cout << "quantUnknown failed, result = " << result << "   file " << arguments.spectrum_file << endl;
                 error = true;
@@ -1706,6 +1629,34 @@ try {
     }   //  if( cmd == EM_SDD_DATA )
 
 
+    //**************************************************************************
+    //      Decode a PIXLISE dataset once into a spectrum store file,
+    //      or read a list of MSA files once into an MSA spectrum pack file
+    //      Maps can then memory-map the file instead of parsing the spectra
+    //**************************************************************************
+
+    if( ( cmd == PACK ) && ( ! error ) ) {
+        if( check_file_extension( arguments.spectrum_file, "TXT" ) ) {
+            if( ! check_file_extension( arguments.map_file, "PQM" ) ) {
+                termOutFile << "MSA spectrum pack file name must end in .pqm to be recognized by map and sum: " << arguments.map_file << endl;
+                error = true;
+            } else {
+                result = pack_MSA_list( termOutFile, arguments.spectrum_file, arguments.map_file );
+                if ( result < 0 ) {
+                    termOutFile << "Packing list of MSA files into spectrum pack failed, result = " << result << endl;
+                    error = true;
+                }
+            }
+        } else {
+            result = pack_PIXLISE_dataset( termOutFile, arguments.spectrum_file, arguments.map_file );
+            if ( result < 0 ) {
+                termOutFile << "Packing PIXLISE dataset into spectrum store failed, result = " << result << endl;
+                error = true;
+            }
+        }
+    }   //  if( cmd == PACK )
+
+
 
 	finishTime = clock();
 	double duration = (double) ( finishTime - startTime ) / CLOCKS_PER_SEC;
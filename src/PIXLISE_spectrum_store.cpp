@@ -0,0 +1,350 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "PIXLISE_spectrum_store.h"
+
+#include <fstream>
+#include <map>
+#include <algorithm>
+#include <string.h>
+
+using namespace std;
+
+static const char PIXLISE_STORE_MAGIC[8] = { 'P', 'Q', 'S', 'T', 'O', 'R', 'E', 0 };
+static const uint32_t PIXLISE_STORE_BYTE_ORDER = 0x01020304;
+
+static uint64_t alignSection(uint64_t offset)
+{
+    return (offset + 7) & ~uint64_t(7);
+}
+
+PIXLISESpectrumStore::PIXLISESpectrumStore() :
+    _labels(0),
+    _locations(0),
+    _pmcs(0),
+    _detectors(0),
+    _metas(0),
+    _channels(0),
+    _strings(0)
+{
+    memset(&_header, 0, sizeof(_header));
+    memcpy(_header.magic, PIXLISE_STORE_MAGIC, sizeof(_header.magic));
+    _header.version = PIXLISE_STORE_VERSION;
+    _header.byteOrder = PIXLISE_STORE_BYTE_ORDER;
+}
+
+PIXLISESpectrumStore::~PIXLISESpectrumStore()
+{
+}
+
+uint32_t PIXLISESpectrumStore::addString(const std::string &s)
+{
+    uint32_t offset = _ownedStrings.size();
+    _ownedStrings.insert(_ownedStrings.end(), s.begin(), s.end());
+    return offset;
+}
+
+void PIXLISESpectrumStore::addLabel(const std::string &name, PIXLISEStoreMetaType type)
+{
+    PIXLISEStoreLabel label;
+    label.name.offset = addString(name);
+    label.name.length = name.length();
+    label.type = type;
+    label.pad = 0;
+    _ownedLabels.push_back(label);
+}
+
+void PIXLISESpectrumStore::addLocation(int pmc, bool hasBeam, float x, float y, float z, float image_i, float image_j, float geom_corr)
+{
+    PIXLISEStoreLocation loc;
+    loc.pmc = pmc;
+    loc.hasBeam = hasBeam ? 1 : 0;
+    loc.x = x;
+    loc.y = y;
+    loc.z = z;
+    loc.image_i = image_i;
+    loc.image_j = image_j;
+    loc.geom_corr = geom_corr;
+    loc.firstDetector = _ownedDetectors.size();
+    loc.detectorCount = 0;
+    _ownedLocations.push_back(loc);
+}
+
+void PIXLISESpectrumStore::addDetector()
+{
+    PIXLISEStoreDetector detector;
+    detector.firstMeta = _ownedMetas.size();
+    detector.firstChannel = _ownedChannels.size();
+    detector.metaCount = 0;
+    detector.channelCount = 0;
+    _ownedDetectors.push_back(detector);
+    _ownedLocations.back().detectorCount++;
+}
+
+void PIXLISESpectrumStore::addMeta(uint32_t label, const std::string &svalue, int64_t ivalue, float fvalue)
+{
+    PIXLISEStoreMeta meta;
+    meta.label = label;
+    meta.fvalue = fvalue;
+    meta.ivalue = ivalue;
+    meta.svalue.offset = addString(svalue);
+    meta.svalue.length = svalue.length();
+    _ownedMetas.push_back(meta);
+    _ownedDetectors.back().metaCount++;
+}
+
+int PIXLISESpectrumStore::finish(std::ostream &termOutFile, const std::string &pathName)
+{
+    // If a PMC is repeated, we keep the first one, as the old scan through the locations would have
+    std::map<int, uint32_t> locationIdxByPMC;
+    for(uint32_t c = 0; c < _ownedLocations.size(); c++)
+    {
+        auto locPMC = _ownedLocations[c].pmc;
+        if(!locationIdxByPMC.insert(std::make_pair(locPMC, c)).second)
+        {
+            termOutFile << "PIXLISE binary file: " << pathName << " has duplicate location for pmc: " << locPMC << ", using first one" << endl;
+        }
+    }
+
+    _ownedPMCs.clear();
+    for(auto it = locationIdxByPMC.begin(); it != locationIdxByPMC.end(); it++)
+    {
+        PIXLISEStorePMC pmc;
+        pmc.pmc = it->first;
+        pmc.location = it->second;
+        _ownedPMCs.push_back(pmc);
+    }
+
+    _header.labelCount = _ownedLabels.size();
+    _header.locationCount = _ownedLocations.size();
+    _header.pmcCount = _ownedPMCs.size();
+    _header.detectorCount = _ownedDetectors.size();
+    _header.metaCount = _ownedMetas.size();
+    _header.channelCount = _ownedChannels.size();
+    _header.stringBytes = _ownedStrings.size();
+
+    _labels = _ownedLabels.data();
+    _locations = _ownedLocations.data();
+    _pmcs = _ownedPMCs.data();
+    _detectors = _ownedDetectors.data();
+    _metas = _ownedMetas.data();
+    _channels = _ownedChannels.data();
+    _strings = _ownedStrings.data();
+
+    return check(termOutFile, pathName);
+}
+
+bool PIXLISESpectrumStore::equals(const PIXLISEStoreString &s, const char *text) const
+{
+    return strlen(text) == s.length && memcmp(_strings+s.offset, text, s.length) == 0;
+}
+
+int PIXLISESpectrumStore::findLocation(int pmc) const
+{
+    const PIXLISEStorePMC *end = _pmcs+_header.pmcCount;
+    const PIXLISEStorePMC *it = std::lower_bound(_pmcs, end, pmc,
+        [](const PIXLISEStorePMC &entry, int value) { return entry.pmc < value; });
+    if(it == end || it->pmc != pmc)
+    {
+        return -1;
+    }
+    return it->location;
+}
+
+// Everything in a store file is checked once when it's opened, so reading spectra from it needs no checks
+int PIXLISESpectrumStore::check(std::ostream &termOutFile, const std::string &pathName) const
+{
+    const char *problem = 0;
+    for(uint32_t c = 0; c < _header.labelCount && !problem; c++)
+    {
+        if(uint64_t(_labels[c].name.offset)+_labels[c].name.length > _header.stringBytes)
+        {
+            problem = "label name out of range";
+        }
+    }
+    for(uint32_t c = 0; c < _header.locationCount && !problem; c++)
+    {
+        if(uint64_t(_locations[c].firstDetector)+_locations[c].detectorCount > _header.detectorCount)
+        {
+            problem = "location detectors out of range";
+        }
+    }
+    for(uint32_t c = 0; c < _header.pmcCount && !problem; c++)
+    {
+        if(_pmcs[c].location >= _header.locationCount || (c > 0 && _pmcs[c-1].pmc >= _pmcs[c].pmc))
+        {
+            problem = "PMC index not valid";
+        }
+    }
+    for(uint32_t c = 0; c < _header.detectorCount && !problem; c++)
+    {
+        if(_detectors[c].firstMeta+_detectors[c].metaCount > _header.metaCount ||
+           _detectors[c].firstChannel+_detectors[c].channelCount > _header.channelCount)
+        {
+            problem = "detector spectrum out of range";
+        }
+    }
+    for(uint64_t c = 0; c < _header.metaCount && !problem; c++)
+    {
+        if(_metas[c].label >= _header.labelCount ||
+           uint64_t(_metas[c].svalue.offset)+_metas[c].svalue.length > _header.stringBytes)
+        {
+            problem = "metadata item out of range";
+        }
+    }
+
+    if(problem)
+    {
+        termOutFile << "PIXLISE dataset: " << pathName << " is not valid, " << problem << endl;
+        return -1;
+    }
+    return 0;
+}
+
+int PIXLISESpectrumStore::write(std::ostream &termOutFile, const std::string &pathName) const
+{
+    PIXLISEStoreHeader header = _header;
+    header.labelOffset = alignSection(sizeof(header));
+    header.locationOffset = alignSection(header.labelOffset + header.labelCount*sizeof(PIXLISEStoreLabel));
+    header.pmcOffset = alignSection(header.locationOffset + header.locationCount*sizeof(PIXLISEStoreLocation));
+    header.detectorOffset = alignSection(header.pmcOffset + header.pmcCount*sizeof(PIXLISEStorePMC));
+    header.metaOffset = alignSection(header.detectorOffset + header.detectorCount*sizeof(PIXLISEStoreDetector));
+    header.channelOffset = alignSection(header.metaOffset + header.metaCount*sizeof(PIXLISEStoreMeta));
+    header.stringOffset = alignSection(header.channelOffset + header.channelCount*sizeof(int32_t));
+    header.fileSize = header.stringOffset + header.stringBytes;
+
+    // Write to a temporary file and rename it when complete, so a map started in another process
+    // can't map a store that is only partly written
+    const string tempPathName = pathName+".tmp";
+    {
+        ofstream fout(tempPathName.c_str(), ios::out | ios::binary | ios::trunc);
+        if(!fout)
+        {
+            termOutFile << "Can't open spectrum store file for writing: " << tempPathName << endl;
+            return -1;
+        }
+
+        uint64_t written = 0;
+        auto writeSection = [&fout, &written](uint64_t offset, const void *data, uint64_t bytes)
+        {
+            static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+            fout.write(zeros, offset-written);
+            if(bytes > 0)
+            {
+                fout.write(static_cast<const char *>(data), bytes);
+            }
+            written = offset+bytes;
+        };
+
+        writeSection(0, &header, sizeof(header));
+        writeSection(header.labelOffset, _labels, header.labelCount*sizeof(PIXLISEStoreLabel));
+        writeSection(header.locationOffset, _locations, header.locationCount*sizeof(PIXLISEStoreLocation));
+        writeSection(header.pmcOffset, _pmcs, header.pmcCount*sizeof(PIXLISEStorePMC));
+        writeSection(header.detectorOffset, _detectors, header.detectorCount*sizeof(PIXLISEStoreDetector));
+        writeSection(header.metaOffset, _metas, header.metaCount*sizeof(PIXLISEStoreMeta));
+        writeSection(header.channelOffset, _channels, header.channelCount*sizeof(int32_t));
+        writeSection(header.stringOffset, _strings, header.stringBytes);
+
+        if(!fout)
+        {
+            termOutFile << "Failed to write spectrum store file: " << tempPathName << endl;
+            return -2;
+        }
+    }
+
+    return replaceWithTempFile(termOutFile, tempPathName, pathName, "spectrum store");
+}
+
+int PIXLISESpectrumStore::open(std::ostream &termOutFile, const std::string &pathName, std::shared_ptr<const PIXLISESpectrumStore> &out_store)
+{
+    out_store.reset();
+    std::shared_ptr<PIXLISESpectrumStore> store = std::make_shared<PIXLISESpectrumStore>();
+
+    if(store->_file.open(termOutFile, pathName, "spectrum store") != 0)
+    {
+        return -1;
+    }
+    const char *base = store->_file.data();
+    const uint64_t size = store->_file.size();
+
+    if(size < sizeof(PIXLISEStoreHeader))
+    {
+        termOutFile << "Spectrum store file: " << pathName << " is too short" << endl;
+        return -2;
+    }
+    PIXLISEStoreHeader &header = store->_header;
+    memcpy(&header, base, sizeof(header));
+    if(memcmp(header.magic, PIXLISE_STORE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        termOutFile << "File: " << pathName << " is not a PIQUANT spectrum store" << endl;
+        return -2;
+    }
+    if(header.byteOrder != PIXLISE_STORE_BYTE_ORDER)
+    {
+        termOutFile << "Spectrum store file: " << pathName << " was written on a machine with a different byte order" << endl;
+        return -2;
+    }
+    if(header.version != PIXLISE_STORE_VERSION)
+    {
+        termOutFile << "Spectrum store file: " << pathName << " is version " << header.version << ", expected version " << PIXLISE_STORE_VERSION << " (pack the dataset again)" << endl;
+        return -2;
+    }
+
+    // Each section must be aligned and fit in the file
+    bool sectionsOK = header.fileSize == size;
+    auto section = [base, size, &sectionsOK](uint64_t offset, uint64_t count, size_t itemSize) -> const void *
+    {
+        if(offset % 8 != 0 || offset > size || count > (size-offset)/itemSize)
+        {
+            sectionsOK = false;
+            return 0;
+        }
+        return base+offset;
+    };
+    store->_labels = static_cast<const PIXLISEStoreLabel *>(section(header.labelOffset, header.labelCount, sizeof(PIXLISEStoreLabel)));
+    store->_locations = static_cast<const PIXLISEStoreLocation *>(section(header.locationOffset, header.locationCount, sizeof(PIXLISEStoreLocation)));
+    store->_pmcs = static_cast<const PIXLISEStorePMC *>(section(header.pmcOffset, header.pmcCount, sizeof(PIXLISEStorePMC)));
+    store->_detectors = static_cast<const PIXLISEStoreDetector *>(section(header.detectorOffset, header.detectorCount, sizeof(PIXLISEStoreDetector)));
+    store->_metas = static_cast<const PIXLISEStoreMeta *>(section(header.metaOffset, header.metaCount, sizeof(PIXLISEStoreMeta)));
+    store->_channels = static_cast<const int32_t *>(section(header.channelOffset, header.channelCount, sizeof(int32_t)));
+    store->_strings = static_cast<const char *>(section(header.stringOffset, header.stringBytes, 1));
+    if(!sectionsOK)
+    {
+        termOutFile << "Spectrum store file: " << pathName << " is truncated or damaged" << endl;
+        return -2;
+    }
+
+    if(store->check(termOutFile, pathName) != 0)
+    {
+        return -3;
+    }
+
+    out_store = store;
+    return 0;
+}
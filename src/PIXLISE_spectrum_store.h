@@ -0,0 +1,202 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include "mapped_file.h"
+
+// A PIXLISE dataset decoded into flat arrays, so it can be written to a spectrum store file once and then
+// memory-mapped read-only by any number of PIQUANT processes (they share the page cache and nothing has to be
+// parsed when a map starts). A dataset read from a PIXLISE binary (.bin) file is decoded into the same arrays,
+// so read_PIXLISE_spectrum doesn't care where it came from.
+//
+// File layout (native byte order, checked on open): PIXLISEStoreHeader, then each section at the offset given
+// in the header, 8-byte aligned. Spectrum channels are kept zero-run-length encoded as in the PIXLISE file,
+// metadata items keep their label index and values so they are interpreted exactly as they would be from the
+// .bin file (including the conditions, which are applied over the configuration file values per spectrum)
+
+#define PIXLISE_STORE_EXTENSION ".pqs"
+
+const uint32_t PIXLISE_STORE_VERSION = 1;
+
+// Most channels a decoded spectrum can have (zero runs that would go past this are rejected when decoding)
+const uint32_t PIXLISE_MAX_SPECTRUM_CHANNELS = 65536;
+
+enum PIXLISEStoreMetaType
+{
+    PIXLISE_META_FLOAT = 0,
+    PIXLISE_META_INT = 1,
+    PIXLISE_META_STRING = 2,
+    PIXLISE_META_UNKNOWN = 3
+};
+
+// Offset and length of a string in the string section (not zero terminated)
+struct PIXLISEStoreString
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct PIXLISEStoreHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+
+    uint32_t labelCount;
+    uint32_t locationCount;
+    uint32_t pmcCount;
+    uint32_t detectorCount;
+    uint64_t metaCount;
+    uint64_t channelCount;
+    uint64_t stringBytes;
+
+    uint64_t labelOffset;
+    uint64_t locationOffset;
+    uint64_t pmcOffset;
+    uint64_t detectorOffset;
+    uint64_t metaOffset;
+    uint64_t channelOffset;
+    uint64_t stringOffset;
+    uint64_t fileSize;
+};
+
+struct PIXLISEStoreLabel
+{
+    PIXLISEStoreString name;
+    int32_t type;   // PIXLISEStoreMetaType
+    int32_t pad;
+};
+
+struct PIXLISEStoreLocation
+{
+    int32_t pmc;
+    int32_t hasBeam;
+    float x;
+    float y;
+    float z;
+    float image_i;
+    float image_j;
+    float geom_corr;
+    uint32_t firstDetector;
+    uint32_t detectorCount;
+};
+
+// PMC index, sorted by PMC. If a PMC is repeated in the dataset only the first location is in here
+struct PIXLISEStorePMC
+{
+    int32_t pmc;
+    uint32_t location;
+};
+
+struct PIXLISEStoreDetector
+{
+    uint64_t firstMeta;
+    uint64_t firstChannel;
+    uint32_t metaCount;
+    uint32_t channelCount;
+};
+
+struct PIXLISEStoreMeta
+{
+    uint32_t label;
+    float fvalue;
+    int64_t ivalue;
+    PIXLISEStoreString svalue;
+};
+
+class PIXLISESpectrumStore
+{
+public:
+    PIXLISESpectrumStore();
+    ~PIXLISESpectrumStore();
+
+    // Used while decoding a dataset, call finish() once everything has been added
+    void addLabel(const std::string &name, PIXLISEStoreMetaType type);
+    void addLocation(int pmc, bool hasBeam, float x, float y, float z, float image_i, float image_j, float geom_corr);
+    // Adds a detector spectrum to the last location added
+    void addDetector();
+    // Adds a metadata item to the last detector added
+    void addMeta(uint32_t label, const std::string &svalue, int64_t ivalue, float fvalue);
+    // Appends a (run-length encoded) channel value to the last detector added
+    void addChannel(int32_t value) { _ownedChannels.push_back(value); _ownedDetectors.back().channelCount++; }
+    // Builds the PMC index (writing messages for repeated PMCs) and checks everything added is in range
+    int finish(std::ostream &termOutFile, const std::string &pathName);
+
+    uint32_t labelCount() const { return _header.labelCount; }
+    uint32_t locationCount() const { return _header.locationCount; }
+
+    const PIXLISEStoreLabel &label(uint32_t idx) const { return _labels[idx]; }
+    const PIXLISEStoreLocation &location(uint32_t idx) const { return _locations[idx]; }
+    const PIXLISEStoreDetector &detector(uint32_t idx) const { return _detectors[idx]; }
+    const PIXLISEStoreMeta &meta(uint64_t idx) const { return _metas[idx]; }
+    const int32_t *channels(const PIXLISEStoreDetector &detector) const { return _channels+detector.firstChannel; }
+
+    std::string str(const PIXLISEStoreString &s) const { return std::string(_strings+s.offset, s.length); }
+    bool equals(const PIXLISEStoreString &s, const char *text) const;
+
+    // Index of the location for a PMC, -1 if it's not in the dataset
+    int findLocation(int pmc) const;
+
+    // Writes the store file (to a temporary file that is then renamed, so other processes never see part of one)
+    int write(std::ostream &termOutFile, const std::string &pathName) const;
+    // Maps a store file read-only, checks the header and that everything in it is in range
+    static int open(std::ostream &termOutFile, const std::string &pathName, std::shared_ptr<const PIXLISESpectrumStore> &out_store);
+
+private:
+    int check(std::ostream &termOutFile, const std::string &pathName) const;
+    uint32_t addString(const std::string &s);
+
+    PIXLISEStoreHeader _header;
+
+    // Sections, pointing into the mapped file or into the vectors below
+    const PIXLISEStoreLabel *_labels;
+    const PIXLISEStoreLocation *_locations;
+    const PIXLISEStorePMC *_pmcs;
+    const PIXLISEStoreDetector *_detectors;
+    const PIXLISEStoreMeta *_metas;
+    const int32_t *_channels;
+    const char *_strings;
+
+    std::vector<PIXLISEStoreLabel> _ownedLabels;
+    std::vector<PIXLISEStoreLocation> _ownedLocations;
+    std::vector<PIXLISEStorePMC> _ownedPMCs;
+    std::vector<PIXLISEStoreDetector> _ownedDetectors;
+    std::vector<PIXLISEStoreMeta> _ownedMetas;
+    std::vector<int32_t> _ownedChannels;
+    std::vector<char> _ownedStrings;
+
+    // Mapped store file (or the whole file read in, where there is no mmap)
+    MappedFile _file;
+};
@@ -42,6 +42,8 @@ using namespace std;
 
 //  Modified Oct. 1, 2015 to use data from include file (compiled in)
 //      instead of binary file read at execution
+//  Modified Oct. 16, 2026 to save the occupied orbitals (edge energy, Jzero, occupancy) in the constructor
+//      instead of constructing a vector of XrayEdge objects in every doubly-differential Compton calculation
 
 ScatterXsectTable::ScatterXsectTable(const Element& el) {
 	int i;
@@ -79,6 +81,17 @@ ScatterXsectTable::ScatterXsectTable(const Element& el) {
 			f = db_data[thisPointer+1];
 			fofx[i] = f;
 		};
+//			get all of the occupied electron orbitals (identified by corresponding x-ray absorption edges)
+		vector <EdgeIndex> edgeIndices;
+		int ns = XrayEdge::numberOccupied( edgeIndices, thisElement );
+		for ( i=0; i<ns; i++ ) {
+			XrayEdge edge ( thisElement, edgeIndices[i] );
+			ComptonOrbital orbital;
+			orbital.energy = edge.energy();
+			orbital.jzero = edge.jzero();
+			orbital.occupancy = edge.occupancy();
+			orbitals.push_back( orbital );
+		};
 	};
 };
 
@@ -144,15 +157,8 @@ float ScatterXsectTable::incohCalc(const float energy_in, const float angle_in,
 
 	float cosTheta = cos ( angle_in );
 	float ec = eC ( energy_in, angle_in );
-//		get all of the occupied electron orbitals (identified by corresponding x-ray absorption edges)
-	vector <EdgeIndex> edgeIndices;
-	vector <XrayEdge> edges;
-	int ns = XrayEdge::numberOccupied( edgeIndices, thisElement );
+//		occupied electron orbitals are saved in the constructor
 	int jLoop;
-	for ( jLoop=0; jLoop<ns; jLoop++ ) {
-		XrayEdge edge ( thisElement, edgeIndices[jLoop] );
-		edges.push_back ( edge );
-	};
 //cout << "edges " << thisElement.symbol() << " " << edges.size() << endl;
 	float q = sqrt ( energy_in*energy_in + ePrime_in*ePrime_in - 2.0 * energy_in * ePrime_in * cosTheta );
 	float pz = energy_in * ( ePrime_in - ec ) / ( ec * q );
@@ -164,15 +170,15 @@ float ScatterXsectTable::incohCalc(const float energy_in, const float angle_in,
 	float invFac = bigRinv - bigRprimeInv;
 	float bigX = bigR*bigRprimeInv + bigRprime*bigRinv + 2 * invFac + invFac*invFac;
 	float jAll = 0.0;
-	for ( jLoop=0; jLoop<edges.size(); jLoop++ ) {
+	for ( jLoop=0; jLoop<orbitals.size(); jLoop++ ) {
 //			account for kinematic limit
-		if ( edges[jLoop].energy() > energy_in-ePrime_in ) continue;
-		float jZero = edges[jLoop].jzero();
+		if ( orbitals[jLoop].energy > energy_in-ePrime_in ) continue;
+		float jZero = orbitals[jLoop].jzero;
 //			convert from hydrogenic units (m e**2 / hBar, as in Biggs et. al.) to units of mc (as in Brusa et. al.)
 //				using the fine structure constant, alpha
 		jZero *= ALPHA_INV;
 		float jZeroArg = 1.0 + 2.0 * jZero * fabs(pz);
-		jAll += edges[jLoop].occupancy() * jZero * jZeroArg * exp ( 0.5 - 0.5 * jZeroArg * jZeroArg );
+		jAll += orbitals[jLoop].occupancy * jZero * jZeroArg * exp ( 0.5 - 0.5 * jZeroArg * jZeroArg );
 	};
 //		RE2 is classical electron radius (squared) in cm2 (defined in file FPconstants.h)
 	float ddcs = 0.5 * RE2 * (ePrime_in/energy_in)*(1.0/q) * sqrt( 1.0 + pz*pz ) * bigX * jAll;
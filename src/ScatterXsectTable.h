@@ -39,6 +39,14 @@
 
 using namespace std;
 
+//	Occupied electron orbital info used in the doubly-differential Compton cross section
+//		(saved when the table is constructed instead of making XrayEdge objects on every call)   Oct. 16, 2026
+struct ComptonOrbital {
+	float energy;
+	float jzero;
+	float occupancy;
+};
+
 //	Angle-dependent form factors for coherent and incoherent scattering - database class
 
 class ScatterXsectTable {
@@ -116,5 +124,6 @@ private:
 	int numberIncoherent;
 	vector <float> xIncoh;
 	vector <float> sofx;
+	vector <ComptonOrbital> orbitals;
 };
 #endif
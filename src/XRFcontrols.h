@@ -93,5 +93,24 @@
 //  Length of list of peaks for pulse pileup calculation (zero => no pileup included)
 //      Note that the time taken for the pileup calculation depends on the square of this length
 #define PILEUP_LIST_LENGTH  8
+//  Solve the least-squares normal equations with a double precision Cholesky decomposition instead of
+//      single precision LU (faster and more accurate, but changes the last digits of the results)
+//      Default for lfitCholesky, the -L option turns it on
+#define LFIT_CHOLESKY false
+//  Evaluate the x-ray cross sections by linear interpolation on a uniform log-energy grid for each element
+//      instead of the cubic splines (faster, results differ from the spline values by up to the tolerance)
+//      Default for XrayXsectTable::tabulated, the -X option turns it on
+#define XSECT_TABULATED false
+#define XSECT_GRID_STEP 0.002f          //  Grid spacing in log(energy)
+#define XSECT_GRID_TOLERANCE 1.0e-5f    //  Largest relative difference from the spline, grid cells above this use the spline
+#define XSECT_GRID_CHECKS 8             //  Grid cells are checked at the points that divide them into this many parts
+#define XSECT_GRID_BUCKET_BITS 7        //  Mantissa bits of the energy used to find its grid cell without a log
+//  Anderson mixing of the composition, energy calibration, and detector resolution updates in quantUnknown
+//      (fewer iterations for slowly converging fits, results differ within the fit convergence tolerance),
+//      number of previous iterations used, and largest change from the plain update (as a factor on the fraction)
+//      Default for quantAndersonMixing, the -A option turns it on (with this depth if no depth is given)
+#define QUANT_ANDERSON_MIXING false
+#define QUANT_ANDERSON_DEPTH 2
+#define QUANT_ANDERSON_MAX_STEP 10
 
 #endif
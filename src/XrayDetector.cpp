@@ -78,6 +78,7 @@ using namespace std;
 //  Modified June 19, 2021  Fixing above bug had repercussions for calibration, lots of flailing around to check shelf factor, slope, & tail parameters
 //                          Final choice was shelf factor 1 & slope 0, tail unchanged, and front contact shelf enabled with thickness 150 um
 //  Modified July 10, 2021  Add pulse resolving time for simple pulse pileup calculation (header change only for now)
+//  Modified Oct. 16, 2026  Add same_layers function to compare the window and layers for the calculation caches
 
 
 // Principal Auger electron energies for selected elements added for shelf calculations
@@ -649,6 +650,12 @@ float XrayDetector::electron_range( const float electron_energy, const float den
 
 
 
+bool XrayDetector::same_layers( const XrayDetector &detector ) const
+{
+    return window.identical( detector.window ) && frontContact.identical( detector.frontContact )
+        && deadLayer.identical( detector.deadLayer ) && activeLayer.identical( detector.activeLayer );
+}
+
 string XrayDetector::toString() const
 {
     std::ostringstream os;
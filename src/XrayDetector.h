@@ -94,6 +94,7 @@ class XrayDetector {
 //          This makes it easier and more reasonable to avoid square root of a negative number or zero resolution
 //      Moved setResolution out of this file as part of this change
 //  Modified July 10, 2021  Add pulse resolving time for simple pulse pileup calculation
+//  Modified Oct. 16, 2026  Add same_layers function to compare the window and layers for the calculation caches
 
 public:
 //		must have default constructor to declare arrays
@@ -145,6 +146,9 @@ public:
 	void pileup_time( const float time_in ) { pulse_resolving_time = time_in; };
 
     std::string toString() const;
+//		window, front contact, dead layer, and active layer have the same composition and thickness
+//			(everything the detector response and Compton escape fractions depend on)
+    bool same_layers( const XrayDetector &detector ) const;
 
 private:
 
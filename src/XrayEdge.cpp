@@ -33,6 +33,7 @@
 #include "interp.h"
 #include "Element.h"
 #include "XrayEdge.h"
+#include "XrayLineTable.h"
 
 //  Modified June 27, 2012 to update energies from latest Gwyn Williams table and add some comments
 //  Checked occupancies vs energy table
@@ -41,6 +42,8 @@
 //      (see note with data below on Hubble erratum)
 //` Modified March 31, 2017 to make EdgeIndex and EdgeLevel more consistent
 //      Change first EdgeLevel to K and first EdgeIndex to K1
+//  Modified Oct. 16, 2026 to look up yields, jump ratios, widths, and total Coster-Kronig rates
+//      in XrayLineTable instead of evaluating the data arrays and interpolations on every call
 
 const std::string XrayEdge::EDGE_NAMES[MAXINDEX+1] = {
 	"K",  "L1", "L2", "L3", "M1", "M2",
@@ -206,7 +209,23 @@ const float XrayEdge::spin() const {
 	return spins[edgeIndex];
 };
 
+const float XrayEdge::yield() const {
+	if ( XrayLineTable::covers( z.Z() ) ) return XrayLineTable::table().yield( XrayLineTable::slot( z.Z(), edgeIndex ) );
+	return yield_value ( z.Z(), edgeIndex );
+};
+
+const float XrayEdge::jump() const {
+	if ( XrayLineTable::covers( z.Z() ) ) return XrayLineTable::table().jump( XrayLineTable::slot( z.Z(), edgeIndex ) );
+	return jump_value ( z.Z(), edgeIndex );
+};
+
 const float XrayEdge::cktotal ( const XrayEdge toEdge ) const {
+	if ( z.Z() != toEdge.element().Z() ) return 0.0;
+	if ( XrayLineTable::covers( z.Z() ) ) return XrayLineTable::table().cktotal( z.Z(), edgeIndex, toEdge.index() );
+	return cktotal_value ( toEdge );
+};
+
+const float XrayEdge::cktotal_value ( const XrayEdge& toEdge ) const {
 //		total Coster-Kronig transition rate from this edge to given edge
 //		including vacancy rattling down through intermediate levels
 //			executive decision - only handle up to 10 intermediate levels
@@ -316,8 +335,13 @@ const float XrayEdge::jzero() const {
 	return EDGE_JZEROS[(i-1)*(MAXINDEX+1)+edgeIndex];
 };
 
-//		Level width data from Campbell ATNDT_77_1_2001
 const float XrayEdge::width ( ) const {
+	if ( XrayLineTable::covers( z.Z() ) ) return XrayLineTable::table().width( XrayLineTable::slot( z.Z(), edgeIndex ) );
+	return width_value ( );
+};
+
+//		Level width data from Campbell ATNDT_77_1_2001
+const float XrayEdge::width_value ( ) const {
 #include "CampbellWidthData_extrap_XrayEdge_Mar2012.h"
    	int i;
 	i=z.Z();
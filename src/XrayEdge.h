@@ -38,6 +38,7 @@
 //  Modified Feb. 11, 2017 to include an EdgeLevel that matches nothing (for spectrum components)
 //` Modified March 31, 2017 to make EdgeIndex and EdgeLevel more consistent
 //      Change first EdgeLevel to K and first EdgeIndex to K1
+//  Modified Oct. 16, 2026 to take yields, jump ratios, widths, and total Coster-Kronig rates from XrayLineTable
 
 //	enum for edge indices
  enum EdgeIndex {
@@ -50,6 +51,7 @@ enum EdgeLevel { NO_EDGE = -1, K, L, M, N, O, P, Q};   //  Modified to use for s
 enum EdgeAngularMonmentum {s, p, d, f};
 class XrayEdge {
 friend class XrayLines;
+friend class XrayLineTable;
 public:
 	XrayEdge ( const Element e, const EdgeIndex indexIn = K1 );
 //	XrayEdge ( const Element e, const std::string s );
@@ -70,10 +72,10 @@ public:
 	const EdgeAngularMonmentum angularMomentum() const;
 	const float spin() const;
 //		fluorescence yield
-	const float yield() const { return yield_value ( z.Z(), edgeIndex ); };
+	const float yield() const;
 //		absorption edge jump ratio (also called edge step)
-	const float jump() const { return jump_value ( z.Z(), edgeIndex ); };
-	const float step() const { return jump_value ( z.Z(), edgeIndex ); };
+	const float jump() const;
+	const float step() const { return jump(); };
 //		Coster-Kronig transition rate from this edge to given edge
 	const float ck ( const XrayEdge toEdge) const { return z == toEdge.element() ?
 		ck_value ( z.Z(), edgeIndex, toEdge.index() ) : 0.0; } ;
@@ -112,5 +114,8 @@ private:
 	const float yield_value ( const int zi, const int fromIndex ) const;
 	const float jump_value ( const int zi, const int fromIndex ) const;
 	const float ck_value ( const int zi, const int fromIndex, const int toIndex ) const;
+//		calculations used to fill XrayLineTable (and for elements outside the table)
+	const float cktotal_value ( const XrayEdge& toEdge ) const;
+	const float width_value ( ) const;
 };
 #endif
@@ -0,0 +1,86 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <vector>
+#include <string>
+#include "Element.h"
+#include "XrayEdge.h"
+#include "XrayLines.h"
+#include "XrayLineTable.h"
+
+using namespace std;
+
+//  Flattened table of absorption edge and emission line data for all elements
+//  Added Oct. 16, 2026
+
+const XrayLineTable &XrayLineTable::table() {
+//		built on first use (thread safe), read only after that
+	static const XrayLineTable the_table;
+	return the_table;
+};
+
+XrayLineTable::XrayLineTable() {
+	const int nIndex = XrayEdge::maxIndex() + 1;
+	const int nSlots = XrayEdge::maxz() * nIndex;
+	edge_yield.resize( nSlots );
+	edge_jump.resize( nSlots );
+	edge_width.resize( nSlots );
+	ck_total.resize( nSlots * nIndex );
+	first_line.resize( nSlots + 1 );
+//		use the original calculations in XrayEdge and XrayLines (not the accessors, which read this table)
+	XrayLines calc;
+	vector <XrayLinesInfo> candidates;
+	int z;
+	for ( z=1; z<=XrayEdge::maxz(); z++ ) {
+		Element el( z );
+		int edgeIndex;
+		for ( edgeIndex=0; edgeIndex<nIndex; edgeIndex++ ) {
+			XrayEdge edge( el, static_cast<EdgeIndex>(edgeIndex) );
+			const int s = slot( z, edgeIndex );
+			edge_yield[s] = edge.yield_value( z, edgeIndex );
+			edge_jump[s] = edge.jump_value( z, edgeIndex );
+			edge_width[s] = edge.width_value();
+			int toIndex;
+			for ( toIndex=0; toIndex<nIndex; toIndex++ ) {
+				XrayEdge toEdge( el, static_cast<EdgeIndex>(toIndex) );
+				ck_total[ s * nIndex + toIndex ] = edge.cktotal_value( toEdge );
+			};
+			first_line[s] = energy.size();
+			calc.lineCandidates( edge, candidates );
+			int i;
+			for ( i=0; i<candidates.size(); i++ ) {
+				energy.push_back( candidates[i].lineEnergy );
+				intensity.push_back( candidates[i].lineIntensity );
+				occupied.push_back( candidates[i].edgeOccupied );
+				symbol.push_back( *candidates[i].lineIUPAC );
+			};
+		};
+	};
+	first_line[nSlots] = energy.size();
+};
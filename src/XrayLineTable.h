@@ -0,0 +1,78 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef XrayLineTable_h
+#define XrayLineTable_h
+
+#include <vector>
+#include <string>
+#include "XrayEdge.h"
+
+//  Flattened (structure of arrays) table of absorption edge and emission line data for all elements
+//      Built once, the first time it is used, from the data and functions in XrayEdge and XrayLines
+//      and never changed after that, so it is shared by all threads without locking
+//  Edge data are indexed by slot = (Z-1)*(XrayEdge::maxIndex()+1) + edge index
+//  Lines emitted from a vacancy in each edge are contiguous, starting at line_first(slot),
+//      with the relative intensities before normalization (so XrayLines can apply its energy limits)
+//  Values are the same ones XrayEdge and XrayLines calculate, so results do not change
+//  Added Oct. 16, 2026
+
+class XrayLineTable {
+public:
+	static const XrayLineTable &table();
+	static bool covers( const int z ) { return ( 1 <= z && z <= XrayEdge::maxz() ); };
+	static int slot( const int z, const int edgeIndex ) { return ( z - 1 ) * ( XrayEdge::maxIndex() + 1 ) + edgeIndex; };
+//		edge data
+	float yield( const int s ) const { return edge_yield[s]; };
+	float jump( const int s ) const { return edge_jump[s]; };
+	float width( const int s ) const { return edge_width[s]; };
+//		total Coster-Kronig transition rate (including intermediate levels) between two edges of the same element
+	float cktotal( const int z, const int fromIndex, const int toIndex ) const {
+		return ck_total[ slot( z, fromIndex ) * ( XrayEdge::maxIndex() + 1 ) + toIndex ]; };
+//		emission lines from a vacancy in the edge at this slot
+	int line_first( const int s ) const { return first_line[s]; };
+	int line_count( const int s ) const { return first_line[s+1] - first_line[s]; };
+	float line_energy( const int i ) const { return energy[i]; };
+	float line_intensity( const int i ) const { return intensity[i]; };
+	const XrayEdge &line_occupied( const int i ) const { return occupied[i]; };
+	const std::string &line_IUPAC( const int i ) const { return symbol[i]; };
+private:
+	XrayLineTable();
+	std::vector <float> edge_yield;
+	std::vector <float> edge_jump;
+	std::vector <float> edge_width;
+	std::vector <float> ck_total;
+	std::vector <int> first_line;
+	std::vector <float> energy;
+	std::vector <float> intensity;
+	std::vector <XrayEdge> occupied;
+	std::vector <std::string> symbol;
+};
+
+#endif
@@ -32,8 +32,11 @@
 #include "Element.h"
 #include "XrayEdge.h"
 #include "XrayLines.h"
+#include "XrayLineTable.h"
 #include "interp.h"
 #include <sstream>
+#include <set>
+#include <mutex>
 
 using namespace std;
 
@@ -48,6 +51,11 @@ using namespace std;
 //      Old way: call XrayEdge::number (checked edge energies for entry)
 //      New way: call XrayEdge::numberOccupied (checks electron occupancy)
 //      This also is consistent with strongly typed enum EdgeIndex
+//  Modified Oct. 16, 2026
+//      Line energies, intensities, and symbols are copied from XrayLineTable (calculated once for all elements)
+//      The calculation was moved to lineCandidates, which fills the table
+//  Modified Oct. 17, 2026
+//      Lines point to their IUPAC symbols in XrayLineTable instead of copying them
 
 
 #define MAXLINES 27
@@ -68,6 +76,15 @@ const string XrayLines::LINE_NAMES_IUPAC[MAXLINES] = {
 
 //	this is for returning a blank string when no name was available
 const string XrayLines::blank("");
+const string XrayLines::single_symbol(" ");
+
+const string &XrayLines::keep_symbol( const string &symbol ) {
+//		symbols for lines not in XrayLineTable are kept here so the lines can point to them
+	static set <string> symbols;
+	static mutex symbols_mutex;
+	lock_guard <mutex> lock( symbols_mutex );
+	return *symbols.insert( symbol ).first;
+};
 
 
 XrayLines::XrayLines ( ) {
@@ -85,7 +102,7 @@ XrayLines::XrayLines ( const float energy ) {
 	lineCount = 0;
     XrayLinesInfo temp;
 	temp.edgeOccupied = fakeEdge;
-	temp.lineIUPAC = " " ;
+	temp.lineIUPAC = &single_symbol;
 	temp.lineEnergy = energy;
 	temp.lineIntensity = 1;
 	temp.lineFactor = 1;
@@ -102,40 +119,39 @@ XrayLines::XrayLines ( const XrayEdge& newEdge, const float separation,
 //			interpolation time during repetitive calculations
 	edgeVacant = newEdge;
 	lineCount = 0;
-//		find the number of edges with energy below this edge
-	vector<EdgeIndex>  possibilities;
-    newEdge.numberOccupied( possibilities, newEdge.element() );
-    //  Fix up a couple of differences between occupancy table and Scofield configuration
-    //  Scofield assumes that Al and Si have K-M3 (Kb1) lines even though the occupancy table only has M1 and M2 electrons
-    if( newEdge.element().Z() == 13 || newEdge.element().Z() == 14 ) {
-        possibilities.push_back( M3 );
-    }
     float sum = 0;
     int i;
-    for ( i=0; i<possibilities.size(); i++ ) {
-//				check possible edges for transitions
-        XrayEdge testEdge ( edgeVacant.element(), possibilities[i] );
-//				see if this line has any intensity (also get IUPAC symbol)
-        string testSymbol;
-//				intSymbol returns the intensity of a line and its IUPAC symbol,
-//					given the two edges between which the transition occurs
-        float testInt = intSymbol ( testSymbol, edgeVacant, testEdge );
-//        cout << testEdge.symbol() << "  " << testInt << "  " << testSymbol << endl;
-        if ( testInt > 0.0 ) {
-//				create an entry for an emission line, transition from occupied edge level
-//					to vacant edge level
-            XrayLinesInfo temp;
-            temp.edgeOccupied = testEdge;
-            temp.lineIUPAC = testSymbol;
-            temp.lineEnergy = edgeVacant.energy()-testEdge.energy();
-            temp.lineIntensity = testInt;
-            temp.lineFactor = 1.0;
-            if( energy_low_limit <= temp.lineEnergy
-                   && temp.lineEnergy <= energy_high_limit ) {
+    const int z = newEdge.element().Z();
+    if ( XrayLineTable::covers( z ) ) {
+//				copy the lines for this edge from the table, keeping those within the energy limits
+        const XrayLineTable &table = XrayLineTable::table();
+        const int s = XrayLineTable::slot( z, newEdge.index() );
+        const int first = table.line_first( s );
+        const int n = table.line_count( s );
+        lineList.reserve( n );
+        for ( i=first; i<first+n; i++ ) {
+            const float lineEnergy = table.line_energy( i );
+            if( energy_low_limit <= lineEnergy && lineEnergy <= energy_high_limit ) {
+                XrayLinesInfo temp;
+                temp.edgeOccupied = table.line_occupied( i );
+                temp.lineIUPAC = &table.line_IUPAC( i );
+                temp.lineEnergy = lineEnergy;
+                temp.lineIntensity = table.line_intensity( i );
+                temp.lineFactor = 1.0;
                 sum += temp.lineIntensity;
                 lineList.push_back( temp );
             };
         };
+    } else {
+        vector <XrayLinesInfo> candidates;
+        lineCandidates ( edgeVacant, candidates );
+        for ( i=0; i<candidates.size(); i++ ) {
+            if( energy_low_limit <= candidates[i].lineEnergy
+                   && candidates[i].lineEnergy <= energy_high_limit ) {
+                sum += candidates[i].lineIntensity;
+                lineList.push_back( candidates[i] );
+            };
+        };
     };
     lineCount = lineList.size();
 //			normalize relative intensities
@@ -153,7 +169,7 @@ XrayLines::XrayLines ( const XrayLines& newLines, const float separation ) {
 	int i;
 	for ( i=0; i<lineCount; i++ ) {
 		lineList[i].edgeOccupied = newLines.edgeSource(i);
-		lineList[i].lineIUPAC = newLines.symbolIUPAC(i);
+		lineList[i].lineIUPAC = newLines.lineList[i].lineIUPAC;
 		lineList[i].lineEnergy = newLines.energy(i);
 		lineList[i].lineIntensity = newLines.relative(i);
 		lineList[i].lineFactor = newLines.factor(i);
@@ -162,6 +178,42 @@ XrayLines::XrayLines ( const XrayLines& newLines, const float separation ) {
     lineCount = lineList.size();
 };
 
+void XrayLines::lineCandidates ( const XrayEdge& vacant, vector <XrayLinesInfo> &candidates ) {
+//		list of x-ray emission lines from a vacancy in the given edge, in the order of the edge indices
+//			relative intensities are not normalized and no energy limits are applied
+	candidates.resize( 0 );
+//		find the number of edges with energy below this edge
+	vector<EdgeIndex>  possibilities;
+    vacant.numberOccupied( possibilities, vacant.element() );
+    //  Fix up a couple of differences between occupancy table and Scofield configuration
+    //  Scofield assumes that Al and Si have K-M3 (Kb1) lines even though the occupancy table only has M1 and M2 electrons
+    if( vacant.element().Z() == 13 || vacant.element().Z() == 14 ) {
+        possibilities.push_back( M3 );
+    }
+    int i;
+    for ( i=0; i<possibilities.size(); i++ ) {
+//				check possible edges for transitions
+        XrayEdge testEdge ( vacant.element(), possibilities[i] );
+//				see if this line has any intensity (also get IUPAC symbol)
+        string testSymbol;
+//				intSymbol returns the intensity of a line and its IUPAC symbol,
+//					given the two edges between which the transition occurs
+        float testInt = intSymbol ( testSymbol, vacant, testEdge );
+//        cout << testEdge.symbol() << "  " << testInt << "  " << testSymbol << endl;
+        if ( testInt > 0.0 ) {
+//				create an entry for an emission line, transition from occupied edge level
+//					to vacant edge level
+            XrayLinesInfo temp;
+            temp.edgeOccupied = testEdge;
+            temp.lineIUPAC = &keep_symbol( testSymbol );
+            temp.lineEnergy = vacant.energy()-testEdge.energy();
+            temp.lineIntensity = testInt;
+            temp.lineFactor = 1.0;
+            candidates.push_back( temp );
+        };
+    };
+};
+
 const float XrayLines::energy (  const string& symbol ) const {
 //		return the energy of the line whose IUPAC or Siegbahn designation
 //			matches the given symbol (check IUPAC first)
@@ -173,7 +225,7 @@ const float XrayLines::energy (  const string& symbol ) const {
 
 const string& XrayLines::symbolSiegbahn ( const int index ) const {
 	int i;
-	string test = (*this).symbolIUPAC(index);
+	const string &test = (*this).symbolIUPAC(index);
 	for ( i=0; i<MAXLINES; i++ ) {
 		if ( test == LINE_NAMES_IUPAC[i] ) return LINE_NAMES_Siegbahn[i];
 	};
@@ -490,7 +542,7 @@ string XrayLinesInfo_toString(const XrayLinesInfo &lines)
     os << "XrayLinesInfo:" << endl;
     os << "  edgeOccupied:" << lines.edgeOccupied.toString() << endl;
 
-    os << "  lineIUPAC: " << lines.lineIUPAC << endl;
+    os << "  lineIUPAC: " << ( lines.lineIUPAC ? *lines.lineIUPAC : "" ) << endl;
     os << "  lineEnergy: " << lines.lineEnergy << endl;
     os << "  lineFactor: " << lines.lineFactor << endl;
 
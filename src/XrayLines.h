@@ -36,7 +36,8 @@
 
 struct XrayLinesInfo {
     XrayEdge edgeOccupied;
-    std::string lineIUPAC;
+//      points to a symbol in XrayLineTable (or a static string), so copying lines does not copy strings
+    const std::string *lineIUPAC = 0;
     float lineEnergy;
     float lineIntensity;
     float lineFactor;
@@ -52,8 +53,11 @@ std::string XrayLinesInfo_toString(const XrayLinesInfo &);
 //	Modified Aug. 20, 2012 to accomodate special fits of a subset of lines         WTE
 //	Modified Feb. 20, 2017 to include common factor for all lines (for live time)
 //	Modified Nov. 24, 2020 to include matrix effect factor
+//	Modified Oct. 16, 2026 to copy lines from XrayLineTable instead of calculating them for every object
+//	Modified Oct. 17, 2026 to point to the IUPAC symbols instead of copying them for every line
 
 class XrayLines {
+friend class XrayLineTable;
 //		creates a list of x-ray emission lines from a vacancy
 //			in the energy level associated with an absorption edge
 //		keeps energies and relative intensities in memory to save search and
@@ -72,7 +76,7 @@ public:
 //			don't check index to save time (may have to add if too many confusing errors)
 	const float energy ( const int index ) const { return lineList[index].lineEnergy; };
 	const float energy ( const std::string& symbol ) const;
-	std::string symbolIUPAC ( const int index ) const { return lineList.at(index).lineIUPAC; };
+	const std::string& symbolIUPAC ( const int index ) const { return *lineList.at(index).lineIUPAC; };
 	const std::string& symbolSiegbahn ( const int index ) const;
 	const int index ( const std::string& symbol ) const;
 //			intensity gives relative intensity modified by user factor (emitted intensities, for example)
@@ -104,8 +108,12 @@ private:
 	static const std::string LINE_NAMES_Siegbahn[];
 	static const std::string LINE_NAMES_IUPAC[];
 	float intSymbol ( std::string& symbol, const XrayEdge& upper, const XrayEdge& lower );
+//		all lines from a vacancy in this edge, relative intensities not normalized (used to fill XrayLineTable)
+	void lineCandidates ( const XrayEdge& vacant, std::vector <XrayLinesInfo> &candidates );
 	float linePolyCalc ( const float z, const float array[] ) ;
 	static const std::string blank;
+	static const std::string single_symbol;
+	static const std::string &keep_symbol( const std::string &symbol );
     void merge_peaks( const float separation, std::vector <XrayLinesInfo> &lineList_in );
 };
 
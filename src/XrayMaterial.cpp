@@ -66,6 +66,10 @@
 //  Modified June 9, 2021   Change oxides and element reporting to match team wishes (e-mail from Joel 6/7/2021, 1:27 PM)
 //  Modified June 27, 2021  Add command line option to normalize element sum to 100% (or any value)
 //  Modified July 9, 2021   Add command line option to change Fe oxide ratio (-Fe)
+//  Modified Oct. 16, 2026  Add cross sections for a list of energies, and from a per-element matrix
+//                          (only the fractions change between FP iterations, so the element values are kept)
+//  Modified Oct. 16, 2026  Add key function with exact composition for the FP setup caches
+//  Modified Oct. 17, 2026  Add identical function to compare the same values without formatting them
 
 
 using namespace std;
@@ -191,6 +195,51 @@ float XrayMaterial::cross_section( const float energy_in ) const {
 	return sigma / sum;
 };
 
+void XrayMaterial::cross_section( const float *energies, float *out, const int n ) const {
+//      Cross-sections at a list of energies, same results as calling cross_section for each one
+	float sum = 0;
+	int i, j;
+	for ( i=0; i<fractions.size(); i++ ) sum += fractions[i];
+	for ( j=0; j<n; j++ ) out[j] = 0;
+	if( sum == 0 ) return;
+	for ( i=0; i<elements.size(); i++ ) {
+		const float f = fractions[i];
+		for ( j=0; j<n; j++ ) {
+			if ( energies[j] > 0 ) out[j] += f * absorption_tables[i].total( energies[j] );
+		};
+	};
+	for ( j=0; j<n; j++ ) out[j] /= sum;
+};
+
+void XrayMaterial::cross_section_matrix( const float *energies, const int n, std::vector <float> &matrix ) const {
+//      Cross-section of each element at a list of energies, n values for each element in element_list order
+//      (zero for energies <= 0, as in cross_section)
+	matrix.resize( elements.size() * n );
+	int i, j;
+	for ( i=0; i<elements.size(); i++ ) {
+		for ( j=0; j<n; j++ ) {
+			matrix[ i * n + j ] = energies[j] > 0 ? absorption_tables[i].total( energies[j] ) : 0;
+		};
+	};
+};
+
+void XrayMaterial::cross_section( const std::vector <float> &matrix, const int n, float *out ) const {
+//      Cross-sections for this composition from a matrix calculated by cross_section_matrix
+//          for the same element list (a matrix-vector product with the element fractions)
+//      Terms are added in the same order as cross_section, so the results are identical
+	float sum = 0;
+	int i, j;
+	for ( i=0; i<fractions.size(); i++ ) sum += fractions[i];
+	for ( j=0; j<n; j++ ) out[j] = 0;
+	if( sum == 0 ) return;
+	for ( i=0; i<elements.size(); i++ ) {
+		const float f = fractions[i];
+		const float *row = &matrix[ i * n ];
+		for ( j=0; j<n; j++ ) out[j] += f * row[j];
+	};
+	for ( j=0; j<n; j++ ) out[j] /= sum;
+};
+
 float XrayMaterial::cross_section( const Element el, const float energy_in ) const {
     //  Returns the absorption cross-section for a single element at the given energy
 	if ( energy_in <= 0 ) return 0;
@@ -832,6 +881,22 @@ string XrayMaterial::formula_string( const Element formula_element_in, const Lig
 	return output_str;
 };
 
+void XrayMaterial::key( std::ostream &os ) const
+{
+    //  Hexadecimal floats so that nothing is lost to rounding
+    os << "material" << hexfloat;
+    unsigned int ii;
+    for( ii=0; ii<elements.size(); ii++ ) os << " " << elements[ii].Z() << " " << fractions[ii];
+    os << " density " << mass_density << " thickness " << thickness_in << " " << m_thickness;
+    os << defaultfloat << endl;
+}
+
+bool XrayMaterial::identical( const XrayMaterial &material ) const
+{
+    return elements == material.elements && fractions == material.fractions && mass_density == material.mass_density
+        && thickness_in == material.thickness_in && m_thickness == material.m_thickness;
+}
+
 string XrayMaterial::toString() const
 {
     ostringstream os;
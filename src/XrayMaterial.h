@@ -74,6 +74,12 @@ class XrayMaterial
         float photo( const Element el, const float energy_in ) const;
         float cross_section( const float energy_in )const;
         float cross_section( const Element el, const float energy_in ) const;
+        //  Cross-sections at n energies (same as cross_section for each energy)
+        void cross_section( const float *energies, float *out, const int n ) const;
+        //  Each element's cross-section at n energies, in element_list order (row i is element i)
+        void cross_section_matrix( const float *energies, const int n, std::vector <float> &matrix ) const;
+        //  Cross-sections at the same n energies from that matrix, for the current fractions
+        void cross_section( const std::vector <float> &matrix, const int n, float *out ) const;
         const XrayXsectTable &cross_section_table( const Element el ) const;
         float incoherent( const float energy_in, const float theta_in ) const;
         float incoherent( const float energy_in, const float theta_in, const float scattered_energy_in ) const;
@@ -136,6 +142,10 @@ class XrayMaterial
 //        void debug_print();
 
         string toString() const;
+        //  Writes the exact composition and thickness for cache keys
+        void key( std::ostream &os ) const;
+        //  Same composition and thickness (the values written by key, compared directly)
+        bool identical( const XrayMaterial &material ) const;
 
     private:
 
@@ -52,6 +52,8 @@
 //      Improvements to optic response function, new optic response clculations, results into FM_OpticResponse_Nov2020.h
 //  Modified Apr. 28, 2021  Fix bug in checking size of derivative data in 3 vector constructor
 //                          Change PIXL FM optic type (#7) to PIXL_FM_OPTIC_OLD, add new PIXL_FM_OPTIC (#8) calculated with correct Be window for X-ray tube
+//  Modified Oct. 16, 2026  Add key function with exact parameter values for the FP setup caches
+//      Add identical function to check the optic used for the detector response table
 
 
 #include <iostream>
@@ -487,6 +489,31 @@ void InterpPrintTest()
 }
 */
 
+void XrayOptic::key( std::ostream &os ) const
+{
+    //  Hexadecimal floats so that nothing is lost to rounding
+    os << "optic " << m_type << " " << m_defaultFlag << hexfloat;
+    os << " " << m_centerEnergy << " " << m_bandwidth << " " << m_maxTransmission;
+    unsigned int i;
+    os << " X";
+    for( i=0; i<m_vectorData.vectorDataX.size(); i++ ) os << " " << m_vectorData.vectorDataX[i];
+    os << " Y";
+    for( i=0; i<m_vectorData.vectorDataY.size(); i++ ) os << " " << m_vectorData.vectorDataY[i];
+    os << " D";
+    for( i=0; i<m_vectorData.vectorDataD.size(); i++ ) os << " " << m_vectorData.vectorDataD[i];
+    os << defaultfloat << endl;
+}
+
+bool XrayOptic::identical( const XrayOptic &optic ) const
+{
+    //  Same values as key, compared directly
+    return m_type == optic.m_type && m_defaultFlag == optic.m_defaultFlag && m_centerEnergy == optic.m_centerEnergy
+        && m_bandwidth == optic.m_bandwidth && m_maxTransmission == optic.m_maxTransmission
+        && m_vectorData.vectorDataX == optic.m_vectorData.vectorDataX
+        && m_vectorData.vectorDataY == optic.m_vectorData.vectorDataY
+        && m_vectorData.vectorDataD == optic.m_vectorData.vectorDataD;
+}
+
 std::string XrayOptic::toString() const
 {
     std::ostringstream os;
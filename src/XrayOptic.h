@@ -77,6 +77,10 @@ public:
 	const   XrayOpticType		GetType()	const	{ return m_type; }
 
 	std::string toString() const;
+	//  Writes the exact parameter values (including the transmission arrays) for cache keys
+	void key( std::ostream &os ) const;
+	//  True if all of the values written by key are exactly the same
+	bool identical( const XrayOptic &optic ) const;
 };
 
 #endif
@@ -675,6 +675,28 @@ float XraySource::continuum_Sewell( const float energy ) const {
 };
 */
 
+void XraySource::key( std::ostream &os ) const
+{
+    //  Hexadecimal floats so that nothing is lost to rounding
+    os << "source " << tube << " " << sr << " " << external << " " << endWindow << hexfloat;
+    os << " " << tubeVoltage << " " << incSin << " " << takeoffSin << " " << tubeCurrent << " " << activity << endl;
+    os << "target ";
+    target.key( os );
+    os << "window ";
+    window.key( os );
+    unsigned int i;
+    int j;
+    os << "continuum" << hexfloat;
+    for( i=0; i<continuum_energies.size(); i++ ) os << " " << continuum_energies[i];
+    for( i=0; i<continuum_intensities.size(); i++ ) os << " " << continuum_intensities[i];
+    for( i=0; i<tube_lines_ext.size(); i++ ) {
+        os << " lines " << tube_lines_ext[i].edge().element().Z() << " " << tube_lines_ext[i].edge().energy();
+        for( j=0; j<tube_lines_ext[i].numberOfLines(); j++ )
+            os << " " << tube_lines_ext[i].energy( j ) << " " << tube_lines_ext[i].intensity( j );
+    };
+    os << defaultfloat << endl;
+}
+
 string XraySource::toString() const
 {
     ostringstream os;
@@ -50,6 +50,7 @@ class XraySource {
 //      Modified May 21, 2020 to add constructor from XrayLines objects and continuum arrays
 //                                  so tube spectrum can be used from a different calculation
 //                            move Be window absorption out of header file for Ebel continuum
+//      Modified Oct. 16, 2026 to add key function with exact parameter values for the FP setup caches
 
 public:
 //		must have default constructor to declare arrays
@@ -105,6 +106,8 @@ public:
 	const float mmBe ( ) const { return window.thickness() * 10.0; };   //  Convert cm to mm
 
 	string toString() const;
+//		exact parameter values for cache keys
+	void key( std::ostream &os ) const;
 
 private:
 	bool tube;
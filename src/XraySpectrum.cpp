@@ -86,10 +86,24 @@
 //                           Comment out bkg_SNIP for now, may need it in the future
 //  Modified June 9, 2021   Fix bug in energy per channel calculation that was disturbing convolution normalization  (header change only)
 //                          Add geometry factor so it can be written to bulk sum MSA files  (header change only)
+//  Modified Oct. 16, 2026  Keep track of the non-zero channel band of each component, sums over components only use their bands
+//  Modified Oct. 16, 2026  Add XrayEnergyCal::identical to compare every term of the calibration (header change only)
+//                          Add fit_vector_bands to pass the bands to the least squares fit
 
 
 using namespace std;
 
+//  Channels to sum over for a component, from its band (if known) limited to n channels
+//      The whole spectrum is used if the factor multiplying it is not finite, so inf*0 gives nan as before
+static void band_limits( const SpectrumComponent &component_in, const int n, const float factor, int &start, int &end ) {
+    start = 0;
+    end = n;
+    if( component_in.band_end < 0 || ! isfinite( factor ) ) return;
+    if( component_in.band_start > start ) start = component_in.band_start;
+    if( component_in.band_end < end ) end = component_in.band_end;
+    if( end < start ) end = start;
+};
+
 // ********************************
 //  ***** XrayEnergyCal class *****
 // ********************************
@@ -347,10 +361,12 @@ void XraySpectrum::add_component( const SpectrumComponent &component_in ) {
     //  If component exists already, replace it
     if( ic >= 0 ) {
         components[ic] = component_in;
+        update_band( components[ic] );
         update_intensity( components[ic] );
      // If component does not exist already, add it
     } else {
         components.push_back( component_in );
+        update_band( components[components.size()-1] );
         update_intensity( components[components.size()-1] );
     }
     return;
@@ -369,6 +385,7 @@ void XraySpectrum::update_component( const SpectrumComponent &component_in ) {
     int ic = find_component( component_in );
     if( ic >= 0 ) {
         move_spectrum( component_in.spectrum, components[ic].spectrum );
+        update_band( components[ic] );
         update_intensity( components[ic] );
         components[ic].matrix = component_in.matrix;
     }
@@ -499,8 +516,9 @@ void XraySpectrum::update_background() {
         if( components[ic].coefficient <= 0 ) continue;
         if( components[ic].spectrum.size() < measured_data.size() ) continue;
         found_bkg = true;
-        int is;
-        for( is=0; is<measured_data.size(); is++ ) {
+        int is, is_start, is_end;
+        band_limits( components[ic], measured_data.size(), components[ic].coefficient, is_start, is_end );
+        for( is=is_start; is<is_end; is++ ) {
             float value = components[ic].coefficient * components[ic].spectrum[is];
             temp_bkg[is] += value;
         }
@@ -521,8 +539,9 @@ void XraySpectrum::update_calc( ) {
         if( components[ic].bkg ) continue;
         if( ! components[ic].enabled ) continue;
         if( components[ic].spectrum.size() < measured_data.size() ) continue;
-        int is;
-        for( is=0; is<measured_data.size(); is++ ) {
+        int is, is_start, is_end;
+        band_limits( components[ic], measured_data.size(), components[ic].coefficient, is_start, is_end );
+        for( is=is_start; is<is_end; is++ ) {
             float value = components[ic].coefficient * components[ic].spectrum[is];
             temp_calc[is] += value;
         }
@@ -555,8 +574,9 @@ void XraySpectrum::fit_vector( std::vector <float> &componentSpectra,
         if( ! components[ic].fit ) continue;
         if( components[ic].spectrum.size() < ns ) continue;
         float spec_sum = 0;
-        int is;
-        for( is=0; is<ns; is++ ) spec_sum += components[ic].spectrum[is];
+        int is, is_start, is_end;
+        band_limits( components[ic], ns, 1, is_start, is_end );
+        for( is=is_start; is<is_end; is++ ) spec_sum += components[ic].spectrum[is];
         if( spec_sum <= 0 || isnan( spec_sum ) ) continue;   //  Avoid singular fit matrix
         if( spec_sum > largest_int ) largest_int = spec_sum;
         if( spec_sum / largest_int < 1e-10f )  continue;    //  Avoid fit instability from very small components
@@ -592,6 +612,17 @@ void XraySpectrum::fit_vector( std::vector <float> &componentSpectra,
     return;
 };
 
+void XraySpectrum::fit_vector_bands( std::vector <int> &band_start, std::vector <int> &band_end ) const {
+    //  Non-zero channel band for each spectrum in the last fit vector (whole spectrum if not known)
+    int ns = measured_data.size();
+    band_start.resize( fit_vector_indices.size() );
+    band_end.resize( fit_vector_indices.size() );
+    int ic_fit;
+    for( ic_fit=0; ic_fit<fit_vector_indices.size(); ic_fit++ ) {
+        band_limits( components[ fit_vector_indices[ic_fit] ], ns, 1, band_start[ic_fit], band_end[ic_fit] );
+    }
+};
+
 int XraySpectrum::update_coefficients( const std::vector <float> &new_coefficients,
                    const std::vector <float> &new_variances ) {
     //  Update the values of the coefficients for all enabled components included in the least squares fit
@@ -632,6 +663,7 @@ void XraySpectrum::clean() {
     int ic;
     for( ic=0; ic<components.size(); ic++ ) {
         components[ic].spectrum.clear();
+        update_band( components[ic] );
         //  Force reallocation to actually free up the space
         //  (This will eventually be replaced by the shrink_to_fit member function)
         vector<float>(components[ic].spectrum).swap(components[ic].spectrum);
@@ -699,10 +731,32 @@ int XraySpectrum::find_component( const SpectrumComponent &component_in ) const
     return index;
 };
 
+void XraySpectrum::update_band( SpectrumComponent &component_in ) {
+    //  Find the first and last non-zero channels (band is not used if there are any inf or nan values)
+    const vector <float> &spec = component_in.spectrum;
+    int first = spec.size();
+    int last = -1;
+    int is;
+    for( is=0; is<spec.size(); is++ ) {
+        if( ! isfinite( spec[is] ) ) {
+            component_in.band_start = 0;
+            component_in.band_end = -1;
+            return;
+        }
+        if( spec[is] == 0 ) continue;
+        if( is < first ) first = is;
+        last = is;
+    }
+    if( last < 0 ) first = 0;
+    component_in.band_start = first;
+    component_in.band_end = last + 1;
+};
+
 void XraySpectrum::update_intensity( SpectrumComponent &component_in ) {
         float sum = 0;
-        int is;
-        for( is=0; is<component_in.spectrum.size(); is++ ) {
+        int is, is_start, is_end;
+        band_limits( component_in, component_in.spectrum.size(), component_in.coefficient, is_start, is_end );
+        for( is=is_start; is<is_end; is++ ) {
             float value = component_in.coefficient * component_in.spectrum[is];
             sum += value;
         }
@@ -135,6 +135,12 @@ public:
     void offset( const float offset_in ) { offset_save = offset_in; };
     void tilt( const float tilt_in ) { tilt_save = tilt_in; };
     bool good() const { return ( energyPerChannel_save > 0 && ! isnan(energyPerChannel_save) ); };
+    //  True only if every stored term (including temporary and linear corrections) is the same
+    bool identical( const XrayEnergyCal &cal_in ) const {
+        return ( energyStart_save == cal_in.energyStart_save && energyPerChannel_save == cal_in.energyPerChannel_save
+            && quad_save == cal_in.quad_save && offset_save == cal_in.offset_save && tilt_save == cal_in.tilt_save
+            && energyCorrectionOffset_save == cal_in.energyCorrectionOffset_save
+            && energyCorrectionSlope_save == cal_in.energyCorrectionSlope_save ); };
     void linearCorrection( const float lin_offset, const float lin_slope ) { energyCorrectionOffset_save = lin_offset; energyCorrectionSlope_save = lin_slope; return ; };
     const float linearCorrectionOffset( ) const { return energyCorrectionOffset_save; };
     const float linearCorrectionSlope( ) const { return energyCorrectionSlope_save; };
@@ -237,6 +243,8 @@ public:
     //  produces vector of all enabled component spectra plus some other things needed for fits
     void fit_vector( std::vector <float> &componentSpectra,
                 std::vector <float> &coefficients_out, std::vector <float> &centerEnergy );
+    //  channel range of the non-zero part of each spectrum in the fit vector (in the same order)
+    void fit_vector_bands( std::vector <int> &band_start, std::vector <int> &band_end ) const;
     int update_coefficients( const std::vector <float> &new_coefficients,
                    const std::vector <float> &new_variances ); //  this list must match the spectra returned by the above function
     void clean();   //  Remove the component spectra to save storage space when lots of spectra processed
@@ -324,6 +332,7 @@ private:
     void move_spectrum( const std::vector <float> &vec_in, std::vector <float> &vec_out, const float factor = 1 );
     int find_component( const Element &el_in ) const;
     int find_component( const SpectrumComponent &component_in ) const;
+    void update_band( SpectrumComponent &component_in );
     void update_intensity( SpectrumComponent &component_in );
     void update_non_fit_coefficients();
     void update_background();   //  Used when background components are included in fit
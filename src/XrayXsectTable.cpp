@@ -30,7 +30,13 @@
 #include <iostream>
 #include <ios>
 #include <iosfwd>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <algorithm>
 #include "XrayXsectTable.h"
+#include "XRFcontrols.h"
 //#include "xrayxsct_data.h"
 #include "xrayxsct_data_cmh.h"
 #include "nofx.h"
@@ -51,6 +57,21 @@ using namespace std;
 //	Chantler, C.T., Olsen, K., Dragoset, R.A., Chang, J., Kishore, A.R., Kotochigova, S.A., and Zucker, D.S. (2005), X-Ray Form Factor, Attenuation and Scattering Tables (version 2.1). [Online] Available: http://physics.nist.gov/ffast [year, month day]. National Institute of Standards and Technology, Gaithersburg, MD.
 //	Originally published as Chantler, C.T., J. Phys. Chem. Ref. Data 29(4), 597-1048 (2000); and Chantler, C.T., J. Phys. Chem. Ref. Data 24, 71-643 (1995).
 //  Modified July 25, 2019 to prevent na returns when energy is too low for tables
+//  Modified Oct. 16, 2026 to add optional tabulated mode (XSECT_TABULATED in XRFcontrols.h or XrayXsectTable::tabulated, -X option)
+//  Modified Oct. 17, 2026 to look up the tabulated values without taking the log of the energy
+//      Each element gets a uniform log-energy grid, built once from the splines and shared by all tables for that element
+
+static atomic <bool> use_grid( XSECT_TABULATED );
+static mutex grid_mutex;
+static map <int, shared_ptr <const XsectGrid> > element_grids;
+
+void XrayXsectTable::tabulated( const bool use_grid_in ) {
+	use_grid = use_grid_in;
+};
+
+bool XrayXsectTable::tabulated() {
+	return use_grid;
+};
 
 XrayXsectTable::XrayXsectTable(const Element& el) {
 	int i;
@@ -100,7 +121,17 @@ XrayXsectTable::XrayXsectTable(const Element& el) {
 			f = db_data[thisPointer+2];
 			splinePhoto[i] = f;
 		};
-
+//			attach the grid for this element, calculate it if this is the first table for the element
+		if ( use_grid ) {
+			lock_guard <mutex> lock( grid_mutex );
+			shared_ptr <const XsectGrid> &element_grid = element_grids[thisZ];
+			if ( ! element_grid ) {
+				shared_ptr <XsectGrid> new_grid = make_shared <XsectGrid> ();
+				buildGrid( *new_grid );
+				element_grid = new_grid;
+			};
+			grid = element_grid;
+		};
 	};
 };
 
@@ -119,7 +150,7 @@ XrayXsectTable::XrayXsectTable() {
 };
 
 
-float XrayXsectTable::photoCalc(const float energy) const {
+float XrayXsectTable::photoSplineCalc(const float energy) const {
 	if ( energy <= 0.0 ) return 0.0;
 	int i = nofx ( energiesPhoto, log(energy) );
 //		if the requested energy exactly matches an edge discontintuity pair,
@@ -140,3 +171,146 @@ float XrayXsectTable::photoCalc(const float energy) const {
 		return value;
 	};
 };
+
+
+//	fills the grid values for one cross section from the spline calculation and checks the interpolation
+//		at several points inside each grid cell (the largest error is not always at the midpoint
+//		when there is a spline knot inside the cell), with a margin for the error between those points
+static void fill_grid( const XsectGrid &grid, const function <float ( const float )> &spline_value,
+		vector <float> &values, vector <char> &ok, float &max_error ) {
+	int i;
+	for ( i=0; i<grid.n_points; i++ ) {
+		values[i] = spline_value( grid.energy[i] );
+		if ( ! isfinite( values[i] ) ) {
+			ok[i] = false;
+			if ( i > 0 ) ok[i-1] = false;
+		};
+	};
+	for ( i=0; i<grid.n_points-1; i++ ) {
+		if ( ! ok[i] ) continue;
+		float cell_error = 0;
+		int k;
+		for ( k=1; k<XSECT_GRID_CHECKS; k++ ) {
+			float energy = exp( grid.log_start + ( i + k / float( XSECT_GRID_CHECKS ) ) / grid.inv_step );
+			float spline = spline_value( energy );
+			float interpolated = 0;
+			if ( ! grid.lookup( values, ok, energy, interpolated ) ) continue;
+			float error = spline != 0 ? fabs( ( interpolated - spline ) / spline ) : fabs( interpolated );
+			if ( ! ( error <= cell_error ) ) cell_error = error;
+		};
+		if ( ! ( cell_error <= 0.5f * XSECT_GRID_TOLERANCE ) ) {
+			ok[i] = false;
+			continue;
+		};
+		if ( cell_error > max_error ) max_error = cell_error;
+	};
+};
+
+float XrayXsectTable::gridCheck() const {
+	if ( ! grid ) return 0;
+	float max_difference = 0;
+	auto check = [&] ( const float energy ) {
+		if ( ! ( energy > 0 ) ) return;
+		float spline[3] = { energiesCoh.empty() ? 0.0f : float( exp( splint( energiesCoh, sigmaCoh, splineCoh, log( energy ) ) ) ),
+				energiesCoh.empty() ? 0.0f : float( exp( splint( energiesCoh, sigmaIncoh, splineIncoh, log( energy ) ) ) ),
+				photoSplineCalc( energy ) };
+		float value[3] = { cohCalc( energy ), incohCalc( energy ), photoCalc( energy ) };
+		int k;
+		for ( k=0; k<3; k++ ) {
+			float difference = spline[k] != 0 ? fabs( ( value[k] - spline[k] ) / spline[k] ) : fabs( value[k] );
+			if ( ! ( difference <= max_difference ) ) max_difference = difference;
+		};
+	};
+//		grid points and points in each cell that are not the ones used by fill_grid
+	int i;
+	for ( i=0; i<grid->n_points; i++ ) {
+		int k;
+		for ( k=0; k<5; k++ ) check( exp( grid->log_start + ( i + 0.2f * k ) / grid->inv_step ) );
+	};
+//		both sides of each absorption edge (pairs of equal energies in the photoabsorption table)
+	for ( i=0; i<int( energiesPhoto.size() ) - 1; i++ ) {
+		if ( energiesPhoto[i] != energiesPhoto[i+1] ) continue;
+		float edge = exp( energiesPhoto[i] );
+		check( edge );
+		check( edge * ( 1 - 1.0e-5f ) );
+		check( edge * ( 1 + 1.0e-5f ) );
+		check( edge * exp( -XSECT_GRID_STEP ) );
+		check( edge * exp( XSECT_GRID_STEP ) );
+	};
+	return max_difference;
+};
+
+void XrayXsectTable::gridCheckAll( int &n_elements, float &max_difference, float &max_grid_error ) {
+	n_elements = 0;
+	max_difference = 0;
+	max_grid_error = 0;
+	int z;
+	for ( z=1; z<=maxZ; z++ ) {
+		XrayXsectTable table( ( Element( z ) ) );
+		if ( ! table.gridded() ) continue;
+		n_elements++;
+		float difference = table.gridCheck();
+		if ( ! ( difference <= max_difference ) ) max_difference = difference;
+		if ( table.gridError() > max_grid_error ) max_grid_error = table.gridError();
+	};
+};
+
+//	saves the grid energies and the first cell for each bucket of energy bits, used by lookup to find the cell
+void XsectGrid::index_cells() {
+	energy.resize( n_points );
+	inv_width.assign( n_points, 0 );
+	int i;
+	for ( i=0; i<n_points; i++ ) energy[i] = exp( log_start + i / inv_step );
+	for ( i=0; i<n_points-1; i++ ) inv_width[i] = 1 / ( energy[i+1] - energy[i] );
+	bucket_cell.clear();
+	if ( n_points < 2 ) return;
+	const int shift = 23 - XSECT_GRID_BUCKET_BITS;
+	uint32_t bits;
+	memcpy( &bits, &energy[0], sizeof( bits ) );
+	first_bucket = bits >> shift;
+	memcpy( &bits, &energy[n_points-1], sizeof( bits ) );
+	const uint32_t last_bucket = bits >> shift;
+	i = 0;
+	uint32_t b;
+	for ( b=first_bucket; b<=last_bucket; b++ ) {
+		uint32_t low_bits = b << shift;
+		float low;
+		memcpy( &low, &low_bits, sizeof( low ) );
+		while ( i < n_points - 2 && low >= energy[i+1] ) i++;
+		bucket_cell.push_back( i );
+	};
+};
+
+//	calculates the uniform log-energy grids for this element from the spline tables
+void XrayXsectTable::buildGrid( XsectGrid &grid_out ) const {
+	if ( energiesCoh.size() < 2 || energiesPhoto.size() < 2 ) return;
+//		the range covered by both tables, the splines are used outside of it
+	float x_start = max( energiesCoh.front(), energiesPhoto.front() );
+	float x_end = min( energiesCoh.back(), energiesPhoto.back() );
+	if ( ! ( x_end > x_start ) ) return;
+	grid_out.log_start = x_start;
+	grid_out.inv_step = 1 / XSECT_GRID_STEP;
+	grid_out.n_points = int( ( x_end - x_start ) * grid_out.inv_step ) + 1;
+	grid_out.index_cells();
+	grid_out.coh.assign( grid_out.n_points, 0 );
+	grid_out.incoh.assign( grid_out.n_points, 0 );
+	grid_out.photo.assign( grid_out.n_points, 0 );
+	grid_out.coh_ok.assign( grid_out.n_points, true );
+	grid_out.incoh_ok.assign( grid_out.n_points, true );
+	grid_out.photo_ok.assign( grid_out.n_points, true );
+//		cells next to an absorption edge (pair of equal energies in the table) always use the spline
+	int i;
+	for ( i=0; i<int( energiesPhoto.size() ) - 1; i++ ) {
+		if ( energiesPhoto[i] != energiesPhoto[i+1] ) continue;
+		int cell = int( floor( ( energiesPhoto[i] - x_start ) * grid_out.inv_step ) );
+		int k;
+		for ( k=cell-1; k<=cell+1; k++ ) if ( k >= 0 && k < grid_out.n_points ) grid_out.photo_ok[k] = false;
+	};
+	float max_error = 0;
+	fill_grid( grid_out, [this] ( const float e ) { return energiesCoh.empty() || e <= 0 ? 0.0f
+			: exp( splint( energiesCoh, sigmaCoh, splineCoh, log( e ) ) ); }, grid_out.coh, grid_out.coh_ok, max_error );
+	fill_grid( grid_out, [this] ( const float e ) { return energiesCoh.empty() || e <= 0 ? 0.0f
+			: exp( splint( energiesCoh, sigmaIncoh, splineIncoh, log( e ) ) ); }, grid_out.incoh, grid_out.incoh_ok, max_error );
+	fill_grid( grid_out, [this] ( const float e ) { return photoSplineCalc( e ); }, grid_out.photo, grid_out.photo_ok, max_error );
+	grid_out.max_error = max_error;
+};
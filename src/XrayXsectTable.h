@@ -34,12 +34,59 @@
 #include <fstream>
 #include <iomanip>
 #include <vector>
+#include <memory>
 #include <math.h>
+#include <cstdint>
+#include <cstring>
 #include "Element.h"
 #include "spline.h"
+#include "XRFcontrols.h"
 
 using namespace std;
 
+//  Cross sections tabulated on a uniform log-energy grid, calculated once per element from the spline tables
+//      Values between grid points are interpolated linearly, grid cells that contain an absorption edge
+//      or where the interpolation does not match the spline to XSECT_GRID_TOLERANCE use the spline instead
+//  Added Oct. 16, 2026
+//  Modified Oct. 17, 2026  Find the grid cell from the bits of the energy and the saved grid energies,
+//      and interpolate linearly in energy, so a lookup does not need a log (see index_cells)
+struct XsectGrid {
+	float log_start = 0;
+	float inv_step = 0;
+	int n_points = 0;
+	//  energy at each grid point and 1 / width of each cell
+	vector<float> energy;
+	vector<float> inv_width;
+	//  the energy bits above the top XSECT_GRID_BUCKET_BITS of the mantissa select a bucket (positive floats
+	//      sort the same as their bits), this is the cell that contains the lowest energy in each bucket
+	vector<int> bucket_cell;
+	uint32_t first_bucket = 0;
+	vector<float> coh;
+	vector<float> incoh;
+	vector<float> photo;
+	//  one flag for each grid cell (starting at that grid point), true if the interpolation can be used
+	vector<char> coh_ok;
+	vector<char> incoh_ok;
+	vector<char> photo_ok;
+	//  largest relative difference from the spline at the points checked inside the cells that are used
+	float max_error = 0;
+	void index_cells();
+	bool lookup( const vector<float> &values, const vector<char> &ok, const float e, float &result ) const {
+		if ( n_points < 2 ) return false;
+		const float *en = energy.data();
+		if ( ! ( e >= en[0] && e < en[n_points-1] ) ) return false;	//	also rejects nan
+		uint32_t bits;
+		memcpy( &bits, &e, sizeof( bits ) );
+		int i = bucket_cell.data()[ ( bits >> ( 23 - XSECT_GRID_BUCKET_BITS ) ) - first_bucket ];
+		while ( e >= en[i+1] ) i++;		//	buckets are narrower than a few cells
+		if ( ! ok.data()[i] ) return false;
+		const float *v = values.data();
+		float f = ( e - en[i] ) * inv_width.data()[i];
+		result = v[i] + f * ( v[i+1] - v[i] );
+		return true;
+	};
+};
+
 //	Elam Ravel Sieber database class
 
 class XrayXsectTable {
@@ -81,16 +128,39 @@ public:
 	float photoEnergy(const int index) const { return energiesPhoto.at(index); };
 	float photoValue(const int index) const { return sigmaPhoto.at(index); };
 	float photoSpline(const int index) const { return splinePhoto.at(index); };
+//		switch between the spline tables and the tabulated grids (only affects tables constructed afterwards)
+	static void tabulated( const bool use_grid_in );
+	static bool tabulated();
+	bool gridded() const { return bool( grid ); };
+	float gridError() const { return grid ? grid->max_error : 0; };
+//		largest relative difference between the grid values and the splines for this table (zero if no grid),
+//			checked at 0, 0.2, 0.4, 0.6, and 0.8 of each grid cell (fill_grid checks at the points that divide
+//			each cell into XSECT_GRID_CHECKS parts), and at every absorption edge, just either side of it,
+//			and one grid step either side of it
+	float gridCheck() const;
+//		checks the grids for every element in the database (tabulated mode must be on), returns the largest
+//			difference from gridCheck and the largest gridError
+	static void gridCheckAll( int &n_elements, float &max_difference, float &max_grid_error );
 
 private:
 	float cohCalc(const float energy) const {
+		float value;
+		if ( grid && grid->lookup( grid->coh, grid->coh_ok, energy, value ) ) return value;
 		return energy > 0.0 ? exp ( splint(energiesCoh, sigmaCoh, splineCoh, log(energy) ) ) :0.0;
 	};
 	float incohCalc(const float energy) const { 
+		float value;
+		if ( grid && grid->lookup( grid->incoh, grid->incoh_ok, energy, value ) ) return value;
 		return energy > 0.0 ? exp ( splint(energiesCoh, sigmaIncoh, splineIncoh, log(energy) ) ) :0.0;
 	};	
-//			photoCalc must check for exact match to edge energy and always return xsect below edge
-	float photoCalc(const float energy) const ;
+	float photoCalc(const float energy) const {
+		float value;
+		if ( grid && grid->lookup( grid->photo, grid->photo_ok, energy, value ) ) return value;
+		return photoSplineCalc( energy );
+	};
+//			photoSplineCalc must check for exact match to edge energy and always return xsect below edge
+	float photoSplineCalc(const float energy) const ;
+	void buildGrid( XsectGrid &grid_out ) const;
 
 //individual data
 	Element thisElement;
@@ -104,5 +174,7 @@ private:
 	vector<float> energiesPhoto;
 	vector<float> sigmaPhoto;
 	vector<float> splinePhoto; 
+//		shared by all tables for this element, empty unless the tabulated mode was on when constructed
+	shared_ptr<const XsectGrid> grid;
 };
 #endif
@@ -0,0 +1,121 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+//  Anderson mixing for fixed-point iterations
+//  Oct. 16, 2026
+
+#include <math.h>
+#include <utility>
+#include "andersonMix.h"
+
+using namespace std;
+
+bool andersonMix( AndersonHistory &history, const vector <double> &x, const vector <double> &g,
+        vector <double> &x_new ) {
+
+    const int n = x.size();
+    vector <double> r( n );
+    int i, j, k;
+    for( i=0; i<n; i++ ) r[i] = g[i] - x[i];
+    x_new = g;
+
+    //  Start over if the number of variables changed, otherwise add the differences from the last iterate
+    if( (int) history.x_last.size() != n ) {
+        history.clear();
+    } else {
+        vector <double> dx_k( n ), dr_k( n );
+        for( i=0; i<n; i++ ) {
+            dx_k[i] = x[i] - history.x_last[i];
+            dr_k[i] = r[i] - history.r_last[i];
+        }
+        history.dx.push_back( dx_k );
+        history.dr.push_back( dr_k );
+        if( (int) history.dx.size() > history.depth ) {
+            history.dx.erase( history.dx.begin() );
+            history.dr.erase( history.dr.begin() );
+        }
+    }
+    history.x_last = x;
+    history.r_last = r;
+    const int m = history.dr.size();
+    if( m <= 0 || n <= 0 ) return false;
+
+    //  Normal equations for the coefficients gamma that minimize | r - dr gamma |
+    vector <double> a( m * m );
+    vector <double> gamma( m );
+    double trace = 0;
+    for( j=0; j<m; j++ ) {
+        for( k=0; k<m; k++ ) {
+            double sum = 0;
+            for( i=0; i<n; i++ ) sum += history.dr[j][i] * history.dr[k][i];
+            a[j*m+k] = sum;
+        }
+        double sum = 0;
+        for( i=0; i<n; i++ ) sum += history.dr[j][i] * r[i];
+        gamma[j] = sum;
+        trace += a[j*m+j];
+    }
+    //  A little regularization keeps this stable when the residual differences are nearly parallel
+    if( trace <= 0 || isnan( trace ) ) {
+        history.dx.clear();
+        history.dr.clear();
+        return false;
+    }
+    for( j=0; j<m; j++ ) a[j*m+j] += 1e-10 * trace;
+    //  Gaussian elimination with partial pivoting (m is only a few)
+    for( j=0; j<m; j++ ) {
+        int p = j;
+        for( k=j+1; k<m; k++ ) if( fabs( a[k*m+j] ) > fabs( a[p*m+j] ) ) p = k;
+        if( fabs( a[p*m+j] ) <= 1e-12 * trace ) {
+            history.dx.clear();
+            history.dr.clear();
+            return false;
+        }
+        if( p != j ) {
+            for( k=0; k<m; k++ ) swap( a[j*m+k], a[p*m+k] );
+            swap( gamma[j], gamma[p] );
+        }
+        for( k=j+1; k<m; k++ ) {
+            const double f = a[k*m+j] / a[j*m+j];
+            int l;
+            for( l=j; l<m; l++ ) a[k*m+l] -= f * a[j*m+l];
+            gamma[k] -= f * gamma[j];
+        }
+    }
+    for( j=m-1; j>=0; j-- ) {
+        for( k=j+1; k<m; k++ ) gamma[j] -= a[j*m+k] * gamma[k];
+        gamma[j] /= a[j*m+j];
+    }
+
+    //  Mixed iterate is g minus the same combination of the changes in g (dx + dr)
+    for( j=0; j<m; j++ ) {
+        for( i=0; i<n; i++ ) x_new[i] -= gamma[j] * ( history.dx[j][i] + history.dr[j][i] );
+    }
+    return true;
+}
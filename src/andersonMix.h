@@ -0,0 +1,57 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef andersonMix_h
+#define andersonMix_h
+
+#include <vector>
+#include "XRFcontrols.h"
+
+//  Oct. 16, 2026
+//  Anderson mixing (also called DIIS) to speed up a fixed-point iteration x -> g(x)
+//      Keeps the last few iterates and residuals r = g(x) - x, and returns the combination of them
+//      that minimizes the residual in a least-squares sense (Walker and Ni, SIAM J. Numer. Anal. 49, 1715 (2011))
+//  The caller must clear the history whenever the meaning of the variables changes (e.g. one is dropped)
+
+struct AndersonHistory {
+    int depth = QUANT_ANDERSON_DEPTH;      //  Number of previous iterates used
+    std::vector < std::vector <double> > dx;    //  Differences between successive iterates
+    std::vector < std::vector <double> > dr;    //  Differences between successive residuals
+    std::vector <double> x_last;
+    std::vector <double> r_last;
+    void clear() { dx.clear(); dr.clear(); x_last.clear(); r_last.clear(); };
+};
+
+//  x is the current iterate and g the result of the plain fixed-point step from it
+//  Returns true and the mixed next iterate in x_new, or false if there is not enough history yet
+//      or the least-squares problem is singular (x_new is then g, and the history is restarted from x)
+bool andersonMix( AndersonHistory &history, const std::vector <double> &x, const std::vector <double> &g,
+        std::vector <double> &x_new );
+
+#endif
@@ -43,53 +43,105 @@
 //	Written Jan. 28, 2017 from code in fpMain.cpp, mostly fpContScat function
 //      Extensive re-write to use new XRFconditions and XrayMaterial class
 //      also add extra information from ISO standard version of EMSA format
+//  Modified Oct. 16, 2026
+//      Separate the material transmissions from the products so they can be saved in DetectorResponseTable
+//      (the products are always formed here in the same order, so results are identical)
+//      DetectorResponseTable holds the values for each channel of a spectrum
 
 
 using namespace std;
 
+IncidentTransmissions fpIncidentTransmissions( const float energy, const XRFconditions &conditions ) {
+    IncidentTransmissions t;
+    //			incident beam filtration
+    if( conditions.filter.thickness() > 0 )
+        t.filter = conditions.filter.transmission( energy );
+    // Optic transmission function
+    if ( !conditions.optic.DefaultCheck() )
+        t.optic = conditions.optic.CheckTransmission( energy );
+    //  Dust on optic
+    if( conditions.dust_on_optic.thickness() > 0 )
+        t.dust_on_optic = conditions.dust_on_optic.transmission( energy );
+    //  Atmosphere path
+    if( conditions.incidentPath.thickness() > 0 )
+        t.path = conditions.incidentPath.transmission( energy );
+    //  Dust on specimen (to incoming beam)
+    if( conditions.dust_on_specimen.thickness() > 0 )
+        t.dust_on_specimen = conditions.dust_on_specimen.transmission( energy, conditions.excitCosecant );
+    //  Window in front of specimen (to incoming beam)
+    if( conditions.window.thickness() > 0 )
+        t.window = conditions.window.transmission( energy, conditions.excitCosecant );
+    return t;
+};
+
+EmergentTransmissions fpEmergentTransmissions( const float energy, const XRFconditions &conditions ) {
+    EmergentTransmissions t;
+    //  Dust on specimen (to outgoing beam)
+    if( conditions.dust_on_specimen.thickness() > 0 )
+        t.dust_on_specimen = conditions.dust_on_specimen.transmission( energy, conditions.emergCosecant );
+    //  Window in front of specimen (to outgoing beam)
+    if( conditions.window.thickness() > 0 )
+        t.window = conditions.window.transmission( energy, conditions.emergCosecant );
+    //  Atmosphere path
+    if( conditions.emergentPath.thickness() > 0 )
+        t.path = conditions.emergentPath.transmission( energy );
+    //  Dust on detector
+    if( conditions.dust_on_detector.thickness() > 0 )
+        t.dust_on_detector = conditions.dust_on_detector.transmission( energy );
+    return t;
+};
+
 float fpIncidentBeam( const float energy, const XRFconditions &conditions ) {
+    return fpIncidentBeam( fpIncidentTransmissions( energy, conditions ), conditions );
+};
+
+float fpEmergentBeam( const float energy, const XRFconditions &conditions ) {
+    return fpEmergentBeam( fpEmergentTransmissions( energy, conditions ), conditions );
+};
+
+float fpIncidentBeam( const IncidentTransmissions &t, const XRFconditions &conditions ) {
     float factor = 1;
     //			apply incident beam filtration
     if( conditions.filter.thickness() > 0 )
-        factor *= conditions.filter.transmission( energy );
+        factor *= t.filter;
     // Apply Optic transmission function
     if ( !conditions.optic.DefaultCheck() )
-        factor *= conditions.optic.CheckTransmission( energy );
+        factor *= t.optic;
     //  Apply effect of dust on optic
     if( conditions.dust_on_optic.thickness() > 0 )
-        factor *= conditions.dust_on_optic.transmission( energy );
+        factor *= t.dust_on_optic;
     //  Apply effect of atmosphere path
     if( conditions.incidentPath.thickness() > 0 )
-        factor *= conditions.incidentPath.transmission( energy );
+        factor *= t.path;
     //  Account for source solid angle
     if( conditions.solidAngleSource > 0 )
         factor *= conditions.solidAngleSource;  //  Note that this is not steradians, converted in fpSetupConditions.cpp
     //  Apply effect of dust on specimen (to incoming beam)
     if( conditions.dust_on_specimen.thickness() > 0 )
-        factor *= conditions.dust_on_specimen.transmission( energy, conditions.excitCosecant );
+        factor *= t.dust_on_specimen;
     //  Apply effect of window in front of specimen (to incoming beam)
     if( conditions.window.thickness() > 0 )
-        factor *= conditions.window.transmission( energy, conditions.excitCosecant );
+        factor *= t.window;
     return factor;
 };
 
-float fpEmergentBeam( const float energy, const XRFconditions &conditions ) {
+float fpEmergentBeam( const EmergentTransmissions &t, const XRFconditions &conditions ) {
     float factor = 1;
     //  Account for geometric factor
     if( conditions.geometryFactor > 0 )
         factor *= conditions.geometryFactor;
     //  Apply effect of dust on specimen (to outgoing beam)
     if( conditions.dust_on_specimen.thickness() > 0 )
-        factor *= conditions.dust_on_specimen.transmission( energy, conditions.emergCosecant );
+        factor *= t.dust_on_specimen;
     //  Apply effect of window in front of specimen (to outgoing beam)
     if( conditions.window.thickness() > 0 )
-        factor *= conditions.window.transmission( energy, conditions.emergCosecant );
+        factor *= t.window;
     //  Apply effect of atmosphere path
     if( conditions.emergentPath.thickness() > 0 )
-        factor *= conditions.emergentPath.transmission( energy );
+        factor *= t.path;
     //  Apply effect of dust on detector
     if( conditions.dust_on_detector.thickness() > 0 )
-        factor *= conditions.dust_on_detector.transmission( energy );
+        factor *= t.dust_on_detector;
     //  Account for detector solid angle
     if( conditions.solidAngleDetector > 0 )
         factor *= conditions.solidAngleDetector;  //  Note that this is not steradians, converted in fpSetupConditions.cpp
@@ -110,3 +162,51 @@ void fpEmergentBeam( const XRFconditions &conditions, const std::vector <float>
     return;
 };
 
+
+
+vector <const XrayMaterial *> DetectorResponseTable::beam_material_list( const XRFconditions &conditions ) {
+    //  Every material in the incident and emergent beams (the detector layers are compared with the detector)
+    return { &conditions.filter, &conditions.dust_on_optic, &conditions.incidentPath, &conditions.dust_on_specimen,
+        &conditions.window, &conditions.emergentPath, &conditions.dust_on_detector };
+};
+
+bool DetectorResponseTable::covers( const XrayDetector &detector_in, const XrayEnergyCal &calibration,
+        const int n_channels ) const {
+    return n_channels == n_chan && calibration.identical( cal ) && detector_in.same_layers( detector )
+        && detector_in.resolution() == detector.resolution() && detector_in.fano() == detector.fano();
+};
+
+bool DetectorResponseTable::matches( const XRFconditions &conditions, const XrayEnergyCal &calibration,
+        const int n_channels ) const {
+    if( ! covers( conditions.detector, calibration, n_channels ) ) return false;
+    if( conditions.excitCosecant != excit_cosecant || conditions.emergCosecant != emerg_cosecant ) return false;
+    vector <const XrayMaterial *> m = beam_material_list( conditions );
+    unsigned int i;
+    for( i=0; i<m.size(); i++ ) if( ! m[i]->identical( beam_materials[i] ) ) return false;
+    return optic.identical( conditions.optic );
+};
+
+void DetectorResponseTable::update( const XRFconditions &conditions, const XrayEnergyCal &calibration,
+        const int n_channels ) {
+    if( matches( conditions, calibration, n_channels ) ) return;
+    n_chan = n_channels;
+    cal = calibration;
+    detector = conditions.detector;
+    excit_cosecant = conditions.excitCosecant;
+    emerg_cosecant = conditions.emergCosecant;
+    optic = conditions.optic;
+    vector <const XrayMaterial *> m = beam_material_list( conditions );
+    beam_materials.clear();
+    unsigned int i;
+    for( i=0; i<m.size(); i++ ) beam_materials.push_back( *m[i] );
+    responses.resize( n_chan );
+    incidents.resize( n_chan );
+    emergents.resize( n_chan );
+    int iChan;
+    for( iChan=0; iChan<n_chan; iChan++ ) {
+        float energy = cal.energy( iChan );
+        responses[iChan] = detector.response( energy );
+        incidents[iChan] = fpIncidentTransmissions( energy, conditions );
+        emergents[iChan] = fpEmergentTransmissions( energy, conditions );
+    }
+};
@@ -32,6 +32,7 @@
 
 #include <vector>
 #include "XRFconditions.h"
+#include "XraySpectrum.h"
 
 
     //  Incoming primary beam, from source to specimen
@@ -46,4 +47,65 @@ void fpIncidentBeam( const XRFconditions &conditions, const std::vector <float>
 void fpEmergentBeam( const XRFconditions &conditions, const std::vector <float> &energies,
                     std::vector <float> &intensities );
 
+    //  Transmissions of the materials in each beam, multiplied together in fpIncidentBeam and fpEmergentBeam
+    //      with the solid angles and geometry factor (which can change from spectrum to spectrum)
+struct IncidentTransmissions {
+    float filter = 1;
+    float optic = 1;
+    float dust_on_optic = 1;
+    float path = 1;
+    float dust_on_specimen = 1;
+    float window = 1;
+};
+
+struct EmergentTransmissions {
+    float dust_on_specimen = 1;
+    float window = 1;
+    float path = 1;
+    float dust_on_detector = 1;
+};
+
+IncidentTransmissions fpIncidentTransmissions( const float energy, const XRFconditions &conditions );
+EmergentTransmissions fpEmergentTransmissions( const float energy, const XRFconditions &conditions );
+
+    //  Beam factors from transmissions calculated earlier (same products in the same order as above)
+float fpIncidentBeam( const IncidentTransmissions &transmissions, const XRFconditions &conditions );
+float fpEmergentBeam( const EmergentTransmissions &transmissions, const XRFconditions &conditions );
+
+//  Detector response and beam transmissions for every channel of a spectrum
+//      Made for one energy calibration and number of channels, and for the detector and beam materials,
+//      optic, and angles in the conditions
+//  update rebuilds the table when any of these has changed, including the calibration offset and tilt
+//      and the detector resolution and Fano factor (setResolution and fano), which the fit adjusts
+//      (the values themselves only depend on the channel energies, the materials, optic, and angles)
+//  Kept in FPstorage and updated by quantCalculate, so the values are calculated once for each
+//      calibration and used by fpContScat and fpComptonEscape
+//  Values are exactly the ones calculated directly (no interpolation)
+//  Added Oct. 16, 2026
+class DetectorResponseTable {
+public:
+    void update( const XRFconditions &conditions, const XrayEnergyCal &calibration, const int n_channels );
+    //  Table was made for this detector, calibration, and number of channels (enough for the response)
+    bool covers( const XrayDetector &detector, const XrayEnergyCal &calibration, const int n_channels ) const;
+    //  Also the same beam materials, optic, and angles (needed for the transmissions)
+    bool matches( const XRFconditions &conditions, const XrayEnergyCal &calibration, const int n_channels ) const;
+    float response( const int channel ) const { return responses[channel]; };
+    const IncidentTransmissions &incident( const int channel ) const { return incidents[channel]; };
+    const EmergentTransmissions &emergent( const int channel ) const { return emergents[channel]; };
+private:
+    //  What the values depend on
+    int n_chan = -1;
+    XrayEnergyCal cal;
+    XrayDetector detector;
+    float excit_cosecant = 0;
+    float emerg_cosecant = 0;
+    XrayOptic optic;
+    std::vector <XrayMaterial> beam_materials;
+    static std::vector <const XrayMaterial *> beam_material_list( const XRFconditions &conditions );
+    //  Values for each channel
+    std::vector <float> responses;
+    std::vector <IncidentTransmissions> incidents;
+    std::vector <EmergentTransmissions> emergents;
+};
+
 #endif
@@ -0,0 +1,194 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <math.h>
+#include "fpComptonEscape.h"
+#include "XrayDetector.h"
+
+using namespace std;
+
+//	Compton escape shelf calculation, moved from quantCalculate.cpp     Oct. 16, 2026
+//      The original loop evaluated the detector response and the Compton escape fraction
+//      for every pair of channels on every call
+//      The fractions depend on the energy calibration, which changes on most iterations of a fit,
+//      so the first call with new parameters uses the original loop (only the response is evaluated
+//      once for each channel instead of for every pair), and a ComptonEscapeKernel is made
+//      if the next call has the same parameters (one kernel per thread)
+//      In the BHVO-2G quantify test all 18 calls have a different calibration, so no kernel is made
+//  Modified Oct. 17, 2026  Only make the kernel when it is used again, compare the detector layers directly
+//                          Take the response from the DetectorResponseTable that quantCalculate made for the same calibration
+
+void fpComptonEscape( const XrayDetector &detector, const XrayEnergyCal &cal_in, const float eMin,
+        const float max_energy, const vector <float> &calc, vector <float> &ce_calc,
+        const DetectorResponseTable &table ) {
+    //  Each map thread has its own kernel and parameters, so no locking is needed
+    static thread_local unique_ptr <ComptonEscapeKernel> kernel;
+    static thread_local ComptonEscapeParameters previous;
+    const int n_out = ce_calc.size();
+    const int n_in = calc.size();
+    if( kernel && kernel->matches( detector, cal_in, eMin, max_energy, n_out, n_in ) ) {
+        kernel->apply( calc, ce_calc );
+        return;
+    }
+    if( previous.matches( detector, cal_in, eMin, max_energy, n_out, n_in ) ) {
+        //  Same parameters as the last call, so the kernel will probably be used again
+        kernel.reset( new ComptonEscapeKernel( detector, cal_in, eMin, max_energy, n_out, n_in ) );
+        kernel->apply( calc, ce_calc );
+        return;
+    }
+    previous.set( detector, cal_in, eMin, max_energy, n_out, n_in );
+    //  Find original intensity incident on detector by dividing by response at each energy
+    vector <float> incoming( n_in, 0 );
+    vector <char> use( n_in, false );
+    const bool use_table = table.covers( detector, cal_in, n_in );
+    int is;
+    for( is=0; is<n_in; is++ ) {
+        float meas_intensity = calc[is];
+        if( meas_intensity <= 0 ) continue;
+        float det_resp = use_table ? table.response( is ) : detector.response( cal_in.energy( is ) );
+        if( det_resp <= 0 ) continue;
+        incoming[is] =  meas_intensity / det_resp;
+        use[is] = true;
+    }
+    //  Loop over channels in the full calculation and add Compton escape contribution
+    int i_ce;
+    for( i_ce=0; i_ce<n_out; i_ce++ ) {
+        float spec_energy = cal_in.energy( i_ce );
+        if( spec_energy < eMin ) continue;
+        //  Check if Compton escape is possible for this channel (or any higher channels)
+        float min_ce_energy = detector.ce_minimum( spec_energy );
+        if( min_ce_energy > max_energy ) break;
+        unsigned int min_ce_channel = cal_in.channel( min_ce_energy );
+        if( min_ce_channel >= n_in - 1 ) break;
+        for( is=min_ce_channel; is<n_in; is++ ) {
+            if( ! use[is] ) continue;
+            //  Add the Compton escape intensity from this incident energy to the background channel
+            ce_calc[i_ce] += incoming[is] * detector.ce_fraction( cal_in.energy( is ), spec_energy );
+        }
+    }
+    return;
+};
+
+
+bool ComptonEscapeParameters::matches( const XrayDetector &detector_in, const XrayEnergyCal &cal_in, const float eMin,
+        const float max_energy, const int n_out, const int n_in ) const {
+    return ( n_out == n_output && n_in == n_input && eMin == e_min && max_energy == e_max
+        && cal_in.identical( cal ) && detector_in.same_layers( detector ) );
+};
+
+void ComptonEscapeParameters::set( const XrayDetector &detector_in, const XrayEnergyCal &cal_in, const float eMin,
+        const float max_energy, const int n_out, const int n_in ) {
+    //  The detector layers don't change during a fit, so they are only copied when they do
+    if( ! detector_in.same_layers( detector ) ) detector = detector_in;
+    cal = cal_in;
+    e_min = eMin;
+    e_max = max_energy;
+    n_output = n_out;
+    n_input = n_in;
+};
+
+
+ComptonEscapeKernel::ComptonEscapeKernel( const XrayDetector &detector, const XrayEnergyCal &cal_in, const float eMin,
+        const float max_energy, const int n_out, const int n_in ) {
+    parameters.set( detector, cal_in, eMin, max_energy, n_out, n_in );
+    first_input = n_in;
+    row_first.assign( n_out, 0 );
+    row_offset.assign( n_out + 1, 0 );
+    vector <float> row;
+    //  Loop over channels in the full calculation and find the channels that can contribute Compton escape
+    unsigned int i_ce;
+    for( i_ce=0; i_ce<n_out; i_ce++ ) {
+        row_offset[i_ce] = fractions.size();
+        row_first[i_ce] = n_in;
+        if( n_in <= 0 ) continue;
+        float spec_energy = cal_in.energy( int( i_ce ) );
+        if( spec_energy < eMin ) continue;
+        //  Check if Compton escape is possible for this channel (or any higher channels)
+        float min_ce_energy = detector.ce_minimum( spec_energy );
+        if( min_ce_energy > max_energy ) break;
+        unsigned int min_ce_channel = cal_in.channel( min_ce_energy );
+        if( min_ce_channel >= n_in - 1 ) break;
+        //  Compton escape for this spectrum channel from each incident energy
+        row.resize( n_in - min_ce_channel );
+        unsigned int is;
+        for( is=min_ce_channel; is<n_in; is++ ) row[is-min_ce_channel] = detector.ce_fraction( cal_in.energy( int( is ) ), spec_energy );
+        //  Only keep the band between the first and last non-zero fractions
+        int first = 0;
+        int last = int( row.size() ) - 1;
+        while( first <= last && row[first] == 0 ) first++;
+        while( last >= first && row[last] == 0 ) last--;
+        if( first > last ) continue;
+        row_first[i_ce] = min_ce_channel + first;
+        if( row_first[i_ce] < first_input ) first_input = row_first[i_ce];
+        fractions.insert( fractions.end(), row.begin() + first, row.begin() + last + 1 );
+    }
+    for( ; i_ce<n_out; i_ce++ ) {
+        row_offset[i_ce] = fractions.size();
+        row_first[i_ce] = n_in;
+    }
+    row_offset[n_out] = fractions.size();
+    response.assign( n_in - first_input, 0 );
+    int is;
+    for( is=first_input; is<n_in; is++ ) response[is-first_input] = detector.response( cal_in.energy( is ) );
+};
+
+
+void ComptonEscapeKernel::apply( const vector <float> &calc, vector <float> &ce_calc ) const {
+    const int n_input = parameters.n_input;
+    const int n_output = parameters.n_output;
+    if( calc.size() != n_input || ce_calc.size() != n_output ) return;
+    //  Find original intensity incident on detector by dividing by response at each energy
+    vector <float> incoming( n_input - first_input, 0 );
+    vector <char> use( n_input - first_input, false );
+    int is;
+    for( is=first_input; is<n_input; is++ ) {
+        float meas_intensity = calc[is];
+        if( meas_intensity <= 0 ) continue;
+        float det_resp = response[is-first_input];
+        if( det_resp <= 0 ) continue;
+        incoming[is-first_input] =  meas_intensity / det_resp;
+        use[is-first_input] = true;
+    }
+    int i_ce;
+    for( i_ce=0; i_ce<n_output; i_ce++ ) {
+        int first = row_first[i_ce];
+        const float *frac = fractions.data() + row_offset[i_ce];
+        int n = row_offset[i_ce+1] - row_offset[i_ce];
+        int k;
+        for( k=0; k<n; k++ ) {
+            if( ! use[first+k-first_input] ) continue;
+            //  Add the Compton escape intensity to the background channel
+            ce_calc[i_ce] += incoming[first+k-first_input] * frac[k];
+        }
+    }
+    return;
+};
@@ -0,0 +1,91 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef fpComptonEscape_h
+#define fpComptonEscape_h
+
+#include <vector>
+#include "XraySpectrum.h"
+#include "XrayDetector.h"
+#include "fpBeams.h"
+
+
+//	Compton escape shelf from the spectrum incident on the detector
+//      For each spectrum channel, sum of the Compton escape intensity from all higher channels
+//      (detector response and Compton escape fractions are kept in ComptonEscapeKernel)
+//      The detector response is taken from the table if it was made for this detector and calibration
+//  Moved from quantCalculate.cpp Oct. 16, 2026
+
+void fpComptonEscape( const XrayDetector &detector, const XrayEnergyCal &calibration, const float eMin,
+        const float max_energy, const std::vector <float> &calc, std::vector <float> &ce_calc,
+        const DetectorResponseTable &table );
+
+//  Everything the Compton escape shelf depends on except the calculated spectrum
+//      (the detector only through its window and layers, see XrayDetector::same_layers)
+//  Added Oct. 17, 2026
+struct ComptonEscapeParameters {
+    XrayDetector detector;
+    XrayEnergyCal cal;
+    float e_min = 0;
+    float e_max = 0;
+    int n_output = -1;
+    int n_input = -1;
+    bool matches( const XrayDetector &detector_in, const XrayEnergyCal &calibration, const float eMin,
+        const float max_energy, const int n_out, const int n_in ) const;
+    void set( const XrayDetector &detector_in, const XrayEnergyCal &calibration, const float eMin,
+        const float max_energy, const int n_out, const int n_in );
+};
+
+//  Detector response for each channel and Compton escape fractions for each output channel
+//      Only the band of non-zero fractions is kept for each output channel, and rows stop at the maximum energy
+//      These depend on the energy calibration, which changes on most iterations of a fit that adjusts it,
+//      so fpComptonEscape only makes a kernel when it is called again with the same parameters
+//      (fits with a fixed calibration, or several calculations of the same spectrum)
+//  Results are the same as the original loop (same terms in the same order) for finite intensities
+//      Zero fractions are skipped, so an infinite or NaN intensity does not make a NaN
+//      in output channels it has no Compton escape into (the original loop multiplied it by zero)
+//  Added Oct. 16, 2026
+class ComptonEscapeKernel {
+public:
+    ComptonEscapeKernel( const XrayDetector &detector, const XrayEnergyCal &calibration, const float eMin,
+        const float max_energy, const int n_out, const int n_in );
+    bool matches( const XrayDetector &detector, const XrayEnergyCal &calibration, const float eMin,
+        const float max_energy, const int n_out, const int n_in ) const {
+        return parameters.matches( detector, calibration, eMin, max_energy, n_out, n_in ); };
+    void apply( const std::vector <float> &calc, std::vector <float> &ce_calc ) const;
+private:
+    ComptonEscapeParameters parameters;
+    int first_input = 0;                //  lowest input channel used by any output channel
+    std::vector <float> response;       //  detector response for each input channel (from first_input)
+    std::vector <int> row_first;        //  first input channel with a non-zero fraction for each output channel
+    std::vector <int> row_offset;       //  start of the fractions for each output channel (one more entry than rows)
+    std::vector <float> fractions;
+};
+
+#endif
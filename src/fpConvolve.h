@@ -34,10 +34,34 @@
 #include "XrayDetector.h"
 
 
-//	Convolves calculated spectrum of any component with a Gaussian
-//      Width from detector resolution at each channel energy     May 16, 2019
+//	Convolves calculated spectrum of any component with a Gaussian
+//      Width from detector resolution at each channel energy     May 16, 2019
 //  Brute force convolution, expensive but accurate
+//  Modified Oct. 16, 2026  Pass detector and calibration by reference, use a tabulated kernel
+//      that is kept (per thread) until the detector resolution or energy calibration changes
 
-void fpConvolve( const XrayDetector detector, const XrayEnergyCal calibration, std::vector <float> &spectrum_out );
+void fpConvolve( const XrayDetector &detector, const XrayEnergyCal &calibration, std::vector <float> &spectrum_out );
+
+//  Gaussian weights for every output channel, calculated once for a detector resolution and energy calibration
+//      so applying the convolution is only multiply-add (no exp or energy calculations for each point)
+//  Results are identical to the brute force calculation (same points, same order of the sums)
+//  Added Oct. 16, 2026
+class fpConvolveKernel {
+public:
+    fpConvolveKernel( const XrayDetector &detector, const XrayEnergyCal &calibration, const int n_channels );
+    bool matches( const XrayDetector &detector, const XrayEnergyCal &calibration, const int n_channels ) const;
+    void apply( std::vector <float> &spectrum_out ) const;
+private:
+    int n_chan;
+    float electronic_noise;
+    float fano_factor;
+    float pair_energy;
+    XrayEnergyCal cal;
+    std::vector <float> norm;           //  normalization for each output channel (counts per channel)
+    std::vector <int> first_input;      //  first input channel contributing to each output channel
+    std::vector <int> weight_offset;    //  start of the weights for each output channel (n_chan+1 entries)
+    std::vector <char> energy_ok;       //  input channels with positive energy
+    std::vector <float> weights;
+};
 
 #endif
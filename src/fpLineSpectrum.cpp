@@ -70,9 +70,10 @@ using namespace std;
 //  Modified May 14, 2021   Move shelf factor and slope to XrayDetector and control via -T option
 //  Modified May 25, 2021   Added symbol to grouped lines, for identification during debugging
 //  Modified July 10, 2021  Add simple pulse pileup calculation - return peak intensity information and use average energy for grouped lines
+//  Modified Oct. 16, 2026  Pass detector by reference (it holds several materials with cross section tables)
 
 
-void fpLineSpectrum( const XrayLines &lines_in, const XrayDetector detector, const float threshold_in,
+void fpLineSpectrum( const XrayLines &lines_in, const XrayDetector &detector, const float threshold_in,
 				   const XrayEnergyCal &cal_in, const float eMin, std::vector <LineGroup> &pileup_list,
 				   SpectrumComponent &component_out ) {
 	int ns = component_out.spectrum.size();
@@ -50,7 +50,7 @@ struct LineGroup {
 //		Calculated spectrum is counts in each channel
 //	Added check for zero or negative energy at low channels     Dec. 12, 2011
 
-void fpLineSpectrum( const XrayLines &lines_in, const XrayDetector detector, const float threshold_in,
+void fpLineSpectrum( const XrayLines &lines_in, const XrayDetector &detector, const float threshold_in,
 				   const XrayEnergyCal &cal_in, const float eMin, std::vector <LineGroup> &pileup_list,
 				   SpectrumComponent &component_out );
 
@@ -30,7 +30,9 @@
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <string>
 #include <algorithm>
+#include <functional>
 #include "Element.h"
 #include "XrayEdge.h"
 #include "XrayLines.h"
@@ -83,6 +85,23 @@
 //      Add matrix effect factor to sample XrayLines in fpCalc
 //  Modified Jan. 7, 2021
 //      Implement SEC_FLUOR_THRESHOLD from XRFcontrols.h in fpCalc (and re-arrange sec fluor criteria)
+//  Modified Oct. 16, 2026
+//      Split fpPrep into incident and emergent parts, add fpPrep version using FPprepCache
+//          so the incident part is only calculated once for all the spectra in a map
+//  Modified Oct. 16, 2026
+//      fpContScat takes the detector response and beam transmissions from the table in storage
+//      Pass sample material by reference to fpPrep and fpCalc
+//  Modified Oct. 16, 2026
+//      fpCalc copies the blank line list saved in storage by fpPrep instead of constructing new XrayLines
+//  Modified Oct. 16, 2026
+//      Calculate edge absorption for primary and secondary fluorescence once in fpPrep and keep it in storage
+//          (it only depends on the elements and excitation energies, not on the composition)
+//  Modified Oct. 16, 2026
+//      Keep element cross-sections at the excitation energies in storage, fpCalc only combines them with the fractions
+//  Modified Oct. 16, 2026
+//      Keep the spectrum-independent part of storage in FPprepShared so cache hits share it instead of copying it
+//      Build the cache key from exact parameter values instead of the toString output
+//      FPprepCache calculates new entries without holding its lock (only threads that want the same entry wait)
 
 
 using namespace std;
@@ -97,36 +116,37 @@ using namespace std;
 
 string FPstorage_toString(const FPstorage &storage)
 {
+	const FPprepShared &prep = *storage.prep;
 	ostringstream os;
 	os << "FPstorage:" << endl;
 	os << "  sampleElements:" << endl;
 	int c = 0;
-	for(auto it = storage.sampleElements.begin(); it != storage.sampleElements.end(); it++)
+	for(auto it = prep.sampleElements.begin(); it != prep.sampleElements.end(); it++)
 	{
 		os << "  [" << c << "]: " << it->toString() << endl;
 		c++;
 	}
 
 	c = 0;
-	for(auto it = storage.sampleEdges.begin(); it != storage.sampleEdges.end(); it++)
+	for(auto it = prep.sampleEdges.begin(); it != prep.sampleEdges.end(); it++)
 	{
 		os << "  [" << c << "]: " << it->toString() << endl;
 		c++;
 	}
 
 	c = 0;
-	for(auto it = storage.elementIndices.begin(); it != storage.elementIndices.end(); it++)
+	for(auto it = prep.elementIndices.begin(); it != prep.elementIndices.end(); it++)
 	{
 		os << "  [" << c << "]: " << *it << endl;
 		c++;
 	}
 
-	os << "  excitEnergies: " << floatVecToString(storage.excitEnergies) << endl;
-	os << "  excitIntensities: " << floatVecToString(storage.excitIntensities) << endl;
+	os << "  excitEnergies: " << floatVecToString(prep.excitEnergies) << endl;
+	os << "  excitIntensities: " << floatVecToString(prep.excitIntensities) << endl;
 
-	os << "  sinExcit: " << storage.sinExcit << endl;
-	os << "  sinEmerg: " << storage.sinEmerg << endl;
-	os << "  geometry: " << storage.geometry << endl;
+	os << "  sinExcit: " << prep.sinExcit << endl;
+	os << "  sinEmerg: " << prep.sinEmerg << endl;
+	os << "  geometry: " << prep.geometry << endl;
 
 	c = 0;
 	for(auto it = storage.pureLines.begin(); it != storage.pureLines.end(); it++)
@@ -196,7 +216,45 @@ void fpIDlist ( const float detRes, const float eMin, const float eMax,
 
 
 
-void fpPrep (FPstorage &storage, const XrayMaterial sample, const XRFconditions &conditions_in,
+//		subshell absorption for every edge at the excitation energies, and for every lower-energy edge
+//			at each emission line energy (secondary fluorescence), saved in storage for fpCalc
+static void fpPrepAbsorption (FPprepShared &prep, const XrayMaterial &sample, const XRFconditions &conditions_in ) {
+
+	sample.cross_section_matrix( prep.excitEnergies.data(), prep.excitEnergies.size(), prep.elementIncAbs );
+	const vector <XrayLines> &lines = prep.blankLines;
+	const int nEdges = lines.size();
+	prep.edgeAbsorption.resize( nEdges );
+	prep.secondaryAbsorption.resize( nEdges );
+	vector <float> lineEnergy(1);
+	vector <float> secAbs(1);
+	int edgeIndex;
+	for ( edgeIndex=0; edgeIndex<nEdges; edgeIndex++ ) {
+		int ePri = prep.elementIndices[edgeIndex];
+		fpEdgeAbsorption ( lines[edgeIndex].edge(),
+            sample.cross_section_table ( prep.sampleElements[ePri] ),
+            prep.excitEnergies, prep.edgeAbsorption[edgeIndex] );
+		prep.secondaryAbsorption[edgeIndex].assign( lines[edgeIndex].numberOfLines() * nEdges, 0 );
+		int lineIndex;
+		for ( lineIndex=0; lineIndex<lines[edgeIndex].numberOfLines(); lineIndex++ ) {
+//				same tests as fpCalc uses to skip secondary fluorescence (those that don't depend on composition)
+			int secEdgeIndex;
+			for ( secEdgeIndex=edgeIndex+1; secEdgeIndex<nEdges; secEdgeIndex++ ) {
+				if ( lines[secEdgeIndex].edge().energy() < conditions_in.eMin ) continue;
+				if ( lines[edgeIndex].energy(lineIndex) < lines[secEdgeIndex].edge().energy() ) continue;
+				int eSec = prep.elementIndices[secEdgeIndex];
+				lineEnergy[0] = lines[edgeIndex].energy(lineIndex);
+				fpEdgeAbsorption ( lines[secEdgeIndex].edge(),
+                        sample.cross_section_table ( prep.sampleElements[eSec] ),
+                        lineEnergy, secAbs );
+				prep.secondaryAbsorption[edgeIndex][ lineIndex * nEdges + secEdgeIndex ] = secAbs[0];
+			};
+		};
+	};
+};
+
+//		everything in fpPrep up to the emergent beam and detector corrections
+//		(depends only on the element list and conditions, not on the composition or geometry factor)
+static void fpPrepIncident (FPprepShared &prep, const XrayMaterial &sample, const XRFconditions &conditions_in,
             vector <XrayLines> &pureLines ) {
 
 //		reset storage to match this specimen and conditions
@@ -206,19 +264,19 @@ void fpPrep (FPstorage &storage, const XrayMaterial sample, const XRFconditions
 
 	pureLines.resize ( 0 );
 //		save sample element list
-	storage.sampleElements.resize( sample.element_list().size() );
-	for ( i=0; i<sample.element_list().size(); i++ ) storage.sampleElements[i] = sample.element_list()[i];
+	prep.sampleElements.resize( sample.element_list().size() );
+	for ( i=0; i<sample.element_list().size(); i++ ) prep.sampleElements[i] = sample.element_list()[i];
 
 //		create list of x-ray absorption edges excited by this xray source
-	sampleEdgeList ( storage.sampleElements, conditions_in.source, storage.sampleEdges, conditions_in.eMin );
+	sampleEdgeList ( prep.sampleElements, conditions_in.source, prep.sampleEdges, conditions_in.eMin );
 
 //		sort by decreasing edge energy (sort in standard template library is increasing)
-	sort( storage.sampleEdges.begin(), storage.sampleEdges.end() );
-	reverse( storage.sampleEdges.begin(), storage.sampleEdges.end() );
+	sort( prep.sampleEdges.begin(), prep.sampleEdges.end() );
+	reverse( prep.sampleEdges.begin(), prep.sampleEdges.end() );
 
 //		generate vector of lines emitted by vacancy at each edge (if any)
-	for ( i=0; i<storage.sampleEdges.size(); i++ ) {
-		XrayLines thisLine ( storage.sampleEdges[i] );
+	for ( i=0; i<prep.sampleEdges.size(); i++ ) {
+		XrayLines thisLine ( prep.sampleEdges[i] );
 		if ( thisLine.numberOfLines() <= 0 ) continue;
 //			set intensity factor to zero for each line
 		int lineIndex;
@@ -227,25 +285,26 @@ void fpPrep (FPstorage &storage, const XrayMaterial sample, const XRFconditions
 		};
 		pureLines.push_back ( thisLine );
 	};
+	prep.blankLines = pureLines;
 //		keep track of index in element list associated with each edge so that
 //			corresponding fractions and absorption tables can be found easily
-	storage.elementIndices.resize( pureLines.size() );
+	prep.elementIndices.resize( pureLines.size() );
 	for ( i=0; i<pureLines.size(); i++ ) {
 //			generate list of element indices
 		int elementIndex;
-		for ( elementIndex=0; elementIndex<storage.sampleElements.size(); elementIndex++ ) {
-			if ( storage.sampleElements[elementIndex] == pureLines[i].edge().element() ) {
-				storage.elementIndices[i] = elementIndex;
+		for ( elementIndex=0; elementIndex<prep.sampleElements.size(); elementIndex++ ) {
+			if ( prep.sampleElements[elementIndex] == pureLines[i].edge().element() ) {
+				prep.elementIndices[i] = elementIndex;
 			};
 		};
 	};
 
 //		calculate some quantities which don't depend on individual lines
-	storage.sinExcit = sin ( conditions_in.excitAngle * RADDEG );
-	if ( storage.sinExcit < 1.0e-6f ) storage.sinExcit = 1.0e-6f;
-	storage.sinEmerg = sin ( conditions_in.emergAngle * RADDEG );
-	if ( storage.sinEmerg < 1.0e-6f ) storage.sinEmerg = 1.0e-6f;
-	storage.geometry =  ( storage.sinExcit / storage.sinEmerg ) / ( 4.0 * PI );
+	prep.sinExcit = sin ( conditions_in.excitAngle * RADDEG );
+	if ( prep.sinExcit < 1.0e-6f ) prep.sinExcit = 1.0e-6f;
+	prep.sinEmerg = sin ( conditions_in.emergAngle * RADDEG );
+	if ( prep.sinEmerg < 1.0e-6f ) prep.sinEmerg = 1.0e-6f;
+	prep.geometry =  ( prep.sinExcit / prep.sinEmerg ) / ( 4.0 * PI );
 
 //		include optic center energy in excitation energies list
 	float opticCenterEnergy[2] = { -1, -1 };
@@ -267,38 +326,37 @@ void fpPrep (FPstorage &storage, const XrayMaterial sample, const XRFconditions
     }
     vector <XrayEdge> all_edges;
 	sampleEdgeList ( all_elements, conditions_in.source, all_edges, conditions_in.eMin );
-	fpExcitation( all_edges, conditions_in.source, opticCenterEnergy, conditions_in.eMin, storage.excitEnergies, storage.excitIntensities );
-//	cout << "excit n all elements" << storage.excitEnergies.size() << endl;
-//	fpExcitation( storage.sampleEdges, conditions_in.source, opticCenterEnergy, conditions_in.eMin, storage.excitEnergies, storage.excitIntensities );
-//	cout << "excit n std elements" << storage.excitEnergies.size() << endl;
+	fpExcitation( all_edges, conditions_in.source, opticCenterEnergy, conditions_in.eMin, prep.excitEnergies, prep.excitIntensities );
+//	cout << "excit n all elements" << prep.excitEnergies.size() << endl;
+//	fpExcitation( prep.sampleEdges, conditions_in.source, opticCenterEnergy, conditions_in.eMin, prep.excitEnergies, prep.excitIntensities );
+//	cout << "excit n std elements" << prep.excitEnergies.size() << endl;
 
 //		apply incident beam corrections
-	fpIncidentBeam( conditions_in, storage.excitEnergies, storage.excitIntensities );
+	fpIncidentBeam( conditions_in, prep.excitEnergies, prep.excitIntensities );
+
+//		calculate subshell absorption for all edges (used here and by fpCalc)
+	fpPrepAbsorption( prep, sample, conditions_in );
 
 //		calculate x-ray fluorescence intensity for each pure element emission line
 
 	int edgeIndex;
 	for ( edgeIndex=0; edgeIndex<pureLines.size() ;edgeIndex++ ) {
 //			get index of corresponding info in element and absorption table vectors
-		int ePri = storage.elementIndices[edgeIndex];
-//			calculate subshell absorption for this edge at excitation energies
-		vector <float> edgeAbs;
-		fpEdgeAbsorption ( pureLines[edgeIndex].edge(),
-            sample.cross_section_table ( storage.sampleElements[ePri] ),
-            storage.excitEnergies, edgeAbs );
-//			calculate pure element absorption at incient energies (for pure element emission)
-		vector <float> pureIncAbs(storage.excitEnergies.size());
-		for ( i=0; i<storage.excitEnergies.size(); i++ ) {
-			pureIncAbs[i] = sample.cross_section( storage.sampleElements[ePri], storage.excitEnergies[i] );
-		};
+		int ePri = prep.elementIndices[edgeIndex];
+//			subshell absorption for this edge at excitation energies
+		const vector <float> &edgeAbs = prep.edgeAbsorption[edgeIndex];
+//			pure element absorption at incient energies (for pure element emission), from the element matrix
+		const int nExcit = prep.excitEnergies.size();
+		vector <float> pureIncAbs( prep.elementIncAbs.begin() + ePri * nExcit,
+				prep.elementIncAbs.begin() + ( ePri + 1 ) * nExcit );
 		int lineIndex;
 		for ( lineIndex=0; lineIndex<pureLines[edgeIndex].numberOfLines() ;lineIndex++ ) {
 //	primary fluorescence
 //				fluorescence of line in pure element under same measurement conditions as sample
-			float muSp = sample.cross_section( storage.sampleElements[ePri], pureLines[edgeIndex].energy(lineIndex) );
+			float muSp = sample.cross_section( prep.sampleElements[ePri], pureLines[edgeIndex].energy(lineIndex) );
 			float pure = fpPrimary ( pureLines[edgeIndex], edgeAbs,
-			 	1.0, storage.excitEnergies, storage.excitIntensities, muSp,
-			 	pureIncAbs, storage.sinExcit, storage.sinEmerg, storage.geometry );
+			 	1.0, prep.excitEnergies, prep.excitIntensities, muSp,
+			 	pureIncAbs, prep.sinExcit, prep.sinEmerg, prep.geometry );
 //				add primary fluorescence into line intensity factor for pure element lines
 			 temp = pureLines[edgeIndex].factor( lineIndex );
 			 pureLines[edgeIndex].factor( lineIndex, pure + temp );
@@ -314,10 +372,10 @@ void fpPrep (FPstorage &storage, const XrayMaterial sample, const XRFconditions
 			int secLineIndex;
 			for ( secLineIndex=0; secLineIndex<pureLines[secEdgeIndex].numberOfLines(); secLineIndex++ ) {
 //					Conter-Kronig transitions for pure element
-				float muSp = sample.cross_section( storage.sampleElements[ePri], pureLines[secEdgeIndex].energy(secLineIndex) );
+				float muSp = sample.cross_section( prep.sampleElements[ePri], pureLines[secEdgeIndex].energy(secLineIndex) );
 				float cksum = fpCK ( pureLines[secEdgeIndex], edgeAbs, pureLines[edgeIndex].edge(),
-					1.0, storage.excitEnergies, storage.excitIntensities, muSp,
-					 pureIncAbs, storage.sinExcit, storage.sinEmerg, storage.geometry );
+					1.0, prep.excitEnergies, prep.excitIntensities, muSp,
+					 pureIncAbs, prep.sinExcit, prep.sinEmerg, prep.geometry );
 //						add Coster_Kronig transitions into line intensity factor for pure lines
 				temp = pureLines[secEdgeIndex].factor(secLineIndex);
 				pureLines[secEdgeIndex].factor(secLineIndex, cksum + temp);
@@ -325,7 +383,14 @@ void fpPrep (FPstorage &storage, const XrayMaterial sample, const XRFconditions
 		};  //	end of loop over Conter-Kronig secondary absorption edges
 
 	};  //	end of loop over primary emission lines
+};
+
+//		apply emergent beam and detector response corrections to pure element lines and save them in storage
+static void fpPrepEmergent (FPstorage &storage, const XRFconditions &conditions_in,
+            vector <XrayLines> &pureLines ) {
 
+	float temp;
+	int edgeIndex;
 //		apply incident beam corrections
 //		apply detector response correction
 	for ( edgeIndex=0; edgeIndex<pureLines.size() ;edgeIndex++ ) {
@@ -342,60 +407,149 @@ void fpPrep (FPstorage &storage, const XrayMaterial sample, const XRFconditions
     storage.pureLines = pureLines;
 };
 
+void fpPrep (FPstorage &storage, const XrayMaterial &sample, const XRFconditions &conditions_in,
+            vector <XrayLines> &pureLines ) {
 
-void fpCalc(const FPstorage &storage, const XrayMaterial sample, const XRFconditions &conditions_in,
-            std::vector <XrayLines> &sampleLines ) {
+	shared_ptr <FPprepShared> prep = make_shared <FPprepShared> ();
+	fpPrepIncident( *prep, sample, conditions_in, pureLines );
+	storage.prep = prep;
+	fpPrepEmergent( storage, conditions_in, pureLines );
+};
 
+//		key for FPprepCache, everything used by fpPrepIncident
+//		(cross-sections only depend on the elements, not on the composition)
+//		exact values are written (hexadecimal floats and the full optic data) so different conditions never share an entry
+string fpPrepKey( const XrayMaterial &sample, const XRFconditions &conditions_in ) {
+	ostringstream os;
 	int i;
-	float temp;
+	os << "Z:";
+	for ( i=0; i<sample.element_list().size(); i++ ) os << " " << sample.element_list()[i].Z();
+	os << endl;
+	conditions_in.source.key( os );
+	os << "tube_file_title=" << conditions_in.tube_file_title << endl;
+	os << "filter ";
+	conditions_in.filter.key( os );
+	conditions_in.optic.key( os );
+	os << "dust_on_optic ";
+	conditions_in.dust_on_optic.key( os );
+	os << "incidentPath ";
+	conditions_in.incidentPath.key( os );
+	os << "dust_on_specimen ";
+	conditions_in.dust_on_specimen.key( os );
+	os << "window ";
+	conditions_in.window.key( os );
+	os << hexfloat << conditions_in.solidAngleSource << " " << conditions_in.excitAngle << " " << conditions_in.excitCosecant;
+	os << " " << conditions_in.emergAngle << " " << conditions_in.eMin << endl;
+	return os.str();
+};
 
-	sampleLines.resize ( 0 );
+void fpPrep (FPstorage &storage, const XrayMaterial &sample, const XRFconditions &conditions_in,
+            vector <XrayLines> &pureLines, FPprepCache &cache ) {
+
+	shared_ptr <const FPprepCacheEntry> entry = cache.get( fpPrepKey( sample, conditions_in ),
+		[&]( FPprepCacheEntry &new_entry ) {
+			shared_ptr <FPprepShared> prep = make_shared <FPprepShared> ();
+			fpPrepIncident( *prep, sample, conditions_in, new_entry.pureLinesIncident );
+			new_entry.prep = prep;
+		} );
+	//  Share the cached setup instead of copying it, only the pure element lines are changed here
+	storage.prep = entry->prep;
+	pureLines = entry->pureLinesIncident;
+	fpPrepEmergent( storage, conditions_in, pureLines );
+};
 
-	if ( sample.number_of_elements() != storage.sampleElements.size() ) {
-		cout << "fpCalc  Bad Element list   " << sample.number_of_elements() << "  " << storage.sampleElements.size() << endl;
-		return;
+shared_ptr <const FPprepCacheEntry> FPprepCache::get( const string &key,
+		const function <void ( FPprepCacheEntry & )> &build ) {
+	size_t key_hash = hash <string> () ( key );
+	promise < shared_ptr <const FPprepCacheEntry> > new_promise;
+	bool keep = true;
+	unique_lock <mutex> lock( cache_mutex );
+	auto it = entries.find( key_hash );
+	//  Check the whole key in case of a hash collision
+	if ( it != entries.end() && it->second.key == key ) {
+		n_hits++;
+		shared_future < shared_ptr <const FPprepCacheEntry> > found = it->second.entry;
+		//  Wait outside the lock if another thread is still calculating it
+		lock.unlock();
+		return found.get();
 	};
-
-	for ( i=0; i<storage.sampleEdges.size(); i++ ) {
-//			generate vector of lines emitted by vacancy at each edge
-		XrayLines thisLine ( storage.sampleEdges[i] );
-		if ( thisLine.numberOfLines() <= 0 ) continue;
-//			set intensity factor to zero for each line
-		int lineIndex;
-		for ( lineIndex=0; lineIndex<thisLine.numberOfLines(); lineIndex++ ) {
-			thisLine.factor ( lineIndex, 0 );
+	n_misses++;
+	if ( it != entries.end() ) {
+		//  Another key with the same hash stays in the cache, this one is calculated but not kept
+		keep = false;
+	} else {
+		//  Conditions change from spectrum to spectrum in some maps, don't let the cache grow without limit
+		//      (threads waiting for entries that are removed here have their own copy of the future)
+		if ( entries.size() >= max_entries ) entries.clear();
+		entries[ key_hash ] = Slot{ key, new_promise.get_future().share() };
+	};
+	lock.unlock();
+	shared_ptr <FPprepCacheEntry> new_entry = make_shared <FPprepCacheEntry> ();
+	new_entry->key = key;
+	try {
+		build( *new_entry );
+	} catch ( ... ) {
+		//  Let any threads waiting for this entry see the error and don't keep it
+		if ( keep ) {
+			new_promise.set_exception( current_exception() );
+			lock.lock();
+			it = entries.find( key_hash );
+			if ( it != entries.end() && it->second.key == key ) entries.erase( it );
 		};
-		sampleLines.push_back ( thisLine );
+		throw;
+	};
+	if ( keep ) new_promise.set_value( new_entry );
+	return new_entry;
+};
+
+
+void fpCalc(const FPstorage &storage, const XrayMaterial &sample, const XRFconditions &conditions_in,
+            std::vector <XrayLines> &sampleLines ) {
+	const FPprepShared &prep = *storage.prep;
+
+	float temp;
+
+	if ( sample.number_of_elements() != prep.sampleElements.size() ) {
+		cout << "fpCalc  Bad Element list   " << sample.number_of_elements() << "  " << prep.sampleElements.size() << endl;
+		sampleLines.resize ( 0 );
+		return;
 	};
 
+//		vector of lines emitted by vacancy at each edge, intensity factors zero (same as pure lines in fpPrep)
+	sampleLines = prep.blankLines;
+
 //		load vector with sample absorption at each excitation energy
-	vector <float> sampleIncAbs( storage.excitEnergies.size() );
-	for ( i=0; i<sampleIncAbs.size(); i++ ) {
-		sampleIncAbs[i] = sample.cross_section( storage.excitEnergies[i] );
+//			(from the element cross-sections saved by fpPrep if the element list is the same)
+	vector <float> sampleIncAbs( prep.excitEnergies.size() );
+	if ( sampleIncAbs.size() > 0 ) {
+		if ( sample.element_list() == prep.sampleElements
+				&& prep.elementIncAbs.size() == sample.number_of_elements() * sampleIncAbs.size() ) {
+			sample.cross_section( prep.elementIncAbs, sampleIncAbs.size(), sampleIncAbs.data() );
+		} else {
+			sample.cross_section( prep.excitEnergies.data(), sampleIncAbs.data(), sampleIncAbs.size() );
+		};
 	};
 
 
 //		calculate x-ray fluorescence intensity for each sample emission line
 
+	const int nEdges = sampleLines.size();
 	int edgeIndex;
 	for ( edgeIndex=0; edgeIndex<sampleLines.size() ;edgeIndex++ ) {
 //			get index of corresponding info in element and absorption table vectors
-		int ePri = storage.elementIndices[edgeIndex];
-		float fPri = sample.fraction( storage.sampleElements[ePri] );
+		int ePri = prep.elementIndices[edgeIndex];
+		float fPri = sample.fraction( prep.sampleElements[ePri] );
 		if ( fPri <= 0 ) continue;
-//			calculate subshell absorption for this edge at excitation energies
-		vector <float> edgeAbs;
-		fpEdgeAbsorption ( sampleLines[edgeIndex].edge(),
-            sample.cross_section_table ( storage.sampleElements[ePri] ),
-            storage.excitEnergies, edgeAbs );
+//			subshell absorption for this edge at excitation energies (calculated in fpPrep)
+		const vector <float> &edgeAbs = prep.edgeAbsorption[edgeIndex];
 		int lineIndex;
 		for ( lineIndex=0; lineIndex<sampleLines[edgeIndex].numberOfLines() ;lineIndex++ ) {
 //				calculate sample absorption at emission line energy
 			float muSpri = sample.cross_section( sampleLines[edgeIndex].energy(lineIndex) );
 //	primary fluorescence
 			float pri = fpPrimary ( sampleLines[edgeIndex], edgeAbs, fPri,
-                storage.excitEnergies, storage.excitIntensities, muSpri,
-			 	sampleIncAbs, storage.sinExcit, storage.sinEmerg, storage.geometry, sample.mass_thickness() );
+                prep.excitEnergies, prep.excitIntensities, muSpri,
+			 	sampleIncAbs, prep.sinExcit, prep.sinEmerg, prep.geometry, sample.mass_thickness() );
 //				add primary fluorescence into line intensity factor
 			temp = sampleLines[edgeIndex].factor(lineIndex) + pri;
 			if( temp  <= 0 || isnan( temp ) ) {
@@ -419,28 +573,23 @@ void fpCalc(const FPstorage &storage, const XrayMaterial sample, const XRFcondit
 //					skip if primary line can't excite this edge
 				if ( sampleLines[edgeIndex].energy(lineIndex) < sampleLines[secEdgeIndex].edge().energy() ) continue;
 //					get element list index for exciter
-				int eSec = storage.elementIndices[secEdgeIndex];
-                float fSec = sample.fraction( storage.sampleElements[eSec] );
+				int eSec = prep.elementIndices[secEdgeIndex];
+                float fSec = sample.fraction( prep.sampleElements[eSec] );
 //				    skip secondary fluorescence calculations if this is a minor element
 //                if( fSec < 0.001f ) continue;
 //					skip on some other conditions to speed things up
 //				if( fSec * 1000 < fPri ) continue;
 				int secLineIndex;
-//						calculate subshell absorption for secondary edge at primary line energy
-				vector <float> lineEnergy(1);
-				vector <float> secAbs(1);
-				lineEnergy[0] = sampleLines[edgeIndex].energy(lineIndex);
-				fpEdgeAbsorption ( sampleLines[secEdgeIndex].edge(),
-                        sample.cross_section_table ( storage.sampleElements[eSec] ),
-                        lineEnergy, secAbs );
+//						subshell absorption for secondary edge at primary line energy (calculated in fpPrep)
+				const float secAbs = prep.secondaryAbsorption[edgeIndex][ lineIndex * nEdges + secEdgeIndex ];
 //					cout << sampleLines[edgeIndex].symbolIUPAC(lineIndex) << "  " << secEdgeIndex << "  " << sampleLines[secEdgeIndex].numberOfLines() << endl;
                 float sec_total = 0;
 				for ( secLineIndex=0; secLineIndex<sampleLines[secEdgeIndex].numberOfLines(); secLineIndex++ ) {
 					float muSsec = sample.cross_section( sampleLines[secEdgeIndex].energy(secLineIndex) );
-					float sec = fpSecondary ( sampleLines[secEdgeIndex], secAbs[0],
+					float sec = fpSecondary ( sampleLines[secEdgeIndex], secAbs,
 			 			fSec, sampleLines[edgeIndex], lineIndex, edgeAbs,
-			 			fPri, storage.excitEnergies, storage.excitIntensities, muSsec, muSpri,
-			 			sampleIncAbs, storage.sinExcit, storage.sinEmerg, storage.geometry, sample.mass_thickness() );
+			 			fPri, prep.excitEnergies, prep.excitIntensities, muSsec, muSpri,
+			 			sampleIncAbs, prep.sinExcit, prep.sinEmerg, prep.geometry, sample.mass_thickness() );
 //					cout << edgeIndex << "  " << lineIndex << "  " << secEdgeIndex << "  " << secLineIndex << "  " << sec << endl;
 //							add secondary fluorescence into line intensity factor for secondary line
 					temp = sampleLines[secEdgeIndex].factor(secLineIndex);
@@ -466,8 +615,8 @@ void fpCalc(const FPstorage &storage, const XrayMaterial sample, const XRFcondit
 			for ( secLineIndex=0; secLineIndex<sampleLines[secEdgeIndex].numberOfLines(); secLineIndex++ ) {
 				float muSsec = sample.cross_section( sampleLines[secEdgeIndex].energy(secLineIndex) );
 				float cksum = fpCK ( sampleLines[secEdgeIndex], edgeAbs, sampleLines[edgeIndex].edge(),
-					fPri, storage.excitEnergies, storage.excitIntensities, muSsec,
-					 sampleIncAbs, storage.sinExcit, storage.sinEmerg, storage.geometry, sample.mass_thickness() );
+					fPri, prep.excitEnergies, prep.excitIntensities, muSsec,
+					 sampleIncAbs, prep.sinExcit, prep.sinEmerg, prep.geometry, sample.mass_thickness() );
 //					cout << sampleLines[edgeIndex].symbolIUPAC(lineIndex) << "  " << sampleLines[secEdgeIndex].edge().symbol();
 //					cout << "   " << edgeIndex << "  " << lineIndex << "  " << secEdgeIndex << "  " << cktemp << "   " << cksum << endl;
 //						add Coster_Kronig transitions into line intensity factor for sample lines
@@ -497,8 +646,8 @@ void fpCalc(const FPstorage &storage, const XrayMaterial sample, const XRFcondit
                 cout << endl;
             }                       */
             //  Add matrix effect factor
-            unsigned int ePri = storage.elementIndices[edgeIndex];
-            float fPri = sample.fraction( storage.sampleElements[ePri] );
+            unsigned int ePri = prep.elementIndices[edgeIndex];
+            float fPri = sample.fraction( prep.sampleElements[ePri] );
             float pureInt = storage.pureLines[edgeIndex].intensity( lineIndex );
             float mf = sampleLines[edgeIndex].intensity( lineIndex ) / ( fPri * pureInt );
             sampleLines[edgeIndex].matrix( lineIndex, mf );
@@ -516,11 +665,12 @@ void fpCalc(const FPstorage &storage, const XrayMaterial sample, const XRFcondit
 
 void fpRayleigh(const FPstorage &storage, const XrayMaterial &sample, const XRFconditions &conditions_in,
             std::vector <XrayLines> &scatterLines ) {
+	const FPprepShared &prep = *storage.prep;
 
 //	calculates Rayleigh scatter of tube characteristic lines & sets factor in XrayLInes objects
 
-	if ( sample.number_of_elements() != storage.sampleElements.size() ) {
-		cout << "Bad Element list   " << sample.number_of_elements() << "  " << storage.sampleElements.size() << endl;
+	if ( sample.number_of_elements() != prep.sampleElements.size() ) {
+		cout << "Bad Element list   " << sample.number_of_elements() << "  " << prep.sampleElements.size() << endl;
 		return;
 	};
 //		some things that don't depend on energy
@@ -561,18 +711,23 @@ void fpRayleigh(const FPstorage &storage, const XrayMaterial &sample, const XRFc
 
 void fpContScat(const FPstorage &storage, const XrayEnergyCal &cal_in, const XrayMaterial &sample,
 				const XRFconditions &conditions_in, vector <float> &continuumSpec ) {
+	const FPprepShared &prep = *storage.prep;
 
 //	calculates background from Compton and Rayleigh scatter of tube continuum
 
-	if ( sample.number_of_elements() != storage.sampleElements.size() ) {
-		cout << "Bad Element list   " << sample.number_of_elements() << "  " << storage.sampleElements.size() << endl;
+	if ( sample.number_of_elements() != prep.sampleElements.size() ) {
+		cout << "Bad Element list   " << sample.number_of_elements() << "  " << prep.sampleElements.size() << endl;
 		return;
 	};
 	int nChan = continuumSpec.size();
 	int iChan;
+//		single-element vectors for the beam correction functions, reused for every channel
+	vector <float> contEn(1);
+	vector <float> contInt(1);
+//		values for each channel, if the table was made for this calibration and these conditions
+	const DetectorResponseTable &table = storage.response_table;
+	const bool use_table = table.matches( conditions_in, cal_in, nChan );
 	for( iChan=0; iChan<nChan; iChan++ ) {
-		vector <float> contEn(1);
-		vector <float> contInt(1);
 		contEn[0] = cal_in.energy( iChan );
 		if( contEn[0] <= 0 ) {
 			continuumSpec[iChan] = 0;
@@ -581,7 +736,8 @@ void fpContScat(const FPstorage &storage, const XrayEnergyCal &cal_in, const Xra
 //			find continuum intensity at desired energy
 		contInt[0] = conditions_in.source.continuum( contEn[0] );
 //			apply incident beam corrections
-		fpIncidentBeam ( conditions_in, contEn, contInt );
+		if( use_table ) contInt[0] *= fpIncidentBeam( table.incident( iChan ), conditions_in );
+		else fpIncidentBeam ( conditions_in, contEn, contInt );
 //			calculate sample absorption at desired energy
 		float muSamp = sample.cross_section( contEn[0] );
 //			calculate Compton and Rayleigh cross section at given energy and angle
@@ -600,8 +756,9 @@ void fpContScat(const FPstorage &storage, const XrayEnergyCal &cal_in, const Xra
 //		apply detector response correction
         int i;
 		for ( i=0; i<contEn.size(); i++ ) {
-            float emergCorr = fpEmergentBeam( contEn[i], conditions_in );
-            float detResp = conditions_in.detector.response( contEn[i] );
+            float emergCorr = use_table ? fpEmergentBeam( table.emergent( iChan ), conditions_in )
+                : fpEmergentBeam( contEn[i], conditions_in );
+            float detResp = use_table ? table.response( iChan ) : conditions_in.detector.response( contEn[i] );
 			bkgEst *= emergCorr * detResp;
 		};
 //			result is per keV, so multiply by channel width in keV to get counts in each channel
@@ -613,11 +770,12 @@ void fpContScat(const FPstorage &storage, const XrayEnergyCal &cal_in, const Xra
 
 void fpCompton(const FPstorage &storage, const XrayEnergyCal &cal_in, const XrayMaterial &sample,
 				const XRFconditions &conditions_in, SpectrumComponent &component_out ) {
+	const FPprepShared &prep = *storage.prep;
 
 //	calculates peaks from Compton and Rayleigh scatter of tube characteristic lines
 
-	if ( sample.number_of_elements() != storage.sampleElements.size() ) {
-		cout << "Bad Element list   " << sample.number_of_elements() << "  " << storage.sampleElements.size() << endl;
+	if ( sample.number_of_elements() != prep.sampleElements.size() ) {
+		cout << "Bad Element list   " << sample.number_of_elements() << "  " << prep.sampleElements.size() << endl;
 		return;
 	};
 //		need vectors for the functions that calculate absorption corrections
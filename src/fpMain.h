@@ -31,18 +31,27 @@
 #define fpMain_h
 
 #include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <functional>
 #include "XRFconditions.h"
 #include "Element.h"
 #include "XrayEdge.h"
 #include "XraySpectrum.h"
 #include "XrayXsectTable.h"
 #include "ScatterXsectTable.h"
+#include "fpBeams.h"
 
 //  Re-written Feb. 2, 2017
 //      Use XrayMaterial class for specimen composition, thickness, and X-ray parameters
 //      Use new conditions structure and setup for fp calculations
 
-struct FPstorage {
+//  Part of the FP setup that only depends on the element list and the measurement conditions
+//      (calculated once and shared read-only through FPprepCache by all of the spectra that use it)
+//  Split out of FPstorage Oct. 16, 2026
+struct FPprepShared {
 	std::vector <Element> sampleElements;
 	std::vector <XrayEdge> sampleEdges;
 	std::vector <int> elementIndices;
@@ -51,11 +60,63 @@ struct FPstorage {
 	float sinExcit;
 	float sinEmerg;
 	float geometry;
+//		lines for each edge with all factors zero, copied by fpCalc instead of constructing new XrayLines
+	std::vector <XrayLines> blankLines;
+//		subshell absorption of each edge at the excitation energies (same index as blankLines)
+	std::vector < std::vector <float> > edgeAbsorption;
+//		subshell absorption of each lower-energy edge at each line energy, for secondary fluorescence
+//			index is [edge][line * number of edges + secondary edge], zero if the line can't excite that edge
+	std::vector < std::vector <float> > secondaryAbsorption;
+//		cross-section of each sample element at the excitation energies (XrayMaterial::cross_section_matrix)
+	std::vector <float> elementIncAbs;
+};
+
+struct FPstorage {
+	std::shared_ptr <const FPprepShared> prep = std::make_shared <const FPprepShared> ();
+//		pure element lines including the emergent beam and detector corrections for this spectrum
 	std::vector <XrayLines> pureLines;
+//		sample lines calculated by fpCalc, kept here so they are not allocated again for every iteration
+	std::vector <XrayLines> sampleLines;
+//		detector response and beam transmissions for each spectrum channel, updated by quantCalculate
+	DetectorResponseTable response_table;
 };
 
 string FPstorage_toString(const FPstorage &storage);
 
+//  Cache for the part of fpPrep that only depends on the element list and the measurement conditions
+//      (edge list, excitation energies and intensities, and pure element line intensities before the
+//      emergent beam and detector corrections, so the per-spectrum geometry factor is not part of the key)
+//      Shared by all of the spectra in a map, new entry is calculated when the key changes
+//  Added Oct. 16, 2026
+struct FPprepCacheEntry {
+	std::string key;
+	std::shared_ptr <const FPprepShared> prep;
+	std::vector <XrayLines> pureLinesIncident;
+};
+
+class FPprepCache {
+public:
+	FPprepCache( const int max_entries_in = 8 ) : max_entries( max_entries_in ) {};
+	//  Returns the entry for this key, calls build to calculate it if it is not in the cache yet
+	//      (build runs without the lock held, other threads that want the same key wait for it
+	//      rather than all calculating the same entry, threads that want other keys don't wait)
+	std::shared_ptr <const FPprepCacheEntry> get( const std::string &key,
+			const std::function <void ( FPprepCacheEntry & )> &build );
+	int hits() const { return n_hits; };
+	int misses() const { return n_misses; };
+private:
+	//  Entries that are still being calculated are in the map, so the key is kept separately
+	struct Slot {
+		std::string key;
+		std::shared_future < std::shared_ptr <const FPprepCacheEntry> > entry;
+	};
+	std::map <std::size_t, Slot> entries;
+	std::mutex cache_mutex;
+	int max_entries;
+	int n_hits = 0;
+	int n_misses = 0;
+};
+
 
 //		constructs a list of line energies with corresponding Elements for peak ID
 //		(lines within detector FWHM are combined as weighted average)
@@ -63,11 +124,16 @@ void fpIDlist ( const float detRes, const float eMin, const float eMax,
 			   std::vector <float> &energies, std::vector <Element> &elements );
 
 //		prepare info for FP calculations of an element list and return pure element intensities
-void fpPrep(FPstorage &storage, const XrayMaterial sample, const XRFconditions &conditions_in,
+void fpPrep(FPstorage &storage, const XrayMaterial &sample, const XRFconditions &conditions_in,
             std::vector <XrayLines> &pureLines );
+//		same as above, but takes the results that don't change from spectrum to spectrum from the cache if possible
+void fpPrep(FPstorage &storage, const XrayMaterial &sample, const XRFconditions &conditions_in,
+            std::vector <XrayLines> &pureLines, FPprepCache &cache );
+//		key used by the cache, everything the cached part of fpPrep depends on
+std::string fpPrepKey( const XrayMaterial &sample, const XRFconditions &conditions_in );
 
 //		perform FP calculations for a specific sample composition
-void fpCalc(const FPstorage &storage, const XrayMaterial sample, const XRFconditions &conditions_in,
+void fpCalc(const FPstorage &storage, const XrayMaterial &sample, const XRFconditions &conditions_in,
             std::vector <XrayLines> &sampleLines );
 
 void fpContScat(const FPstorage &storage, const XrayEnergyCal &cal_in, const XrayMaterial &sample,
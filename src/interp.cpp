@@ -33,6 +33,7 @@
 
 //  Adapted from "Numerical Recipes in C"
 //  Modified to check for n <= 0     April 17, 2009   WTE
+//  Modified Oct. 16, 2026  Pass vectors by reference (called for every element in every scatter cross section)
 
 using namespace std;
 
@@ -63,7 +64,7 @@ float interp(const float x, const float xa[], const float ya[], const int n)
 };
 
 
-float interp(const float x, const vector <float> xa, const vector <float> ya)
+float interp(const float x, const vector <float> &xa, const vector <float> &ya)
 //	linear interpolation of vectors
 {
 	int n = xa.size();
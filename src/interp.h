@@ -39,7 +39,7 @@ using namespace std;
 float interp(const float x, const float xa[], const float ya[], const int n);
 
 //	linear interpolation of vectors
-float interp(const float x, const vector <float> xa, const vector <float> ya);
+float interp(const float x, const vector <float> &xa, const vector <float> &ya);
 
 
 #endif
@@ -0,0 +1,167 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+
+// Jobs waiting to be run by worker threads. Each worker has its own queue, jobs are dealt out to the
+// queues in turn as they're added. A worker takes from the front of its own queue and when that's empty it
+// steals from the back of the others, so a worker that got slow jobs doesn't hold up the end of the run.
+// Idle workers block on a condition variable rather than polling.
+// Used for map spectra and for the standards in calibrate and evaluate (moved from map_threading.cpp)
+template <class Job>
+class MTJobPool
+{
+public:
+    MTJobPool() : _nextQueue(0), _available(0), _running(false) {}
+
+    void start(int workerCount)
+    {
+        _queues.clear();
+        for(int c = 0; c < std::max(workerCount, 1); c++)
+        {
+            _queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue));
+        }
+        _nextQueue = 0;
+        _available = 0;
+
+        const std::lock_guard<std::mutex> lock(_waitMutex);
+        _running = true;
+    }
+
+    // Called by the thread queueing the jobs
+    void add(Job *job)
+    {
+        WorkerQueue &q = *_queues[_nextQueue];
+        _nextQueue = (_nextQueue+1) % _queues.size();
+        {
+            const std::lock_guard<std::mutex> lock(q.mutex);
+            q.jobs.push_back(job);
+        }
+
+        // Count it only once it's in a queue, so any worker that reserves it is sure to find it
+        _available++;
+        {
+            // Taking the lock here means we can't notify between a worker checking for jobs and it going to sleep
+            const std::lock_guard<std::mutex> lock(_waitMutex);
+        }
+        _wake.notify_one();
+    }
+
+    // No more jobs will be added, lets workers exit once the queues are empty
+    void finish()
+    {
+        {
+            const std::lock_guard<std::mutex> lock(_waitMutex);
+            _running = false;
+        }
+        _wake.notify_all();
+    }
+
+    // Blocks until there is a job for this worker, returns 0 when finished and all jobs have been taken
+    Job *take(int workerIdx)
+    {
+        while(!reserve())
+        {
+            std::unique_lock<std::mutex> lock(_waitMutex);
+            if(_available > 0)
+            {
+                continue;
+            }
+            if(!_running)
+            {
+                return 0;
+            }
+            _wake.wait(lock);
+        }
+
+        // We have reserved a job, so there is one in some queue. Other workers may take the ones we look at
+        // first, but they've reserved their own too, so keep looking until we get one
+        const size_t n = _queues.size();
+        const size_t own = workerIdx % n;
+        for(;;)
+        {
+            for(size_t c = 0; c < n; c++)
+            {
+                WorkerQueue &q = *_queues[(own+c) % n];
+                const std::lock_guard<std::mutex> lock(q.mutex);
+                if(!q.jobs.empty())
+                {
+                    Job *job = 0;
+                    if(c == 0)
+                    {
+                        job = q.jobs.front();
+                        q.jobs.pop_front();
+                    }
+                    else
+                    {
+                        job = q.jobs.back();
+                        q.jobs.pop_back();
+                    }
+                    return job;
+                }
+            }
+        }
+    }
+
+private:
+    bool reserve()
+    {
+        size_t available = _available.load();
+        while(available > 0)
+        {
+            if(_available.compare_exchange_weak(available, available-1))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    struct WorkerQueue
+    {
+        std::deque<Job *> jobs;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> _queues;
+    size_t _nextQueue;
+    std::atomic<size_t> _available;
+
+    bool _running;
+    std::mutex _waitMutex;
+    std::condition_variable _wake;
+};
@@ -31,9 +31,15 @@
 
 
 #include <sstream>
+#include <fstream>
+#include <map>
 #include <mutex>
 #include <thread>
-#include <chrono>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
 
 #include "read_spectrum_file.h"
 #include "fpSetupConditions.h"
@@ -45,7 +51,47 @@
 #include "setup_spectrum_parameters.h"
 #include "time_code.h"
 #include "read_PIXLISE_spectrum.h"
+#include "fpMain.h"
+#include "job_pool.h"
+#include "XRFcontrols.h"
 
+// FP setup shared by all map jobs, usually only the element list & conditions of the first spectrum end up in here
+// (plus the element list with matrix elements and each ignored element on its own)
+FPprepCache _mapFPprepCache(32);
+
+// ECFs and spectrum components, the same for every map spectrum unless the conditions change
+QuantUnknownSetupCache _mapQuantSetupCache;
+
+// Calibration file contents and ECFs, loaded once before any map jobs are queued
+std::shared_ptr<const QuantCalibration> _mapCalibration;
+
+void setMapLogFormat(std::ios &logger)
+{
+    logger.setf( ios::fixed, ios::floatfield );
+    logger.precision(2);
+}
+
+// Inputs that are the same for every spectrum in the map. Made once in startMapJobs and shared by all of the jobs
+// instead of being copied into each one
+struct MapJobSettings
+{
+    MapJobSettings(const XRFconditionsInput &condStruct_config, const ARGUMENT_LIST &arguments, const bool oxidesOutput,
+        const XraySpectrum &configSpectrum, const vector <ElementListEntry> &element_list) :
+        condStruct_config(condStruct_config),
+        arguments(arguments),
+        oxidesOutput(oxidesOutput),
+        configSpectrum(configSpectrum),
+        element_list(element_list)
+    {
+    }
+
+    const XRFconditionsInput condStruct_config;
+    const ARGUMENT_LIST arguments;
+    const bool oxidesOutput;
+    const XraySpectrum configSpectrum;
+    // Each job takes its own copy while it runs, the results are saved in it
+    const vector <ElementListEntry> element_list;
+};
 
 class SpectrumMapJob
 {
@@ -53,37 +99,37 @@ public:
     SpectrumMapJob(
         const string &map_spec_file,
 
-        const XRFconditionsInput &condStruct_config,
-
-        const ARGUMENT_LIST &arguments,
-        const bool oxidesOutput,
-
-        const XraySpectrum &configSpectrum,
-
-        const vector <ElementListEntry> &element_list,
+        const std::shared_ptr<const MapJobSettings> &settings,
 
         int jobId,
 
         int sequence_number,
 
-        const string &pmcSpecifier  // If not empty, we assume the map_spec_file is a PIXLISE binary
+        const string &pmcSpecifier, // If not empty, we assume the map_spec_file is a PIXLISE binary
                                     // file and need to process the given PMC in there. Otherwise
                                     // we process as before. Can be a number or number,A or number,B
                                     // to specify what detector to read. This is a temporary measure
                                     // while we still operate on MSAs that have 1 column (FM data)
+        const std::shared_ptr<const PIXLISEDataset> &dataset,   // PIXLISE binary file, already loaded & shared between all jobs
+        const std::shared_ptr<const MSASpectrumPack> &msa_pack, // If set, map_spec_file is entry pack_entry in this MSA spectrum pack
+        int pack_entry
     ) :
         _map_spec_file(map_spec_file),
-        _condStruct_config(condStruct_config),
-        _arguments(arguments),
-        _oxidesOutput(oxidesOutput),
-        _configSpectrum(configSpectrum),
-        _element_list(element_list),
+        _settings(settings),
+        _condStruct_config(settings->condStruct_config),
+        _arguments(settings->arguments),
+        _oxidesOutput(settings->oxidesOutput),
+        _configSpectrum(settings->configSpectrum),
         _jobId(jobId),
         _sequence_number(sequence_number),
-        _pmcSpecifier(pmcSpecifier)
+        _pmcSpecifier(pmcSpecifier),
+        _dataset(dataset),
+        _msaPack(msa_pack),
+        _packEntry(pack_entry),
+        _iterations(0),
+        _runtime(0)
     {
-        _logger.setf( ios::fixed, ios::floatfield );
-        _logger.precision(2);
+        setMapLogFormat(_logger);
     }
 
     int getJobId() const { return _jobId; }
@@ -93,55 +139,98 @@ public:
     const ostringstream &getResultString() const { return _logger; }
     const string &getSpectrumFile() const { return _map_spec_file; }
     string getRunTimeSec() const { return _runtimeSec; }
+    double getRunTime() const { return _runtime; }
+    int getIterations() const { return _iterations; }
+    const vector <ElementListEntry> &getElementList() const { return _settings->element_list; }
+
+    // Reads the spectrum and sets up its measurement conditions. Returns false if it can't be quantified (the job is
+    // finished then and has the error)
+    bool prepare()
+    {
+        auto tm = time_code("mapSpectrum", false);
+        const bool ok = prepareInternal();
+        addRunTime(tm.elapsedSince(false));
+        return ok;
+    }
+
+    // The spectrum, conditions and log for quantUnknownSequence (the entry must be used before this job is deleted)
+    void setSequenceEntry(QuantUnknownSequenceEntry &entry)
+    {
+        entry.spectrum = &_spectrum;
+        entry.conditions = &_conditions;
+        entry.logger = &_logger;
+    }
 
-    void run()
+    // Writes the results from quantUnknownSequence to the log and map row. fitTime is the time spent quantifying this spectrum
+    void finish(QuantUnknownSequenceEntry &entry, double fitTime)
     {
-        // So we can wrap the run with some timing code...
         auto tm = time_code("mapSpectrum", false);
+        finishInternal(entry);
+        addRunTime(fitTime + tm.elapsedSince(false));
 
-        runInternal();
+        // Only the log and map row are needed from here on
+        _spectrum = XraySpectrum();
+        _conditions = XRFconditions();
+    }
 
+private:
+    void addRunTime(double seconds)
+    {
+        _runtime += seconds;
         ostringstream str;
         str.precision(3);
-        str << tm.elapsedSince(false);
+        str << _runtime;
         _runtimeSec = str.str();
     }
 
-private:
-
-    void runInternal()
+    bool prepareInternal()
     {
         // Spectrum we've read
         vector <XraySpectrum> spectrum_vec;
 
-        XraySpectrum singleSpectrum = _configSpectrum;
+        XraySpectrum &singleSpectrum = _spectrum;
+        singleSpectrum = _configSpectrum;
 
         int result = 0;
         _error = false;
 
         XRFconditionsInput condStruct_Map;
 
-        if(!_pmcSpecifier.empty() && _map_spec_file.length() > 4 && _map_spec_file.substr(_map_spec_file.length()-4) == ".bin")
+        if(!_pmcSpecifier.empty() && is_PIXLISE_dataset_file(_map_spec_file))
         {
-            // We're reading a PIXLISE binary file, and processing the spectra for a given PMC in there
-            result = read_PIXLISE_spectrum(_logger, _map_spec_file, _pmcSpecifier, spectrum_vec, condStruct_Map.conditionsVector, condStruct_Map.optic_file_name );
+            // We're reading a PIXLISE binary file (or spectrum store), and processing the spectra for a given PMC in there
+            if(_dataset)
+            {
+                result = read_PIXLISE_spectrum(_logger, *_dataset, _pmcSpecifier, spectrum_vec, condStruct_Map.conditionsVector, condStruct_Map.optic_file_name );
+            }
+            else
+            {
+                result = read_PIXLISE_spectrum(_logger, _map_spec_file, _pmcSpecifier, spectrum_vec, condStruct_Map.conditionsVector, condStruct_Map.optic_file_name );
+            }
             if ( result != 0 )
             {
                 _logger << "read_PIXLISE_spectrum failed, result = " << result << " file " << endl;
                 _error = true;
                 _result_code = -1;
-                return;
+                return false;
             }
         }
         else
         {
-            result = read_spectrum_file( _logger, _map_spec_file, spectrum_vec, condStruct_Map );
+            if(_msaPack)
+            {
+                result = read_packed_spectrum( _logger, *_msaPack, _packEntry, spectrum_vec, condStruct_Map );
+            }
+            else
+            {
+                result = read_spectrum_file( _logger, _map_spec_file, spectrum_vec, condStruct_Map );
+            }
             if ( result != 0 )
             {
                 _logger << "read_spectrum_file failed, result = " << result << " file " << endl;
                 _error = true;
                 _result_code = -1;
-                return;
+                return false;
             }
         }
 
@@ -156,7 +245,7 @@ private:
             _logger << "No spectra in file " << _map_spec_file << endl;
             _error = true;
             _result_code = -1;
-            return;
+            return false;
         } else {
             //  Combine the spectrum information from several detectors (or the selected detector) into the variable where they will be used
             //      NB: quantCombineSpectra modifies the spectra in the input list to match them to a single energy axis
@@ -165,7 +254,7 @@ private:
             if( result < 0 ) {
                 _error = true;
                 _result_code = -1;
-                return;
+                return false;
             };
         }
         singleSpectrum.seq_number( _sequence_number );
@@ -174,17 +263,17 @@ private:
             _logger << "Bad energy calibration, can't quantify spectrum." << endl;
             _error = true;
             _result_code = -1;
-            return;
+            return false;
         }
         if( singleSpectrum.live_time() <= 0 ) {
             _logger << "*** Error - live time is bad, can't quantify spectrum." << endl;
             _error = true; //  Plot can be vs channels, all others are not possible without calibration
             _result_code = 0;
-            return;
+            return false;
         }
 //tm.split("setup_spectrum");
         //  Set up new instrument measurement conditions
-        XRFconditions mapConditions;
+        XRFconditions &mapConditions = _conditions;
 
         result = fpSetupConditions ( condStruct_Map, mapConditions );
         if( result < 0 ) {
@@ -192,13 +281,28 @@ private:
             _logger << "   error in parameter with keyword " << get_EMSA_keyword( -(result+100) ) << endl;
             _error = true;
             _result_code = -500 + result;
-            return;
+            return false;
         };
         _logger << endl;
 
-//tm.split("setup_conditions");
-        XrayMaterial unknown;
-        result = quantUnknown( unknown, _element_list, mapConditions, singleSpectrum, _arguments.calibration_file, _logger );
+        if(!_mapCalibration)
+        {
+            _logger << "Calibration not loaded before map job was run" << endl;
+            _error = true;
+            _result_code = -1;
+            return false;
+        }
+        return true;
+    }
+
+    void finishInternal(QuantUnknownSequenceEntry &entry)
+    {
+        XraySpectrum &singleSpectrum = _spectrum;
+        const XRFconditions &mapConditions = _conditions;
+        XrayMaterial &unknown = entry.unknown;
+        vector <ElementListEntry> &element_list = entry.element_list;
+        int result = entry.result;
+        _iterations = singleSpectrum.iterations();
         if ( result < 0 ) {
             _logger << "quantUnknown failed, result = " << result << "   file " << _arguments.spectrum_file << endl;
             _error = true;
@@ -208,7 +312,7 @@ private:
         float element_sum = 0;
         //  Normalize result if argument is not zero
         if( _arguments.normalization > 0 ) unknown.normalize( _arguments.normalization / 100 );
-        result = quantWriteResults( unknown, mapConditions.detector, _element_list,
+        result = quantWriteResults( unknown, mapConditions.detector, element_list,
                             singleSpectrum, _oxidesOutput, _logger, element_sum );
         if ( result != 0 )
         {
@@ -222,7 +326,7 @@ private:
         // Save map row output locally
         quantWriteMapRow(_map_row,
             _arguments.quant_map_outputs, // TIMTIME: This was upper_trim'd twice, once when saved into ARGUMENT_LIST and once when calling quantWriteMap
-            _element_list,
+            element_list,
             mapConditions.detector,
             singleSpectrum, element_sum);
 
@@ -233,14 +337,15 @@ private:
 private:
     const string _map_spec_file;
 
-    const XRFconditionsInput _condStruct_config;
+    const std::shared_ptr<const MapJobSettings> _settings;
 
-    const ARGUMENT_LIST _arguments;
-    const bool _oxidesOutput;
+    // These are in _settings
+    const XRFconditionsInput &_condStruct_config;
 
-    const XraySpectrum _configSpectrum;
+    const ARGUMENT_LIST &_arguments;
+    const bool _oxidesOutput;
 
-    vector <ElementListEntry> _element_list;
+    const XraySpectrum &_configSpectrum;
 
     const int _jobId;
 
@@ -248,152 +353,271 @@ private:
 
     const string _pmcSpecifier;
 
+    const std::shared_ptr<const PIXLISEDataset> _dataset;
+
+    const std::shared_ptr<const MSASpectrumPack> _msaPack;
+    const int _packEntry;
+
+    // Read by prepare and quantified by quantUnknownSequence
+    XraySpectrum _spectrum;
+    XRFconditions _conditions;
+
 // Outputs
     ostringstream _logger;
     ostringstream _map_row;
     int _result_code;
     bool _error;
     string _runtimeSec;
+    int _iterations;
+    double _runtime;
 };
 
 
-class MTSpectrumMapJobList
+// Writes finished map jobs to the map file and its log as soon as every job queued before them has been written,
+// so rows come out in the order the spectra were read in. Jobs that finish early wait here (keyed by job id) until
+// the ones before them are done, then they're written and deleted. The queueing thread waits (waitForRoom) while
+// too many jobs are queued or waiting here, so memory doesn't grow with the size of the map, and the output files
+// can be watched while a long map is running.
+class MapOutputWriter
 {
 public:
-    void add(SpectrumMapJob *job)
+    MapOutputWriter() : _oxidesOutput(false), _nextJobId(1), _written(0), _opened(false), _openFailed(false), _rowCount(0), _fitCount(0), _iterationSum(0),
+        _maxIterations(0), _limitCount(0), _fitTime(0) {}
+
+    void start(const ARGUMENT_LIST &arguments, const vector <ElementListEntry> &element_list, const bool oxidesOutput)
     {
         const std::lock_guard<std::mutex> lock(_mutex);
-        _jobs.push_back(job);
+        _mapFile = arguments.map_file;
+        _quantMapOutputs = arguments.quant_map_outputs;
+        _element_list = element_list;
+        _oxidesOutput = oxidesOutput;
+        _nextJobId = 1;
+        _written = 0;
+        _rowCount = 0;
+        _fitCount = 0;
+        _iterationSum = 0;
+        _maxIterations = 0;
+        _limitCount = 0;
+        _fitTime = 0;
     }
 
-    bool empty()
+    // Called by the worker threads when a job has run. Takes ownership of the job
+    void add(SpectrumMapJob *job)
     {
-        bool empty = false;
         {
             const std::lock_guard<std::mutex> lock(_mutex);
-            empty = _jobs.empty();
+            _waiting[job->getJobId()] = job;
+            writeReady();
         }
-        return empty;
+        _writtenChanged.notify_all();
     }
 
-    size_t size()
+    // Blocks the queueing thread while jobCount jobs have been queued and maxInFlight or more of them are not yet written
+    void waitForRoom(int jobCount, int maxInFlight)
     {
-        return _jobs.size();
+        std::unique_lock<std::mutex> lock(_mutex);
+        while(jobCount - _written >= maxInFlight)
+        {
+            _writtenChanged.wait(lock);
+        }
     }
 
-    SpectrumMapJob *remove()
+    // Called once all workers have stopped, writes out anything still waiting (only if a job id was skipped)
+    void finish()
     {
-        SpectrumMapJob *result = 0;
+        const std::lock_guard<std::mutex> lock(_mutex);
+        while(!_waiting.empty())
+        {
+            _nextJobId = _waiting.begin()->first;
+            writeReady();
+        }
+        _fout.close();
+        _logout.close();
+    }
 
+    size_t rowCount() const { return _rowCount; }
+    // Average number of fit iterations over the spectra that were quantified
+    double averageIterations() const { return _fitCount > 0 ? double(_iterationSum) / _fitCount : 0; }
+    int maxIterations() const { return _maxIterations; }
+    // Number of fits that stopped at MAX_ITERATIONS (XRFcontrols.h) without converging
+    size_t limitCount() const { return _limitCount; }
+    // Time to read and quantify the spectra (summed over the threads), in seconds
+    double fitTime() const { return _fitTime; }
+    double averageFitTime() const { return _fitCount > 0 ? _fitTime / _fitCount : 0; }
+    bool openFailed() const { return _openFailed; }
+    const vector<string> &errors() const { return _errors; }
+
+private:
+    void writeReady()
+    {
+        bool wrote = false;
+        for(auto it = _waiting.find(_nextJobId); it != _waiting.end(); it = _waiting.find(++_nextJobId))
         {
-            const std::lock_guard<std::mutex> lock(_mutex);
+            write(*it->second);
 
-            if(_jobs.size() > 0)
-            {
-                result = _jobs[_jobs.size()-1];
-                _jobs.pop_back();
-            }
+            // Done with this!
+            delete it->second;
+            _waiting.erase(it);
+            _written++;
+            wrote = true;
         }
 
-        return result;
+        if(wrote && _opened)
+        {
+            _fout.flush();
+            _logout.flush();
+        }
     }
 
-    void orderByMapFileName(const vector<string> &order)
+    void write(const SpectrumMapJob &job)
     {
-        const std::lock_guard<std::mutex> lock(_mutex);
+        _rowCount++;
+
+        if(job.getError())
+        {
+            ostringstream msg;
+            msg << "Map row for: " << job.getJobId() << " had ERROR! Result code: " << job.getResultCode();
+            _errors.push_back(msg.str());
+        }
 
-        if(order.size() != _jobs.size())
+        if(!open())
         {
-            cout << "ERROR: orderByMapFileName: ordering list size is different to job list size" << endl;
             return;
         }
 
-        vector<SpectrumMapJob *> orderedJobs;
-        for(auto itOrd = order.rbegin(); itOrd != order.rend(); itOrd++)
+        _logout << "=================================================================" << endl;
+        _logout << "= " << job.getSpectrumFile() << " error=" << (job.getError() ? "true" : "false") << " result=" << job.getResultCode() << " runtime: " << job.getRunTimeSec() << "sec" << endl;
+        _logout << "=================================================================" << endl;
+
+        _logout << job.getResultString().str() << endl << endl;
+
+        if(!job.getError())
+        {
+            _fout << job.getMapOutput().str();
+            _fitCount++;
+            _iterationSum += job.getIterations();
+            _maxIterations = std::max(_maxIterations, job.getIterations());
+            if(job.getIterations() >= MAX_ITERATIONS) _limitCount++;
+            _fitTime += job.getRunTime();
+        }
+    }
+
+    // Files are only created once there is a row to write, so a map with no output doesn't leave an empty file
+    bool open()
+    {
+        if(!_opened && !_openFailed)
         {
-            for(auto it = _jobs.begin(); it != _jobs.end(); it++)
+            _fout.open(_mapFile);
+            _logout.open(_mapFile+"_log.txt");
+            if(!_fout)
+            {
+                _openFailed = true;
+            }
+            else
             {
-                if(*itOrd == (*it)->getSpectrumFile())
-                {
-                    orderedJobs.push_back(*it);
-                    _jobs.erase(it);
-                    break;
-                }
+                // Write the header
+                // TIMTIME: What title should we put here?
+                quantWriteMapHeader(_fout, "Insert Title Here", _quantMapOutputs, _element_list, _oxidesOutput);
+                _opened = true;
             }
         }
-
-        _jobs = orderedJobs;
+        return _opened;
     }
 
-private:
-    vector<SpectrumMapJob *> _jobs;
+    string _mapFile;
+    string _quantMapOutputs;
+    vector <ElementListEntry> _element_list;
+    bool _oxidesOutput;
+
+    std::map<int, SpectrumMapJob *> _waiting;
+    int _nextJobId;
+    int _written;
+
+    std::ofstream _fout;
+    std::ofstream _logout;
+    bool _opened;
+    bool _openFailed;
+    size_t _rowCount;
+    size_t _fitCount;
+    long long _iterationSum;
+    int _maxIterations;
+    size_t _limitCount;
+    double _fitTime;
+    vector<string> _errors;
+
     std::mutex _mutex;
+    std::condition_variable _writtenChanged;
 };
 
-MTSpectrumMapJobList _mapJobQ;
-MTSpectrumMapJobList _mapOutputQ;
-vector<string> _mapFileOrder;
+MTJobPool<SpectrumMapJob> _mapJobPool;
+MapOutputWriter _mapOutput;
+int _mapJobCount = 0;
+std::shared_ptr<const MapJobSettings> _mapJobSettings;
+// Jobs queued or waiting to be written before the queueing thread waits, per worker thread
+const int _mapReadAhead = 2;
+int _mapMaxInFlight = _mapReadAhead;
+
+void startMapJobs(int threadCount, const XRFconditionsInput &condStruct_config, const ARGUMENT_LIST &arguments, const bool oxidesOutput,
+    const XraySpectrum &configSpectrum, const vector <ElementListEntry> &element_list)
+{
+    _mapJobCount = 0;
+    _mapJobSettings = std::make_shared<const MapJobSettings>(condStruct_config, arguments, oxidesOutput, configSpectrum, element_list);
+    _mapMaxInFlight = _mapReadAhead * std::max(threadCount, 1);
+    _mapOutput.start(arguments, element_list, oxidesOutput);
+    _mapJobPool.start(threadCount);
+}
 
-bool _mapJobRunning = false;
+void finishMapJobs()
+{
+    _mapJobPool.finish();
+    _mapJobSettings.reset();
+}
 
-void setMapJobRunning(bool mapJobRunning)
+int loadMapCalibration(ostream &termOutFile, const ARGUMENT_LIST &arguments, const vector <ElementListEntry> &element_list)
 {
-    _mapJobRunning = mapJobRunning;
+    // The saved ECF messages are only reused if the job log streams have the same format
+    ostringstream logFormat;
+    setMapLogFormat(logFormat);
+
+    auto calibration = std::make_shared<QuantCalibration>();
+    int result = quantLoadCalibration(arguments.calibration_file, element_list, logFormat, *calibration);
+    termOutFile << calibration->read_log;
+
+    _mapCalibration = calibration;
+    return result;
 }
 
-void outputMapFile(ostream &logger, const ARGUMENT_LIST &arguments, const vector <ElementListEntry> &element_list, const bool oxidesOutput)
+void outputMapFile(ostream &logger, const ARGUMENT_LIST &arguments)
 {
-    // We've run through, if we have any outputs, save to the output map file
-    if(_mapOutputQ.empty())
+    // Rows have been written as the jobs finished, just finish off the files
+    _mapOutput.finish();
+
+    if(_mapOutput.rowCount() <= 0)
     {
         logger << "No map data to output!" << endl;
     }
+    else if(_mapOutput.openFailed())
+    {
+        logger << "Failed open: " << arguments.map_file << " for writing." << endl;
+    }
     else
     {
-        // Write the header
-        std::ofstream fout(arguments.map_file);
-        std::ofstream logout(arguments.map_file+"_log.txt");
-        if(!fout)
+        for(auto it = _mapOutput.errors().begin(); it != _mapOutput.errors().end(); it++)
         {
-            logger << "Failed open: " << arguments.map_file << " for writing." << endl;
+            logger << *it << endl;
         }
-        else
-        {
-            // TIMTIME: What title should we put here?
-            quantWriteMapHeader(fout, "Insert Title Here", arguments.quant_map_outputs, element_list, oxidesOutput);
-
-            // Order it so we output lines in the same order we read the spectra in
-            _mapOutputQ.orderByMapFileName(_mapFileOrder);
-
-            SpectrumMapJob *job = _mapOutputQ.remove();
-            while(job)
-            {
-                if(job->getError())
-                {
-                    logger << "Map row for: " << job->getJobId() << " had ERROR! Result code: " << job->getResultCode() << endl;
-                }
-
-                logout << "=================================================================" << endl;
-                logout << "= " << job->getSpectrumFile() << " error=" << (job->getError() ? "true" : "false") << " result=" << job->getResultCode() << " runtime: " << job->getRunTimeSec() << "sec" << endl;
-                logout << "=================================================================" << endl;
-
-                logout << job->getResultString().str() << endl << endl;
-
-                if(!job->getError())
-                {
-                    fout << job->getMapOutput().str();
-                }
-
-                // Done with this!
-                delete job;
-                job = _mapOutputQ.remove();
-            }
 
-            logger << "Map file written to " << arguments.map_file << endl;
-            logger << "          map quantitative output options ";
-            if( arguments.quant_map_outputs.length() <= 0 ) logger << "default (percents only)" << endl;
-            else logger << arguments.quant_map_outputs << endl;
-        }
+        logger << "Map file written to " << arguments.map_file << endl;
+        logger << "          FP setup cache " << _mapFPprepCache.hits() << " hits, " << _mapFPprepCache.misses() << " misses" << endl;
+        logger << "          quant setup cache " << _mapQuantSetupCache.hits() << " hits, " << _mapQuantSetupCache.misses() << " misses" << endl;
+        logger << "          average fit iterations " << _mapOutput.averageIterations();
+        if(quantAndersonMixing() > 0) logger << " (Anderson mixing of the last " << quantAndersonMixing() << " updates)";
+        logger << endl;
+        logger << "          most fit iterations " << _mapOutput.maxIterations() << ", " << _mapOutput.limitCount() << " fits stopped at the limit of " << MAX_ITERATIONS << endl;
+        logger << "          average time per spectrum " << _mapOutput.averageFitTime() << " sec, total " << _mapOutput.fitTime() << " sec (all threads)" << endl;
+        logger << "          map quantitative output options ";
+        if( arguments.quant_map_outputs.length() <= 0 ) logger << "default (percents only)" << endl;
+        else logger << arguments.quant_map_outputs << endl;
     }
 }
 
@@ -403,87 +627,66 @@ void outputMapFile(ostream &logger, const ARGUMENT_LIST &arguments, const vector
 // mapSpectrum(quantWriteMap) took: 0.0038 sec
 
 void queueMapSpectrum(const std::string &map_spec_file,
-
-    const XRFconditionsInput &condStruct_config,
-
-    const ARGUMENT_LIST &arguments,
-    const bool oxidesOutput,
-
-    const XraySpectrum &configSpectrum,
-    int n_map_spectra,
-
-    vector <ElementListEntry> &element_list,
-
     int sequence_number,
-    const string &pmcSpecifier)
+    const string &pmcSpecifier,
+    const std::shared_ptr<const PIXLISEDataset> &dataset,
+    const std::shared_ptr<const MSASpectrumPack> &msa_pack,
+    int pack_entry)
 {
-    _mapFileOrder.push_back(map_spec_file);
+    // Keeps the memory used by queued and finished jobs down, whatever the size of the map
+    _mapOutput.waitForRoom(_mapJobCount, _mapMaxInFlight);
 
     auto job = new SpectrumMapJob(
         map_spec_file,
 
-        condStruct_config,
-
-        arguments,
-        oxidesOutput,
+        _mapJobSettings,
 
-        configSpectrum,
-
-        element_list,
-
-        _mapJobQ.size()+1,
+        ++_mapJobCount,
 
         sequence_number,
-        pmcSpecifier
+        pmcSpecifier,
+        dataset,
+        msa_pack,
+        pack_entry
         );
 
     cout << "Queued: \"" << map_spec_file << "\", pmc spec: \"" << pmcSpecifier << "\"" << endl;
-    _mapJobQ.add(job);
+    _mapJobPool.add(job);
 }
 
 #define DBG_THREAD 1
 
-void processMapJob()
+void processMapJob(int workerIdx)
 {
 #ifdef DBG_THREAD
     auto id = std::this_thread::get_id();
     cout << id << " processMapJob start" << endl;
 #endif
 
-    while(_mapJobRunning || !_mapJobQ.empty())
+    // Waits for jobs to be queued, returns 0 once finishMapJobs has been called and nothing is left
+    SpectrumMapJob *job = 0;
+    while((job = _mapJobPool.take(workerIdx)) != 0)
     {
-        // Get it
-        auto job = _mapJobQ.remove();
-
-        if(!job)
-        {
 #ifdef DBG_THREAD
-            cout << id << " Waiting for map job!" << endl;
+        cout << id << " Dequeued map job: " << job->getJobId() << endl;
 #endif
-
-            // Nothing to do, wait around
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        }
-        else
+        // Jobs that can't be quantified are written out now (once all earlier jobs are written)
+        if(!job->prepare())
         {
-#ifdef DBG_THREAD
-            cout << id << " Dequeued map job: " << job->getJobId() << endl;
-#endif
-
-            // Process
-            job->run();
-
-#ifdef DBG_THREAD
-            cout << id << " Job ran: " << job->getJobId() << endl;
-#endif
-
-            // Save output results
-            _mapOutputQ.add(job);
+            _mapOutput.add(job);
+            continue;
+        }
 
+        // Each job is its own pool job, so the sequence is one spectrum long (setups are shared through the setup cache)
+        vector<QuantUnknownSequenceEntry> spectra(1);
+        job->setSequenceEntry(spectra[0]);
+        auto tm = time_code("mapFit", false);
+        quantUnknownSequence(spectra, job->getElementList(), *_mapCalibration, &_mapFPprepCache, &_mapQuantSetupCache);
+        job->finish(spectra[0], tm.elapsedSince(false));
 #ifdef DBG_THREAD
-            cout << id << " Output saved for job: " << job->getJobId() << endl;
+        cout << id << " Job ran: " << job->getJobId() << endl;
 #endif
-        }
+        _mapOutput.add(job);
     }
 
 #ifdef DBG_THREAD
@@ -38,25 +38,30 @@ using namespace std;
 #include "parse_arguments.h"
 #include "parse_element_list.h"
 #include "XraySpectrum.h"
+#include "read_PIXLISE_spectrum.h"
+#include "MSA_spectrum_pack.h"
 
 
-void outputMapFile(ostream &termOutFile, const ARGUMENT_LIST &arguments, const vector <ElementListEntry> &element_list, const bool oxidesOutput);
+// Reads the calibration file and works out the ECFs once for all of the map jobs. Call before queueing any jobs
+int loadMapCalibration(ostream &termOutFile, const ARGUMENT_LIST &arguments, const vector <ElementListEntry> &element_list);
 
-void queueMapSpectrum(const std::string &map_spec_file,
-
-    const XRFconditionsInput &condStruct_config,
-
-    const ARGUMENT_LIST &arguments,
-    const bool oxidesOutput,
-
-    const XraySpectrum &configSpectrum,
-    int n_map_spectra,
-
-    vector <ElementListEntry> &element_list,
+// Map rows are written to the map file as the jobs finish, this closes the files and reports on the map. Call after the worker threads have finished
+void outputMapFile(ostream &termOutFile, const ARGUMENT_LIST &arguments);
 
+// Queues a job for one map spectrum, the conditions, arguments and element list are the ones given to startMapJobs.
+// Waits while too many jobs are queued or waiting to be written
+void queueMapSpectrum(const std::string &map_spec_file,
     int sequence_number,
-    const string &pmcSpecifier
+    const string &pmcSpecifier,
+    const std::shared_ptr<const PIXLISEDataset> &dataset,  // Loaded once for the whole map if map_spec_file is a PIXLISE binary file
+    const std::shared_ptr<const MSASpectrumPack> &msa_pack, // Opened once for the whole map if the spectrum files are in an MSA spectrum pack
+    int pack_entry                                          // Index of map_spec_file in msa_pack
 );
 
-void processMapJob();
-void setMapJobRunning(bool mapJobRunning);
+// Sets up the job queues for the given number of worker threads and the map file output, call before queueing any jobs or starting the threads
+void startMapJobs(int threadCount, const XRFconditionsInput &condStruct_config, const ARGUMENT_LIST &arguments, const bool oxidesOutput,
+    const XraySpectrum &configSpectrum, const vector <ElementListEntry> &element_list);
+// Worker thread function, workerIdx is 0..threadCount-1. Returns once finishMapJobs has been called and all jobs are done
+void processMapJob(int workerIdx);
+// Call once all map spectra have been queued
+void finishMapJobs();
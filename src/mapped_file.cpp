@@ -0,0 +1,122 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "mapped_file.h"
+
+#include <fstream>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile() :
+    _data(0),
+    _size(0),
+    _mapping(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if(_mapping)
+    {
+        munmap(_mapping, _size);
+    }
+#endif
+}
+
+int MappedFile::open(std::ostream &termOutFile, const std::string &pathName, const std::string &fileDescription)
+{
+#ifdef _WIN32
+    // No mmap, read it all in (still nothing to parse)
+    ifstream fin(pathName.c_str(), ios::in | ios::binary | ios::ate);
+    if(!fin)
+    {
+        termOutFile << "Failed to open " << fileDescription << " file: " << pathName << endl;
+        return -1;
+    }
+    _fileContents.resize(fin.tellg());
+    fin.seekg(0);
+    fin.read(_fileContents.data(), _fileContents.size());
+    if(!fin || _fileContents.empty())
+    {
+        termOutFile << "Failed to read " << fileDescription << " file: " << pathName << endl;
+        return -1;
+    }
+    _data = _fileContents.data();
+    _size = _fileContents.size();
+#else
+    int fd = ::open(pathName.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        termOutFile << "Failed to open " << fileDescription << " file: " << pathName << endl;
+        return -1;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        termOutFile << "Failed to read " << fileDescription << " file: " << pathName << endl;
+        close(fd);
+        return -1;
+    }
+    void *mapping = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+    {
+        termOutFile << "Failed to map " << fileDescription << " file: " << pathName << endl;
+        return -1;
+    }
+    _mapping = mapping;
+    _data = static_cast<const char *>(mapping);
+    _size = st.st_size;
+#endif
+    return 0;
+}
+
+int replaceWithTempFile(std::ostream &termOutFile, const std::string &tempPathName, const std::string &pathName, const std::string &fileDescription)
+{
+#ifdef _WIN32
+    // rename doesn't replace an existing file here
+    remove(pathName.c_str());
+#endif
+    if(rename(tempPathName.c_str(), pathName.c_str()) != 0)
+    {
+        termOutFile << "Failed to rename " << tempPathName << " to " << fileDescription << " file: " << pathName << endl;
+        remove(tempPathName.c_str());
+        return -3;
+    }
+    return 0;
+}
@@ -79,6 +79,11 @@
 //  Modified May 14, 2021   Move shelf factor and slope to XrayDetector and control via -T option
 //  Modified June 27, 2021  Add command line option to normalize element sum to 100% (or any value)
 //  Modified July 9, 2021   Add command line option to change Fe oxide ratio (-Fe)
+//  Modified Oct. 16, 2026  Add pack sub-command to decode a PIXLISE dataset into a spectrum store file
+//                          or to read a list of MSA files into an MSA spectrum pack file
+//                          Add -L option to solve the least-squares fits with the double precision Cholesky solver
+//                          Add -X option to evaluate the cross sections from tabulated log-energy grids
+//                          Add -A option for Anderson mixing of the quantUnknown iteration updates (optional depth)
 
 using namespace std;
 
@@ -385,6 +390,23 @@ int parse_arguments( const int argc, const char * argv[],
                 arguments.plot_file = plot_file;
            }
             break;
+        case PACK:
+            term_file_index = 4;
+            if( argc < term_file_index ) {
+                cout << endl;
+                cout << "Not enough arguments for pack sub-command." << endl;
+                cout << "   PIXLISE dataset binary file (.bin), or list of MSA spectrum files (.txt)" << endl;
+                cout << "   Spectrum store file (.pqs, overwritten, use in place of the .bin file in a PMC list)" << endl;
+                cout << "       or MSA spectrum pack file (.pqm, overwritten, use in place of the .txt list for map or sum)" << endl;
+                cout << endl;
+                return -2014;
+            } else {
+                string spec_file( argv[2] );
+                arguments.spectrum_file = spec_file;
+                string map_file( argv[3] );
+                arguments.map_file = map_file;
+            }
+            break;
         default:
             return -2020;
             break;
@@ -520,6 +542,10 @@ int parse_arguments( const int argc, const char * argv[],
                     arguments.fit_adjust_energy = false;
                 } else if( records[0] == "-g" ) {  //  Turn off adjustments to detector resolution in fits
                     arguments.fit_adjust_width = false;
+                } else if( records[0] == "-L" ) {  //  Use the Cholesky solver for the least-squares fits
+                    arguments.lfit_cholesky = true;
+                } else if( records[0] == "-X" ) {  //  Use the tabulated grids for the x-ray cross sections
+                    arguments.xsect_tabulated = true;
                 } else if( records[0] == "-v" ) {  //  Turn on convolution of Compton components with detector resolution
                     arguments.convolve_Compton = true;
                 } else if( records[0] == "-c" ) {  //  Treat some elements as carbonates instead of oxides
@@ -541,6 +567,19 @@ int parse_arguments( const int argc, const char * argv[],
                         arguments.invalid_arguments += "Invalid thread count in argument list: " + temp;
                         return -2027;
                     }
+                } else if( records[0] == "-A" ) {  //  Anderson mixing of the fit iterations, optional depth (0 turns it off)
+                    int tmp = QUANT_ANDERSON_DEPTH;   //  Defined in XRFcontrols.h
+                    result = 1;
+                    if( records.size() > 1 ) {
+                        istringstream temp_stream1( records[1] );
+                        temp_stream1 >> tmp;
+                        if( ! temp_stream1 || tmp < 0 ) result = -1;
+                    }
+                    if( result < 0 ) {
+                        arguments.invalid_arguments += "Invalid Anderson mixing depth in argument list: " + temp;
+                        return -2033;
+                    }
+                    arguments.anderson_depth = tmp;
                 } else if( records[0] == "-s" ) {  //  Select standard from input file by number or name
                     int temp_std = -1;
                     result = -1;
@@ -679,6 +718,8 @@ int parse_command( const string &sub_command, PIQUANT_SUBCOMMAND &cmd ) {
         cmd = PRINT_VERSION;
     } else if( cmd_uc.substr(0,3) == "OPT" ) {
         cmd = OPTIC_RESPONSE;
+    } else if( cmd_uc.substr(0,3) == "PAC" ) {
+        cmd = PACK;
     } else {
         cout << endl;
         cout << "Invalid sub-command; " << cmd_uc << ", possibilities are (only the first 3 letters are checked):" << endl; // What about CALI vs CAL vs CALC?
@@ -694,6 +735,7 @@ int parse_command( const string &sub_command, PIQUANT_SUBCOMMAND &cmd ) {
         cout << "   map              - quantify a set of spectra and write a map file" << endl;
         cout << "   sum              - calculate sum and maximum value spectra from a set of spectra" << endl;
         cout << "   ems              - convert output of SEND_SDD_DATA command (SDF contents in csv file) to EDR (csv) format" << endl;
+        cout << "   pack             - decode a PIXLISE dataset (.pqs) or list of MSA files (.pqm) once into a file that maps can share" << endl;
         cout << "   version          - print piquant version" << endl;
         cout << endl;
         return -2000;
@@ -49,7 +49,8 @@ enum PIQUANT_SUBCOMMAND {
     BULK_SUM_MAX,
     EM_SDD_DATA,
     PRINT_VERSION,
-    OPTIC_RESPONSE
+    OPTIC_RESPONSE,
+    PACK
 };
 
 struct ARGUMENT_LIST {
@@ -78,7 +79,10 @@ struct ARGUMENT_LIST {
     bool fit_adjust_energy = true;
     bool fit_adjust_width = true;
     bool convolve_Compton = true;
+    bool lfit_cholesky = LFIT_CHOLESKY;
+    bool xsect_tabulated = XSECT_TABULATED;
     int map_threads = 1;
+    int anderson_depth = QUANT_ANDERSON_MIXING ? QUANT_ANDERSON_DEPTH : 0;   //  Anderson mixing of the fit iterations (0 is off)
     bool standard_selected = false;
     int standard_selection = 0;
     std::string standard_name;
@@ -31,6 +31,7 @@
 #include "fpLineSpectrum.h"
 #include "fpMain.h"
 #include "fpConvolve.h"
+#include "fpComptonEscape.h"
 #include "Element.h"
 #include "XrayEdge.h"
 #include "XrayLines.h"
@@ -80,6 +81,11 @@ using namespace std;
 //  Modified May 10, 2021   Use scale_under_peaks function when scale factor is negative in arguments
 //  Modified May 14, 2021   Fixed logic error where coefficient was reset to unity when it should be manual scale factor
 //  Modified July 10, 2021  Add simple pulse pileup calculation
+//  Modified Oct. 16, 2026  Compton escape loop moved to fpComptonEscape, detector response and
+//                          Compton escape fractions are kept while the energy calibration does not change
+//  Modified Oct. 17, 2026  Sample lines are kept in fpStorage and reused for every iteration
+//                          Detector response and beam transmissions for each channel are kept in fpStorage
+//                          (DetectorResponseTable) for the continuum and Compton escape calculations
 
 
 const vector<float> X_BkgAdj;
@@ -95,7 +101,7 @@ const vector<float> D_BkgAdj;
 //const vector<float> D_BkgAdj( X_BkgAdj.size(), 0 );
 
 
-int quantCalculate(const FPstorage &fpStorage, const XrayMaterial &specimen, const XRFconditions &conditions_in,
+int quantCalculate(FPstorage &fpStorage, const XrayMaterial &specimen, const XRFconditions &conditions_in,
             XraySpectrum &spectrum ) {
 //		check input parameters
 	if( spectrum.numberOfChannels() <= 0 ) return -701;
@@ -106,7 +112,7 @@ int quantCalculate(const FPstorage &fpStorage, const XrayMaterial &specimen, con
 
 //			generate calculated emission line intensities for all elements using this sample composition
 //cout << "Starting fp calc." << endl;
-	vector <XrayLines> sampleLines(0);
+	vector <XrayLines> &sampleLines = fpStorage.sampleLines;
 	fpCalc (fpStorage, specimen, conditions_in, sampleLines );
 //			correct for spectrum live time
     for( i=0; i<sampleLines.size(); i++ ) sampleLines[i].commonFactor( spectrum.live_time() );
@@ -127,6 +133,9 @@ int quantCalculate(const FPstorage &fpStorage, const XrayMaterial &specimen, con
             sigma_mult = updated_component.scale_under;
         }
     }
+    //  Rebuilt here if the calibration has changed since the last calculation (it usually has during a fit)
+    if( i_bkg_component >= 0 || index_ce >= 0 )
+        fpStorage.response_table.update( conditions_in, spectrum.calibration(), nChan );
    //  Get any background crossover parameters stored with the spectrum and see if this is a defauly bkg calculation
     vector <float> bkg_split_energies;
     spectrum.get_bkg_split( bkg_split_energies );
@@ -361,36 +370,13 @@ int quantCalculate(const FPstorage &fpStorage, const XrayMaterial &specimen, con
     if( index_ce >= 0 ) {
         //  Calculate Compton escape shelf at low energies
         //  Loop over channels in the full calculation and add Compton escape contribution
-        unsigned int i_ce;
-        for( i_ce=0; i_ce<ce_calc.size(); i_ce++ ) {
-            float spec_energy = spectrum.energy( i_ce );
-            if( spec_energy < conditions_in.eMin ) continue;
-            //  Check if Compton escape is possible for this channel (or any higher channels)
-            float min_ce_energy = conditions_in.detector.ce_minimum( spec_energy );
-            if( min_ce_energy > conditions_in.source.kV() * 1000 ) break;
-            unsigned int min_ce_channel = spectrum.channel( min_ce_energy );
-            if( min_ce_channel >= spectrum.calc().size() - 1 ) break;
-            unsigned int is;
-            for( is=min_ce_channel; is<spectrum.calc().size(); is++ ) {
-                float meas_intensity = spectrum.calc()[is];
-                if( meas_intensity <= 0 ) continue;
-                float inc_energy = spectrum.energy( is );
-                //  Find original intensity incident on detector by dividing by response at this energy
-                float det_resp = conditions_in.detector.response( inc_energy );
-                if( det_resp <= 0 ) continue;
-                float incoming_int =  meas_intensity / det_resp;
-                //  Compton escape for this spectrum channel from the incident energy
-                float ce_intensity = incoming_int * conditions_in.detector.ce_fraction( inc_energy, spec_energy );
-                //  Add the Compton escape intensity to the background channel
-                ce_calc[i_ce] += ce_intensity;
-                //  Include the same intensity in the channel that was the source of the Compton escape, for debugging
-                //ce_calc[is] += ce_intensity;
-            }
-        }
+        fpComptonEscape( conditions_in.detector, spectrum.calibration(), conditions_in.eMin,
+                conditions_in.source.kV() * 1000, spectrum.calc(), ce_calc, fpStorage.response_table );
         fpConvolve( conditions_in.detector, spectrum.calibration(), ce_calc );
         //  Add Compton escape to its component
         SpectrumComponent bkg_component = spectrum.component( index_ce );
         bkg_component.spectrum.resize( spectrum.numberOfChannels() );
+        unsigned int i_ce;
         for( i_ce=0; i_ce<ce_calc.size(); i_ce++ ) bkg_component.spectrum[i_ce] = ce_calc[i_ce];
         spectrum.update_component( bkg_component );
     }
@@ -37,7 +37,7 @@
 #include "XraySpectrum.h"
 #include "fpMain.h"
 
-int quantCalculate(const FPstorage &fpStorage, const XrayMaterial &specimen, const XRFconditions &conditions_in,
+int quantCalculate(FPstorage &fpStorage, const XrayMaterial &specimen, const XRFconditions &conditions_in,
             XraySpectrum &spectrum );
 
 #endif
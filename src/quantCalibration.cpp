@@ -0,0 +1,99 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <sstream>
+#include "quantCalibration.h"
+#include "quantWriteCalibrationTXT.h"
+#include "setupStandardsCSV.h"
+#include "quantECFs.h"
+#include "XrayMaterial.h"
+#include "XRFcontrols.h"
+#include "XRFutilities.h"
+
+//  Written Oct. 16, 2026
+//      Read the calibration file once (moved here from quantUnknown) and calculate the ECFs for the run's element list
+//      quantUnknown was reading the file and running quantECFs for every spectrum in a map
+
+
+using namespace std;
+
+int quantLoadCalibration( const std::string &calFileName, const std::vector <ElementListEntry> &element_list,
+        const std::ios &log_format, QuantCalibration &calibration ) {
+
+    int result = 0;
+    calibration = QuantCalibration();
+    calibration.file_name = calFileName;
+
+    ostringstream read_log;
+    read_log.copyfmt( log_format );
+    //  Read in ECF list or standards information from calibration file
+    if( check_file_extension( calFileName, "TXT" ) ) {
+        int ne_in = quantReadCalibrationTXT( calFileName, calibration.cal_element_list, calibration.cal_factor_list, read_log );
+        if( ne_in > 0 ) {
+            read_log << "Calibration file read OK, " << calibration.cal_element_list.size() << " element calibration factors." << endl;
+        } else {
+            read_log << "No element calibration factors read in from file." << endl;
+        }
+    } else if( check_file_extension( calFileName, "CSV" ) ) {
+        result = setupStandardsCSV( calFileName, calibration.cal_standards, MINIMUM_AMOUNT );
+        if ( result != 0 ) {
+            read_log << "Calibration file read failed, result = " << result << endl;
+        } else {
+            read_log << "Calibration file read OK, entries for " << calibration.cal_standards.size() << " standards read in." << endl;
+            read_log << endl;
+        };
+    } else {
+        read_log << "Calibration files can only be .txt or .csv" << endl;
+        result = -1;
+    }
+    calibration.read_log = read_log.str();
+
+    //  Set up the list of elements the same way quantUnknown does, and find their ECFs
+    XrayMaterial unknown;
+    unsigned int ie;
+    for( ie=0; ie<element_list.size(); ie++ ) {
+        if( element_list[ie].qualifier == NO_QUALIFIER || element_list[ie].qualifier == FORCE ) {
+            unknown.add_element( element_list[ie].element, 1.0f / element_list.size(), element_list[ie].stoichiometry );
+        }
+    }
+    calibration.ecf_elements = unknown.original_element_list();
+    if( calibration.ecf_elements.size() > 0 ) {
+        ostringstream ecf_log;
+        ecf_log.copyfmt( log_format );
+        calibration.ecf_log_flags = ecf_log.flags();
+        calibration.ecf_log_precision_before = ecf_log.precision();
+        vector <float> unk_fractions_dummy;
+        quantECFs( calibration.cal_standards, calibration.cal_element_list, calibration.cal_factor_list,
+                calibration.ecf_elements, unk_fractions_dummy, calibration.ecf_factors, calibration.ecf_SDs, ecf_log );
+        calibration.ecf_log = ecf_log.str();
+        calibration.ecf_log_precision_after = ecf_log.precision();
+    }
+
+    return result;
+}
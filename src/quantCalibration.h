@@ -0,0 +1,68 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef quantCalibration_h
+#define quantCalibration_h
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include "Element.h"
+#include "XRFstandards.h"
+#include "parse_element_list.h"
+
+//  Written Oct. 16, 2026
+//      Calibration file contents, read once per run and then used (read-only) for every spectrum
+//      Includes the ECFs for the run's element list so quantECFs does not need to be repeated for each spectrum
+
+struct QuantCalibration {
+    std::string file_name;
+    //  Messages from reading the file, repeated in the log for each spectrum
+    std::string read_log;
+    //  Old-style txt calibration file with only elements and ECFs
+    std::vector <Element> cal_element_list;
+    std::vector <float> cal_factor_list;
+    //  Standards list with ECFs and weights from a csv calibration file
+    std::vector <StandardInformation> cal_standards;
+    //  Results from quantECFs for the element list given to quantLoadCalibration
+    //      (only valid if the unknown has the same elements and no standards are disabled)
+    std::vector <Element> ecf_elements;
+    std::vector <float> ecf_factors;
+    std::vector <float> ecf_SDs;
+    std::string ecf_log;
+    std::ios::fmtflags ecf_log_flags = std::ios::fmtflags();
+    std::streamsize ecf_log_precision_before = 0;
+    std::streamsize ecf_log_precision_after = 0;
+};
+
+//  log_format is the stream the ECF messages will eventually be written to (or one with the same format flags)
+int quantLoadCalibration( const std::string &calFileName, const std::vector <ElementListEntry> &element_list,
+        const std::ios &log_format, QuantCalibration &calibration );
+
+#endif
@@ -75,11 +75,12 @@
 //  Modified May 10, 2021   Added scale_under to use scale-under-peaks algorithm for calculated background (every time it is calculated in quantCalculate)
 //                          Modify matchComponent to handle multiple SNIP_BKG components
 //  Modified July 10, 2021  Add pulse pileup component
+//  Modified Oct. 16, 2026  Pass line and element lists by reference
 
 
 using namespace std;
 
-int setupComponents( const std::vector <XrayLines> sourceLines, const std::vector <XrayLines> pureLines,
+int setupComponents( const std::vector <XrayLines> &sourceLines, const std::vector <XrayLines> &pureLines,
                 std::vector <SpectrumComponent> &components_out ) {
 
     bool error = false;
@@ -231,7 +232,7 @@ bool matchComponent( const SpectrumComponent &component_1, const SpectrumCompone
 
 //  Set flags of components that will be used to quantify their associated elements
 //  Mark any components that are to be excluded based on the element list inputs
-int quantComponents( const std::vector <ElementListEntry> element_list_in,
+int quantComponents( const std::vector <ElementListEntry> &element_list_in,
 				std::vector <SpectrumComponent> &components_out ) {
     int ie;
     for( ie=0; ie<element_list_in.size(); ie++ ) {
@@ -523,6 +524,8 @@ std::string SpectrumComponent_toString(const SpectrumComponent &comp)
     os << "non-fit factor: " << comp.non_fit_factor << endl;
     os << "matrix effect factor: " << comp.matrix << endl;
     os << "included: " << comp.included << endl;
+    os << "band_start: " << comp.band_start << endl;
+    os << "band_end: " << comp.band_end << endl;
 
     return os.str();
 }
@@ -89,19 +89,23 @@ struct SpectrumComponent {
     float non_fit_factor = 0;   //  Used to set coefficient of non-fit components, ratio to coefficient of a fit component
     float adjusted_coefficient = -1;   //  Used to get coefficients to better match updated concentration for next calculation (used in detector shelf calculation)
     bool included = true;   //  Only to be used in XraySpectrum to form fit vector, will be set there as needed
+    //  Channels where the spectrum is non-zero (start to end-1), set by XraySpectrum whenever the spectrum changes
+    //      so sums over the spectrum can skip the rest of the channels (end = -1 => not known, use all channels)
+    int band_start = 0;
+    int band_end = -1;
 
 };
 
 std::string SpectrumComponent_toString(const SpectrumComponent &comp);
 
 
-int setupComponents(  const std::vector <XrayLines> sourceLines, const std::vector <XrayLines> pureLines,
+int setupComponents(  const std::vector <XrayLines> &sourceLines, const std::vector <XrayLines> &pureLines,
                 std::vector <SpectrumComponent> &components_out );
 
 int makeComponents( const SpectrumComponentType type_in, const std::vector <XrayLines> &lines_in,
                 std::vector <SpectrumComponent> &components_out, const int n_bkg = 1 );
 
-int quantComponents( const std::vector <ElementListEntry> element_list_in,
+int quantComponents( const std::vector <ElementListEntry> &element_list_in,
 				std::vector <SpectrumComponent> &components_out );
 
 int quantDefaults( std::vector <ElementListEntry> &element_list_in,
@@ -58,6 +58,8 @@ using namespace std;
 //                              (So bkg can be several components, some fit and some not)
 //                          This implies that everything in the background must always show up as a component
 //  Modified Apr. 8, 2021   Ignore zero-energy components for done check (not an element component with a reasonable peak at a known energy)
+//  Modified Oct. 16, 2026  Use the non-zero channel band of each component in the fit and in the peak shift and width sums
+//                          Reuse the derivative storage for all components
 
 int quantFitSpectrum( XRFconditions &conditions_in, XraySpectrum &spectrum, std::ostream &logger ) {
 //		check input parameters
@@ -72,6 +74,10 @@ int quantFitSpectrum( XRFconditions &conditions_in, XraySpectrum &spectrum, std:
 	vector <float> elementCenterEnergy;	//	center energy of largest peak for this element
 	spectrum.fit_vector( componentSpec, coeff_save, elementCenterEnergy );
 	int nc_fit = coeff_save.size();
+	//  Channels where each component spectrum is non-zero, so the fit can skip the rest
+	vector <int> band_start;
+	vector <int> band_end;
+	spectrum.fit_vector_bands( band_start, band_end );
 
 	vector <float> coeff(nc_fit);
 	vector <float> var(nc_fit);
@@ -93,7 +99,7 @@ int quantFitSpectrum( XRFconditions &conditions_in, XraySpectrum &spectrum, std:
     }
     //  Use least squares to find coefficient values that best fit components to spectrum
     int result = 0;
-    result = lfit ( fit_spectrum, spectrum.sigma(), coeff, var, chisq, componentSpec, nChan );
+    result = lfit ( fit_spectrum, spectrum.sigma(), coeff, var, chisq, componentSpec, nChan, band_start, band_end );
 	if( result < 0 ) return -810 + result;
     //  **** DEBUG **** Code to write coefficients to output
 //    cout << "quantFitSpectrum    fit coeff";
@@ -159,23 +165,42 @@ int quantFitSpectrum( XRFconditions &conditions_in, XraySpectrum &spectrum, std:
 	float nominal_resolution = conditions_in.detector.resolution();
     float det_ref_energy = conditions_in.detector.fwhm_energy();
     float ev_ch = spectrum.calibration().energyPerChannel();
+    //  The derivatives are only non-zero within a few channels of the component band (3 for each differentiate),
+    //      so they are calculated over the band plus a margin (the whole spectrum if there are any inf or nan values)
+    //  Numerical derivatives of the component spectra as calculated, so they include the energy calibration from this
+    //      iteration and every line shape feature (this is a small part of the fit time, fpLineSpectrum is much more)
+    const int DERIV_BAND_MARGIN = 12;
+    vector <float> deriv;
+    vector <float> deriv2;
+    const vector <float> &residual_spec = spectrum.residual();
+    bool residual_finite = true;
+    int is;
+    for ( is=0; is<nChan; is++ ) {
+        if( ! isfinite( residual_spec[is] ) ) residual_finite = false;
+    }
 	for ( ic_fit=0; ic_fit<nc_fit; ic_fit++ ) {
         if( elementCenterEnergy[ic_fit] == 0 ) continue;    //  Skip if not an element component (with a reasonable peak at a known energy)
         float elementResolution = conditions_in.detector.resolution( elementCenterEnergy[ic_fit] );
-		vector <float> deriv (nChan,0);
-		int is;
-        for ( is=0; is<nChan; is++ ) deriv[is] = coeff[ic_fit] * componentSpec[ic_fit*nChan + is] / ev_ch;
+        int lo = 0;
+        int hi = nChan;
+        if( residual_finite && isfinite( coeff[ic_fit] / ev_ch ) ) {
+            lo = max( 0, band_start[ic_fit] - DERIV_BAND_MARGIN );
+            hi = min( nChan, band_end[ic_fit] + DERIV_BAND_MARGIN );
+        }
+        int nd = hi - lo;
+        deriv.resize( nd );
+        for ( is=0; is<nd; is++ ) deriv[is] = coeff[ic_fit] * componentSpec[ic_fit*nChan + lo + is] / ev_ch;
         differentiate( deriv );
-		vector <float> deriv2 (nChan,0);
-        for ( is=0; is<nChan; is++ ) deriv2[is] = deriv[is] / ev_ch;
+        deriv2.resize( nd );
+        for ( is=0; is<nd; is++ ) deriv2[is] = deriv[is] / ev_ch;
         differentiate( deriv2 );
         float sumRD = 0;
         float sumDD = 0;
         float sumR2D = 0;
         float sum2D2 = 0;
-        for ( is=0; is<nChan; is++ ) {
-            float e = spectrum.energy( is );
-            float residual = spectrum.residual()[is];
+        for ( is=0; is<nd; is++ ) {
+            float e = spectrum.energy( lo + is );
+            float residual = residual_spec[lo + is];
             sumRD += residual * deriv[is];
             float d2 = deriv[is] * deriv[is];
             sumDD += d2;
@@ -42,9 +42,11 @@ using namespace std;
 //  Modified Dec. 13, 02017
 //      Add check for minimum energy to escape peaks (passed to fpLineSpectrum)
 //  Modified July 10, 2021  Add simple pulse pileup calculation - change return for fpLineSpectrum (note ignore peaks not included in pileup)
+//  Modified Oct. 16, 2026  Optional FPprepCache for the pure element calculations
+//  Modified Oct. 16, 2026  Pass element list by reference
 
-int quantIgnore( const std::vector <ElementListEntry> element_list, XRFconditions &conditions,
-                        XraySpectrum &spectrum, std::vector <XrayLines> &ignoreLines ) {
+int quantIgnore( const std::vector <ElementListEntry> &element_list, XRFconditions &conditions,
+                        XraySpectrum &spectrum, std::vector <XrayLines> &ignoreLines, FPprepCache *fpCache ) {
 //		check input parameters
 	if( ! spectrum.calibration().good() ) return -520;
 	if( spectrum.live_time() <= 0 ) return -521;
@@ -62,7 +64,8 @@ int quantIgnore( const std::vector <ElementListEntry> element_list, XRFcondition
         //  Single-element material
         XrayMaterial temp_mat( element_list[ie].element );
         //  Use intensity of lines from pure element
-        fpPrep(fpStorage, temp_mat, conditions, pureLines );
+        if( fpCache ) fpPrep(fpStorage, temp_mat, conditions, pureLines, *fpCache );
+        else fpPrep(fpStorage, temp_mat, conditions, pureLines );
         int i;
         for( i=0; i<pureLines.size(); i++ ) pureLines[i].commonFactor( spectrum.live_time() );
         int result = makeComponents( ELEMENT, pureLines, components );
@@ -36,10 +36,11 @@
 #include "XRFconditions.h"
 #include "XraySpectrum.h"
 #include "XrayLines.h"
+#include "fpMain.h"
 
 //  Process any element to be included in the fit but ignored in the composition
 
-int quantIgnore( const std::vector <ElementListEntry> element_list, XRFconditions &conditions,
-                    XraySpectrum &spectrum, std::vector <XrayLines> &ignoreLines );
+int quantIgnore( const std::vector <ElementListEntry> &element_list, XRFconditions &conditions,
+                    XraySpectrum &spectrum, std::vector <XrayLines> &ignoreLines, FPprepCache *fpCache = 0 );
 
 #endif
@@ -57,6 +57,7 @@ using namespace std;
 //  Modified Apr. 6, 2021   Add CONTINUUM component type and sort out how to handle background and Compton escape (remove Det shelf component)
 //                          Major rearrangements in fpLineSpectrum to improve speed, move shelf calc from quantCalculate to fpLineSpectrum
 //  Modified July 10, 2021  Add simple pulse pileup calculation - change return for fpLineSpectrum (note these peaks not included in pileup)
+//  Modified Oct. 16, 2026  Continuum and Compton escape use a DetectorResponseTable for the channel values
 
 
 int quantPrimarySpec( const XRFconditions &conditions_in, XraySpectrum &primary_spectrum ) {
@@ -65,6 +66,9 @@ int quantPrimarySpec( const XRFconditions &conditions_in, XraySpectrum &primary_
 	if( ! primary_spectrum.calibration().good() ) return -705;
 	if( primary_spectrum.live_time() <= 0 ) return -706;
 	int nChan = primary_spectrum.numberOfChannels();
+//		detector response and beam transmissions for each channel (used for every pair of channels in Compton escape)
+	DetectorResponseTable table;
+	table.update( conditions_in, primary_spectrum.calibration(), nChan );
 
     //**************************************************************************
     //      calculate contribution to spectrum from characteristic lines
@@ -154,9 +158,9 @@ int quantPrimarySpec( const XRFconditions &conditions_in, XraySpectrum &primary_
                 //			find continuum intensity at desired energy
                 float contInt = conditions_in.source.continuum( contEn );
     //			    apply incident beam corrections
-                contInt *= fpIncidentBeam ( contEn, conditions_in );
+                contInt *= fpIncidentBeam ( table.incident( iChan ), conditions_in );
     //		        apply detector response correction
-                float detResp = conditions_in.detector.response( contEn );
+                float detResp = table.response( iChan );
                 contInt *= detResp;
                 //			result is per keV, so multiply by channel width in keV to get counts in each channel
                 contInt *= primary_spectrum.calibration().energyPerChannel( iChan ) / 1000;
@@ -194,7 +198,7 @@ int quantPrimarySpec( const XRFconditions &conditions_in, XraySpectrum &primary_
                 if( meas_intensity <= 0 ) continue;
                 float inc_energy = primary_spectrum.energy( is );
                 //  Find original intensity incident on detector by dividing by response at this energy
-                float det_resp = conditions_in.detector.response( inc_energy );
+                float det_resp = is < nChan ? table.response( is ) : conditions_in.detector.response( inc_energy );
                 if( det_resp <= 0 ) continue;
                 float eV_ch = primary_spectrum.calibration().energyPerChannel( is );
                 //  Get original intensity incident on detector
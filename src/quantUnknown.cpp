@@ -27,6 +27,8 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <sstream>
+#include <atomic>
 #include "quantUnknown.h"
 #include "quantWriteCalibrationTXT.h"
 #include "quantBackground.h"
@@ -42,6 +44,7 @@
 #include "Fit.h"
 #include "upper_trim.h"
 #include "differentiate.h"
+#include "andersonMix.h"
 #include "XRFconstants.h"
 #include "XRFcontrols.h"
 #include "XRFutilities.h"
@@ -49,6 +52,16 @@
 
 using namespace std;
 
+static atomic <int> anderson_mixing_depth( QUANT_ANDERSON_MIXING ? QUANT_ANDERSON_DEPTH : 0 );
+
+void quantAndersonMixing( const int depth ) {
+    anderson_mixing_depth = depth > 0 ? depth : 0;
+};
+
+int quantAndersonMixing() {
+    return anderson_mixing_depth;
+};
+
 //      Quantify the composition of an unknown material
 //          by analyzing the measured XRF spectrum
 //      Fit the spectrum to calculated components
@@ -108,69 +121,58 @@ using namespace std;
 //                          Disable calibration file (all ECFs are unity, don't open or read cal file)
 //  Modified Apr. 6, 2021   Add CONTINUUM component type and sort out how to handle background and Compton escape (remove Det shelf component)
 //  Modified July 10, 2021  Add simple pulse pileup calculation - change return for fpLineSpectrum (note ignore peaks not included in pileup)
+//  Modified Oct. 16, 2026  Optional FPprepCache so map spectra share the FP setup
+//                          Calibration file is read once by quantLoadCalibration and passed in, use its ECFs if they match
+//                          Split into quantUnknownSetup (ECFs and components, same for every spectrum with the same
+//                              element list and conditions) and the per-spectrum fit, add quantUnknownSequence
+//                          Optional Anderson mixing of the iteration updates (quantAndersonMixing, -A option)
+//                          QuantUnknownSetupCache calculates new setups without holding its lock
+//  Modified Oct. 17, 2026  quantUnknownSequence takes spectra with their own conditions and shares setups by key (used for map spectra)
 
 
-int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list,
-        XRFconditions &conditions, XraySpectrum &unkSpectrum, const std::string &calFileName, std::ostream &logger ) {
-//		check input parameters
-	if( ! unkSpectrum.calibration().good() ) return -520;
-	if( unkSpectrum.live_time() <= 0 ) return -521;
-	int nChan = unkSpectrum.numberOfChannels();
-
+//  Work out everything that is the same for all spectra with this element list, conditions, and standards
+static int quantUnknownSetupInternal( QuantUnknownSetup &setup, const vector <ElementListEntry> &element_list_in,
+        const XRFconditions &conditions, const XraySpectrum &unkSpectrum, const QuantCalibration &calibration, std::ostream &logger,
+        FPprepCache *fpCache ) {
 	int result;
 
-	//  Old-style txt calibration file with only elements and ECFs
-    vector <Element> cal_element_list;
-    vector <float> cal_factor_list;
-    //  Standards list with ECFs and weights from a csv calibration file
+    setup.element_list = element_list_in;
+    vector <ElementListEntry> &element_list = setup.element_list;
+    XrayMaterial &unknown = setup.unknown;
+
+    //  Calibration file was read in once by quantLoadCalibration (messages repeated here for each spectrum)
+    logger << calibration.read_log;
+    //  Disable any standards in the list that match the one being evaluated (on a copy of the standards list)
+    const vector <StandardInformation> *cal_standards_used = &calibration.cal_standards;
     vector <StandardInformation> cal_standards;
-    //  Read in ECF list or standards information from calibration file
-    if( check_file_extension( calFileName, "TXT" ) ) {
-        int ne_in = quantReadCalibrationTXT( calFileName, cal_element_list, cal_factor_list, logger );
-        if( ne_in > 0 ) {
-            logger << "Calibration file read OK, " << cal_element_list.size() << " element calibration factors." << endl;
-        } else {
-            logger << "No element calibration factors read in from file." << endl;
-        }
-    } else if( check_file_extension( calFileName, "CSV" ) ) {
-        result = setupStandardsCSV( calFileName, cal_standards, MINIMUM_AMOUNT );
-        if ( result != 0 ) {
-            logger << "Calibration file read failed, result = " << result << endl;
-        } else {
-            logger << "Calibration file read OK, entries for " << cal_standards.size() << " standards read in." << endl;
-            logger << endl;
-            //  Disable any standards in the list that match the one being evaluated
-            const vector <string> &eval_names = unkSpectrum.std_names();
-            if( eval_names.size() > 0 ) {
-                unsigned int is;
-                int stds_count = 0;
-                for( is=0; is<cal_standards.size(); is++ ) {
-                    bool name_match_found = false;
-                    unsigned int in;
-                    for( in=0; in<cal_standards[is].names.size(); in++ ) {
-                        unsigned int in_eval;
-                        for( in_eval=0; in_eval<eval_names.size(); in_eval++ ) {
-                            if( eval_names[in_eval] == cal_standards[is].names[in] ) name_match_found = true;
-                            //cout << "Std disable " << eval_names[in_eval] << "     " << cal_standards[is].names[in] << "   " << name_match_found << endl;
-                        }
-                    }
-                    if( name_match_found ) {
-                        cal_standards[is].disable = true;
-                        logger << "Standard    " << ( cal_standards[is].names.size()>0?cal_standards[is].names[0]:"");
-                        logger << " (# " << is << ") is disabled for this evaluation." << endl;
-                    } else {
-                        stds_count++;
-                        cal_standards[is].disable = false;
-                    }
-                }
-                if( stds_count == 0 ) {
-                    logger << "Error - no calibration standards for " << eval_names[0] << " during Evaluate." << endl;
+    const vector <string> &eval_names = unkSpectrum.std_names();
+    if( calibration.cal_standards.size() > 0 && eval_names.size() > 0 ) {
+        cal_standards = calibration.cal_standards;
+        cal_standards_used = &cal_standards;
+        unsigned int is;
+        int stds_count = 0;
+        for( is=0; is<cal_standards.size(); is++ ) {
+            bool name_match_found = false;
+            unsigned int in;
+            for( in=0; in<cal_standards[is].names.size(); in++ ) {
+                unsigned int in_eval;
+                for( in_eval=0; in_eval<eval_names.size(); in_eval++ ) {
+                    if( eval_names[in_eval] == cal_standards[is].names[in] ) name_match_found = true;
+                    //cout << "Std disable " << eval_names[in_eval] << "     " << cal_standards[is].names[in] << "   " << name_match_found << endl;
                 }
             }
-        };
-    } else {
-        logger << "Calibration files can only be .txt or .csv" << endl;
-        result = -1;
+            if( name_match_found ) {
+                cal_standards[is].disable = true;
+                logger << "Standard    " << ( cal_standards[is].names.size()>0?cal_standards[is].names[0]:"");
+                logger << " (# " << is << ") is disabled for this evaluation." << endl;
+            } else {
+                stds_count++;
+                cal_standards[is].disable = false;
+            }
+        }
+        if( stds_count == 0 ) {
+            logger << "Error - no calibration standards for " << eval_names[0] << " during Evaluate." << endl;
+        }
     }
 
 
@@ -195,7 +197,17 @@ int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list
     //  Added return of ECF standard deviations            Nov. 4, 2019
     vector <float> unk_ECF_SDs;
     //  Standards list will be used if populated, otherwise element & ECF lists
-    result = quantECFs( cal_standards, cal_element_list, cal_factor_list, unk_elements, unk_fractions_dummy, unk_factors_list, unk_ECF_SDs, logger );
+    //  Use the ECFs calculated when the calibration was loaded if they are for the same elements and standards
+    if( cal_standards_used == &calibration.cal_standards && unk_elements == calibration.ecf_elements
+            && logger.flags() == calibration.ecf_log_flags ) {
+        unk_factors_list = calibration.ecf_factors;
+        unk_ECF_SDs = calibration.ecf_SDs;
+        logger << calibration.ecf_log;
+        if( calibration.ecf_log_precision_after != calibration.ecf_log_precision_before ) logger.precision( calibration.ecf_log_precision_after );
+        result = 0;
+    } else {
+        result = quantECFs( *cal_standards_used, calibration.cal_element_list, calibration.cal_factor_list, unk_elements, unk_fractions_dummy, unk_factors_list, unk_ECF_SDs, logger );
+    }
     //  Put ECFs into element list for output to results and map file
     for( ie=0; ie<element_list.size(); ie++ ) {
         int iu;
@@ -212,22 +224,15 @@ int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list
     vector <XrayLines> pureLines;
     if( Compton_escape_enable_flag ) result = makeComponents( DETECTOR_CE, pureLines, components, 0 );
 
-    // Include components for any elements to be included in fit but ignored in composition
-    vector <XrayLines> ignoreLines;
-    result = quantIgnore( element_list, conditions, unkSpectrum, ignoreLines );
-    if( result < 0 ) {
-        logger << "quantIgnore failed to set up components for ignored elements, result is " << result << endl;
-        return -540 + result;
-    }
-
     vector <XrayLines> sourceLines;
     //  Load vector with emission lines from X-ray source
     conditions.source.lines( sourceLines, conditions.eMin );
     //  Load vector with pure element emission lines from specimen and set up FP calculations
+    //  (the line intensities are not needed here, only which lines are excited)
     FPstorage fpStorage;
-    fpPrep(fpStorage, unknown, conditions, pureLines );
+    if( fpCache ) fpPrep(fpStorage, unknown, conditions, pureLines, *fpCache );
+    else fpPrep(fpStorage, unknown, conditions, pureLines );
     int i;
-    for( i=0; i<pureLines.size(); i++ ) pureLines[i].commonFactor( unkSpectrum.live_time() );
     //  Copy list of pure element lines and remove any matrix elements before setting up spectrum components
     vector <XrayLines> pureLines_nonMatrix;
     for( i=0; i<pureLines.size(); i++ ) {
@@ -277,7 +282,7 @@ int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list
             }
         }
     }
-    //  Add the components to the spectrum object
+    //  Save the components to be added to each spectrum
     int ic;
     for( ic=0; ic<components.size(); ic++ ) {
         //  Leave out Compton lines from tube L edges (fit with extra La and Lb1 lines above)
@@ -305,8 +310,86 @@ int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list
                 if( components[ic].level == M ) components[ic].non_fit_factor = COEFF_RATIO_M_L;    //  defined in XRFcontrols.h
             }
         }
-        unkSpectrum.add_component( components[ic] );
+        setup.components.push_back( components[ic] );
+    }
+
+
+    setup.unk_factors_list = unk_factors_list;
+	return 0;
+
+};
+
+
+int quantUnknownSetup( QuantUnknownSetup &setup, const vector <ElementListEntry> &element_list,
+        const XRFconditions &conditions, const XraySpectrum &unkSpectrum, const QuantCalibration &calibration, const std::ios &log_format,
+        FPprepCache *fpCache ) {
+    //  Messages go into the setup so they can be repeated in the log for each spectrum
+    ostringstream logger;
+    logger.copyfmt( log_format );
+    setup.log_precision_before = logger.precision();
+    int result = quantUnknownSetupInternal( setup, element_list, conditions, unkSpectrum, calibration, logger, fpCache );
+    setup.log = logger.str();
+    setup.log_precision_after = logger.precision();
+    return result;
+};
+
+
+std::string quantUnknownSetupKey( const vector <ElementListEntry> &element_list,
+        const XRFconditions &conditions, const XraySpectrum &unkSpectrum ) {
+    ostringstream os;
+    os.precision( 9 );
+    XrayMaterial unknown;
+    int ie;
+    for( ie=0; ie<element_list.size(); ie++ ) {
+        const ElementListEntry &entry = element_list[ie];
+        os << entry.element.Z() << " " << entry.quant_level << " " << entry.qualifier << " " << entry.percent;
+        os << " " << entry.uncertainty << " " << entry.stoichiometry.formula << " " << entry.stoichiometry.formula_ratio;
+        os << " " << entry.stoichiometry.input_fractions_are_formula << endl;
+        if( entry.qualifier == NO_QUALIFIER || entry.qualifier == FORCE ) {
+            unknown.add_element( entry.element, 1.0f / element_list.size(), entry.stoichiometry );
+        }
     }
+    //  Standards with these names are disabled during evaluate
+    int in;
+    for( in=0; in<unkSpectrum.std_names().size(); in++ ) os << "std " << unkSpectrum.std_names()[in] << endl;
+    //  The components depend on which emission lines are excited, so on the same things as the FP setup
+    os << fpPrepKey( unknown, conditions );
+    return os.str();
+};
+
+
+int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list,
+        XRFconditions &conditions, XraySpectrum &unkSpectrum, const QuantUnknownSetup &setup, std::ostream &logger,
+        FPprepCache *fpCache ) {
+//		check input parameters
+	if( ! unkSpectrum.calibration().good() ) return -520;
+	if( unkSpectrum.live_time() <= 0 ) return -521;
+	int nChan = unkSpectrum.numberOfChannels();
+
+	int result;
+
+    //  Messages from the setup are repeated for each spectrum
+    logger << setup.log;
+    if( setup.log_precision_after != setup.log_precision_before ) logger.precision( setup.log_precision_after );
+
+    //  Start from the element list (with ECFs and any default matrix elements) and initial composition from the setup
+    element_list = setup.element_list;
+    unknown = setup.unknown;
+    const vector <Element> &unk_elements = unknown.original_element_list();
+    const vector <float> &unk_factors_list = setup.unk_factors_list;
+    int ie;
+
+    // Include components for any elements to be included in fit but ignored in composition
+    vector <XrayLines> ignoreLines;
+    result = quantIgnore( element_list, conditions, unkSpectrum, ignoreLines, fpCache );
+    if( result < 0 ) {
+        logger << "quantIgnore failed to set up components for ignored elements, result is " << result << endl;
+        return -540 + result;
+    }
+
+    //  Add the components to the spectrum object
+    int ic;
+    for( ic=0; ic<setup.components.size(); ic++ ) unkSpectrum.add_component( setup.components[ic] );
 
     //  Load the matrix elements into the XrayMaterial object
     for( ie=0; ie<element_list.size(); ie++ ) {
@@ -316,8 +399,10 @@ int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list
         }
     }
     //  Set up FP calculations with final element list (including matrix)
+    FPstorage fpStorage;
     vector <XrayLines> pureLines_matrix;    //  This gets ignored since there are no matrix elements with useful emission lines
-    fpPrep (fpStorage, unknown, conditions, pureLines_matrix );
+    if( fpCache ) fpPrep (fpStorage, unknown, conditions, pureLines_matrix, *fpCache );
+    else fpPrep (fpStorage, unknown, conditions, pureLines_matrix );
 
     //  Check the bkg parameters and calculate the background using the SNIP digital filter (if selected)
     //  Checks for calculated background and for bkg fit (and adds components if fit)
@@ -327,11 +412,31 @@ int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list
         return -530 + result;
     };
 
+    //  Starting resolution, sets the scale of the energy calibration changes for Anderson mixing
+    const float start_resolution = conditions.detector.resolution();
+
     //  Fit the components to the measured spectrum
     int iterations = 0;
     bool done = false;
+    //  For Anderson mixing, values before and after the plain update: log of fractions for the elements being fit,
+    //      then energy calibration and detector resolution (the fits adjust these too, and they are often what converges last)
+    const bool use_anderson = quantAndersonMixing() > 0;
+    AndersonHistory anderson;
+    anderson.depth = quantAndersonMixing();
+    vector <int> mix_elements, mix_elements_last;
+    vector <float> mix_coeff;
+    vector <double> mix_x, mix_g, mix_new;
+    double mix_energy_x[4];
+    //  Energy calibration changes are scaled to the peak width, so they have about the same weight as the relative fractions
+    const double mix_energy_scale = start_resolution > 0 ? 1 / start_resolution : 1;
     while( iterations < MAX_ITERATIONS && ( ! done )) { //  MAX_ITERATIONS Defined in XRFcontrols.h
         iterations++;
+        if( use_anderson ) {
+            mix_energy_x[0] = unkSpectrum.calibration().offset() * mix_energy_scale;
+            mix_energy_x[1] = unkSpectrum.calibration().tilt() * nChan * mix_energy_scale;
+            mix_energy_x[2] = log( (double) conditions.detector.resolution() );
+            mix_energy_x[3] = log( (double) conditions.detector.fano() );
+        }
         // Calculate spectrum for this unknown, updating component spectra
         result = quantCalculate(fpStorage, unknown, conditions, unkSpectrum );
         if ( result != 0 ) {
@@ -381,6 +486,10 @@ int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list
         if( iterations < MINIMUM_ITERATIONS ) done = false;   //  Defined in XRFcontrols.h
         //  Improve composition using fit
         bool all_zero = true;
+        mix_elements.clear();
+        mix_coeff.clear();
+        mix_x.clear();
+        mix_g.clear();
         for( ie=0; ie<unk_elements.size(); ie++ ) {
             float fraction = unknown.fraction_input( unk_elements[ie] );
             float fraction_save = fraction;
@@ -391,6 +500,12 @@ int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list
                 float adj_coeff = unk_factors_list[ie];
                 if( fraction > 0 ) adj_coeff = coeff * fraction_save / fraction;
                 unkSpectrum.adjusted_coefficient( unk_elements[ie], adj_coeff );
+                if( use_anderson ) {
+                    mix_elements.push_back( ie );
+                    mix_coeff.push_back( coeff );
+                    mix_x.push_back( log( (double) fraction_save ) );
+                    mix_g.push_back( log( (double) fraction ) );
+                }
             } else if( coeff == COEFFICIENT_NO_COMPONENT ) {
                 continue;   //  No spectrum component for this element, don't adjust it
             } else {
@@ -406,6 +521,43 @@ int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list
             unknown.fraction( unk_elements[ie], fraction );
             if( fraction > 0 ) all_zero = false;
         }
+        //  Replace the plain updates by a combination of the last few (Anderson mixing), done in log(fraction) so
+        //      fractions stay positive. Only while the same elements are being fit, and not after the last fit
+        //      so the final composition is from the same kind of update as without mixing
+        //      (the convergence test in quantFitSpectrum is not changed)
+        if( use_anderson && ! done ) {
+            const int n_el = mix_x.size();
+            mix_x.insert( mix_x.end(), mix_energy_x, mix_energy_x + 4 );
+            mix_g.push_back( unkSpectrum.calibration().offset() * mix_energy_scale );
+            mix_g.push_back( unkSpectrum.calibration().tilt() * nChan * mix_energy_scale );
+            mix_g.push_back( log( (double) conditions.detector.resolution() ) );
+            mix_g.push_back( log( (double) conditions.detector.fano() ) );
+            bool usable = ( mix_elements == mix_elements_last );
+            for( ie=0; ie<mix_x.size() && usable; ie++ ) usable = isfinite( mix_x[ie] ) && isfinite( mix_g[ie] );
+            if( ! usable ) anderson.clear();
+            if( usable && andersonMix( anderson, mix_x, mix_g, mix_new ) ) {
+                //  Don't let the mixed step go too far from the plain update (e.g. when the fit is noisy),
+                //      energy calibration changes are limited to half a peak width as in quantFitSpectrum
+                for( ie=0; ie<mix_new.size() && usable; ie++ ) usable = isfinite( mix_new[ie] )
+                        && fabs( mix_new[ie] - mix_g[ie] ) <= ( ie < n_el ? log( QUANT_ANDERSON_MAX_STEP ) : 0.5 );
+                if( ! usable ) anderson.clear();
+                for( ie=0; ie<n_el && usable; ie++ ) {
+                    const Element &el = unk_elements[ mix_elements[ie] ];
+                    float fraction = exp( mix_new[ie] );
+                    unknown.fraction( el, fraction );
+                    unkSpectrum.adjusted_coefficient( el, mix_coeff[ie] * exp( mix_x[ie] - mix_new[ie] ) );
+                }
+                if( usable && unkSpectrum.adjust_energy() ) {
+                    unkSpectrum.calibration_change().offset( mix_new[n_el] / mix_energy_scale );
+                    unkSpectrum.calibration_change().tilt( mix_new[n_el+1] / mix_energy_scale / nChan );
+                }
+                if( usable && unkSpectrum.adjust_width() ) {
+                    conditions.detector.setResolution( exp( mix_new[n_el+2] ) );
+                    conditions.detector.fano( exp( mix_new[n_el+3] ) );
+                }
+            }
+            mix_elements_last = mix_elements;
+        }
         //  The following lines make the fit a non-negative least squares algorithm following Lawson and Hanson (1974)
         for( ic=0; ic<unkSpectrum.numberOfComponents(); ic++ ) {
             //  Need to do fit at least once after disabling negative coeff
@@ -421,3 +573,130 @@ int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list
 	return iterations;
 
 };
+
+
+//  Setup from the cache if there is one, otherwise a new setup
+static shared_ptr <const QuantUnknownSetup> quantUnknownFindSetup( const string &key, const vector <ElementListEntry> &element_list,
+        const XRFconditions &conditions, const XraySpectrum &unkSpectrum, const QuantCalibration &calibration, std::ostream &logger,
+        FPprepCache *fpCache, QuantUnknownSetupCache *setupCache, int &result ) {
+    if( setupCache ) {
+        return setupCache->get( key,
+            [&]( QuantUnknownSetup &new_setup ) {
+                return quantUnknownSetup( new_setup, element_list, conditions, unkSpectrum, calibration, logger, fpCache );
+            }, result );
+    }
+    shared_ptr <QuantUnknownSetup> new_setup = make_shared <QuantUnknownSetup> ();
+    new_setup->key = key;
+    result = quantUnknownSetup( *new_setup, element_list, conditions, unkSpectrum, calibration, logger, fpCache );
+    new_setup->result = result;
+    return new_setup;
+};
+
+
+int quantUnknown( XrayMaterial &unknown, vector <ElementListEntry> &element_list,
+        XRFconditions &conditions, XraySpectrum &unkSpectrum, const QuantCalibration &calibration, std::ostream &logger,
+        FPprepCache *fpCache, QuantUnknownSetupCache *setupCache ) {
+//		check input parameters
+	if( ! unkSpectrum.calibration().good() ) return -520;
+	if( unkSpectrum.live_time() <= 0 ) return -521;
+
+    int result = 0;
+    shared_ptr <const QuantUnknownSetup> setup = quantUnknownFindSetup( quantUnknownSetupKey( element_list, conditions, unkSpectrum ),
+        element_list, conditions, unkSpectrum, calibration, logger, fpCache, setupCache, result );
+    if( result < 0 ) {
+        logger << setup->log;
+        return result;
+    }
+    return quantUnknown( unknown, element_list, conditions, unkSpectrum, *setup, logger, fpCache );
+};
+
+
+int quantUnknownSequence( vector <QuantUnknownSequenceEntry> &spectra, const vector <ElementListEntry> &element_list,
+        const QuantCalibration &calibration, FPprepCache *fpCache, QuantUnknownSetupCache *setupCache,
+        const function <void ( int )> &done ) {
+    int n_failed = 0;
+    //  Setup used for the spectrum before, kept while the key is the same
+    shared_ptr <const QuantUnknownSetup> setup;
+    int is;
+    for( is=0; is<spectra.size(); is++ ) {
+        QuantUnknownSequenceEntry &entry = spectra[is];
+        std::ostream &logger = *entry.logger;
+        entry.unknown = XrayMaterial();
+        entry.element_list = element_list;
+        //  Same checks as quantUnknown before the setup
+        if( ! entry.spectrum->calibration().good() ) entry.result = -520;
+        else if( entry.spectrum->live_time() <= 0 ) entry.result = -521;
+        else {
+            const string key = quantUnknownSetupKey( element_list, *entry.conditions, *entry.spectrum );
+            int result = 0;
+            if( ! setup || setup->key != key || setup->result < 0 ) {
+                setup = quantUnknownFindSetup( key, element_list, *entry.conditions, *entry.spectrum, calibration, logger,
+                    fpCache, setupCache, result );
+            }
+            if( result < 0 ) {
+                logger << setup->log;
+                entry.result = result;
+            } else {
+                entry.result = quantUnknown( entry.unknown, entry.element_list, *entry.conditions, *entry.spectrum, *setup, logger,
+                    fpCache );
+            }
+        }
+        if( entry.result < 0 ) n_failed++;
+        if( done ) done( is );
+    }
+    return n_failed;
+};
+
+
+shared_ptr <const QuantUnknownSetup> QuantUnknownSetupCache::get( const string &key,
+		const function <int ( QuantUnknownSetup & )> &build, int &result ) {
+	size_t key_hash = hash <string> () ( key );
+	promise < shared_ptr <const QuantUnknownSetup> > new_promise;
+	bool keep = true;
+	unique_lock <mutex> lock( cache_mutex );
+	auto it = entries.find( key_hash );
+	//  Check the whole key in case of a hash collision
+	if ( it != entries.end() && it->second.key == key ) {
+		n_hits++;
+		shared_future < shared_ptr <const QuantUnknownSetup> > found = it->second.setup;
+		//  Wait outside the lock if another thread is still calculating it
+		lock.unlock();
+		shared_ptr <const QuantUnknownSetup> setup = found.get();
+		result = setup->result;
+		return setup;
+	};
+	n_misses++;
+	if ( it != entries.end() ) {
+		//  Another key with the same hash stays in the cache, this one is calculated but not kept
+		keep = false;
+	} else {
+		if ( entries.size() >= max_entries ) entries.clear();
+		entries[ key_hash ] = Slot{ key, new_promise.get_future().share() };
+	};
+	lock.unlock();
+	shared_ptr <QuantUnknownSetup> new_setup = make_shared <QuantUnknownSetup> ();
+	new_setup->key = key;
+	try {
+		result = build( *new_setup );
+	} catch ( ... ) {
+		//  Let any threads waiting for this setup see the error and don't keep it
+		if ( keep ) {
+			new_promise.set_exception( current_exception() );
+			lock.lock();
+			it = entries.find( key_hash );
+			if ( it != entries.end() && it->second.key == key ) entries.erase( it );
+		};
+		throw;
+	};
+	new_setup->result = result;
+	if ( ! keep ) return new_setup;
+	//  Threads already waiting get this setup even if it failed, but a failed setup isn't kept,
+	//      later spectra will try again (and report the error in their own logs)
+	new_promise.set_value( new_setup );
+	if ( result < 0 ) {
+		lock.lock();
+		it = entries.find( key_hash );
+		if ( it != entries.end() && it->second.key == key ) entries.erase( it );
+	};
+	return new_setup;
+};
@@ -32,12 +32,104 @@
 #define quantUnknown_h
 
 #include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <functional>
 #include "XrayMaterial.h"
 #include "XRFconditions.h"
 #include "XraySpectrum.h"
+#include "fpMain.h"
+#include "quantCalibration.h"
 
 
+//  Everything in quantUnknown that is the same for all spectra with the same element list, measurement conditions,
+//      and calibration standards: ECFs, the list of spectrum components and the initial composition
+//  Added Oct. 16, 2026
+struct QuantUnknownSetup {
+    std::string key;
+    std::vector <ElementListEntry> element_list;    //  With ECFs and any elements changed to matrix by quantDefaults
+    XrayMaterial unknown;   //  Initial composition (matrix elements are added for each spectrum)
+    std::vector <float> unk_factors_list;
+    std::vector <SpectrumComponent> components;     //  Not including ignored elements and background
+    std::string log;    //  Messages from the setup, repeated in the log for each spectrum
+    std::streamsize log_precision_before = 0;
+    std::streamsize log_precision_after = 0;
+    int result = 0;     //  From quantUnknownSetup
+};
+
+//  Setups shared between spectra in a map, new setup is calculated when the key changes
+class QuantUnknownSetupCache {
+public:
+	QuantUnknownSetupCache( const int max_entries_in = 8 ) : max_entries( max_entries_in ) {};
+	//  Returns the setup for this key, calls build to calculate it if it is not in the cache yet
+	//      (build runs without the lock held, other threads that want the same key wait for it, threads that want
+	//      other keys don't wait). Failed setups are returned with the result from build but not kept
+	std::shared_ptr <const QuantUnknownSetup> get( const std::string &key,
+			const std::function <int ( QuantUnknownSetup & )> &build, int &result );
+	int hits() const { return n_hits; };
+	int misses() const { return n_misses; };
+private:
+	//  Setups that are still being calculated are in the map, so the key is kept separately
+	struct Slot {
+		std::string key;
+		std::shared_future < std::shared_ptr <const QuantUnknownSetup> > setup;
+	};
+	std::map <std::size_t, Slot> entries;
+	std::mutex cache_mutex;
+	int max_entries;
+	int n_hits = 0;
+	int n_misses = 0;
+};
+
+//  log_format is the stream the setup messages will be written to (so the precision etc. match)
+int quantUnknownSetup( QuantUnknownSetup &setup, const std::vector <ElementListEntry> &element_list,
+        const XRFconditions &conditions, const XraySpectrum &unkSpectrum, const QuantCalibration &calibration, const std::ios &log_format,
+        FPprepCache *fpCache = 0 );
+
+//  Everything the setup depends on, for QuantUnknownSetupCache
+std::string quantUnknownSetupKey( const std::vector <ElementListEntry> &element_list,
+        const XRFconditions &conditions, const XraySpectrum &unkSpectrum );
+
+//  Quantify one spectrum using a setup made with the same element list, conditions and calibration standards
 int quantUnknown( XrayMaterial &unknown, std::vector <ElementListEntry> &element_list,
-        XRFconditions &conditions, XraySpectrum &unkSpectrum, const std::string &calFileName, std::ostream &logger );
+        XRFconditions &conditions, XraySpectrum &unkSpectrum, const QuantUnknownSetup &setup, std::ostream &logger,
+        FPprepCache *fpCache = 0 );
+
+//  If fpCache is not null, the FP setup is taken from the cache when the element list and conditions match
+//  If setupCache is not null, the setup is shared with other spectra that have the same element list and conditions
+int quantUnknown( XrayMaterial &unknown, std::vector <ElementListEntry> &element_list,
+        XRFconditions &conditions, XraySpectrum &unkSpectrum, const QuantCalibration &calibration, std::ostream &logger,
+        FPprepCache *fpCache = 0, QuantUnknownSetupCache *setupCache = 0 );
+
+//  One spectrum for quantUnknownSequence, the spectrum and its measurement conditions are set up by the caller
+//  Added Oct. 17, 2026
+struct QuantUnknownSequenceEntry {
+    XraySpectrum *spectrum = 0;
+    XRFconditions *conditions = 0;
+    std::ostream *logger = 0;
+    //  Results
+    XrayMaterial unknown;
+    std::vector <ElementListEntry> element_list;    //  With ECFs and fit results
+    int result = 0;     //  From quantUnknown
+};
+
+//  Quantify a list of spectra with the same element list and calibration, one after the other
+//      The fits are not combined into one solve: the component spectra of each fit depend on that spectrum's own
+//      composition, which is iterated, so there is no design matrix the spectra could share
+//      Consecutive spectra with the same setup key share one setup (and share it with other calls through setupCache if it is not null)
+//      Every fit starts from the initial composition of its setup, whether or not the spectrum before it could be quantified
+//  done is called with the index of each spectrum as soon as it has been quantified (if it is set)
+//  Returns the number of spectra that could not be quantified
+int quantUnknownSequence( std::vector <QuantUnknownSequenceEntry> &spectra, const std::vector <ElementListEntry> &element_list,
+        const QuantCalibration &calibration, FPprepCache *fpCache = 0, QuantUnknownSetupCache *setupCache = 0,
+        const std::function <void ( int )> &done = nullptr );
+
+//  Anderson mixing of the fit iteration updates (-A option), number of previous iterations used (0 is off)
+//      Default from QUANT_ANDERSON_MIXING and QUANT_ANDERSON_DEPTH in XRFcontrols.h
+void quantAndersonMixing( const int depth );
+int quantAndersonMixing();
 
 #endif
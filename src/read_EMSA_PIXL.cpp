@@ -33,7 +33,10 @@
 #include <iomanip>
 #include <sstream>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <limits>
+#include <algorithm>
 #include "read_EMSA_PIXL.h"
 #include "XRFconditions.h"
 #include "parse_records.h"
@@ -103,29 +106,72 @@
 //                          add optic_file_name and tube_file_name to get_EMSA_keyword for error messages
 //  Modified Dec. 4, 2020   fix minor bug in removing CR from end of lines
 //  Modified June 9, 2021   Write geometry factor if it is non-zero
+//  Modified Oct. 16, 2026  Read the whole file into memory and find lines and values in place (no string copies or stream for each value)
+//                          Look up keywords in a sorted table and use a switch instead of checking each one in turn
+//                          Values are converted exactly as before (same characters accepted, same float result)
+//                          Keyword, units, and type name tables are const statics initialized once (safe when standards are read in parallel)
 
 	using namespace std;
 
 //	Utility functions at end of this file
-void parseEMSAkeyword( const string strIn, const string delim, string &sKeyword, vector <string> &sValue );
 int parse_EMSA_description( const int index, const string &s );
 
+//  The file is read into memory in one piece and each line and value is found in place, without copying
+//  A piece of the file buffer (not zero terminated)
+struct EMSASpan {
+    const char *begin;
+    const char *end;
+    int length() const { return end - begin; };
+    bool equals( const char *s ) const { return strlen( s ) == length() && memcmp( begin, s, length() ) == 0; };
+    string str() const { return string( begin, end ); };
+};
+
+//  Keywords handled individually below, the conditions array keywords use their index
+enum EMSAKeywordID {
+    EMSA_UNKNOWN_KEYWORD = -1,
+    EMSA_FORMAT = XRF_PARAMETER_LAST, EMSA_VERSION, EMSA_SIGNALTYPE, EMSA_DATATYPE, EMSA_COMMENT, EMSA_TITLE,
+    EMSA_DATE, EMSA_TIME, EMSA_OWNER, EMSA_NPOINTS, EMSA_NCOLUMNS, EMSA_XUNITS, EMSA_YUNITS, EMSA_XLABEL, EMSA_YLABEL,
+    EMSA_OPTICFILE, EMSA_ANODE, EMSA_TUBEFILE, EMSA_XPERCHAN, EMSA_OFFSET, EMSA_LIVETIME, EMSA_REALTIME,
+    EMSA_TRIGGERS, EMSA_EVENTS, EMSA_OVERFLOWS, EMSA_UNDERFLOWS, EMSA_BASE_EVENTS, EMSA_RESETS, EMSA_OVER_ADCMAX,
+    EMSA_XPOSITION, EMSA_YPOSITION, EMSA_ZPOSITION, EMSA_IPOSITION, EMSA_JPOSITION, EMSA_RTT, EMSA_PMC,
+    EMSA_DETECTOR_ID, EMSA_SPECTRUM
+};
+
+bool EMSA_getline( const char *&position, const char *file_end, EMSASpan &line );
+void EMSA_records( const char *p, const char *end, vector <EMSASpan> &records );
+void EMSA_upper_trim( const EMSASpan &s, string &out );
+bool EMSA_float( const EMSASpan &s, float &value );
+int EMSA_keyword_id( const string &keyword );
+
 int read_EMSA_PIXL ( const std::string spectrumFileName, XRFconditionsInput &conditionsStructEMSA,
 				std::vector <XraySpectrum> &spectrum_vector ) {
 
 //  Initialize output conditions structure
     conditionsStructEMSA.conditionsVector.resize( XRF_PARAMETER_LAST, 0 );
 
-//		Open input file
+//		Open input file and read all of it
 
-	ifstream inputFile(spectrumFileName.c_str(), ios::in);
+	ifstream inputFile(spectrumFileName.c_str(), ios::in | ios::binary);
 	if ( !inputFile ) {
 		return -1;
 	};
+	vector <char> file_buffer;
+	inputFile.seekg( 0, ios::end );
+	streamoff file_size = inputFile.tellg();
+	inputFile.seekg( 0, ios::beg );
+	if( file_size > 0 ) {
+        file_buffer.resize( file_size );
+        inputFile.read( file_buffer.data(), file_size );
+        file_buffer.resize( inputFile.gcount() );
+	}
+	inputFile.close();
+	const char *position = file_buffer.data();
+	const char *file_end = position + file_buffer.size();
 
-//		Read line from file, interpret data, and place in arguments
+//		Get each line from the buffer, interpret data, and place in arguments
 
-    string strRead, sKeyword;
+    string sKeyword;
+    string sUpper;
 	int numChannels = 0;
     bool bNumChanFound;
     bNumChanFound = false;
@@ -140,77 +186,109 @@ int read_EMSA_PIXL ( const std::string spectrumFileName, XRFconditionsInput &con
 	Spec_Aux_Info spec_info_hold;
 	bool livetime_XIA = false;
 	int triggers_line = -1;
+	vector <EMSASpan> sValue;
 
-	while ( !( !inputFile ) ) {
+	while ( true ) {
 
         //Process required EMSA keywords and check file format
-		getline( inputFile, strRead );
+        EMSASpan strRead;
+		bool line_found = EMSA_getline( position, file_end, strRead );
 		line_number++;
-		if ( !inputFile ) {
+		if ( !line_found ) {
             break;
 		}
-		vector <string> sValue;
 		//  Get rid of trailing CR if file is Windows line endings on Linux or Mac
-		if( strRead.length() > 0 && (int) (strRead.data()[strRead.length()-1]) == 13 ) strRead.erase( strRead.length()-1,1);
-		parseEMSAkeyword(strRead, ":", sKeyword, sValue);
-        sKeyword = upper_trim(sKeyword);
+		if( strRead.length() > 0 && (int) (strRead.end[-1]) == 13 ) strRead.end--;
+		//  Keyword is up to the colon, values are separated by commas or blanks after it
+		EMSASpan keyword = strRead;
+		sValue.clear();
+		const char *colon = (const char *) memchr( strRead.begin, ':', strRead.length() );
+		if( colon ) {
+            keyword.end = colon;
+            EMSA_records( colon + 1, strRead.end, sValue );
+		}
+        EMSA_upper_trim( keyword, sKeyword );
 //			work-around for early typographical error in spectrum save
 		if( sKeyword == "SOLID_ANLGE" ) sKeyword = "SOLID_ANGLE";
-//		cout << strRead << "   keyword '" << sKeyword << "'  " << (sValue.size()>0?sValue[0]:" ") << endl;
-		if (sKeyword == "#FORMAT") {
-            if ( sValue.size()<=3 || sValue[0] != "EMSA/MAS" || sValue[1] != "spectral" || sValue[2] != "data" || sValue[3] != "file" ) {
+		const int keyword_id = EMSA_keyword_id( sKeyword );
+		switch( keyword_id ) {
+        case EMSA_FORMAT:
+            if ( sValue.size()<=3 || ! sValue[0].equals( "EMSA/MAS" ) || ! sValue[1].equals( "spectral" ) || ! sValue[2].equals( "data" ) || ! sValue[3].equals( "file" ) ) {
                 return -line_number;
             };
-        } else if (sKeyword == "#VERSION") {
-            if ( sValue.size()<=1 || sValue[0] != "TC202v2.0" || sValue[1] != "PIXL" ) {
+            break;
+        case EMSA_VERSION:
+            if ( sValue.size()<=1 || ! sValue[0].equals( "TC202v2.0" ) || ! sValue[1].equals( "PIXL" ) ) {
                 return -line_number;
             };
+            break;
 //	Need to check for PIXL, return -6                                *****
-       } else if (sKeyword == "#SIGNALTYPE") {
-            if ( sValue.size()<=0 || upper_trim(sValue[0]) != "XRF" ) {
+        case EMSA_SIGNALTYPE:
+            if ( sValue.size()<=0 ) return -line_number;
+            EMSA_upper_trim( sValue[0], sUpper );
+            if ( sUpper != "XRF" ) {
                 return -line_number;
             };
-       } else if (sKeyword == "#DATATYPE") {
-            if ( sValue.size()<=0 || ( upper_trim(sValue[0]) != "Y" && upper_trim(sValue[0]) != "YY" ) ) {
+            break;
+        case EMSA_DATATYPE:
+            if ( sValue.size()<=0 ) return -line_number;
+            EMSA_upper_trim( sValue[0], sUpper );
+            if ( sUpper != "Y" && sUpper != "YY" ) {
                 return -line_number;
             };
-       } else if (sKeyword == "#COMMENT") {
+            break;
+        case EMSA_COMMENT:
         	 if( sValue.size()>0) {
                 int k;
                 string temp_str;
-                for(k=0; k<sValue.size(); k++ ) temp_str += sValue[k] + BLANK_CHARACTER;
+                for(k=0; k<sValue.size(); k++ ) {
+                    temp_str.append( sValue[k].begin, sValue[k].end );
+                    temp_str += BLANK_CHARACTER;
+                }
                 spec_info_hold.comments.push_back( temp_str );
             }
+            break;
 
 //	Handle text keywords with returned strings
 
-        } else if (sKeyword == "#TITLE") {
+        case EMSA_TITLE:
         	 if( sValue.size()>0) {
                 int k;
                 string temp_str;
-                for(k=0; k<sValue.size(); k++ ) temp_str += sValue[k] + BLANK_CHARACTER;
+                for(k=0; k<sValue.size(); k++ ) {
+                    temp_str.append( sValue[k].begin, sValue[k].end );
+                    temp_str += BLANK_CHARACTER;
+                }
                 spec_info_hold.titles.push_back( temp_str );
             }
-        } else if (sKeyword == "#DATE") {
-            if(sValue.size()>0) spec_info_hold.date = sValue[0];
-        } else if (sKeyword == "#TIME") {
-            if(sValue.size()>0) spec_info_hold.time = sValue[0];
-        } else if (sKeyword == "#OWNER") {
+            break;
+        case EMSA_DATE:
+            if(sValue.size()>0) spec_info_hold.date = sValue[0].str();
+            break;
+        case EMSA_TIME:
+            if(sValue.size()>0) spec_info_hold.time = sValue[0].str();
+            break;
+        case EMSA_OWNER:
             spec_info_hold.owner.clear();
             if( sValue.size()>0) {	// Only keep first title
                 int k;
-                for(k=0; k<sValue.size(); k++ ) spec_info_hold.owner += sValue[k] + BLANK_CHARACTER;
+                for(k=0; k<sValue.size(); k++ ) {
+                    spec_info_hold.owner.append( sValue[k].begin, sValue[k].end );
+                    spec_info_hold.owner += BLANK_CHARACTER;
+                }
             }
-        } else if (sKeyword == "#NPOINTS") {
+            break;
+        case EMSA_NPOINTS:
             if(sValue.size()>0) {
-                istringstream val( sValue[0] );
+                istringstream val( sValue[0].str() );
                 val >> numChannels;
                 if( !val || numChannels < 0 ) return -line_number;
                 bNumChanFound = true;
             }
-        } else if (sKeyword == "#NCOLUMNS") {
+            break;
+        case EMSA_NCOLUMNS:
             if(sValue.size()>0) {
-                istringstream val( sValue[0] );
+                istringstream val( sValue[0].str() );
                 val >> numColumns;
                 if( numColumns<1 || numColumns>2 ) {
                     return -line_number;
@@ -221,54 +299,61 @@ int read_EMSA_PIXL ( const std::string spectrumFileName, XRFconditionsInput &con
                     spectrum_hold_vec.resize(numColumns);
                 }
             }
-        } else if (sKeyword == "#XUNITS") {
+            break;
+        case EMSA_XUNITS:
             if ( sValue.size()<=0 ) return -line_number;
-            if( upper_trim(sValue[0]) == "EV" ) {
+            EMSA_upper_trim( sValue[0], sUpper );
+            if( sUpper == "EV" ) {
                 kev_units = false;
-            } else if( upper_trim(sValue[0]) == "KEV" ) {
+            } else if( sUpper == "KEV" ) {
                 kev_units = true;
             } else {
                 return -line_number;
             };
             // Don't overwrite label from XLABEL keyword, only use if no label set so far
             //if( spec_x_label.length() == 0 ) spec_x_label = sValue[0];
-        } else if (sKeyword == "#YUNITS") {
-            if (  sValue.size()<=0 || upper_trim(sValue[0]) != "COUNTS") {
+            break;
+        case EMSA_YUNITS:
+            if ( sValue.size()<=0 ) return -line_number;
+            EMSA_upper_trim( sValue[0], sUpper );
+            if ( sUpper != "COUNTS") {
                 return -line_number;
             };
             // Don't overwrite label from YLABEL keyword, only use if no label set so far
             //if( spec_y_label.length() == 0 ) spec_y_label = sValue[0];
-        } else if (sKeyword == "#XLABEL") {
+            break;
+        case EMSA_XLABEL:
             //if(sValue.size()>0) spec_x_label = sValue[0];
-            continue;
-        } else if (sKeyword == "#YLABEL") {
+            break;
+        case EMSA_YLABEL:
             //if(sValue.size()>0) spec_y_label = sValue[0];
-            continue;
-        } else if (sKeyword == "##OPTICFILE") {
+            break;
+        case EMSA_OPTICFILE:
             if(sValue.size()>0) {
-                istringstream val( sValue[0] );
+                istringstream val( sValue[0].str() );
                 int temp;
                 val>> temp;
                 if( !val ) {
                     //  If optic file is not a number, set optic type in conditions array
-                    conditionsStructEMSA.optic_file_name = sValue[0];
+                    conditionsStructEMSA.optic_file_name = sValue[0].str();
                     conditionsStructEMSA.conditionsVector[TEST_OPTIC_TYPE_INDEX] = 4;
                 } else {
                     //  If optic file is a number, set optic type in conditions array
                     conditionsStructEMSA.conditionsVector[TEST_OPTIC_TYPE_INDEX] = temp;
                 }
             }
-        } else if (sKeyword == "##ANODE") {
+            break;
+        case EMSA_ANODE:
             if(sValue.size()>0) {
-                istringstream val( sValue[0] );
+                istringstream val( sValue[0].str() );
                 int temp;
                 val>> temp;
                 if( !val ) {
                     //  If anode file is not a number, put the entire string in conditions structure for later parsing
-                    string anode_str = sValue[0];
+                    string anode_str = sValue[0].str();
                     if( sValue.size() > 1 ) {
                         unsigned int jj;
-                        for( jj=1; jj<sValue.size(); jj++ ) anode_str += "," + sValue[jj];
+                        for( jj=1; jj<sValue.size(); jj++ ) anode_str += "," + sValue[jj].str();
                     }
                     conditionsStructEMSA.anode_element_list = anode_str;
                     conditionsStructEMSA.conditionsVector[ANODE_Z_INDEX] = 0;
@@ -277,240 +362,224 @@ int read_EMSA_PIXL ( const std::string spectrumFileName, XRFconditionsInput &con
                     conditionsStructEMSA.conditionsVector[ANODE_Z_INDEX] = temp;
                 }
             }
-        } else if (sKeyword == "##TUBEFILE") {
+            break;
+        case EMSA_TUBEFILE:
             if(sValue.size()>0) {
-                    conditionsStructEMSA.tube_file_name = sValue[0];
+                    conditionsStructEMSA.tube_file_name = sValue[0].str();
             }
+            break;
 
 //	Handle values that are returned as arguments (not in conditions array)
 
 //	Need to handle multiple live times and energy calibrations                                *****
-        } else if (sKeyword == "#XPERCHAN") {
+        case EMSA_XPERCHAN:
             if(sValue.size()>=numColumns) {
                 int k;
                 for( k=0; k<numColumns; k++) {
-                    istringstream val( sValue[k] );
-                    float temp;
-                    val >> temp;
-                    if( !val || temp <= 0 ) return -line_number;
+                    float temp = 0;
+                    if( ! EMSA_float( sValue[k], temp ) || temp <= 0 ) return -line_number;
                     ev_ch[k] = temp;
                 }
             } else {
                 return -line_number;
             }
-        } else if (sKeyword == "#OFFSET") {
+            break;
+        case EMSA_OFFSET:
             if(sValue.size()>=numColumns) {
                 int k;
                 for( k=0; k<numColumns; k++) {
-                    istringstream val( sValue[k] );
-                    float temp;
-                    val >> temp;
-                    if( !val ) return -line_number;
+                    float temp = 0;
+                    if( ! EMSA_float( sValue[k], temp ) ) return -line_number;
                     ev_start[k] = temp;
                 }
             } else {
                 return -line_number;
             }
-        } else if (sKeyword == "#LIVETIME") {
+            break;
+        case EMSA_LIVETIME:
             if(sValue.size()>=numColumns) {
                 int k;
                 for( k=0; k<numColumns; k++) {
-                    istringstream val( sValue[k] );
-                    float temp;
-                    val >> temp;
-                    if( !val || temp < 0 ) return -line_number;
+                    float temp = 0;
+                    if( ! EMSA_float( sValue[k], temp ) || temp < 0 ) return -line_number;
                     spectrum_vector[k].live_time( temp );
                 }
             } else {
                 return -line_number;
             }
-        } else if (sKeyword == "#REALTIME") {
+            break;
+        case EMSA_REALTIME:
             if(sValue.size()>=numColumns) {
                 int k;
                 for( k=0; k<numColumns; k++) {
-                    istringstream val( sValue[k] );
-                    float temp;
-                    val >> temp;
-                    if( !val || temp < 0 ) return -line_number;
+                    float temp = 0;
+                    if( ! EMSA_float( sValue[k], temp ) || temp < 0 ) return -line_number;
                     spectrum_vector[k].real_time( temp );
                 }
             } else {
                 return -line_number;
             }
-        } else if (sKeyword == "##TRIGGERS") {
+            break;
+        case EMSA_TRIGGERS:
             triggers_line = line_number;
             livetime_XIA = true;
             if(sValue.size()>=numColumns) {
                 int k;
                 for( k=0; k<numColumns; k++) {
-                    istringstream val( sValue[k] );
-                    float temp;
-                    val >> temp;
-                    if( !val || temp < 0 ) return -line_number;
+                    float temp = 0;
+                    if( ! EMSA_float( sValue[k], temp ) || temp < 0 ) return -line_number;
                     spectrum_vector[k].header_info_change().triggers = temp;
                 }
             } else {
                 return -line_number;
             }
-        } else if (sKeyword == "##EVENTS") {
+            break;
+        case EMSA_EVENTS:
             if(sValue.size()>=numColumns) {
                 int k;
                 for( k=0; k<numColumns; k++) {
-                    istringstream val( sValue[k] );
-                    float temp;
-                    val >> temp;
-                    if( !val || temp < 0 ) return -line_number;
+                    float temp = 0;
+                    if( ! EMSA_float( sValue[k], temp ) || temp < 0 ) return -line_number;
                     spectrum_vector[k].header_info_change().events = temp;
                 }
             } else {
                 return -line_number;
             }
-        } else if (sKeyword == "##OVERFLOWS") {
+            break;
+        case EMSA_OVERFLOWS:
             if(sValue.size()>=numColumns) {
                 int k;
                 for( k=0; k<numColumns; k++) {
-                    istringstream val( sValue[k] );
-                    float temp;
-                    val >> temp;
-                    if( !val || temp < 0 ) return -line_number;
+                    float temp = 0;
+                    if( ! EMSA_float( sValue[k], temp ) || temp < 0 ) return -line_number;
                     spectrum_vector[k].header_info_change().overflows = temp;
                 }
             } else {
                 return -line_number;
             }
-        } else if (sKeyword == "##UNDERFLOWS") {
+            break;
+        case EMSA_UNDERFLOWS:
             if(sValue.size()>=numColumns) {
                 int k;
                 for( k=0; k<numColumns; k++) {
-                    istringstream val( sValue[k] );
-                    float temp;
-                    val >> temp;
-                    if( !val || temp < 0 ) return -line_number;
+                    float temp = 0;
+                    if( ! EMSA_float( sValue[k], temp ) || temp < 0 ) return -line_number;
                     spectrum_vector[k].header_info_change().underflows = temp;
                 }
             } else {
                 return -line_number;
             }
-        } else if (sKeyword == "##BASE_EVENTS") {
+            break;
+        case EMSA_BASE_EVENTS:
             if(sValue.size()>=numColumns) {
                 int k;
                 for( k=0; k<numColumns; k++) {
-                    istringstream val( sValue[k] );
-                    float temp;
-                    val >> temp;
-                    if( !val || temp < 0 ) return -line_number;
+                    float temp = 0;
+                    if( ! EMSA_float( sValue[k], temp ) || temp < 0 ) return -line_number;
                     spectrum_vector[k].header_info_change().baseline_samples = temp;
                 }
             } else {
                 return -line_number;
             }
-        } else if (sKeyword == "##RESETS") {
+            break;
+        case EMSA_RESETS:
             if(sValue.size()>=numColumns) {
                 int k;
                 for( k=0; k<numColumns; k++) {
-                    istringstream val( sValue[k] );
-                    float temp;
-                    val >> temp;
-                    if( !val || temp < 0 ) return -line_number;
+                    float temp = 0;
+                    if( ! EMSA_float( sValue[k], temp ) || temp < 0 ) return -line_number;
                     spectrum_vector[k].header_info_change().preamp_resets = temp;
                 }
             } else {
                 return -line_number;
             }
-        } else if (sKeyword == "##OVER_ADCMAX") {
+            break;
+        case EMSA_OVER_ADCMAX:
             if(sValue.size()>=numColumns) {
                 int k;
                 for( k=0; k<numColumns; k++) {
-                    istringstream val( sValue[k] );
-                    float temp;
-                    val >> temp;
-                    if( !val || temp < 0 ) return -line_number;
+                    float temp = 0;
+                    if( ! EMSA_float( sValue[k], temp ) || temp < 0 ) return -line_number;
                     spectrum_vector[k].header_info_change().saturates = temp;
                 }
             } else {
                 return -line_number;
             }
-        } else if (sKeyword == "#XPOSITION") {
+            break;
+        case EMSA_XPOSITION:
             if(sValue.size()>0) {
-                istringstream val( sValue[0] );
-                float temp;
-                val >> temp;
+                float temp = 0;
+                EMSA_float( sValue[0], temp );
                 spec_info_hold.x = temp;
             }
-        } else if (sKeyword == "#YPOSITION") {
+            break;
+        case EMSA_YPOSITION:
             if(sValue.size()>0) {
-                istringstream val( sValue[0] );
-                float temp;
-                val >> temp;
+                float temp = 0;
+                EMSA_float( sValue[0], temp );
                 spec_info_hold.y = temp;
             }
-        } else if (sKeyword == "#ZPOSITION") {
+            break;
+        case EMSA_ZPOSITION:
             if(sValue.size()>0) {
-                istringstream val( sValue[0] );
-                float temp;
-                val >> temp;
+                float temp = 0;
+                EMSA_float( sValue[0], temp );
                 spec_info_hold.z = temp;
             }
-        } else if (sKeyword == "##IPOSITION") {
+            break;
+        case EMSA_IPOSITION:
             if(sValue.size()>0) {
-                istringstream val( sValue[0] );
-                float temp;
-                val >> temp;
+                float temp = 0;
+                EMSA_float( sValue[0], temp );
                 spec_info_hold.i = temp;
             }
-        } else if (sKeyword == "##JPOSITION") {
+            break;
+        case EMSA_JPOSITION:
             if(sValue.size()>0) {
-                istringstream val( sValue[0] );
-                float temp;
-                val >> temp;
+                float temp = 0;
+                EMSA_float( sValue[0], temp );
                 spec_info_hold.j = temp;
             }
-        } else if (sKeyword == "##RTT") {
+            break;
+        case EMSA_RTT:
             if(sValue.size()>0) {
-                istringstream val( sValue[0] );
-                float temp;
-                val >> temp;
+                float temp = 0;
+                EMSA_float( sValue[0], temp );
                 spec_info_hold.rtt = temp;
             }
-        } else if (sKeyword == "##PMC") {
+            break;
+        case EMSA_PMC:
             if(sValue.size()>0) {
-                istringstream val( sValue[0] );
-                float temp;
-                val >> temp;
+                float temp = 0;
+                EMSA_float( sValue[0], temp );
                 spec_info_hold.pmc = temp;
             }
-        } else if (sKeyword == "##DETECTOR_ID") {
+            break;
+        case EMSA_DETECTOR_ID:
             if(sValue.size()>0) {
-                spec_info_hold.det_ID = sValue[0];
+                spec_info_hold.det_ID = sValue[0].str();
             }
-        } else if (sKeyword == "#SPECTRUM") {
             break;
-        } else {
+        case EMSA_UNKNOWN_KEYWORD:
+            break;
+        default:
 
-//		Process values returned in conditions array
+//		Process values returned in conditions array (keyword_id is the index)
 
-            int i;
-            for( i=0; i<XRF_PARAMETER_LAST; i++ ) {
-                if( i == TEST_OPTIC_TYPE_INDEX ) continue;  //  handled above since it might be a file name
-                if( i == ANODE_Z_INDEX ) continue;  //  handled above since it might be an element list
-                string upper_test = upper_trim( get_EMSA_keyword(i) );
-                if (sKeyword == upper_test) {
-                    if(sValue.size()>0) {
-                        istringstream val( sValue[0] );
-                        val >> conditionsStructEMSA.conditionsVector[i];  //  This will automatically handle if it is a number
-                        if( ! val ) {
-                            conditionsStructEMSA.conditionsVector[i] = parse_EMSA_description( i, sValue[0] );
-                            //  These are always non-negative integers since they encode items from a list
-                            if( conditionsStructEMSA.conditionsVector[i] < 0 ) return -line_number;
-                        }
-                        if( i == TUBE_CURRENT_INDEX ) conditionsStructEMSA.conditionsVector[i] /= 1000;   //  convert from microAmps to milliAmps
-                    }
-                    break;
-                };
-            };
+            if(sValue.size()>0) {
+                const int i = keyword_id;
+                if( ! EMSA_float( sValue[0], conditionsStructEMSA.conditionsVector[i] ) ) {   //  This will automatically handle if it is a number
+                    conditionsStructEMSA.conditionsVector[i] = parse_EMSA_description( i, sValue[0].str() );
+                    //  These are always non-negative integers since they encode items from a list
+                    if( conditionsStructEMSA.conditionsVector[i] < 0 ) return -line_number;
+                }
+                if( i == TUBE_CURRENT_INDEX ) conditionsStructEMSA.conditionsVector[i] /= 1000;   //  convert from microAmps to milliAmps
+            }
+            break;
         };
+        if( keyword_id == EMSA_SPECTRUM ) break;
 
-	};  //  End while !( !inputFile )
+	};  //  End while reading keywords
 
 //    int ic;
 //    for( ic = 0; ic < XRF_PARAMETER_LAST; ic++ ) {
@@ -548,19 +617,15 @@ int read_EMSA_PIXL ( const std::string spectrumFileName, XRFconditionsInput &con
 	if( numChannels <= 0 ) return 0; // Done if no spectrum data
 	int i;
 	for( i=0; i<numChannels; i++ ) {
-		string data_line;
-		vector <string> sValue;
-		getline( inputFile, data_line );
+		EMSASpan data_line;
+		bool line_found = EMSA_getline( position, file_end, data_line );
 		line_number++;
-		//cout << "data_line " << data_line << endl;
-		if ( !inputFile ) {
+		if ( !line_found ) {
             return -line_number;
 		}
-//        parseCommas( data_line, sValue );
-        string delim( COMMA_CHARACTER );
-        delim += BLANK_CHARACTER;
-        parse_records( delim, data_line, sValue );
-		if ( sValue.size() <= 0 || sValue[0] == "#ENDOFDATA" ) {
+		//  Values are separated by commas or blanks (trailing CR is left on the last one and ignored when it is converted)
+        EMSA_records( data_line.begin, data_line.end, sValue );
+		if ( sValue.size() <= 0 || sValue[0].equals( "#ENDOFDATA" ) ) {
             return -line_number;
 		}
         if( sValue.size() < numColumns ) {
@@ -571,10 +636,9 @@ int read_EMSA_PIXL ( const std::string spectrumFileName, XRFconditionsInput &con
             k_prime++;
             //  Skip empty records (caused by commas, tabs, and blanks together in data)
             if( sValue[k_prime].length() <= 0 && sValue.size() > k_prime + 1 ) k_prime++;
-            istringstream val( sValue[k_prime] );
-            float temp;
-            val >> temp;
-            if( !val ) return -line_number;
+            if( k_prime >= sValue.size() ) return -line_number;
+            float temp = 0;
+            if( ! EMSA_float( sValue[k_prime], temp ) ) return -line_number;
             spectrum_hold_vec[k][i] = temp;
 		}
 	};
@@ -674,39 +738,42 @@ int write_EMSA_PIXL ( const XraySpectrum &spectrum,
 const string get_EMSA_keyword( const int index ) {
 // TODO: get rid of statics!!!
     //		set up keywords for conditions array using EMSA keywords and user-defined keywords
-    static vector <string> paramName( XRF_PARAMETER_LAST );
-    paramName[ANODE_Z_INDEX] = "##ANODE";
-    paramName[KV_INDEX] = "#BEAMKV";
-    paramName[TUBE_INC_ANGLE_INDEX] = "##TUBEINCANG";
-    paramName[TUBE_TAKEOFF_ANGLE_INDEX] = "##TUBETAKEOF";
-    paramName[TUBE_BE_WINDOW_INDEX] = "##TUBEWINDOW";
-    paramName[TUBE_CURRENT_INDEX] = "#EMISSION";
-    paramName[FILTER_Z_INDEX] = "##FILTERZ";
-    paramName[FILTER_THICK_INDEX] = "##FILTERTH";
-    paramName[EXCIT_ANGLE_INDEX] = "##INCANGLE";
-    paramName[EMERG_ANGLE_INDEX] = "#ELEVANGLE";
-    paramName[AZIMUTH_ANGLE_INDEX] = "#AZIMANGLE";
-    paramName[XTILT_ANGLE_INDEX] = "#XTILTSTGE";
-    paramName[YTILT_ANGLE_INDEX] = "#YTILTSTGE";
-    paramName[X_POSITION_INDEX] = "#XPOSITION";
-    paramName[Y_POSITION_INDEX] = "#YPOSITION";
-    paramName[Z_POSITION_INDEX] = "#ZPOSITION";
-    paramName[SOURCE_SOLID_ANGLE_INDEX] = "##INCSR";
-    paramName[DET_SOLID_ANGLE_INDEX] = "#SOLIDANGLE";
-    paramName[GEOMETRY_INDEX] = "##GEOMETRY";
-    paramName[PATH_TYPE_INDEX] = "##ATMOSPHERE";
-    paramName[INC_PATH_LENGTH_INDEX] = "##PATHINCLEN";
-    paramName[EMERG_PATH_LENGTH_INDEX] = "##PATHEMGLEN";
-    paramName[WINDOW_TYPE_INDEX] = "##WINDOWTYPE";
-    paramName[WINDOW_THICK_INDEX] = "##WINDOWTH";
-    paramName[DETECTOR_TYPE_INDEX] = "#EDSDET";
-    paramName[DET_RESOLUTION_INDEX] = "##DETRES";
-    paramName[DET_BE_WINDOW_INDEX] = "#TBEWIND";
-    paramName[DET_ACTIVE_THICK_INDEX] = "#TACTLYR";
-    paramName[TEST_OPTIC_TYPE_INDEX] = "##OPTICFILE";
-    paramName[MINIMUM_ENERGY_INDEX] = "##MINIMUM_EN"; //   So that default values can be set if needed (kept for compatibility)
-    paramName[ENERGY_CORRECTION_SLOPE_INDEX] = "##DL_SLOPE"; //  Modified July 31, 2018 to add linear energy calibration correction
-    paramName[ENERGY_CORRECTION_OFFSET_INDEX] = "##DL_OFFSET";
+    static const vector <string> paramName = [] {
+        vector <string> paramName( XRF_PARAMETER_LAST );
+        paramName[ANODE_Z_INDEX] = "##ANODE";
+        paramName[KV_INDEX] = "#BEAMKV";
+        paramName[TUBE_INC_ANGLE_INDEX] = "##TUBEINCANG";
+        paramName[TUBE_TAKEOFF_ANGLE_INDEX] = "##TUBETAKEOF";
+        paramName[TUBE_BE_WINDOW_INDEX] = "##TUBEWINDOW";
+        paramName[TUBE_CURRENT_INDEX] = "#EMISSION";
+        paramName[FILTER_Z_INDEX] = "##FILTERZ";
+        paramName[FILTER_THICK_INDEX] = "##FILTERTH";
+        paramName[EXCIT_ANGLE_INDEX] = "##INCANGLE";
+        paramName[EMERG_ANGLE_INDEX] = "#ELEVANGLE";
+        paramName[AZIMUTH_ANGLE_INDEX] = "#AZIMANGLE";
+        paramName[XTILT_ANGLE_INDEX] = "#XTILTSTGE";
+        paramName[YTILT_ANGLE_INDEX] = "#YTILTSTGE";
+        paramName[X_POSITION_INDEX] = "#XPOSITION";
+        paramName[Y_POSITION_INDEX] = "#YPOSITION";
+        paramName[Z_POSITION_INDEX] = "#ZPOSITION";
+        paramName[SOURCE_SOLID_ANGLE_INDEX] = "##INCSR";
+        paramName[DET_SOLID_ANGLE_INDEX] = "#SOLIDANGLE";
+        paramName[GEOMETRY_INDEX] = "##GEOMETRY";
+        paramName[PATH_TYPE_INDEX] = "##ATMOSPHERE";
+        paramName[INC_PATH_LENGTH_INDEX] = "##PATHINCLEN";
+        paramName[EMERG_PATH_LENGTH_INDEX] = "##PATHEMGLEN";
+        paramName[WINDOW_TYPE_INDEX] = "##WINDOWTYPE";
+        paramName[WINDOW_THICK_INDEX] = "##WINDOWTH";
+        paramName[DETECTOR_TYPE_INDEX] = "#EDSDET";
+        paramName[DET_RESOLUTION_INDEX] = "##DETRES";
+        paramName[DET_BE_WINDOW_INDEX] = "#TBEWIND";
+        paramName[DET_ACTIVE_THICK_INDEX] = "#TACTLYR";
+        paramName[TEST_OPTIC_TYPE_INDEX] = "##OPTICFILE";
+        paramName[MINIMUM_ENERGY_INDEX] = "##MINIMUM_EN"; //   So that default values can be set if needed (kept for compatibility)
+        paramName[ENERGY_CORRECTION_SLOPE_INDEX] = "##DL_SLOPE"; //  Modified July 31, 2018 to add linear energy calibration correction
+        paramName[ENERGY_CORRECTION_OFFSET_INDEX] = "##DL_OFFSET";
+        return paramName;
+    }();
     string Optic_file_name("Optic file name");
     string Xray_tube_file_name("X-ray tube file name");
 
@@ -721,42 +788,45 @@ const string get_EMSA_keyword( const int index ) {
 const string get_EMSA_units( const int index, const int value ) {
 // TODO: get rid of statics!!!
     //		return units for each conditions parameter read using an EMSA keyword (or user keyword)
-    static vector <string> units_msa( XRF_PARAMETER_LAST );
-    units_msa[ANODE_Z_INDEX] = "(Z)";
-    units_msa[KV_INDEX] = "kV";
-    units_msa[TUBE_INC_ANGLE_INDEX] = "deg";
-    units_msa[TUBE_TAKEOFF_ANGLE_INDEX] = "deg";
-    units_msa[TUBE_BE_WINDOW_INDEX] = "mm";
-    units_msa[TUBE_CURRENT_INDEX] = "mA";
-    units_msa[FILTER_Z_INDEX] = "(Z)";
-    units_msa[FILTER_THICK_INDEX] = "micron";
-    units_msa[EXCIT_ANGLE_INDEX] = "deg";
-    units_msa[EMERG_ANGLE_INDEX] = "deg";
-    units_msa[AZIMUTH_ANGLE_INDEX] = "deg";
-    units_msa[XTILT_ANGLE_INDEX] = "deg";
-    units_msa[YTILT_ANGLE_INDEX] = "deg";
-    units_msa[X_POSITION_INDEX] = "mm";
-    units_msa[Y_POSITION_INDEX] = "mm";
-    units_msa[Z_POSITION_INDEX] = "mm";
-    units_msa[SOURCE_SOLID_ANGLE_INDEX] = "sr";
-    units_msa[DET_SOLID_ANGLE_INDEX] = "sr";
-    units_msa[GEOMETRY_INDEX] = "";
-    units_msa[PATH_TYPE_INDEX] = "";
-    units_msa[INC_PATH_LENGTH_INDEX] = "cm";
-    units_msa[EMERG_PATH_LENGTH_INDEX] = "cm";
-    units_msa[WINDOW_TYPE_INDEX] = "";
-    units_msa[WINDOW_THICK_INDEX] = "micron";
-    units_msa[DETECTOR_TYPE_INDEX] = "";
-    units_msa[DET_RESOLUTION_INDEX] = "eV";
-    units_msa[DET_BE_WINDOW_INDEX] = "micron";
-    units_msa[DET_ACTIVE_THICK_INDEX] = "mm";
-    units_msa[TEST_OPTIC_TYPE_INDEX] = "";
-    units_msa[MINIMUM_ENERGY_INDEX] = "eV"; //   So that default values can be set if needed (kept for compatibility)
-    units_msa[ENERGY_CORRECTION_SLOPE_INDEX] = "eV/keV"; //  Modified July 31, 2018 to add linear energy calibration correction
-    units_msa[ENERGY_CORRECTION_OFFSET_INDEX] = "eV";
-
-    static string bad_value( "bad" );
-    static string none_value( "none" );
+    static const vector <string> units_msa = [] {
+        vector <string> units_msa( XRF_PARAMETER_LAST );
+        units_msa[ANODE_Z_INDEX] = "(Z)";
+        units_msa[KV_INDEX] = "kV";
+        units_msa[TUBE_INC_ANGLE_INDEX] = "deg";
+        units_msa[TUBE_TAKEOFF_ANGLE_INDEX] = "deg";
+        units_msa[TUBE_BE_WINDOW_INDEX] = "mm";
+        units_msa[TUBE_CURRENT_INDEX] = "mA";
+        units_msa[FILTER_Z_INDEX] = "(Z)";
+        units_msa[FILTER_THICK_INDEX] = "micron";
+        units_msa[EXCIT_ANGLE_INDEX] = "deg";
+        units_msa[EMERG_ANGLE_INDEX] = "deg";
+        units_msa[AZIMUTH_ANGLE_INDEX] = "deg";
+        units_msa[XTILT_ANGLE_INDEX] = "deg";
+        units_msa[YTILT_ANGLE_INDEX] = "deg";
+        units_msa[X_POSITION_INDEX] = "mm";
+        units_msa[Y_POSITION_INDEX] = "mm";
+        units_msa[Z_POSITION_INDEX] = "mm";
+        units_msa[SOURCE_SOLID_ANGLE_INDEX] = "sr";
+        units_msa[DET_SOLID_ANGLE_INDEX] = "sr";
+        units_msa[GEOMETRY_INDEX] = "";
+        units_msa[PATH_TYPE_INDEX] = "";
+        units_msa[INC_PATH_LENGTH_INDEX] = "cm";
+        units_msa[EMERG_PATH_LENGTH_INDEX] = "cm";
+        units_msa[WINDOW_TYPE_INDEX] = "";
+        units_msa[WINDOW_THICK_INDEX] = "micron";
+        units_msa[DETECTOR_TYPE_INDEX] = "";
+        units_msa[DET_RESOLUTION_INDEX] = "eV";
+        units_msa[DET_BE_WINDOW_INDEX] = "micron";
+        units_msa[DET_ACTIVE_THICK_INDEX] = "mm";
+        units_msa[TEST_OPTIC_TYPE_INDEX] = "";
+        units_msa[MINIMUM_ENERGY_INDEX] = "eV"; //   So that default values can be set if needed (kept for compatibility)
+        units_msa[ENERGY_CORRECTION_SLOPE_INDEX] = "eV/keV"; //  Modified July 31, 2018 to add linear energy calibration correction
+        units_msa[ENERGY_CORRECTION_OFFSET_INDEX] = "eV";
+        return units_msa;
+    }();
+
+    static const string bad_value( "bad" );
+    static const string none_value( "none" );
 
 //    cout << "get_EMSA_units   " << index << "  " << XRF_PARAMETER_FIRST << "  " << XRF_PARAMETER_LAST << endl;
     if( XRF_PARAMETER_FIRST < index && index < XRF_PARAMETER_LAST ) {
@@ -764,21 +834,27 @@ const string get_EMSA_units( const int index, const int value ) {
             //  Attempt to return more useful text for conditions that are enumerated choices
             if( index == TEST_OPTIC_TYPE_INDEX ) {
                 if( value == 0 ) return none_value;
-                static vector <string> optic_types( 6 );
-                optic_types[1] = "none";
-                optic_types[2] = "boxcar";
-                optic_types[3] = "oldBB";
-                optic_types[4] = "file";
-                optic_types[5] = "newBB";
+                static const vector <string> optic_types = [] {
+                    vector <string> optic_types( 6 );
+                    optic_types[1] = "none";
+                    optic_types[2] = "boxcar";
+                    optic_types[3] = "oldBB";
+                    optic_types[4] = "file";
+                    optic_types[5] = "newBB";
+                    return optic_types;
+                }();
                 if( value > 0 && value < optic_types.size() ) return optic_types[value];
                 return bad_value;
             } else if( index == PATH_TYPE_INDEX ) {
-                static vector <string> atm_types( 5 );
-                atm_types[0] = "vac";
-                atm_types[1] = "He";
-                atm_types[2] = "Mars";
-                atm_types[3] = "HeCO2";
-                atm_types[4] = "air";
+                static const vector <string> atm_types = [] {
+                    vector <string> atm_types( 5 );
+                    atm_types[0] = "vac";
+                    atm_types[1] = "He";
+                    atm_types[2] = "Mars";
+                    atm_types[3] = "HeCO2";
+                    atm_types[4] = "air";
+                    return atm_types;
+                }();
                 XrayAtmosphere atm = (XrayAtmosphere) value;
                 if( atm == VACUUM ) return atm_types[0];
                 else if( atm == HELIUM ) return atm_types[1];
@@ -789,15 +865,18 @@ const string get_EMSA_units( const int index, const int value ) {
             } else if( index == WINDOW_TYPE_INDEX ) {
                 XrayWindowMaterials win = (XrayWindowMaterials) value;
                 if( win == NO_WINDOW ) return none_value;
-                static vector <string> win_types( 9 );
-                win_types[1] = "B4C";
-                win_types[2] = "Plas";
-                win_types[3] = "CFRP";
-                win_types[4] = "Zr";
-                win_types[5] = "Al";
-                win_types[6] = "Nylon";
-                win_types[7] = "Nyl+Zr";
-                win_types[8] = "Al2O3";
+                static const vector <string> win_types = [] {
+                    vector <string> win_types( 9 );
+                    win_types[1] = "B4C";
+                    win_types[2] = "Plas";
+                    win_types[3] = "CFRP";
+                    win_types[4] = "Zr";
+                    win_types[5] = "Al";
+                    win_types[6] = "Nylon";
+                    win_types[7] = "Nyl+Zr";
+                    win_types[8] = "Al2O3";
+                    return win_types;
+                }();
                 if( win == B4C ) return win_types[1];
                 else if( win == PLASTIC ) return win_types[2];
                 else if( win == CFRP ) return win_types[3];
@@ -810,11 +889,14 @@ const string get_EMSA_units( const int index, const int value ) {
             } else if( index == DETECTOR_TYPE_INDEX ) {
                 DetectorType det = (DetectorType) value;
                 if( det == NO_DETECTOR ) return none_value;
-                static vector <string> det_types( 5 );
-                det_types[1] = "SiPIN";
-                det_types[2] = "SDD";
-                det_types[3] = "CdTe";
-                det_types[4] = "HP-Ge";
+                static const vector <string> det_types = [] {
+                    vector <string> det_types( 5 );
+                    det_types[1] = "SiPIN";
+                    det_types[2] = "SDD";
+                    det_types[3] = "CdTe";
+                    det_types[4] = "HP-Ge";
+                    return det_types;
+                }();
                 if( det == SI_PIN ) return det_types[1];
                 else if( det == SI_SDD ) return det_types[2];
                 else if( det == CD_TE ) return det_types[3];
@@ -827,30 +909,10 @@ const string get_EMSA_units( const int index, const int value ) {
             return units_msa[index];
         }
     }
-    static string dummy( "bad index" );
+    static const string dummy( "bad index" );
     return dummy;
 };
 
-void parseEMSAkeyword( const string strIn, const string delim, string &sKeyword, vector <string> &sValue ) {
-// strIn - in, input string
-// del - in, delimiter character
-// sKeyword - out, keyword up to delimiter (not including delimiter)
-// sValue - out, rest of string after delimiter and following blank, if any
-//          entries in the sValue vector are separated by blanks in the input string
-	const int slen = strIn.length();
-	int j;
-	j = strIn.find( delim );
-	if( j >= 0 && j < slen ) {
-		sKeyword = strIn.substr( 0, j );
-        string delim( COMMA_CHARACTER );
-        delim += BLANK_CHARACTER;
-		parse_records( delim, strIn.substr( j + 1, slen ), sValue );
-	} else {
-		sKeyword = strIn.substr( 0, slen );
-	};
-};
-
-
 void parseCommas( const string strIn, vector <string> &sValue ) {
 // strIn - in, input string
 // sValue - out, vector of substrings
@@ -930,3 +992,185 @@ int parse_EMSA_description( const int index, const string &s ) {
     }
 };
 
+
+//  Tokenizer utilities for read_EMSA_PIXL
+//  These work on the file buffer in place, but must give exactly the same values as reading each line
+//  with getline, splitting it with parse_records, and converting each value with istringstream
+
+bool EMSA_getline( const char *&position, const char *file_end, EMSASpan &line ) {
+//  Same lines as getline, false at the end of the file (line does not include the newline)
+    if( position >= file_end ) return false;
+    line.begin = position;
+    const char *newline = (const char *) memchr( position, '\n', file_end - position );
+    if( newline ) {
+        line.end = newline;
+        position = newline + 1;
+    } else {
+        line.end = file_end;
+        position = file_end;
+    }
+    return true;
+};
+
+void EMSA_records( const char *p, const char *end, vector <EMSASpan> &records ) {
+//  Same records as parse_records with comma and blank as delimiters (tabs are also delimiters)
+//  Leading blanks and tabs are skipped, a record in single or double quotes is kept together,
+//  and trailing blanks or a trailing comma give an empty record at the end
+    records.clear();
+    while( p < end ) {
+        bool extra_record = false;
+        while( p < end && ( *p == ' ' || *p == '\t' ) ) p++;
+        EMSASpan record;
+        if( p < end && ( *p == '\'' || *p == '"' ) ) {
+            const char quote = *p;
+            p++;
+            record.begin = p;
+            while( p < end && *p != quote ) p++;
+            record.end = p;
+            if( p < end ) p++;  //  Skip over final quote mark
+            if( p < end ) {
+                //  The next character must be a delimiter, if not parse_records gives up (and this record is lost)
+                if( *p != ',' && *p != ' ' ) return;
+                p++;
+                if( p == end && p[-1] == ',' ) extra_record = true;
+            } else {
+                p = end;
+            }
+        } else {
+            record.begin = p;
+            record.end = end;
+            while( p < end ) {
+                if( *p == ',' || *p == ' ' || *p == '\t' ) {
+                    record.end = p;
+                    p++;
+                    if( p == end && p[-1] == ',' ) extra_record = true;
+                    break;
+                }
+                p++;
+            }
+        }
+        records.push_back( record );
+        if( extra_record ) {
+            record.begin = end;
+            record.end = end;
+            records.push_back( record );
+        }
+    }
+};
+
+void EMSA_upper_trim( const EMSASpan &s, string &out ) {
+//  Same as upper_trim, but into an existing string
+    out.assign( s.begin, s.end );
+    int trail = -1;
+    int i;
+    for( i=0; i<out.length(); i++ ) {
+        const char c = out[i];
+        if( c == ' ' || c == '\t' ) {
+            if( trail < 0 ) trail = i;
+        } else {
+            trail = -1;
+        }
+        if( c >= 'a' && c <= 'z' ) out[i] = c - 'a' + 'A';
+    }
+    if( trail > 0 ) out.erase( trail, out.length() - trail );
+};
+
+bool EMSA_float( const EMSASpan &s, float &value ) {
+//  Same result as istringstream >> float: white space is skipped, then the characters that can be part of a number
+//  are taken, and converted as a whole (so "1e" fails but "12abc" is 12). Value is zero if they can't be converted,
+//  and it is not changed if there is nothing but white space
+    const char *p = s.begin;
+    while( p < s.end && ( *p == ' ' || ( *p >= '\t' && *p <= '\r' ) ) ) p++;
+    if( p >= s.end ) return false;
+    const int max_chars = 60;
+    char number[ max_chars + 4 ];
+    int n = 0;
+    if( *p == '+' || *p == '-' ) {
+        number[n++] = *p;
+        p++;
+    }
+    bool found_mantissa = false;
+    bool found_dec = false;
+    bool found_sci = false;
+    //  Leading zeros (only one is kept)
+    while( p < s.end && *p == '0' ) {
+        if( ! found_mantissa ) number[n++] = '0';
+        found_mantissa = true;
+        p++;
+    }
+    while( p < s.end ) {
+        if( n >= max_chars ) {
+            //  Very long number, let the stream do it
+            istringstream val( s.str() );
+            val >> value;
+            return ! ( !val );
+        }
+        const char c = *p;
+        if( c >= '0' && c <= '9' ) {
+            number[n++] = c;
+            found_mantissa = true;
+        } else if( c == '.' && ! found_dec && ! found_sci ) {
+            number[n++] = '.';
+            found_dec = true;
+        } else if( ( c == 'e' || c == 'E' ) && ! found_sci && found_mantissa ) {
+            number[n++] = 'e';
+            found_sci = true;
+            p++;
+            if( p < s.end && ( *p == '+' || *p == '-' ) ) number[n++] = *p;
+            else continue;
+        } else {
+            break;
+        }
+        p++;
+    }
+    number[n] = 0;
+    char *number_end = 0;
+    const float result = strtof( number, &number_end );
+    if( number_end == number || *number_end != 0 ) {
+        value = 0;
+        return false;
+    } else if( result == numeric_limits<float>::infinity() ) {
+        value = numeric_limits<float>::max();
+        return false;
+    } else if( result == -numeric_limits<float>::infinity() ) {
+        value = -numeric_limits<float>::max();
+        return false;
+    }
+    value = result;
+    return true;
+};
+
+int EMSA_keyword_id( const string &keyword ) {
+//  Look up a keyword (upper case) in a sorted table built the first time it is needed (thread-safe static initialization)
+//  Keywords handled individually come first, then the conditions array keywords in index order
+//  If a keyword is repeated the first one is used, as it was when these were checked in order
+    typedef pair <string, int> KeywordEntry;
+    struct KeywordTable {
+        vector <KeywordEntry> entries;
+        KeywordTable() {
+            const char *names[] = { "#FORMAT", "#VERSION", "#SIGNALTYPE", "#DATATYPE", "#COMMENT", "#TITLE",
+                "#DATE", "#TIME", "#OWNER", "#NPOINTS", "#NCOLUMNS", "#XUNITS", "#YUNITS", "#XLABEL", "#YLABEL",
+                "##OPTICFILE", "##ANODE", "##TUBEFILE", "#XPERCHAN", "#OFFSET", "#LIVETIME", "#REALTIME",
+                "##TRIGGERS", "##EVENTS", "##OVERFLOWS", "##UNDERFLOWS", "##BASE_EVENTS", "##RESETS", "##OVER_ADCMAX",
+                "#XPOSITION", "#YPOSITION", "#ZPOSITION", "##IPOSITION", "##JPOSITION", "##RTT", "##PMC",
+                "##DETECTOR_ID", "#SPECTRUM" };
+            int n;
+            for( n=0; n<=EMSA_SPECTRUM-EMSA_FORMAT; n++ ) entries.push_back( KeywordEntry( names[n], EMSA_FORMAT + n ) );
+            int i;
+            for( i=0; i<XRF_PARAMETER_LAST; i++ ) {
+                if( i == TEST_OPTIC_TYPE_INDEX ) continue;  //  handled above since it might be a file name
+                if( i == ANODE_Z_INDEX ) continue;  //  handled above since it might be an element list
+                entries.push_back( KeywordEntry( upper_trim( get_EMSA_keyword(i) ), i ) );
+            }
+            stable_sort( entries.begin(), entries.end(),
+                []( const KeywordEntry &a, const KeywordEntry &b ) { return a.first < b.first; } );
+            entries.erase( unique( entries.begin(), entries.end(),
+                []( const KeywordEntry &a, const KeywordEntry &b ) { return a.first == b.first; } ), entries.end() );
+        };
+    };
+    static const KeywordTable table;
+    vector <KeywordEntry>::const_iterator it = lower_bound( table.entries.begin(), table.entries.end(), keyword,
+        []( const KeywordEntry &a, const string &b ) { return a.first < b; } );
+    if( it == table.entries.end() || it->first != keyword ) return EMSA_UNKNOWN_KEYWORD;
+    return it->second;
+};
@@ -29,33 +29,22 @@
 
 #include "read_PIXLISE_spectrum.h"
 
-using namespace std;
-
-// We can exclude this if it's not needed, so compilation is simpler/faster by not requiring code
-// generation of protobuf serialiser, protobuf library headers/linking
-#if defined EXCLUDE_PIXLISE_READER
-
-int read_PIXLISE_spectrum(std::ostream &termOutFile,
-        const std::string &spectrumPathName,
-        const std::string &spectrumSelector,
-        std::vector <XraySpectrum> &spectra,
-        std::vector <float> &conditionsArray,
-        std::string &optic_file
-    )
-{
-    termOutFile << "This build of PIQUANT does not support reading PIXLISE binary files" << endl;
-    return -1;
-}
-
-#else
-
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <map>
-#include "data-formats/experiment.pb.h"
+#include <algorithm>
+#include "PIXLISE_spectrum_store.h"
 #include "upper_trim.h"
 #include "read_EMSA_PIXL.h"
 
+// We can exclude the protobuf reader if it's not needed, so compilation is simpler/faster by not requiring code
+// generation of protobuf serialiser, protobuf library headers/linking. Spectrum store files can still be read
+#if ! defined EXCLUDE_PIXLISE_READER
+#include "data-formats/experiment.pb.h"
+#endif
+
+using namespace std;
 
 // Defined in read_EMSA_PIXL
 int parse_EMSA_description( const int index, const string &s );
@@ -63,9 +52,9 @@ int parse_EMSA_description( const int index, const string &s );
 void print_spectrum_summary(const std::vector <XraySpectrum> &spectra, std::ostream &termOutFile);
 
 // Utility functions to make this file more readable...
-string getMetaByLabel(const Experiment_Location_DetectorSpectrum &detector, const vector<string> &meta_labels, const string &label);
-void getSpectrumUncompressed(const Experiment_Location_DetectorSpectrum &detector, vector<float> &out_spectrum_values);
-int processMetadataValue(int pmc, size_t numSpectrumChannels, const string &label, Experiment_MetaDataType metaType, const Experiment_Location_MetaDataItem &meta,
+string getMetaByLabel(const PIXLISESpectrumStore &store, const PIXLISEStoreDetector &detector, const char *label);
+int getSpectrumUncompressed(const PIXLISESpectrumStore &store, const PIXLISEStoreDetector &detector, vector<float> &out_spectrum_values);
+int processMetadataValue(int pmc, size_t numSpectrumChannels, const string &label, PIXLISEStoreMetaType metaType, const PIXLISESpectrumStore &store, const PIXLISEStoreMeta &meta,
     // We read into the following variables:
         XraySpectrum &this_spectrum,
         Spec_Aux_Info &spec_info_hold,
@@ -176,22 +165,57 @@ protected:
 typedef std::map<int, SpectrumMatcher> MatcherMap;
 bool makeSelectorMatcher(const std::string &spectrumSelector, MatcherMap &out_matcher, std::string &out_matcherOverallFileName, std::ostream &termOutFile);
 
-int read_PIXLISE_spectrum(std::ostream &termOutFile,
+// The decoded dataset, either from a PIXLISE binary file or mapped from a spectrum store file. Everything in
+// here is read-only once load_PIXLISE_dataset has returned, so map worker threads can all look up their spectra
+// in the same instance without any locking
+class PIXLISEDataset
+{
+public:
+    std::string _pathName;
+    std::shared_ptr<const PIXLISESpectrumStore> _store;
+};
+
+bool is_PIXLISE_dataset_file(const std::string &pathName)
+{
+    return (pathName.length() > 4 && pathName.substr(pathName.length()-4) == ".bin") || is_PIXLISE_store_file(pathName);
+}
+
+bool is_PIXLISE_store_file(const std::string &pathName)
+{
+    const std::string ext = PIXLISE_STORE_EXTENSION;
+    return pathName.length() > ext.length() && pathName.substr(pathName.length()-ext.length()) == ext;
+}
+
+#if defined EXCLUDE_PIXLISE_READER
+
+static int decode_PIXLISE_binary(std::ostream &termOutFile,
         const std::string &spectrumPathName,
-        const std::string &spectrumSelector,
-        std::vector <XraySpectrum> &spectra,
-        std::vector <float> &conditionsArray,
-        std::string &optic_file
+        std::shared_ptr<const PIXLISESpectrumStore> &out_store
     )
 {
-    std::string selectorPreview = spectrumSelector;
-    if(selectorPreview.length() > 50)
+    termOutFile << "This build of PIQUANT does not support reading PIXLISE binary files" << endl;
+    return -1;
+}
+
+#else
+
+static PIXLISEStoreMetaType storeMetaType(Experiment_MetaDataType metaType)
+{
+    switch(metaType)
     {
-        selectorPreview = selectorPreview.substr(0, 50);
-        selectorPreview += "...";
+        case Experiment_MetaDataType_MT_FLOAT: return PIXLISE_META_FLOAT;
+        case Experiment_MetaDataType_MT_INT: return PIXLISE_META_INT;
+        case Experiment_MetaDataType_MT_STRING: return PIXLISE_META_STRING;
+        default: return PIXLISE_META_UNKNOWN;
     }
-    termOutFile << "Reading spectrum from file: " << spectrumPathName << " with selector: " << selectorPreview << endl;
+}
 
+// Reads a PIXLISE binary file with the protobuf deserialisation code and copies it into the flat store arrays
+static int decode_PIXLISE_binary(std::ostream &termOutFile,
+        const std::string &spectrumPathName,
+        std::shared_ptr<const PIXLISESpectrumStore> &out_store
+    )
+{
     // Open the file
     std::ifstream fin(spectrumPathName.c_str(), std::ios::binary);
     if(!fin)
@@ -200,7 +224,6 @@ int read_PIXLISE_spectrum(std::ostream &termOutFile,
         return -1;
     }
 
-    // Read with protobuf deserialisation code
     Experiment exp;
     if(!exp.ParseFromIstream(&fin))
     {
@@ -208,18 +231,132 @@ int read_PIXLISE_spectrum(std::ostream &termOutFile,
         return -1;
     }
 
-    vector<string> meta_labels;
+    std::shared_ptr<PIXLISESpectrumStore> store = std::make_shared<PIXLISESpectrumStore>();
     for(int c = 0; c < exp.meta_labels_size(); c++)
     {
-        auto label = exp.meta_labels(c);
-        meta_labels.push_back(label);
+        store->addLabel(exp.meta_labels(c), c < exp.meta_types_size() ? storeMetaType(exp.meta_types(c)) : PIXLISE_META_UNKNOWN);
     }
-    vector<Experiment_MetaDataType> meta_types;
-    for(int c = 0; c < exp.meta_labels_size(); c++)
+
+    for(int c = 0; c < exp.locations_size(); c++)
     {
-        meta_types.push_back(exp.meta_types(c));
+        const Experiment_Location &loc = exp.locations(c);
+        const Experiment_Location_BeamLocation &beam = loc.beam();
+        store->addLocation(atoi(loc.id().c_str()), loc.has_beam(), beam.x(), beam.y(), beam.z(), beam.image_i(), beam.image_j(), beam.geom_corr());
+
+        for(int det = 0; det < loc.detectors_size(); det++)
+        {
+            const Experiment_Location_DetectorSpectrum &detector = loc.detectors(det);
+            store->addDetector();
+            for(int metaIdx = 0; metaIdx < detector.meta_size(); metaIdx++)
+            {
+                const Experiment_Location_MetaDataItem &meta = detector.meta(metaIdx);
+                store->addMeta(meta.label_idx(), meta.svalue(), meta.ivalue(), meta.fvalue());
+            }
+            for(int ch = 0; ch < detector.spectrum_size(); ch++)
+            {
+                store->addChannel(detector.spectrum(ch));
+            }
+        }
     }
 
+    if(store->finish(termOutFile, spectrumPathName) != 0)
+    {
+        return -1;
+    }
+
+    termOutFile << "Loaded PIXLISE binary file: " << spectrumPathName << " with " << exp.locations_size() << " locations" << endl;
+
+    out_store = store;
+    return 0;
+}
+
+#endif
+
+int load_PIXLISE_dataset(std::ostream &termOutFile,
+        const std::string &spectrumPathName,
+        std::shared_ptr<const PIXLISEDataset> &out_dataset
+    )
+{
+    out_dataset.reset();
+
+    std::shared_ptr<PIXLISEDataset> dataset = std::make_shared<PIXLISEDataset>();
+    dataset->_pathName = spectrumPathName;
+
+    if(is_PIXLISE_store_file(spectrumPathName))
+    {
+        // Already decoded, just map it
+        if(PIXLISESpectrumStore::open(termOutFile, spectrumPathName, dataset->_store) != 0)
+        {
+            return -1;
+        }
+        termOutFile << "Opened PIXLISE spectrum store: " << spectrumPathName << " with " << dataset->_store->locationCount() << " locations" << endl;
+    }
+    else if(decode_PIXLISE_binary(termOutFile, spectrumPathName, dataset->_store) != 0)
+    {
+        return -1;
+    }
+
+    out_dataset = dataset;
+    return 0;
+}
+
+int pack_PIXLISE_dataset(std::ostream &termOutFile,
+        const std::string &spectrumPathName,
+        const std::string &storePathName
+    )
+{
+    std::shared_ptr<const PIXLISEDataset> dataset;
+    if(load_PIXLISE_dataset(termOutFile, spectrumPathName, dataset) != 0)
+    {
+        return -1;
+    }
+
+    int result = dataset->_store->write(termOutFile, storePathName);
+    if(result != 0)
+    {
+        return -10 + result;
+    }
+
+    termOutFile << "Wrote PIXLISE spectrum store: " << storePathName << " with " << dataset->_store->locationCount() << " locations" << endl;
+    return 0;
+}
+
+int read_PIXLISE_spectrum(std::ostream &termOutFile,
+        const std::string &spectrumPathName,
+        const std::string &spectrumSelector,
+        std::vector <XraySpectrum> &spectra,
+        std::vector <float> &conditionsArray,
+        std::string &optic_file
+    )
+{
+    std::shared_ptr<const PIXLISEDataset> dataset;
+    if(load_PIXLISE_dataset(termOutFile, spectrumPathName, dataset) != 0)
+    {
+        return -1;
+    }
+
+    return read_PIXLISE_spectrum(termOutFile, *dataset, spectrumSelector, spectra, conditionsArray, optic_file);
+}
+
+int read_PIXLISE_spectrum(std::ostream &termOutFile,
+        const PIXLISEDataset &dataset,
+        const std::string &spectrumSelector,
+        std::vector <XraySpectrum> &spectra,
+        std::vector <float> &conditionsArray,
+        std::string &optic_file
+    )
+{
+    const std::string &spectrumPathName = dataset._pathName;
+    const PIXLISESpectrumStore &store = *dataset._store;
+
+    std::string selectorPreview = spectrumSelector;
+    if(selectorPreview.length() > 50)
+    {
+        selectorPreview = selectorPreview.substr(0, 50);
+        selectorPreview += "...";
+    }
+    termOutFile << "Reading spectrum from file: " << spectrumPathName << " with selector: " << selectorPreview << endl;
+
     MatcherMap matcherMap;
     std::string overallFileNameColumn;
     if(!makeSelectorMatcher(spectrumSelector, matcherMap, overallFileNameColumn, termOutFile))
@@ -230,178 +367,179 @@ int read_PIXLISE_spectrum(std::ostream &termOutFile,
 
     termOutFile << "Parsed " << spectrumPathName << ", created selector matcher: " << selectorPreview << " with " << matcherMap.size() << " entries. Overall file name column: " << overallFileNameColumn << endl;
 
-    // Get the spectra for the specified PMC
+    // Look up the locations for the PMCs we were asked for. We visit them in the order they
+    // appear in the file, so the spectra come back in the same order as a scan of all locations
+    vector<int> locationIdxs;
+    for(auto it = matcherMap.begin(); it != matcherMap.end(); it++)
+    {
+        auto locIdx = store.findLocation(it->first);
+        if(locIdx < 0)
+        {
+            termOutFile << "Failed to match all selectors: " << spectrumSelector << " in dataset file: \"" << spectrumPathName << "\"" << endl;
+            return -1;
+        }
+        locationIdxs.push_back(locIdx);
+    }
+    std::sort(locationIdxs.begin(), locationIdxs.end());
+
+    // Get the spectra for the specified PMCs
     spectra.clear();
-    size_t pmcsMatched = 0;
 
-    for(int c = 0; c < exp.locations_size(); c++)
+    for(auto idxIt = locationIdxs.begin(); idxIt != locationIdxs.end(); idxIt++)
     {
-        auto loc = exp.locations(c);
-        auto locPMC = atoi(loc.id().c_str());
+        const PIXLISEStoreLocation &loc = store.location(*idxIt);
+        auto locPMC = loc.pmc;
 
-        // Check if its one of the PMCs we were asked to look for
         auto matcherIt = matcherMap.find(locPMC);
 
-        if(matcherIt != matcherMap.end())
+        // We've found a PMC we're interested in, now find all spectra specified
+        // We have multiple detectors, each will have its own spectra that it read, so for a given PMC we return at least 1 spectrum...
+        // This is mostly copied from read_EMSA_PIXL, as we're basically trying to supply the same data, but from a different source
+        for(uint32_t det = 0; det < loc.detectorCount; det++)
         {
-            // We've found a PMC we're interested in, now find all spectra specified
-            // We have multiple detectors, each will have its own spectra that it read, so for a given PMC we return at least 1 spectrum...
-            // This is mostly copied from read_EMSA_PIXL, as we're basically trying to supply the same data, but from a different source
-            for(int det = 0; det < loc.detectors_size(); det++)
-            {
-                Experiment_Location_DetectorSpectrum detector = loc.detectors(det);
-
-                auto readType = getMetaByLabel(detector, meta_labels, "READTYPE");
-                auto detectorId = getMetaByLabel(detector, meta_labels, "DETECTOR_ID");
+            const PIXLISEStoreDetector &detector = store.detector(loc.firstDetector+det);
 
-                // If we don't find the above, complain
-                if(detectorId.empty() || readType.empty())
-                {
-                    termOutFile << "PIXLISE binary file: " << spectrumPathName << " pmc: " << locPMC << " was missing READTYPE and/or DETECTOR_ID" << endl;
-                }
+            auto readType = getMetaByLabel(store, detector, "READTYPE");
+            auto detectorId = getMetaByLabel(store, detector, "DETECTOR_ID");
 
-                // If we don't match, skip
-                std::vector<SelectorParams>::const_iterator selectorMatchedIt;
-                auto matchCount = matcherIt->second.getMatchCount(readType, detectorId, selectorMatchedIt);
-                if(matchCount == 0)
-                {
-                    // Not one we're interested in
-                    continue;
-                }
-                if(matchCount > 1)
-                {
-                    // Weird, we matched twice, shouldn't be!
-                    termOutFile << "PIXLISE binary file: " << spectrumPathName << " pmc: " << locPMC << " readtype: " << readType << ", detectorId: " << detectorId << " was matched multiple times!" << endl;
-                    return -1;
-                }
+            // If we don't find the above, complain
+            if(detectorId.empty() || readType.empty())
+            {
+                termOutFile << "PIXLISE binary file: " << spectrumPathName << " pmc: " << locPMC << " was missing READTYPE and/or DETECTOR_ID" << endl;
+            }
 
-                // Only consider it if it has beam location info
-                if(!loc.has_beam())
-                {
-                    termOutFile << "PIXLISE binary file: " << spectrumPathName << " pmc: " << locPMC << " readtype: " << readType << ", detectorId: " << detectorId << " had no beam location!" << endl;
-                    return -1;
-                }
+            // If we don't match, skip
+            std::vector<SelectorParams>::const_iterator selectorMatchedIt;
+            auto matchCount = matcherIt->second.getMatchCount(readType, detectorId, selectorMatchedIt);
+            if(matchCount == 0)
+            {
+                // Not one we're interested in
+                continue;
+            }
+            if(matchCount > 1)
+            {
+                // Weird, we matched twice, shouldn't be!
+                termOutFile << "PIXLISE binary file: " << spectrumPathName << " pmc: " << locPMC << " readtype: " << readType << ", detectorId: " << detectorId << " was matched multiple times!" << endl;
+                return -1;
+            }
 
-                auto beam = loc.beam();
+            // Only consider it if it has beam location info
+            if(!loc.hasBeam)
+            {
+                termOutFile << "PIXLISE binary file: " << spectrumPathName << " pmc: " << locPMC << " readtype: " << readType << ", detectorId: " << detectorId << " had no beam location!" << endl;
+                return -1;
+            }
 
-                // Otherwise, we've matched this one, so add it to the spectrum list we're returning
-                XraySpectrum this_spectrum;
+            // Otherwise, we've matched this one, so add it to the spectrum list we're returning
+            XraySpectrum this_spectrum;
 
-                // Read out the spectrum values as an array of floats
-                Spec_Aux_Info spec_info_hold;
-                bool kev_units = false;
-                bool livetime_XIA = false;
-                float ev_ch = 0;
-                float ev_start = 0;
+            // Read out the spectrum values as an array of floats
+            Spec_Aux_Info spec_info_hold;
+            bool kev_units = false;
+            bool livetime_XIA = false;
+            float ev_ch = 0;
+            float ev_start = 0;
 
-                vector<float> spectrum_values;
-                getSpectrumUncompressed(detector, spectrum_values);
+            vector<float> spectrum_values;
+            if(getSpectrumUncompressed(store, detector, spectrum_values) != 0)
+            {
+                termOutFile << "PIXLISE dataset: " << spectrumPathName << " pmc: " << locPMC << " readtype: " << readType << ", detectorId: " << detectorId << " has a spectrum with a bad zero run (negative, or more than " << PIXLISE_MAX_SPECTRUM_CHANNELS << " channels)" << endl;
+                return -1;
+            }
 
-                // Now process all the meta tags, if they exist, using the lookup
-                for(int metaIdx = 0; metaIdx < detector.meta_size(); metaIdx++)
+            // Now process all the meta tags, if they exist, using the lookup
+            for(uint32_t metaIdx = 0; metaIdx < detector.metaCount; metaIdx++)
+            {
+                // Get meta value
+                const PIXLISEStoreMeta &meta = store.meta(detector.firstMeta+metaIdx);
+
+                // Get label and type of this metadata value
+                const PIXLISEStoreLabel &metaLabel = store.label(meta.label);
+                const string label = store.str(metaLabel.name);
+                auto metaType = static_cast<PIXLISEStoreMetaType>(metaLabel.type);
+
+                // Get data for this metadata tag
+                if(processMetadataValue(locPMC, spectrum_values.size(), label, metaType, store, meta,
+                    this_spectrum,
+                    spec_info_hold,
+                    kev_units,
+                    livetime_XIA,
+                    ev_ch,
+                    ev_start,
+                    conditionsArray,
+                    optic_file,
+                    termOutFile) != 0)
                 {
-                    // Get meta value
-                    auto meta = detector.meta(metaIdx);
-
-                    // Get the index to look up label/type with
-                    auto label_idx = meta.label_idx();
-
-                    // Get label and type of this metadata value
-                    auto label = meta_labels[label_idx];
-                    auto metaType = meta_types[label_idx];
-
-                    // Get data for this metadata tag
-                    if(processMetadataValue(locPMC, spectrum_values.size(), label, metaType, meta,
-                        this_spectrum,
-                        spec_info_hold,
-                        kev_units,
-                        livetime_XIA,
-                        ev_ch,
-                        ev_start,
-                        conditionsArray,
-                        optic_file,
-                        termOutFile) != 0)
-                    {
-                        return -1;
-                    }
+                    return -1;
                 }
+            }
 
-                // Set specific fields...
-                spec_info_hold.pmc = locPMC;
+            // Set specific fields...
+            spec_info_hold.pmc = locPMC;
 
-                // Some comes from beam location:
-                spec_info_hold.x = beam.x();
-                spec_info_hold.y = beam.y();
-                spec_info_hold.z = beam.z();
+            // Some comes from beam location:
+            spec_info_hold.x = loc.x;
+            spec_info_hold.y = loc.y;
+            spec_info_hold.z = loc.z;
 
-                spec_info_hold.i = beam.image_i();
-                spec_info_hold.j = beam.image_j();
+            spec_info_hold.i = loc.image_i;
+            spec_info_hold.j = loc.image_j;
 
-                // geom_corr is optional, the only way to tell it's set is if it's non-zero
-                if(beam.geom_corr() != 0)
-                {
-                    conditionsArray[GEOMETRY_INDEX] = beam.geom_corr();
-                }
+            // geom_corr is optional, the only way to tell it's set is if it's non-zero
+            if(loc.geom_corr != 0)
+            {
+                conditionsArray[GEOMETRY_INDEX] = loc.geom_corr;
+            }
 
-                // Now that we've read out the meta values and spectrum counts for this PMC/detector combo, lets set up the spectrum
-                if(kev_units)
+            // Now that we've read out the meta values and spectrum counts for this PMC/detector combo, lets set up the spectrum
+            if(kev_units)
+            {
+                ev_ch *= 1000;
+                ev_start *= 1000;
+            }
+            this_spectrum.calibration(ev_start, ev_ch);
+            this_spectrum.aux_info_replace(spec_info_hold);
+
+            if(livetime_XIA)
+            {
+                //  See writeup in file "JPL-XIA_PIXL_FPGA_Specification_v2.06.pdf", page 9
+                this_spectrum.header_info_change().live_time_DSPC = this_spectrum.live_time();
+                const Spec_Header_Info &header = this_spectrum.header_info();
+                if(header.triggers > 0)
                 {
-                    ev_ch *= 1000;
-                    ev_start *= 1000;
+                    float total_counts_in = header.events + header.overflows + header.underflows;
+                    this_spectrum.live_time( header.live_time_DSPC * total_counts_in / header.triggers );
                 }
-                this_spectrum.calibration(ev_start, ev_ch);
-                this_spectrum.aux_info_replace(spec_info_hold);
-
-                if(livetime_XIA)
+                else if(header.live_time_DSPC != 0)
                 {
-                    //  See writeup in file "JPL-XIA_PIXL_FPGA_Specification_v2.06.pdf", page 9
-                    this_spectrum.header_info_change().live_time_DSPC = this_spectrum.live_time();
-                    const Spec_Header_Info &header = this_spectrum.header_info();
-                    if(header.triggers > 0)
-                    {
-                        float total_counts_in = header.events + header.overflows + header.underflows;
-                        this_spectrum.live_time( header.live_time_DSPC * total_counts_in / header.triggers );
-                    }
-                    else if(header.live_time_DSPC != 0)
-                    {
-                        termOutFile << "Unexpected livetime_XIA/live_time situation found for selector: " << selectorMatchedIt->toString(locPMC) << endl;
-                        return -1;
-                    }
+                    termOutFile << "Unexpected livetime_XIA/live_time situation found for selector: " << selectorMatchedIt->toString(locPMC) << endl;
+                    return -1;
                 }
+            }
 
-                this_spectrum.meas(spectrum_values);
-
-                // Set the file name (using the source file we saved in binary
-                // file, so this should look like an MSA read to the rest of piquant!)
-                string file_name = overallFileNameColumn;
-                this_spectrum.file_name(file_name);
+            this_spectrum.meas(spectrum_values);
 
-                spectra.push_back(this_spectrum);
+            // Set the file name (using the source file we saved in binary
+            // file, so this should look like an MSA read to the rest of piquant!)
+            string file_name = overallFileNameColumn;
+            this_spectrum.file_name(file_name);
 
-                termOutFile << "Read spectrum for selector: " << selectorMatchedIt->toString(locPMC) << " from: \"" << spectrumPathName << "\"" << endl;
-            }
+            spectra.push_back(this_spectrum);
 
-            // At this point we've scanned everything for this PMC (which was matched). Check that all specifiers were matched
-            if(!matcherIt->second.allMatched())
-            {
-                termOutFile << "Failed to match all selectors: " << spectrumSelector << " for PMC: " << locPMC << " in dataset file: \"" << spectrumPathName << "\"" << endl;
-                return -1;
-            }
+            termOutFile << "Read spectrum for selector: " << selectorMatchedIt->toString(locPMC) << " from: \"" << spectrumPathName << "\"" << endl;
+        }
 
-            // If all PMCs have been matched, we can stop here
-            pmcsMatched++;
-            if(pmcsMatched >= matcherMap.size())
-            {
-                termOutFile << "Read " << spectra.size() << " spectra specified by: " << selectorPreview << " from: \"" << spectrumPathName << "\" successfully" << endl;
-                print_spectrum_summary(spectra, termOutFile);
-                return 0;
-            }
+        // At this point we've scanned everything for this PMC (which was matched). Check that all specifiers were matched
+        if(!matcherIt->second.allMatched())
+        {
+            termOutFile << "Failed to match all selectors: " << spectrumSelector << " for PMC: " << locPMC << " in dataset file: \"" << spectrumPathName << "\"" << endl;
+            return -1;
         }
     }
 
-    // Didn't match something anyway...
-    termOutFile << "Failed to match all selectors: " << spectrumSelector << " in dataset file: \"" << spectrumPathName << "\"" << endl;
-    return -1;
+    termOutFile << "Read " << spectra.size() << " spectra specified by: " << selectorPreview << " from: \"" << spectrumPathName << "\" successfully" << endl;
+    print_spectrum_summary(spectra, termOutFile);
+    return 0;
 }
 
 // TODO: should be a unit tested utility function!
@@ -535,14 +673,14 @@ bool makeSelectorMatcher(const std::string &spectrumSelectorRaw, MatcherMap &out
     return true;
 }
 
-string getMetaByLabel(const Experiment_Location_DetectorSpectrum &detector, const vector<string> &meta_labels, const string &label)
+string getMetaByLabel(const PIXLISESpectrumStore &store, const PIXLISEStoreDetector &detector, const char *label)
 {
-    for(int metaIdx = 0; metaIdx < detector.meta_size(); metaIdx++)
+    for(uint32_t metaIdx = 0; metaIdx < detector.metaCount; metaIdx++)
     {
-        auto meta = detector.meta(metaIdx);
-        if(meta_labels[meta.label_idx()] == label)
+        const PIXLISEStoreMeta &meta = store.meta(detector.firstMeta+metaIdx);
+        if(store.equals(store.label(meta.label).name, label))
         {
-            return meta.svalue();
+            return store.str(meta.svalue);
         }
     }
 
@@ -550,14 +688,17 @@ string getMetaByLabel(const Experiment_Location_DetectorSpectrum &detector, cons
 }
 
 
-void getSpectrumUncompressed(const Experiment_Location_DetectorSpectrum &detector, vector<float> &out_spectrum_values)
+// Returns -1 if a zero run is negative or would make the spectrum longer than PIXLISE_MAX_SPECTRUM_CHANNELS
+// (the run lengths come straight from the file, so they're bounded here rather than trusted)
+int getSpectrumUncompressed(const PIXLISESpectrumStore &store, const PIXLISEStoreDetector &detector, vector<float> &out_spectrum_values)
 {
+    const int32_t *spectrum = store.channels(detector);
     // We have to read in the values, but keep in mind they're compressed...
     // at the moment the only way we store them is zero-run-length encoding
     bool lastWas0 = false;
-    for(int ch = 0; ch < detector.spectrum_size(); ch++)
+    for(uint32_t ch = 0; ch < detector.channelCount; ch++)
     {
-        auto val = detector.spectrum(ch);
+        auto val = spectrum[ch];
         if(val == 0)
         {
             // Next value will tell us how many
@@ -568,6 +709,10 @@ void getSpectrumUncompressed(const Experiment_Location_DetectorSpectrum &detecto
             if(lastWas0)
             {
                 // this is telling us how many 0's there are
+                if(val < 0 || uint64_t(out_spectrum_values.size())+val > PIXLISE_MAX_SPECTRUM_CHANNELS)
+                {
+                    return -1;
+                }
                 for(int z = 0; z < val; z++)
                 {
                     out_spectrum_values.push_back(0);
@@ -577,13 +722,18 @@ void getSpectrumUncompressed(const Experiment_Location_DetectorSpectrum &detecto
             else
             {
                 // it's just a value, store it
+                if(out_spectrum_values.size() >= PIXLISE_MAX_SPECTRUM_CHANNELS)
+                {
+                    return -1;
+                }
                 out_spectrum_values.push_back(val);
             }
         }
     }
+    return 0;
 }
 
-int processMetadataValue(int pmc, size_t numSpectrumChannels, const string &label, Experiment_MetaDataType metaType, const Experiment_Location_MetaDataItem &meta,
+int processMetadataValue(int pmc, size_t numSpectrumChannels, const string &label, PIXLISEStoreMetaType metaType, const PIXLISESpectrumStore &store, const PIXLISEStoreMeta &meta,
         // We read into the following variables:
         XraySpectrum &this_spectrum,
         Spec_Aux_Info &spec_info_hold,
@@ -601,9 +751,9 @@ int processMetadataValue(int pmc, size_t numSpectrumChannels, const string &labe
 
     // Some labels we ignore, some we store data for... See read_EMSA_spectrum for what we need to store, this is just
     // another data format that intends to supply the same values as the MSA files did.
-    if(metaType == Experiment_MetaDataType_MT_STRING)
+    if(metaType == PIXLISE_META_STRING)
     {
-        auto value = meta.svalue();
+        auto value = store.str(meta.svalue);
 
         // A bunch of these wants to interpret the string as a float...
         float fValue = 0;
@@ -809,9 +959,9 @@ int processMetadataValue(int pmc, size_t numSpectrumChannels, const string &labe
             handled = false;
         }
     }
-    else if(metaType == Experiment_MetaDataType_MT_INT)
+    else if(metaType == PIXLISE_META_INT)
     {
-        auto ivalue = meta.ivalue();
+        auto ivalue = meta.ivalue;
 /*      Took this out, we set it directly anyway...
         if(label == "PMC")
         {
@@ -826,9 +976,9 @@ int processMetadataValue(int pmc, size_t numSpectrumChannels, const string &labe
             handled = false;
         }
     }
-    else if(metaType == Experiment_MetaDataType_MT_FLOAT)
+    else if(metaType == PIXLISE_META_FLOAT)
     {
-        auto fvalue = meta.fvalue();
+        auto fvalue = meta.fvalue;
 
         if(label == "XPERCHAN")
         {
@@ -894,8 +1044,8 @@ int processMetadataValue(int pmc, size_t numSpectrumChannels, const string &labe
 
             if(label == upper_test)
             {
-                auto value = meta.svalue();
-                if(metaType != Experiment_MetaDataType_MT_STRING)
+                auto value = store.str(meta.svalue);
+                if(metaType != PIXLISE_META_STRING)
                 {
                     termOutFile << "Expected string for " << label << " when reading conditionsArray for PMC: " << pmc << ": " << value << endl;
                     return -1;
@@ -926,5 +1076,3 @@ int processMetadataValue(int pmc, size_t numSpectrumChannels, const string &labe
 
     return 0;
 }
-
-#endif
@@ -31,6 +31,7 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 #include "XraySpectrum.h"
 
 
@@ -41,3 +42,34 @@ int read_PIXLISE_spectrum(std::ostream &termOutFile,
         std::vector <float> &conditionsArray,
         std::string &optic_file
     );
+
+// A PIXLISE dataset file parsed into memory, indexed by PMC. This is read-only once loaded, so a
+// map run can load it once and share it between all map worker threads instead of every job
+// re-reading and re-parsing the whole file
+class PIXLISEDataset;
+
+// PIXLISE binary (.bin) or spectrum store (.pqs) file name, for the first line of a PMC list
+bool is_PIXLISE_dataset_file(const std::string &pathName);
+bool is_PIXLISE_store_file(const std::string &pathName);
+
+// Loads a PIXLISE binary file, or memory-maps a spectrum store file written by pack_PIXLISE_dataset
+// (read-only, so any number of processes can share the same pages)
+int load_PIXLISE_dataset(std::ostream &termOutFile,
+        const std::string &spectrumPathName,
+        std::shared_ptr<const PIXLISEDataset> &out_dataset
+    );
+
+// Decodes a PIXLISE binary file once and writes it as a spectrum store file (pack sub-command)
+int pack_PIXLISE_dataset(std::ostream &termOutFile,
+        const std::string &spectrumPathName,
+        const std::string &storePathName
+    );
+
+// Reads the spectra for a selector out of an already loaded dataset, no file access
+int read_PIXLISE_spectrum(std::ostream &termOutFile,
+        const PIXLISEDataset &dataset,
+        const std::string &spectrumSelector,
+        std::vector <XraySpectrum> &spectra,
+        std::vector <float> &conditionsArray,
+        std::string &optic_file
+    );
@@ -74,10 +74,13 @@
 //  Modified May 22, 2020 to put conditions vector and optic file name in struct
 //                          add file name for X-ray tube spectrum input from external calculation
 //  Modified Jan 13, 2021 to use XRFconditionsInput struct and to resize conditionsVector in this struct before using it in borehole_read
+//  Modified Oct. 16, 2026
+//      Add read_packed_spectrum to get the spectra for a file from an MSA spectrum pack (written by the pack sub-command)
 
 	using namespace std;
 
 void print_spectrum_summary(const std::vector <XraySpectrum> &spectra, std::ostream &termOutFile);
+void print_EMSA_read_error(const int result, const std::string &spectrumPathName, std::ostream &termOutFile);
 
 const int read_spectrum_file( std::ostream &termOutFile, const std::string &spectrumPathName,
         std::vector <XraySpectrum> &spectra, XRFconditionsInput &condStruct_spec ) {
@@ -147,12 +150,7 @@ const int read_spectrum_file( std::ostream &termOutFile, const std::string &spec
         string acq_date, acq_time, x_label, y_label, unit;
         result = read_EMSA_PIXL( spectrumPathName, condStruct_spec, spectra );
         if ( result != 0 ) {
-            termOutFile << "Can't read msa configuration file, result = " << result << "  for file name " << spectrumPathName << endl;
-            if( result == -999999 ) {
-                termOutFile << "Invalid file format or missing required keyword." << endl;
-            } else {
-                termOutFile << "Error on line number = " << -result << "." << endl;
-            }
+            print_EMSA_read_error( result, spectrumPathName, termOutFile );
             error = true;
         };
     } else if ( check_file_extension( spectrumPathName, "XSP" ) ) {
@@ -186,6 +184,40 @@ const int read_spectrum_file( std::ostream &termOutFile, const std::string &spec
     return result;
 }
 
+const int read_packed_spectrum( std::ostream &termOutFile, const MSASpectrumPack &pack, const int entryIndex,
+        std::vector <XraySpectrum> &spectra, XRFconditionsInput &condStruct_spec ) {
+
+//  The pack holds what read_EMSA_PIXL gave for the file when it was packed, including its result
+
+    const string spectrumPathName = pack.path( entryIndex );
+    termOutFile << "Reading spectrum from file " << spectrumPathName << endl;
+
+    string spectrumFileName;
+    string spectrumPathOnly;
+    /*bool path_found =*/ extract_path( spectrumPathName, spectrumPathOnly, spectrumFileName );
+
+    int result = pack.read( entryIndex, spectra, condStruct_spec );
+    if ( result != 0 ) {
+        print_EMSA_read_error( result, spectrumPathName, termOutFile );
+    } else {
+        int is;
+        for( is=0; is<spectra.size(); is++ ) spectra[is].file_name( spectrumFileName );
+        print_spectrum_summary(spectra, termOutFile);
+    }
+
+    return result;
+}
+
+void print_EMSA_read_error(const int result, const std::string &spectrumPathName, std::ostream &termOutFile)
+{
+    termOutFile << "Can't read msa configuration file, result = " << result << "  for file name " << spectrumPathName << endl;
+    if( result == -999999 ) {
+        termOutFile << "Invalid file format or missing required keyword." << endl;
+    } else {
+        termOutFile << "Error on line number = " << -result << "." << endl;
+    }
+}
+
 void print_spectrum_summary(const std::vector <XraySpectrum> &spectra, std::ostream &termOutFile)
 {
     termOutFile << "Spectrum read OK, " << spectra.size() << (spectra.size() != 1 ? " detectors" : " detector") << endl;
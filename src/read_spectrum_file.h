@@ -34,11 +34,17 @@
 #include <string>
 #include <vector>
 #include "XraySpectrum.h"
+#include "MSA_spectrum_pack.h"
 
 //  Determines the spectrum file type and calls appropriate routine to read it
 
 const int read_spectrum_file( std::ostream &termOutFile, const std::string &spectrumPathName,
         std::vector <XraySpectrum> &spectra, XRFconditionsInput &condStruct_spec );
 
+//  Gets the spectra for one file in an MSA spectrum pack, with the same messages as reading the file itself
+
+const int read_packed_spectrum( std::ostream &termOutFile, const MSASpectrumPack &pack, const int entryIndex,
+        std::vector <XraySpectrum> &spectra, XRFconditionsInput &condStruct_spec );
+
 #endif
 
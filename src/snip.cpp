@@ -46,6 +46,7 @@
  * REVISION:    1.0
  *
  * NOTES:       written March 5, 2017   W. T. Elam   APL/UW
+ *              Oct. 17, 2026  window indices only clamped near the ends (same sums as before)
  ************************************************************************/
 
 #include <vector>
@@ -66,7 +67,7 @@ void box_smth( const std::vector <float> &y,  std::vector <float> &s,
 {
  	const int nchan = y.size();
 	int iw, m, jch1, jch2;
-	float sum, m_norm;
+	float m_norm;
 	int i,j;
 
 	iw = _MIN(iwid, nchan);
@@ -76,14 +77,21 @@ void box_smth( const std::vector <float> &y,  std::vector <float> &s,
 	//convolve spectrum with boxcar filter of width ~iw
 	jch1 = _MAX(ich1, 0);
 	jch2 = _MIN(ich2, nchan - 1);
+	if( jch1 > jch2 || m < 0 ) return;
+	//  each window is summed in float in channel order (the results are bit for bit those of the original loop),
+	//  only the channels within m of the ends need their indices clamped
+	const float *yp = y.data();
 	for(i = jch1; i <= jch2; i++)
 	{
-		sum = 0;
-		for(j = -m; j <= m; j++)
+		float sum = 0;
+		if( i - m >= jch1 && i + m <= jch2 )
 		{
-			int j1 = _MAX(i+j, jch1 );
-			j1 = _MIN(j1, jch2 );
-			sum += y[j1];
+			const float *yi = yp + i;
+			for(j = -m; j <= m; j++) sum += yi[j];
+		}
+		else
+		{
+			for(j = -m; j <= m; j++) sum += yp[_MIN(_MAX(i+j, jch1), jch2)];
 		}
 		s[i] = sum / m_norm;
 	}
@@ -91,6 +99,79 @@ void box_smth( const std::vector <float> &y,  std::vector <float> &s,
 }//end box_smth()
 
 
+/************************************************************************
+ * FUNCTION:    snip_strip_pass()
+ *
+ * PURPOSE:     one peak stripping pass of the SNIP algorithm
+ *
+ * CALLED BY:   snipbg, snipbg_lsq, snipbg_2zone
+ *
+ * PARAMETERS:  yback - spectrum being stripped (replaced in place)
+ *              ich_start - first channel to strip in this call
+ *              ich_end - last channel to strip in this call
+ *              iw - half width of the stripping window
+ *              ich1, ich2 - limits of the window (region of the continuum)
+ *
+ * NOTES:       Oct. 16, 2026  The channels are replaced in turn, so each one uses the new value
+ *                  iw channels below it and the old value iw channels above it.  Where the
+ *                  window is not at the ends of the region, any iw channels in a row only use
+ *                  channels outside of themselves, so they are done as a block the compiler can
+ *                  vectorize, with the same result as doing them one at a time.
+ ************************************************************************/
+
+//  Narrower windows are done one channel at a time
+const int SNIP_BLOCK_MIN = 4;
+
+inline void snip_strip_channel( std::vector <float> &yback, const int i, const int iw, const int ich1, const int ich2 )
+{
+	const int i1 = _MAX(i-iw, ich1);
+	const int i2 = _MIN(i+iw, ich2);
+	yback[i] = _MIN(yback[i], (float)(0.5*(yback[i1]+yback[i2])));
+}
+
+inline void snip_strip_block( float * __restrict out, const float * __restrict lo, const float * __restrict hi, const int n )
+{
+	//  four at a time, written out so the compiler will use vector instructions without -O3
+	int k;
+	for( k = 0; k+4 <= n; k += 4 )
+	{
+		const float clip0 = 0.5f * ( lo[k] + hi[k] );
+		const float clip1 = 0.5f * ( lo[k+1] + hi[k+1] );
+		const float clip2 = 0.5f * ( lo[k+2] + hi[k+2] );
+		const float clip3 = 0.5f * ( lo[k+3] + hi[k+3] );
+		out[k] = _MIN(out[k], clip0);
+		out[k+1] = _MIN(out[k+1], clip1);
+		out[k+2] = _MIN(out[k+2], clip2);
+		out[k+3] = _MIN(out[k+3], clip3);
+	}
+	for( ; k < n; k++ )
+	{
+		const float clip = 0.5f * ( lo[k] + hi[k] );
+		out[k] = _MIN(out[k], clip);
+	}
+}
+
+void snip_strip_pass( std::vector <float> &yback, const int ich_start, const int ich_end, const int iw,
+            const int ich1, const int ich2 )
+{
+	int i = ich_start;
+	if( iw >= SNIP_BLOCK_MIN )
+	{
+		//  window cut off at the low end
+		for( ; i <= ich_end && i-iw < ich1; i++ ) snip_strip_channel( yback, i, iw, ich1, ich2 );
+		//  blocks of up to iw channels, until the window is cut off at the high end
+		const int i_last = _MIN(ich_end, ich2-iw);
+		while( i <= i_last )
+		{
+			const int n = _MIN(iw, i_last-i+1);
+			snip_strip_block( &yback[i], &yback[i-iw], &yback[i+iw], n );
+			i += n;
+		}
+	}
+	for( ; i <= ich_end; i++ ) snip_strip_channel( yback, i, iw, ich1, ich2 );
+}
+
+
 /************************************************************************
  * FUNCTION:    snipbg()
  *
@@ -153,12 +234,7 @@ void snipbg( const  std::vector <float> &y,  std::vector <float> &yback, const i
 		if(n > niter-NREDUC)
 			redfac = redfac/SQRT2;
 		iw = int( redfac * fwhm + 0.5f );
-		for( i = ich1; i <= ich2; i++)
-		{
-			i1 = _MAX(i-iw, ich1);
-			i2 = _MIN(i+iw, ich2);
-			yback[i] = _MIN(yback[i], (float)(0.5*(yback[i1]+yback[i2])));
-		}
+		snip_strip_pass( yback, ich1, ich2, iw, ich1, ich2 );
 	}
 
 	//back transformation
@@ -230,12 +306,7 @@ void snipbg_lsq( const  std::vector <float> &y,  std::vector <float> &yback, con
 		if(n > niter-NREDUC)
 			redfac = redfac/SQRT2;
 		iw = int( redfac * fwhm + 0.5f );
-		for( i = ich1; i <= ich2; i++)
-		{
-			i1 = _MAX(i-iw, ich1);
-			i2 = _MIN(i+iw, ich2);
-			yback[i] = _MIN(yback[i], (float)(0.5*(yback[i1]+yback[i2])));
-		}
+		snip_strip_pass( yback, ich1, ich2, iw, ich1, ich2 );
 	}
 
 	//back transformation
@@ -283,7 +354,8 @@ void snipbg_lsq( const  std::vector <float> &y,  std::vector <float> &yback, con
  *
  * REVISION:    2.0
  *
- * NOTES:       wte - 27 July 2018   change to two-region stripping for better
+ * NOTES:       Oct. 16, 2026  stripping passes done by snip_strip_pass, same result
+ *              wte - 27 July 2018   change to two-region stripping for better
  *                      background removal under peaks (inlcuding Compton peak)
  *                      and for better fit to broad hump in continuum near center
  *              wte - 5 March 2017   change Savitsky-Golay smoothing to boxcar
@@ -331,18 +403,19 @@ void snipbg_2zone( const  std::vector <float> &y,  std::vector <float> &yback, c
 			redfac = redfac/SQRT2;
 		iw = int( redfac * fwhm + 0.5f );
 		int iw2 = int( redfac * fwhm2 + 0.5f ); //  2 zone
-		for( i = ich1; i <= ich2; i++)
-		{
-			if( ich1_2z > 0 && ich2_2z > 0 && iw2 > 0 && i >= ich1_2z && i <= ich2_2z ) {
-                i1 = i-iw2; //  2 zone
-                i2 = i+iw2; //  2 zone
-            } else {
-                i1 = i-iw;
-                i2 = i+iw;
-            }
-			i1 = _MAX(i1, ich1);
-			i2 = _MIN(i2, ich2);
-			yback[i] = _MIN(yback[i], (float)(0.5*(yback[i1]+yback[i2])));
+		//  channels below the 2nd zone, in it, and above it (in that order, since they are replaced in turn)
+		int z1 = ich2 + 1;
+		int z2 = ich2;
+		if( ich1_2z > 0 && ich2_2z > 0 && iw2 > 0 ) {
+			z1 = _MAX(ich1_2z, ich1);
+			z2 = _MIN(ich2_2z, ich2);
+		}
+		if( z1 > z2 ) {
+			snip_strip_pass( yback, ich1, ich2, iw, ich1, ich2 );
+		} else {
+			snip_strip_pass( yback, ich1, z1-1, iw, ich1, ich2 );
+			snip_strip_pass( yback, z1, z2, iw2, ich1, ich2 );   //  2 zone
+			snip_strip_pass( yback, z2+1, ich2, iw, ich1, ich2 );
 		}
 	}
 
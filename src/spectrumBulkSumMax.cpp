@@ -28,10 +28,15 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include <sstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include "spectrumBulkSumMax.h"
 #include "setup_spectrum_parameters.h"
 #include "read_spectrum_file.h"
 #include "quantCombineSpectra.h"
+#include "job_pool.h"
 
 
 int spectrumBulkSumMax(const std::string &map_spec_file,
@@ -45,6 +50,8 @@ int spectrumBulkSumMax(const std::string &map_spec_file,
     int n_map_spectra,
 
     int sequence_number,
+    const std::shared_ptr<const MSASpectrumPack> &msa_pack,    // If set, map_spec_file is read from this MSA spectrum pack
+    int pack_entry,
     vector <float> &bulk_sum,
     vector <float> &max_value,
     float &sum_live_time,
@@ -58,30 +65,64 @@ int spectrumBulkSumMax(const std::string &map_spec_file,
     // Init a place to write outputs to
     std::ostringstream termOutFile;
 
+    error = false;
+
+    float geometry = 0;
+    int result = readBulkSumSpectrum(map_spec_file, condStruct_config, arguments, configSpectrum, sequence_number,
+        msa_pack, pack_entry, singleSpectrum, geometry, termOutFile, cout);
+    if( geometry != 0 ) {
+        sum_geometry += geometry;
+        geometry_count++;
+    }
+    if( result == 0 ) {
+        result = addToBulkSum(map_spec_file, singleSpectrum, n_map_spectra, bulk_sum, max_value, sum_live_time, termOutFile);
+    }
+    if( result != 0 ) {
+        error = true;
+        return -1;
+    }
+
+    cout << termOutFile.str();
+    return 0;
+}
+
+int readBulkSumSpectrum(const std::string &map_spec_file,
+    const XRFconditionsInput &condStruct_config,
+    const ARGUMENT_LIST &arguments,
+    const XraySpectrum &configSpectrum,
+    int sequence_number,
+    const std::shared_ptr<const MSASpectrumPack> &msa_pack,
+    int pack_entry,
+    XraySpectrum &singleSpectrum,
+    float &geometry,
+    ostream &termOutFile,
+    ostream &setupLog
+)
+{
     // Spectrum we've read
     vector <XraySpectrum> spectrum_vec;
 
     int result = 0;
-    error = false;
+    geometry = 0;
 
     XRFconditionsInput condStruct_map;
-    result = read_spectrum_file( termOutFile, map_spec_file,
-            spectrum_vec, condStruct_map );
+    if( msa_pack ) {
+        result = read_packed_spectrum( termOutFile, *msa_pack, pack_entry,
+                spectrum_vec, condStruct_map );
+    } else {
+        result = read_spectrum_file( termOutFile, map_spec_file,
+                spectrum_vec, condStruct_map );
+    }
     if ( result != 0 ) {
         termOutFile << "read_spectrum_file failed, result = " << result << "   file " << endl;
-        error = true;
         return -1;
     };
-    if( condStruct_map.conditionsVector[GEOMETRY_INDEX] != 0 ) {
-        sum_geometry += condStruct_map.conditionsVector[GEOMETRY_INDEX];
-        geometry_count++;
-    }
+    geometry = condStruct_map.conditionsVector[GEOMETRY_INDEX];
     //  Set up energy calibration, background parameters, and measurement conditions
     setup_spectrum_parameters( arguments, configSpectrum.calibration(), spectrum_vec,
-            condStruct_config, condStruct_map, cout );
+            condStruct_config, condStruct_map, setupLog );
     if( spectrum_vec.size() <= 0 ) {
         termOutFile << "No spectra in file " << map_spec_file << endl;
-        error = true;
         return -1;
     } else {
         //  Combine the spectrum information from several detectors (or the selected detector) into the variable where they will be used
@@ -89,12 +130,22 @@ int spectrumBulkSumMax(const std::string &map_spec_file,
         //          for proper plotting
         result = quantCombineSpectra( spectrum_vec, singleSpectrum, arguments.detector_select );
         if( result < 0 ) {
-            error = true;
             return -1;
         };
     }
     singleSpectrum.seq_number( sequence_number );
+    return 0;
+}
 
+int addToBulkSum(const std::string &map_spec_file,
+    const XraySpectrum &singleSpectrum,
+    int n_map_spectra,
+    vector <float> &bulk_sum,
+    vector <float> &max_value,
+    float &sum_live_time,
+    ostream &termOutFile
+)
+{
     //  Just read the spectra and calculate the sum spectrum and the maximum value spectrum
     if( n_map_spectra <= 0 ) {
         //  Initialize the sum and max channel storage
@@ -108,7 +159,6 @@ int spectrumBulkSumMax(const std::string &map_spec_file,
     } else {
         if( singleSpectrum.meas().size() != bulk_sum.size() ) {
             termOutFile << "Spectrum in file " << map_spec_file << " is not the same size as previous spectra." << endl;
-            error = true;
             return -1;
         }
     }
@@ -121,7 +171,306 @@ int spectrumBulkSumMax(const std::string &map_spec_file,
         if( singleSpectrum.meas()[is] > max_value[is] ) max_value[is] = singleSpectrum.meas()[is];
     }
     sum_live_time += singleSpectrum.live_time();
-
-    cout << termOutFile.str();
     return 0;
 }
+
+
+// One spectrum for the bulk sum, read and combined on a worker thread
+class BulkSumJob
+{
+public:
+    BulkSumJob(
+        const string &map_spec_file,
+        const XRFconditionsInput &condStruct_config,
+        const ARGUMENT_LIST &arguments,
+        const XraySpectrum &configSpectrum,
+        int jobId,
+        int sequence_number,
+        const std::shared_ptr<const MSASpectrumPack> &msa_pack,
+        int pack_entry
+    ) :
+        _map_spec_file(map_spec_file),
+        _condStruct_config(condStruct_config),
+        _arguments(arguments),
+        _configSpectrum(configSpectrum),
+        _jobId(jobId),
+        _sequence_number(sequence_number),
+        _msaPack(msa_pack),
+        _packEntry(pack_entry),
+        _result(-1),
+        _geometry(0)
+    {
+        // Setting up the spectrum writes to the terminal output, so its messages get the same number format
+        _setupLog.copyfmt(cout);
+    }
+
+    void run()
+    {
+        _result = readBulkSumSpectrum(_map_spec_file, _condStruct_config, _arguments, _configSpectrum, _sequence_number,
+            _msaPack, _packEntry, _spectrum, _geometry, _logger, _setupLog);
+    }
+
+    int getJobId() const { return _jobId; }
+    int getResult() const { return _result; }
+    float getGeometry() const { return _geometry; }
+    const string &getSpectrumFile() const { return _map_spec_file; }
+    XraySpectrum &getSpectrum() { return _spectrum; }
+    ostringstream &getLog() { return _logger; }
+    const ostringstream &getSetupLog() const { return _setupLog; }
+
+private:
+// Inputs
+    const string _map_spec_file;
+    const XRFconditionsInput &_condStruct_config;
+    const ARGUMENT_LIST &_arguments;
+    const XraySpectrum &_configSpectrum;
+    const int _jobId;
+    const int _sequence_number;
+    const std::shared_ptr<const MSASpectrumPack> _msaPack;
+    const int _packEntry;
+
+// Outputs
+    XraySpectrum _spectrum;
+    int _result;
+    float _geometry;
+    ostringstream _logger;
+    ostringstream _setupLog;
+};
+
+
+// Adds finished jobs to the sum in the order they were queued, as MapOutputWriter does for map rows. Jobs that finish
+// early wait here (keyed by job id) until the ones before them have been added. Floating point sums depend on the order
+// they're done in, so this is what keeps the bulk sum the same as a single thread, the reading is what takes the time.
+// After a spectrum fails nothing more is added, as the single thread loop stops there.
+// Jobs are added on whichever worker thread finished the last one needed, so their messages are kept here in order
+// and written out by the queueing (main) thread, not from the workers.
+class BulkSumReducer
+{
+public:
+    BulkSumReducer() : _nextJobId(1), _added(0), _done(0), _failed(false), _sum_live_time(0), _sum_geometry(0), _geometry_count(0), _haveSpectrum(false) {}
+
+    void start()
+    {
+        const std::lock_guard<std::mutex> lock(_mutex);
+        _waiting.clear();
+        _nextJobId = 1;
+        _added = 0;
+        _done = 0;
+        _failed = false;
+        _bulk_sum.clear();
+        _max_value.clear();
+        _sum_live_time = 0;
+        _sum_geometry = 0;
+        _geometry_count = 0;
+        _haveSpectrum = false;
+        _log.str("");
+    }
+
+    // Called by the worker threads when a job has run. Takes ownership of the job
+    void add(BulkSumJob *job)
+    {
+        {
+            const std::lock_guard<std::mutex> lock(_mutex);
+            _waiting[job->getJobId()] = job;
+            addReady();
+        }
+        _doneChanged.notify_all();
+    }
+
+    // Blocks the queueing thread while jobCount jobs have been queued and maxInFlight or more of them are not yet added
+    void waitForRoom(int jobCount, int maxInFlight)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while(jobCount - _done >= maxInFlight)
+        {
+            _doneChanged.wait(lock);
+        }
+    }
+
+    // Writes the messages of the jobs added so far (called from the queueing thread)
+    void writeLog(ostream &out)
+    {
+        string text;
+        {
+            const std::lock_guard<std::mutex> lock(_mutex);
+            text = _log.str();
+            _log.str("");
+        }
+        out << text;
+    }
+
+    bool failed()
+    {
+        const std::lock_guard<std::mutex> lock(_mutex);
+        return _failed;
+    }
+
+    // Called once all workers have stopped (nothing should be left waiting), then hands over the sums
+    void finish(vector <float> &bulk_sum, vector <float> &max_value, float &sum_live_time, float &sum_geometry, int &geometry_count,
+        XraySpectrum &singleSpectrum, bool &error)
+    {
+        const std::lock_guard<std::mutex> lock(_mutex);
+        while(!_waiting.empty())
+        {
+            _nextJobId = _waiting.begin()->first;
+            addReady();
+        }
+
+        bulk_sum.swap(_bulk_sum);
+        max_value.swap(_max_value);
+        sum_live_time = _sum_live_time;
+        sum_geometry = _sum_geometry;
+        geometry_count = _geometry_count;
+        if(_haveSpectrum)
+        {
+            singleSpectrum = _singleSpectrum;
+        }
+        if(_failed)
+        {
+            error = true;
+        }
+    }
+
+private:
+    void addReady()
+    {
+        for(auto it = _waiting.find(_nextJobId); it != _waiting.end(); it = _waiting.find(++_nextJobId))
+        {
+            addJob(*it->second);
+
+            delete it->second;
+            _waiting.erase(it);
+            _done++;
+        }
+    }
+
+    // Same steps and messages as spectrumBulkSumMax, for one spectrum
+    void addJob(BulkSumJob &job)
+    {
+        if(_failed)
+        {
+            return;
+        }
+
+        _log << job.getSetupLog().str();
+        if(job.getGeometry() != 0)
+        {
+            _sum_geometry += job.getGeometry();
+            _geometry_count++;
+        }
+
+        int result = job.getResult();
+        if(result == 0)
+        {
+            _singleSpectrum = std::move(job.getSpectrum());
+            _haveSpectrum = true;
+            result = addToBulkSum(job.getSpectrumFile(), _singleSpectrum, _added, _bulk_sum, _max_value, _sum_live_time, job.getLog());
+        }
+        if(result != 0)
+        {
+            _failed = true;
+            return;
+        }
+
+        _added++;
+        _log << job.getLog().str();
+    }
+
+    std::map<int, BulkSumJob *> _waiting;
+    int _nextJobId;
+    int _added;
+    int _done;
+    bool _failed;
+
+    vector <float> _bulk_sum;
+    vector <float> _max_value;
+    float _sum_live_time;
+    float _sum_geometry;
+    int _geometry_count;
+    XraySpectrum _singleSpectrum;
+    bool _haveSpectrum;
+    ostringstream _log;
+
+    std::mutex _mutex;
+    std::condition_variable _doneChanged;
+};
+
+MTJobPool<BulkSumJob> _bulkSumJobPool;
+BulkSumReducer _bulkSum;
+int _bulkSumJobCount = 0;
+// Spectra read ahead of the sum before the queueing thread waits, per worker thread
+const int _bulkSumReadAhead = 4;
+int _bulkSumMaxInFlight = _bulkSumReadAhead;
+
+void startBulkSumJobs(int threadCount)
+{
+    _bulkSumJobCount = 0;
+    _bulkSumMaxInFlight = _bulkSumReadAhead * std::max(threadCount, 1);
+    _bulkSum.start();
+    _bulkSumJobPool.start(threadCount);
+}
+
+void processBulkSumJob(int workerIdx)
+{
+    // Waits for jobs to be queued, returns 0 once finishBulkSumJobs has been called and nothing is left
+    BulkSumJob *job = 0;
+    while((job = _bulkSumJobPool.take(workerIdx)) != 0)
+    {
+        // Don't bother reading spectra that won't be added
+        if(!_bulkSum.failed())
+        {
+            job->run();
+        }
+
+        // Add it to the sum (once all earlier jobs are added)
+        _bulkSum.add(job);
+    }
+}
+
+void queueBulkSumSpectrum(const std::string &map_spec_file,
+    const XRFconditionsInput &condStruct_config,
+    const ARGUMENT_LIST &arguments,
+    const XraySpectrum &configSpectrum,
+    int sequence_number,
+    const std::shared_ptr<const MSASpectrumPack> &msa_pack,
+    int pack_entry)
+{
+    // Keeps the memory used by spectra waiting to be added down, whatever the length of the list
+    _bulkSum.waitForRoom(_bulkSumJobCount, _bulkSumMaxInFlight);
+    _bulkSum.writeLog(cout);
+
+    auto job = new BulkSumJob(
+        map_spec_file,
+        condStruct_config,
+        arguments,
+        configSpectrum,
+        ++_bulkSumJobCount,
+        sequence_number,
+        msa_pack,
+        pack_entry
+        );
+
+    _bulkSumJobPool.add(job);
+}
+
+bool bulkSumJobsFailed()
+{
+    return _bulkSum.failed();
+}
+
+void finishBulkSumJobs()
+{
+    _bulkSumJobPool.finish();
+}
+
+void takeBulkSumResults(vector <float> &bulk_sum,
+    vector <float> &max_value,
+    float &sum_live_time,
+    float &sum_geometry,
+    int &geometry_count,
+    XraySpectrum &singleSpectrum,
+    bool &error)
+{
+    _bulkSum.finish(bulk_sum, max_value, sum_live_time, sum_geometry, geometry_count, singleSpectrum, error);
+    _bulkSum.writeLog(cout);
+}
@@ -27,11 +27,14 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <iostream>
 #include <string>
 #include <vector>
+#include <memory>
 
 #include "XraySpectrum.h"
 #include "parse_arguments.h"
+#include "MSA_spectrum_pack.h"
 
 using namespace std;
 
@@ -47,6 +50,8 @@ int spectrumBulkSumMax(const std::string &map_spec_file,
     int n_map_spectra,
 
     int sequence_number,
+    const std::shared_ptr<const MSASpectrumPack> &msa_pack,    // If set, map_spec_file is read from this MSA spectrum pack
+    int pack_entry,
     vector <float> &bulk_sum,
     vector <float> &max_value,
     float &sum_live_time,
@@ -56,3 +61,64 @@ int spectrumBulkSumMax(const std::string &map_spec_file,
     XraySpectrum &singleSpectrum,
     bool &error
 );
+
+// The two halves of spectrumBulkSumMax, so the reading can be done on worker threads and the sum still done in order
+
+// Reads one spectrum file (or pack entry), sets it up and combines the detectors into singleSpectrum. geometry is the
+// geometry factor from the file, 0 if it has none or the file couldn't be read. Messages from setting up the spectrum
+// go to setupLog, the rest to termOutFile
+int readBulkSumSpectrum(const std::string &map_spec_file,
+    const XRFconditionsInput &condStruct_config,
+    const ARGUMENT_LIST &arguments,
+    const XraySpectrum &configSpectrum,
+    int sequence_number,
+    const std::shared_ptr<const MSASpectrumPack> &msa_pack,
+    int pack_entry,
+    XraySpectrum &singleSpectrum,
+    float &geometry,
+    ostream &termOutFile,
+    ostream &setupLog
+);
+
+// Adds a spectrum from readBulkSumSpectrum to the sum and max, n_map_spectra is the number already added. The spectra
+// have to be added in list order for the sums (and the live time) to come out the same whatever the number of threads
+int addToBulkSum(const std::string &map_spec_file,
+    const XraySpectrum &singleSpectrum,
+    int n_map_spectra,
+    vector <float> &bulk_sum,
+    vector <float> &max_value,
+    float &sum_live_time,
+    ostream &termOutFile
+);
+
+// Bulk sum with the spectra read on worker threads (the -t option). Each spectrum is added to the sum as soon as all the
+// ones listed before it have been added. Its messages are kept in that order and written out by the thread that queues
+// the spectra (and by takeBulkSumResults), so the sum file and the terminal output are the same as for a single thread
+
+// Sets up the job queues, call before queueing any spectra or starting the threads
+void startBulkSumJobs(int threadCount);
+// Worker thread function, workerIdx is 0..threadCount-1. Returns once finishBulkSumJobs has been called and all jobs are done
+void processBulkSumJob(int workerIdx);
+// Queues the next spectrum in the list. Waits if too many spectra have been read and not yet added to the sum
+void queueBulkSumSpectrum(const std::string &map_spec_file,
+    const XRFconditionsInput &condStruct_config,
+    const ARGUMENT_LIST &arguments,
+    const XraySpectrum &configSpectrum,
+    int sequence_number,
+    const std::shared_ptr<const MSASpectrumPack> &msa_pack,
+    int pack_entry
+);
+// True once a spectrum couldn't be added, nothing after it will be, so there is no need to queue any more
+bool bulkSumJobsFailed();
+// Call once all spectra have been queued
+void finishBulkSumJobs();
+// Call after the worker threads have finished. Outputs are as for spectrumBulkSumMax after the last spectrum,
+// singleSpectrum is only changed if at least one spectrum was read
+void takeBulkSumResults(vector <float> &bulk_sum,
+    vector <float> &max_value,
+    float &sum_live_time,
+    float &sum_geometry,
+    int &geometry_count,
+    XraySpectrum &singleSpectrum,
+    bool &error
+);
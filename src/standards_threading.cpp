@@ -0,0 +1,305 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "standards_threading.h"
+
+#include <thread>
+
+#include "read_spectrum_file.h"
+#include "read_EMSA_PIXL.h"
+#include "setup_spectrum_parameters.h"
+#include "quantCombineSpectra.h"
+#include "fpSetupConditions.h"
+#include "fpMain.h"
+#include "quantStandard.h"
+#include "quantUnknown.h"
+#include "quantWriteResults.h"
+#include "quantWriteMap.h"
+#include "quantWritePlot.h"
+#include "job_pool.h"
+
+StandardJob::StandardJob(
+        const PIQUANT_SUBCOMMAND cmd,
+        const int istd,
+        const StandardInformation &standard,
+
+        const ARGUMENT_LIST &arguments,
+        const XRFconditionsInput &condStruct_config,
+        const XraySpectrum &configSpectrum,
+
+        const vector <ElementListEntry> &element_list,
+        const vector <ElementListEntry> &element_list_eval_master,
+        const bool oxidesOutput,
+
+        const QuantCalibration *calibration,
+        const string &version
+    ) :
+    _cmd(cmd),
+    _istd(istd),
+    _standard(standard),
+    _arguments(arguments),
+    _condStruct_config(condStruct_config),
+    _configSpectrum(configSpectrum),
+    _element_list(element_list),
+    _element_list_eval_master(element_list_eval_master),
+    _oxidesOutput(oxidesOutput),
+    _calibration(calibration),
+    _version(version)
+{
+}
+
+void StandardJob::run(const ios &logFormat)
+{
+    _fitLog.copyfmt(logFormat);
+    runFit(_fitLog);
+    _resultsLog.copyfmt(_fitLog);
+
+    // The command line stops at the first standard with an error, so its results are never written
+    if(_flow == STANDARD_OK && !_error)
+    {
+        runResults(_resultsLog);
+    }
+}
+
+// Same checks and messages as the loops over standards in the command line, which now just act on _flow
+void StandardJob::runFit(ostream &logger)
+{
+    XRFconditionsInput condStruct_std;
+    if( _cmd != EVALUATE && _standard.spectrumFileName.length() == 0 ) {
+        logger << "File name missing for standard number " << _istd;
+        if( _standard.names.size() > 0 ) logger << "   name " << _standard.names[0];
+        logger << endl;
+        _error = true;
+    } else {
+        int result = read_spectrum_file( logger, _standard.spectrumFileName, _spectrum_vec, condStruct_std );
+        if ( result != 0 ) {
+            logger << "read_spectrum_file failed, result = " << result << "   file " << _standard.spectrumFileName << endl;
+            _error = true;
+            _flow = STANDARD_CONTINUE;
+            return;
+        };
+    }
+    //  Set up energy calibration, background parameters, and measurement conditions
+    setup_spectrum_parameters( _arguments, _configSpectrum.calibration(), _spectrum_vec,
+            _condStruct_config, condStruct_std, logger );
+    //  Combine the spectrum information from several detectors (or the selected detector) into the variable where they will be used
+    //      NB: quantCombineSpectra modifies the spectra in the input list to match them to a single energy axis
+    //          for proper plotting
+    int result = quantCombineSpectra( _spectrum_vec, _spectrum, _arguments.detector_select );
+    _combined = ( result >= 0 || result <= -3 );
+    if( result < 0 ) {
+        _error = true;
+        _flow = STANDARD_BREAK;
+        return;
+    };
+    //  Check live time
+    if( _spectrum.live_time() <= 0 ) {
+        logger << "*** Error - live time is bad, can't use this standard for " << ( _cmd == EVALUATE ? "evaluation" : "calibration" ) << ". ***" << endl;
+        _error = true; //  Plot can be vs channels, all others are not possible without calibration
+        _flow = STANDARD_CONTINUE;
+        return;
+    }
+    //Check energy calibration
+    if( _cmd == EVALUATE && ! _spectrum.calibration().good() ) {
+        logger << "Bad energy calibration, can't quantify spectrum." << endl;
+        _error = true;
+        _flow = STANDARD_BREAK;
+        return;
+    }
+    //  Add the standard name to the spectrum aux info titles (for output in map file if requested using "U")
+    if( _cmd != EVALUATE && _standard.names.size() > 0 ) {
+        _spectrum.aux_info_change().titles.clear();
+        _spectrum.aux_info_change().titles.push_back( _standard.names[0] );
+    }
+    //  Set up new instrument measurement conditions
+    result = fpSetupConditions ( condStruct_std, _conditions );
+    if( result < 0 ) {
+        logger << "fpSetupConditions failed, result " << result;
+        logger << "   error in parameter with keyword " << get_EMSA_keyword( -(result+100) ) << endl;
+        _error = true;
+        _flow = STANDARD_RETURN;
+        _return_code = -500 + result;
+        return;
+    };
+    logger << endl;
+    if( _cmd == EVALUATE ) fitUnknown( logger );
+    else fitStandard( logger );
+}
+
+void StandardJob::fitStandard(ostream &logger)
+{
+    //  Input element fit control list overrides the one from standards input
+    unsigned int i_list;
+    //  Move element list from standards input file
+    for( i_list=0; i_list<_standard.element_list.size(); i_list++ )
+        add_element_list_entry( _standard.element_list[i_list], _element_list_std );
+    //  Append or replace entries using element list from arguments
+    for( i_list=0; i_list<_element_list.size(); i_list++ )
+        add_element_list_entry( _element_list[i_list], _element_list_std );
+    //  Each job has its own FP storage so the standards can be fitted at the same time
+    FPstorage fpStorage;
+    int result = quantStandard( fpStorage, _standard.mat, _element_list_std, _conditions, _spectrum );
+    if ( result < 0 ) {
+        logger << "quantStandard failed, result = " << result << "   file " << _standard.spectrumFileName << endl;
+        _error = true;
+        _flow = STANDARD_BREAK;
+    };
+}
+
+void StandardJob::fitUnknown(ostream &logger)
+{
+    //  Add the standard name to the spectrum aux info titles (for output in map file if requested using "U")
+    if( _standard.names.size() > 0 ) {
+        _spectrum.aux_info_change().titles.clear();
+        _spectrum.aux_info_change().titles.push_back( _standard.names[0] );
+    }
+    //  Input element fit control list overrides the one from standards input
+    unsigned int i_list;
+    //  Move element list from standards input file
+    for( i_list=0; i_list<_standard.element_list.size(); i_list++ ) {
+        //  Only include elements that have positive weight (or are matrix elements)
+        if( _standard.element_list[i_list].qualifier != MATRIX && _standard.element_list[i_list].weight <= _arguments.min_wgt_eval ) continue;
+        ElementListEntry element_list_std_unk_new = _standard.element_list[i_list];
+        add_element_list_entry( element_list_std_unk_new, _element_list_std );
+    }
+    //  Append or replace entries using element list from arguments if FORCE is chosen
+    for( i_list=0; i_list<_element_list.size(); i_list++ ) {
+        if( _element_list[i_list].qualifier != FORCE ) continue;
+        add_element_list_entry( _element_list[i_list], _element_list_std );
+    }
+    //  Put the names if the being evaluated into the spectrum object (so that it won't be used for making the ECFs)
+    _spectrum.std_names( _standard.names );
+    int result = quantUnknown( _unknown, _element_list_std, _conditions, _spectrum, *_calibration, logger );
+    if ( result < 0 ) {
+        logger << "quantUnknown failed, result = " << result << "   file " << _arguments.spectrum_file << endl;
+        _error = true;
+        _flow = STANDARD_BREAK;
+    }
+}
+
+void StandardJob::runResults(ostream &logger)
+{
+    //  Write results to output file and put results in element list for map and calibration files
+    //  This will fill the element list for the standards with the coefficients and other fit results
+    _element_sum = 0;
+    if( _cmd == EVALUATE ) {
+        quantWriteResults( _unknown, _conditions.detector, _element_list_std,
+                _spectrum, _oxidesOutput, logger, _element_sum, true );
+        //  Code to write plot file after evaluate when single standard chosen and -w option used to set file name
+        if( _arguments.standard_selected && _arguments.cal_eval_file.length() > 0 ) {
+            //  Write a CSV file of plotting information (if only one standard was included in the evaluation)
+            logger << endl;
+            logger << "Writing plot to file " << _arguments.cal_eval_file;
+            logger << "      " << _spectrum.numberOfChannels() << " channels." << endl;
+            quantWritePlot( _spectrum, _arguments.cal_eval_file, _cmd, _arguments.detector_select, _spectrum_vec, _version );
+        }
+        makeEvalCopy();
+        quantWriteMapRow( _map_row, _arguments.quant_map_outputs, _element_list_eval_copy,
+                _conditions.detector, _spectrum, _element_sum );
+        //  No plot, don't need the component spectra, remove to save space
+        _spectrum.clean();
+        return;
+    }
+    quantWriteResults( _standard.mat, _conditions.detector, _element_list_std,
+            _spectrum, _oxidesOutput, logger, _element_sum );
+    //  Keep the results for the standards info list before the evaluate copy changes the ECFs
+    _element_list_results = _element_list_std;
+    if( _cmd == CALIBRATE ) _spectrum.clean(); //  No plot, don't need the component spectra, remove to save space
+    //  For debugging and evaluation of the calibration, write a synopsis file using the evaluate format
+    //      Calibrate does not normally write this, only then the -w option is invoked (which sets the file name)
+    if( _cmd == CALIBRATE && _arguments.cal_eval_file.length() > 0 ) {
+        makeEvalCopy();
+        quantWriteMapRow( _map_row, _arguments.quant_map_outputs, _element_list_eval_copy,
+                _conditions.detector, _spectrum, _element_sum );
+    }
+}
+
+void StandardJob::makeEvalCopy()
+{
+    //  Duplicate the master list (to preserve it with default values)
+    _element_list_eval_copy = _element_list_eval_master;
+    //  Replace the element list entries with quantification results to the copy (for writing to the map file, preserving element order)
+    unsigned int iel;
+    for( iel=0; iel<_element_list_std.size(); iel++ ) {
+        if( _cmd == EVALUATE ) {
+            if( _element_list_std[iel].given <= 0 ) continue;
+        } else {
+            //  Add coefficient as ECF to this new element list (if weight above threshold)
+            _element_list_std[iel].ecf = _element_list_std[iel].coefficient;
+        }
+        if( _element_list_std[iel].qualifier == IGNORE
+                || _element_list_std[iel].qualifier == EXCLUDE
+                || _element_list_std[iel].qualifier == MATRIX ) continue;
+        //  Only include elements that have weight greater then minimum (set in XRFcontrols.h)
+        if( _cmd != EVALUATE && _element_list_std[iel].weight <= _arguments.min_wgt_eval ) continue;
+        //  Replace the entry in the master list copy
+        unsigned int i_copy;
+        for( i_copy=0; i_copy<_element_list_eval_copy.size(); i_copy++ ) {
+            if( ! ( _element_list_eval_copy[i_copy].element == _element_list_std[iel].element ) ) continue;
+            _element_list_eval_copy[i_copy] = _element_list_std[iel];
+            break;
+        }
+    }
+}
+
+void StandardJob::takeSpectrum(XraySpectrum &singleSpectrum, vector <XraySpectrum> &spectrum_vec)
+{
+    if( _combined ) singleSpectrum = std::move( _spectrum );
+    spectrum_vec = std::move( _spectrum_vec );
+}
+
+void runStandardJobs(int threadCount, vector <unique_ptr<StandardJob>> &jobs, const ios &logFormat)
+{
+    MTJobPool<StandardJob> pool;
+    pool.start(threadCount);
+
+    vector<std::thread> workers;
+    for(int c = 0; c < threadCount; c++)
+    {
+        workers.push_back(std::thread([&pool, &logFormat, c]()
+        {
+            StandardJob *job = 0;
+            while((job = pool.take(c)) != 0)
+            {
+                job->run(logFormat);
+            }
+        }));
+    }
+
+    for(auto &job : jobs)
+    {
+        pool.add(job.get());
+    }
+    pool.finish();
+
+    for(auto &worker : workers)
+    {
+        worker.join();
+    }
+}
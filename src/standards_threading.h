@@ -0,0 +1,141 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <memory>
+
+using namespace std;
+
+#include "parse_arguments.h"
+#include "parse_element_list.h"
+#include "XRFstandards.h"
+#include "XRFconditions.h"
+#include "XraySpectrum.h"
+#include "XrayMaterial.h"
+#include "quantCalibration.h"
+
+// What the command line should do after a standard has been fitted, mirrors the loop over standards
+enum StandardJobFlow { STANDARD_OK, STANDARD_CONTINUE, STANDARD_BREAK, STANDARD_RETURN };
+
+// One standard from the list for the calibrate, fit-one-standard or evaluate sub-commands.
+// runFit reads the spectrum and fits it as a standard (or quantifies it as an unknown for evaluate), runResults writes
+// the results and works out the evaluate map row. The command line then applies the results to the list of standards
+// in the original order, so the calibration and evaluate files don't depend on which thread finished first.
+class StandardJob
+{
+public:
+    StandardJob(
+        const PIQUANT_SUBCOMMAND cmd,
+        const int istd,
+        const StandardInformation &standard,
+
+        const ARGUMENT_LIST &arguments,
+        const XRFconditionsInput &condStruct_config,
+        const XraySpectrum &configSpectrum,
+
+        const vector <ElementListEntry> &element_list,
+        const vector <ElementListEntry> &element_list_eval_master,
+        const bool oxidesOutput,
+
+        const QuantCalibration *calibration,    // Only for evaluate
+        const string &version
+    );
+
+    // Both parts, for the worker threads. The logs are kept in the job until the command line writes them out,
+    //  they start with the number format the command line log had when the jobs were queued
+    void run(const ios &logFormat);
+
+    void runFit(ostream &logger);
+    void runResults(ostream &logger);
+
+    int getStandardIndex() const { return _istd; }
+    StandardJobFlow getFlow() const { return _flow; }
+    int getReturnCode() const { return _return_code; }
+    bool getError() const { return _error; }
+    const ostringstream &getFitLog() const { return _fitLog; }
+    const ostringstream &getResultsLog() const { return _resultsLog; }
+
+    // Element list with the fit results (before any changes for the evaluate map)
+    const vector <ElementListEntry> &getElementListResults() const { return _element_list_results; }
+    // Element list in the order of the evaluate map, for the header
+    const vector <ElementListEntry> &getElementListEval() const { return _element_list_eval_copy; }
+    const ostringstream &getMapRow() const { return _map_row; }
+    const XraySpectrum &getSpectrum() const { return _spectrum; }
+
+    // Hands over the combined spectrum and the spectra read from the file (used by fit-one-standard to write the plot)
+    //  Only if they were combined, so the command line variables are left as they would have been
+    void takeSpectrum(XraySpectrum &singleSpectrum, vector <XraySpectrum> &spectrum_vec);
+
+private:
+    void fitStandard(ostream &logger);
+    void fitUnknown(ostream &logger);
+    void makeEvalCopy();
+
+    const PIQUANT_SUBCOMMAND _cmd;
+    const int _istd;
+    const StandardInformation &_standard;
+
+    const ARGUMENT_LIST &_arguments;
+    const XRFconditionsInput &_condStruct_config;
+    const XraySpectrum &_configSpectrum;
+
+    const vector <ElementListEntry> &_element_list;
+    const vector <ElementListEntry> &_element_list_eval_master;
+    const bool _oxidesOutput;
+
+    const QuantCalibration *_calibration;
+    const string _version;
+
+    StandardJobFlow _flow = STANDARD_OK;
+    int _return_code = 0;
+    bool _error = false;
+    bool _combined = false;
+
+    vector <XraySpectrum> _spectrum_vec;
+    XraySpectrum _spectrum;
+    XRFconditions _conditions;
+    XrayMaterial _unknown;
+    vector <ElementListEntry> _element_list_std;
+    vector <ElementListEntry> _element_list_results;
+    vector <ElementListEntry> _element_list_eval_copy;
+    float _element_sum = 0;
+
+    ostringstream _fitLog;
+    ostringstream _resultsLog;
+    ostringstream _map_row;
+};
+
+// Runs all of the jobs on threadCount worker threads using the same job pool as the map sub-command,
+//  returns when they have all finished
+void runStandardJobs(int threadCount, vector <unique_ptr<StandardJob>> &jobs, const ios &logFormat);
@@ -0,0 +1,219 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+//  quant_alloc_benchmark.cpp
+//  Counts the heap allocations (calls to operator new and bytes requested) made while one spectrum is quantified,
+//  the way the quantify sub-command does it (no caches) and the way each map spectrum is done once the FP and
+//  quantUnknown setups are in the caches. Allocations made directly with malloc are not counted.
+//
+//  Built only when CMake is run with -DPIQUANT_BENCHMARKS=ON
+//  Usage:  quant_alloc_benchmark <configuration file (.msa)> <calibration file> <spectrum file> <element list> [repeat count]
+//  Exits with 2 if the spectrum can't be quantified, 3 if any of the files can't be read
+//
+//  Reference counts for one quantify fit (no caches) of the BHVO-2G bulk sum spectrum in test/data
+//      (Calibration_box_BHVO-2G_28kV_230uA_03_28_2019_bulk_sum.msa, element list "Si_K K_K P_K Ca_K Ti_K Cr_K Mn_K Fe_K Sr_K Ar_I",
+//      PIXL FM configuration and Calibrate_Master_ECF_new_BB_01_08_2020.csv, built with -O2)
+//      23.4 million allocations before the FP functions took their objects by reference (Oct. 16, 2026)
+//      279,000 after that change, 34,900 with the per-channel DetectorResponseTable (Oct. 17, 2026)
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <iomanip>
+#include "read_EMSA_PIXL.h"
+#include "read_spectrum_file.h"
+#include "setup_spectrum_parameters.h"
+#include "parse_arguments.h"
+#include "parse_element_list.h"
+#include "quantCombineSpectra.h"
+#include "quantCalibration.h"
+#include "quantUnknown.h"
+#include "fpSetupConditions.h"
+#include "fpMain.h"
+
+using namespace std;
+
+//  Every operator new in the program comes here, counting is switched on only around the part being measured
+static atomic <bool> counting( false );
+static atomic <unsigned long long> n_allocations( 0 );
+static atomic <unsigned long long> n_bytes( 0 );
+
+void *operator new( size_t size ) {
+    if( counting ) {
+        n_allocations++;
+        n_bytes += size;
+    }
+    void *p = malloc( size > 0 ? size : 1 );
+    if( ! p ) throw bad_alloc();
+    return p;
+}
+
+void *operator new[]( size_t size ) {
+    return operator new( size );
+}
+
+void operator delete( void *p ) noexcept {
+    free( p );
+}
+
+void operator delete[]( void *p ) noexcept {
+    free( p );
+}
+
+void operator delete( void *p, size_t ) noexcept {
+    free( p );
+}
+
+void operator delete[]( void *p, size_t ) noexcept {
+    free( p );
+}
+
+struct AllocationCount {
+    unsigned long long allocations = 0;
+    unsigned long long bytes = 0;
+};
+
+static void start_count() {
+    n_allocations = 0;
+    n_bytes = 0;
+    counting = true;
+}
+
+static AllocationCount stop_count() {
+    counting = false;
+    AllocationCount count;
+    count.allocations = n_allocations;
+    count.bytes = n_bytes;
+    return count;
+}
+
+static void write_count( const string &label, const AllocationCount &count, const int n_spectra ) {
+    cout << label << setw(12) << count.allocations / n_spectra << " allocations, "
+        << fixed << setprecision(2) << setw(10) << count.bytes / double( n_spectra ) / 1.0e6 << " MB per spectrum";
+    if( n_spectra > 1 ) cout << "  (" << n_spectra << " spectra)";
+    cout << endl;
+}
+
+int main( int argc, char *argv[] ) {
+    if( argc < 5 ) {
+        cout << "Usage: quant_alloc_benchmark <configuration file (.msa)> <calibration file> <spectrum file> <element list> [repeat count]" << endl;
+        return 1;
+    }
+    ARGUMENT_LIST arguments;
+    arguments.configuration_file = argv[1];
+    arguments.calibration_file = argv[2];
+    arguments.spectrum_file = argv[3];
+    arguments.element_list = argv[4];
+    int repeat = 10;
+    if( argc > 5 ) repeat = atoi( argv[5] );
+    if( repeat < 1 ) repeat = 1;
+
+    //  Configuration, element list and calibration, as for the quantify and map sub-commands
+    XRFconditionsInput condStruct_config;
+    vector <XraySpectrum> config_vec;
+    int result = read_EMSA_PIXL( arguments.configuration_file, condStruct_config, config_vec );
+    if( result != 0 || config_vec.empty() ) {
+        cout << "Can't read configuration file " << arguments.configuration_file << ", result = " << result << endl;
+        return 3;
+    }
+    const XraySpectrum &configSpectrum = config_vec[0];
+    vector <ElementListEntry> element_list;
+    bool carbonates = false;
+    if( parse_element_list( arguments.element_list, element_list, carbonates ) ) {
+        cout << "Can't parse element list " << arguments.element_list << endl;
+        return 1;
+    }
+    ostringstream log;
+    QuantCalibration calibration;
+    result = quantLoadCalibration( arguments.calibration_file, element_list, log, calibration );
+    if( result != 0 ) {
+        cout << "Can't read calibration file " << arguments.calibration_file << ", result = " << result << endl;
+        return 3;
+    }
+
+    //  Spectrum and its measurement conditions
+    XRFconditionsInput condStruct_spec;
+    copy_conditions_struct( condStruct_config, condStruct_spec );
+    vector <XraySpectrum> spectrum_vec;
+    result = read_spectrum_file( log, arguments.spectrum_file, spectrum_vec, condStruct_spec );
+    if( result != 0 ) {
+        cout << "Can't read spectrum file " << arguments.spectrum_file << ", result = " << result << endl;
+        return 3;
+    }
+    setup_spectrum_parameters( arguments, configSpectrum.calibration(), spectrum_vec, condStruct_config, condStruct_spec, log );
+    XraySpectrum spectrum = configSpectrum;
+    result = quantCombineSpectra( spectrum_vec, spectrum, arguments.detector_select );
+    XRFconditions conditions;
+    if( result >= 0 ) result = fpSetupConditions( condStruct_spec, conditions );
+    if( result < 0 ) {
+        cout << "Can't set up the spectrum and conditions, result = " << result << endl;
+        return 2;
+    }
+
+    //  Each fit gets its own copies of the spectrum and conditions (made before counting starts), since the fit changes them
+    auto quantify = [&]( FPprepCache *fpCache, QuantUnknownSetupCache *setupCache, AllocationCount &count ) {
+        XraySpectrum fit_spectrum = spectrum;
+        XRFconditions fit_conditions = conditions;
+        vector <ElementListEntry> fit_element_list = element_list;
+        XrayMaterial unknown;
+        ostringstream fit_log;
+        start_count();
+        int fit_result = quantUnknown( unknown, fit_element_list, fit_conditions, fit_spectrum, calibration, fit_log, fpCache, setupCache );
+        AllocationCount c = stop_count();
+        count.allocations += c.allocations;
+        count.bytes += c.bytes;
+        return fit_result;
+    };
+
+    //  The first spectrum includes loading the cross-section tables, so it's done twice
+    AllocationCount first, single, map_spectrum;
+    result = quantify( 0, 0, first );
+    if( result >= 0 ) result = quantify( 0, 0, single );
+    //  Map spectra after the first one find their setups in the caches
+    FPprepCache fpCache;
+    QuantUnknownSetupCache setupCache;
+    AllocationCount map_first;
+    if( result >= 0 ) result = quantify( &fpCache, &setupCache, map_first );
+    int i;
+    for( i=0; i<repeat && result >= 0; i++ ) result = quantify( &fpCache, &setupCache, map_spectrum );
+    if( result < 0 ) {
+        cout << "quantUnknown failed, result = " << result << endl;
+        return 2;
+    }
+    cout << "Heap allocations (operator new) to quantify " << arguments.spectrum_file << endl;
+    write_count( "first spectrum (tables loaded):  ", first, 1 );
+    write_count( "quantify (no caches):            ", single, 1 );
+    write_count( "map spectrum (setups made):      ", map_first, 1 );
+    write_count( "map spectrum (setups cached):    ", map_spectrum, repeat );
+    return 0;
+}
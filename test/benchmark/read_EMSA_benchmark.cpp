@@ -0,0 +1,680 @@
+// Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+// University of Washington. U.S. Government sponsorship acknowledged.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// * Neither the name of Caltech nor its operating division, the Jet Propulsion
+//   Laboratory, nor the names of its contributors may be used to endorse or
+//   promote products derived from this software without specific prior written
+//   permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+//  read_EMSA_benchmark.cpp
+//  Throughput of read_EMSA_PIXL compared with the earlier reader (getline, parse_records, and istringstream
+//  for each value), which is kept here as the reference. Also checks that both readers give the same result.
+//
+//  Built only when CMake is run with -DPIQUANT_BENCHMARKS=ON
+//  Usage:  read_EMSA_benchmark <MSA file or list of MSA files (.txt)> [repeat count]
+//  Exits with 2 if the readers disagree, 3 if any file can't be opened or read, or if there is nothing to time
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include "read_EMSA_PIXL.h"
+#include "XRFconditions.h"
+#include "parse_records.h"
+#include "upper_trim.h"
+
+using namespace std;
+
+int parse_EMSA_description( const int index, const string &s );
+
+void parseEMSAkeyword( const string strIn, const string delim, string &sKeyword, vector <string> &sValue );
+
+//  Reference reader, as it was before the file was tokenized in place
+int read_EMSA_PIXL_reference ( const std::string spectrumFileName, XRFconditionsInput &conditionsStructEMSA,
+				std::vector <XraySpectrum> &spectrum_vector ) {
+
+//  Initialize output conditions structure
+    conditionsStructEMSA.conditionsVector.resize( XRF_PARAMETER_LAST, 0 );
+
+//		Open input file
+
+	ifstream inputFile(spectrumFileName.c_str(), ios::in);
+	if ( !inputFile ) {
+		return -1;
+	};
+
+//		Read line from file, interpret data, and place in arguments
+
+    string strRead, sKeyword;
+	int numChannels = 0;
+    bool bNumChanFound;
+    bNumChanFound = false;
+	int numColumns = 0;
+	int line_number = 0;
+    bool kev_units = false;
+	spectrum_vector.clear();
+	//  Need to hold these so they can be entered together into XraySpectrum object
+	vector <float> ev_ch;
+	vector <float> ev_start;
+	vector <vector <float>> spectrum_hold_vec;
+	Spec_Aux_Info spec_info_hold;
+	bool livetime_XIA = false;
+	int triggers_line = -1;
+
+	while ( !( !inputFile ) ) {
+
+        //Process required EMSA keywords and check file format
+		getline( inputFile, strRead );
+		line_number++;
+		if ( !inputFile ) {
+            break;
+		}
+		vector <string> sValue;
+		//  Get rid of trailing CR if file is Windows line endings on Linux or Mac
+		if( strRead.length() > 0 && (int) (strRead.data()[strRead.length()-1]) == 13 ) strRead.erase( strRead.length()-1,1);
+		parseEMSAkeyword(strRead, ":", sKeyword, sValue);
+        sKeyword = upper_trim(sKeyword);
+//			work-around for early typographical error in spectrum save
+		if( sKeyword == "SOLID_ANLGE" ) sKeyword = "SOLID_ANGLE";
+//		cout << strRead << "   keyword '" << sKeyword << "'  " << (sValue.size()>0?sValue[0]:" ") << endl;
+		if (sKeyword == "#FORMAT") {
+            if ( sValue.size()<=3 || sValue[0] != "EMSA/MAS" || sValue[1] != "spectral" || sValue[2] != "data" || sValue[3] != "file" ) {
+                return -line_number;
+            };
+        } else if (sKeyword == "#VERSION") {
+            if ( sValue.size()<=1 || sValue[0] != "TC202v2.0" || sValue[1] != "PIXL" ) {
+                return -line_number;
+            };
+//	Need to check for PIXL, return -6                                *****
+       } else if (sKeyword == "#SIGNALTYPE") {
+            if ( sValue.size()<=0 || upper_trim(sValue[0]) != "XRF" ) {
+                return -line_number;
+            };
+       } else if (sKeyword == "#DATATYPE") {
+            if ( sValue.size()<=0 || ( upper_trim(sValue[0]) != "Y" && upper_trim(sValue[0]) != "YY" ) ) {
+                return -line_number;
+            };
+       } else if (sKeyword == "#COMMENT") {
+        	 if( sValue.size()>0) {
+                int k;
+                string temp_str;
+                for(k=0; k<sValue.size(); k++ ) temp_str += sValue[k] + BLANK_CHARACTER;
+                spec_info_hold.comments.push_back( temp_str );
+            }
+
+//	Handle text keywords with returned strings
+
+        } else if (sKeyword == "#TITLE") {
+        	 if( sValue.size()>0) {
+                int k;
+                string temp_str;
+                for(k=0; k<sValue.size(); k++ ) temp_str += sValue[k] + BLANK_CHARACTER;
+                spec_info_hold.titles.push_back( temp_str );
+            }
+        } else if (sKeyword == "#DATE") {
+            if(sValue.size()>0) spec_info_hold.date = sValue[0];
+        } else if (sKeyword == "#TIME") {
+            if(sValue.size()>0) spec_info_hold.time = sValue[0];
+        } else if (sKeyword == "#OWNER") {
+            spec_info_hold.owner.clear();
+            if( sValue.size()>0) {	// Only keep first title
+                int k;
+                for(k=0; k<sValue.size(); k++ ) spec_info_hold.owner += sValue[k] + BLANK_CHARACTER;
+            }
+        } else if (sKeyword == "#NPOINTS") {
+            if(sValue.size()>0) {
+                istringstream val( sValue[0] );
+                val >> numChannels;
+                if( !val || numChannels < 0 ) return -line_number;
+                bNumChanFound = true;
+            }
+        } else if (sKeyword == "#NCOLUMNS") {
+            if(sValue.size()>0) {
+                istringstream val( sValue[0] );
+                val >> numColumns;
+                if( numColumns<1 || numColumns>2 ) {
+                    return -line_number;
+                } else {
+                    spectrum_vector.resize(numColumns);
+                    ev_ch.resize(numColumns);
+                    ev_start.resize(numColumns);
+                    spectrum_hold_vec.resize(numColumns);
+                }
+            }
+        } else if (sKeyword == "#XUNITS") {
+            if ( sValue.size()<=0 ) return -line_number;
+            if( upper_trim(sValue[0]) == "EV" ) {
+                kev_units = false;
+            } else if( upper_trim(sValue[0]) == "KEV" ) {
+                kev_units = true;
+            } else {
+                return -line_number;
+            };
+            // Don't overwrite label from XLABEL keyword, only use if no label set so far
+            //if( spec_x_label.length() == 0 ) spec_x_label = sValue[0];
+        } else if (sKeyword == "#YUNITS") {
+            if (  sValue.size()<=0 || upper_trim(sValue[0]) != "COUNTS") {
+                return -line_number;
+            };
+            // Don't overwrite label from YLABEL keyword, only use if no label set so far
+            //if( spec_y_label.length() == 0 ) spec_y_label = sValue[0];
+        } else if (sKeyword == "#XLABEL") {
+            //if(sValue.size()>0) spec_x_label = sValue[0];
+            continue;
+        } else if (sKeyword == "#YLABEL") {
+            //if(sValue.size()>0) spec_y_label = sValue[0];
+            continue;
+        } else if (sKeyword == "##OPTICFILE") {
+            if(sValue.size()>0) {
+                istringstream val( sValue[0] );
+                int temp;
+                val>> temp;
+                if( !val ) {
+                    //  If optic file is not a number, set optic type in conditions array
+                    conditionsStructEMSA.optic_file_name = sValue[0];
+                    conditionsStructEMSA.conditionsVector[TEST_OPTIC_TYPE_INDEX] = 4;
+                } else {
+                    //  If optic file is a number, set optic type in conditions array
+                    conditionsStructEMSA.conditionsVector[TEST_OPTIC_TYPE_INDEX] = temp;
+                }
+            }
+        } else if (sKeyword == "##ANODE") {
+            if(sValue.size()>0) {
+                istringstream val( sValue[0] );
+                int temp;
+                val>> temp;
+                if( !val ) {
+                    //  If anode file is not a number, put the entire string in conditions structure for later parsing
+                    string anode_str = sValue[0];
+                    if( sValue.size() > 1 ) {
+                        unsigned int jj;
+                        for( jj=1; jj<sValue.size(); jj++ ) anode_str += "," + sValue[jj];
+                    }
+                    conditionsStructEMSA.anode_element_list = anode_str;
+                    conditionsStructEMSA.conditionsVector[ANODE_Z_INDEX] = 0;
+                } else {
+                    //  If anode file is a number, set anode Z in conditions array
+                    conditionsStructEMSA.conditionsVector[ANODE_Z_INDEX] = temp;
+                }
+            }
+        } else if (sKeyword == "##TUBEFILE") {
+            if(sValue.size()>0) {
+                    conditionsStructEMSA.tube_file_name = sValue[0];
+            }
+
+//	Handle values that are returned as arguments (not in conditions array)
+
+//	Need to handle multiple live times and energy calibrations                                *****
+        } else if (sKeyword == "#XPERCHAN") {
+            if(sValue.size()>=numColumns) {
+                int k;
+                for( k=0; k<numColumns; k++) {
+                    istringstream val( sValue[k] );
+                    float temp;
+                    val >> temp;
+                    if( !val || temp <= 0 ) return -line_number;
+                    ev_ch[k] = temp;
+                }
+            } else {
+                return -line_number;
+            }
+        } else if (sKeyword == "#OFFSET") {
+            if(sValue.size()>=numColumns) {
+                int k;
+                for( k=0; k<numColumns; k++) {
+                    istringstream val( sValue[k] );
+                    float temp;
+                    val >> temp;
+                    if( !val ) return -line_number;
+                    ev_start[k] = temp;
+                }
+            } else {
+                return -line_number;
+            }
+        } else if (sKeyword == "#LIVETIME") {
+            if(sValue.size()>=numColumns) {
+                int k;
+                for( k=0; k<numColumns; k++) {
+                    istringstream val( sValue[k] );
+                    float temp;
+                    val >> temp;
+                    if( !val || temp < 0 ) return -line_number;
+                    spectrum_vector[k].live_time( temp );
+                }
+            } else {
+                return -line_number;
+            }
+        } else if (sKeyword == "#REALTIME") {
+            if(sValue.size()>=numColumns) {
+                int k;
+                for( k=0; k<numColumns; k++) {
+                    istringstream val( sValue[k] );
+                    float temp;
+                    val >> temp;
+                    if( !val || temp < 0 ) return -line_number;
+                    spectrum_vector[k].real_time( temp );
+                }
+            } else {
+                return -line_number;
+            }
+        } else if (sKeyword == "##TRIGGERS") {
+            triggers_line = line_number;
+            livetime_XIA = true;
+            if(sValue.size()>=numColumns) {
+                int k;
+                for( k=0; k<numColumns; k++) {
+                    istringstream val( sValue[k] );
+                    float temp;
+                    val >> temp;
+                    if( !val || temp < 0 ) return -line_number;
+                    spectrum_vector[k].header_info_change().triggers = temp;
+                }
+            } else {
+                return -line_number;
+            }
+        } else if (sKeyword == "##EVENTS") {
+            if(sValue.size()>=numColumns) {
+                int k;
+                for( k=0; k<numColumns; k++) {
+                    istringstream val( sValue[k] );
+                    float temp;
+                    val >> temp;
+                    if( !val || temp < 0 ) return -line_number;
+                    spectrum_vector[k].header_info_change().events = temp;
+                }
+            } else {
+                return -line_number;
+            }
+        } else if (sKeyword == "##OVERFLOWS") {
+            if(sValue.size()>=numColumns) {
+                int k;
+                for( k=0; k<numColumns; k++) {
+                    istringstream val( sValue[k] );
+                    float temp;
+                    val >> temp;
+                    if( !val || temp < 0 ) return -line_number;
+                    spectrum_vector[k].header_info_change().overflows = temp;
+                }
+            } else {
+                return -line_number;
+            }
+        } else if (sKeyword == "##UNDERFLOWS") {
+            if(sValue.size()>=numColumns) {
+                int k;
+                for( k=0; k<numColumns; k++) {
+                    istringstream val( sValue[k] );
+                    float temp;
+                    val >> temp;
+                    if( !val || temp < 0 ) return -line_number;
+                    spectrum_vector[k].header_info_change().underflows = temp;
+                }
+            } else {
+                return -line_number;
+            }
+        } else if (sKeyword == "##BASE_EVENTS") {
+            if(sValue.size()>=numColumns) {
+                int k;
+                for( k=0; k<numColumns; k++) {
+                    istringstream val( sValue[k] );
+                    float temp;
+                    val >> temp;
+                    if( !val || temp < 0 ) return -line_number;
+                    spectrum_vector[k].header_info_change().baseline_samples = temp;
+                }
+            } else {
+                return -line_number;
+            }
+        } else if (sKeyword == "##RESETS") {
+            if(sValue.size()>=numColumns) {
+                int k;
+                for( k=0; k<numColumns; k++) {
+                    istringstream val( sValue[k] );
+                    float temp;
+                    val >> temp;
+                    if( !val || temp < 0 ) return -line_number;
+                    spectrum_vector[k].header_info_change().preamp_resets = temp;
+                }
+            } else {
+                return -line_number;
+            }
+        } else if (sKeyword == "##OVER_ADCMAX") {
+            if(sValue.size()>=numColumns) {
+                int k;
+                for( k=0; k<numColumns; k++) {
+                    istringstream val( sValue[k] );
+                    float temp;
+                    val >> temp;
+                    if( !val || temp < 0 ) return -line_number;
+                    spectrum_vector[k].header_info_change().saturates = temp;
+                }
+            } else {
+                return -line_number;
+            }
+        } else if (sKeyword == "#XPOSITION") {
+            if(sValue.size()>0) {
+                istringstream val( sValue[0] );
+                float temp;
+                val >> temp;
+                spec_info_hold.x = temp;
+            }
+        } else if (sKeyword == "#YPOSITION") {
+            if(sValue.size()>0) {
+                istringstream val( sValue[0] );
+                float temp;
+                val >> temp;
+                spec_info_hold.y = temp;
+            }
+        } else if (sKeyword == "#ZPOSITION") {
+            if(sValue.size()>0) {
+                istringstream val( sValue[0] );
+                float temp;
+                val >> temp;
+                spec_info_hold.z = temp;
+            }
+        } else if (sKeyword == "##IPOSITION") {
+            if(sValue.size()>0) {
+                istringstream val( sValue[0] );
+                float temp;
+                val >> temp;
+                spec_info_hold.i = temp;
+            }
+        } else if (sKeyword == "##JPOSITION") {
+            if(sValue.size()>0) {
+                istringstream val( sValue[0] );
+                float temp;
+                val >> temp;
+                spec_info_hold.j = temp;
+            }
+        } else if (sKeyword == "##RTT") {
+            if(sValue.size()>0) {
+                istringstream val( sValue[0] );
+                float temp;
+                val >> temp;
+                spec_info_hold.rtt = temp;
+            }
+        } else if (sKeyword == "##PMC") {
+            if(sValue.size()>0) {
+                istringstream val( sValue[0] );
+                float temp;
+                val >> temp;
+                spec_info_hold.pmc = temp;
+            }
+        } else if (sKeyword == "##DETECTOR_ID") {
+            if(sValue.size()>0) {
+                spec_info_hold.det_ID = sValue[0];
+            }
+        } else if (sKeyword == "#SPECTRUM") {
+            break;
+        } else {
+
+//		Process values returned in conditions array
+
+            int i;
+            for( i=0; i<XRF_PARAMETER_LAST; i++ ) {
+                if( i == TEST_OPTIC_TYPE_INDEX ) continue;  //  handled above since it might be a file name
+                if( i == ANODE_Z_INDEX ) continue;  //  handled above since it might be an element list
+                string upper_test = upper_trim( get_EMSA_keyword(i) );
+                if (sKeyword == upper_test) {
+                    if(sValue.size()>0) {
+                        istringstream val( sValue[0] );
+                        val >> conditionsStructEMSA.conditionsVector[i];  //  This will automatically handle if it is a number
+                        if( ! val ) {
+                            conditionsStructEMSA.conditionsVector[i] = parse_EMSA_description( i, sValue[0] );
+                            //  These are always non-negative integers since they encode items from a list
+                            if( conditionsStructEMSA.conditionsVector[i] < 0 ) return -line_number;
+                        }
+                        if( i == TUBE_CURRENT_INDEX ) conditionsStructEMSA.conditionsVector[i] /= 1000;   //  convert from microAmps to milliAmps
+                    }
+                    break;
+                };
+            };
+        };
+
+	};  //  End while !( !inputFile )
+
+//    int ic;
+//    for( ic = 0; ic < XRF_PARAMETER_LAST; ic++ ) {
+//        cout << ic << "  " << get_EMSA_keyword(ic) << "  " << conditionsStructEMSA.conditionsVector[ic] << endl;
+//    }
+
+//		Process spectrum
+
+	if( ! bNumChanFound && numColumns > 0 ) return -999999;
+	if( numColumns <= 0 ) return 0; // Done if no columns of data
+	spectrum_vector.resize(numColumns);
+	int k;
+	for( k=0; k<numColumns; k++ ) {
+        if( kev_units ) {
+            //  Convert from keV to eV for energy calibration to work properly
+            spectrum_vector[k].calibration( ev_start[k] * 1000,
+               ev_ch[k] * 1000 );
+        } else {
+            spectrum_vector[k].calibration( ev_start[k],
+               ev_ch[k] );
+        }
+        //  Put all of the auxiliary info into the XraySpectrum objects
+        spectrum_vector[k].aux_info_replace( spec_info_hold );
+        if( livetime_XIA ) {
+            //  See writeup in file "JPL-XIA_PIXL_FPGA_Specification_v2.06.pdf", page 9
+            spectrum_vector[k].header_info_change().live_time_DSPC = spectrum_vector[k].live_time();
+            const Spec_Header_Info &header = spectrum_vector[k].header_info();
+            if( header.triggers > 0 ) {
+                float total_counts_in = header.events + header.overflows + header.underflows;
+                spectrum_vector[k].live_time( header.live_time_DSPC * total_counts_in / header.triggers );
+            } else if( header.live_time_DSPC != 0 ) return -triggers_line;
+        }
+        spectrum_hold_vec[k].resize( numChannels );
+	}
+	if( numChannels <= 0 ) return 0; // Done if no spectrum data
+	int i;
+	for( i=0; i<numChannels; i++ ) {
+		string data_line;
+		vector <string> sValue;
+		getline( inputFile, data_line );
+		line_number++;
+		//cout << "data_line " << data_line << endl;
+		if ( !inputFile ) {
+            return -line_number;
+		}
+//        parseCommas( data_line, sValue );
+        string delim( COMMA_CHARACTER );
+        delim += BLANK_CHARACTER;
+        parse_records( delim, data_line, sValue );
+		if ( sValue.size() <= 0 || sValue[0] == "#ENDOFDATA" ) {
+            return -line_number;
+		}
+        if( sValue.size() < numColumns ) {
+            return -line_number;
+        }
+        int k_prime = -1;
+        for( k=0; k<numColumns; k++ ) {
+            k_prime++;
+            //  Skip empty records (caused by commas, tabs, and blanks together in data)
+            if( sValue[k_prime].length() <= 0 && sValue.size() > k_prime + 1 ) k_prime++;
+            istringstream val( sValue[k_prime] );
+            float temp;
+            val >> temp;
+            if( !val ) return -line_number;
+            spectrum_hold_vec[k][i] = temp;
+		}
+	};
+
+	for( k=0; k<numColumns; k++ ) {
+        spectrum_vector[k].meas( spectrum_hold_vec[k] );
+	}
+
+	return 0;
+}
+
+void parseEMSAkeyword( const string strIn, const string delim, string &sKeyword, vector <string> &sValue ) {
+// strIn - in, input string
+// del - in, delimiter character
+// sKeyword - out, keyword up to delimiter (not including delimiter)
+// sValue - out, rest of string after delimiter and following blank, if any
+//          entries in the sValue vector are separated by blanks in the input string
+	const int slen = strIn.length();
+	int j;
+	j = strIn.find( delim );
+	if( j >= 0 && j < slen ) {
+		sKeyword = strIn.substr( 0, j );
+        string delim( COMMA_CHARACTER );
+        delim += BLANK_CHARACTER;
+		parse_records( delim, strIn.substr( j + 1, slen ), sValue );
+	} else {
+		sKeyword = strIn.substr( 0, slen );
+	};
+};
+
+bool same_result( const int result_a, const XRFconditionsInput &cond_a, const vector <XraySpectrum> &spectra_a,
+                const int result_b, const XRFconditionsInput &cond_b, const vector <XraySpectrum> &spectra_b ) {
+    if( result_a != result_b ) return false;
+    if( cond_a.conditionsVector != cond_b.conditionsVector ) return false;
+    if( cond_a.optic_file_name != cond_b.optic_file_name || cond_a.tube_file_name != cond_b.tube_file_name
+        || cond_a.anode_element_list != cond_b.anode_element_list ) return false;
+    if( spectra_a.size() != spectra_b.size() ) return false;
+    int k;
+    for( k=0; k<spectra_a.size(); k++ ) {
+        const XraySpectrum &a = spectra_a[k];
+        const XraySpectrum &b = spectra_b[k];
+        if( a.numberOfChannels() != b.numberOfChannels() ) return false;
+        int i;
+        for( i=0; i<a.numberOfChannels(); i++ ) if( a.meas()[i] != b.meas()[i] ) return false;
+        if( a.calibration().energyStart() != b.calibration().energyStart()
+            || a.calibration().energyPerChannel() != b.calibration().energyPerChannel() ) return false;
+        if( a.live_time() != b.live_time() || a.real_time() != b.real_time() ) return false;
+        const Spec_Header_Info &ha = a.header_info();
+        const Spec_Header_Info &hb = b.header_info();
+        if( ha.triggers != hb.triggers || ha.events != hb.events || ha.overflows != hb.overflows
+            || ha.underflows != hb.underflows || ha.baseline_samples != hb.baseline_samples
+            || ha.preamp_resets != hb.preamp_resets || ha.saturates != hb.saturates
+            || ha.live_time_DSPC != hb.live_time_DSPC ) return false;
+        const Spec_Aux_Info &xa = a.aux_info();
+        const Spec_Aux_Info &xb = b.aux_info();
+        if( xa.titles != xb.titles || xa.comments != xb.comments || xa.date != xb.date || xa.time != xb.time
+            || xa.owner != xb.owner || xa.det_ID != xb.det_ID ) return false;
+        if( xa.x != xb.x || xa.y != xb.y || xa.z != xb.z || xa.i != xb.i || xa.j != xb.j
+            || xa.rtt != xb.rtt || xa.pmc != xb.pmc ) return false;
+    }
+    return true;
+}
+
+int main( int argc, char *argv[] ) {
+    if( argc < 2 ) {
+        cout << "Usage: read_EMSA_benchmark <MSA file or list of MSA files (.txt)> [repeat count]" << endl;
+        return 1;
+    }
+    string input = argv[1];
+    int repeat = 20;
+    if( argc > 2 ) repeat = atoi( argv[2] );
+    if( repeat < 1 ) repeat = 1;
+
+    //  Get the list of files (names in a list are relative to the list)
+    vector <string> files;
+    if( input.length() > 4 && input.substr( input.length() - 4 ) == ".txt" ) {
+        ifstream list( input.c_str() );
+        if( !list ) {
+            cout << "Can't open list of files " << input << endl;
+            return 1;
+        }
+        string dir;
+        size_t slash = input.find_last_of( "/\\" );
+        if( slash != string::npos ) dir = input.substr( 0, slash + 1 );
+        string line;
+        while( getline( list, line ) ) {
+            if( line.length() > 0 && line[ line.length() - 1 ] == '\r' ) line.erase( line.length() - 1 );
+            if( line.length() == 0 ) continue;
+            if( line[0] == '/' ) files.push_back( line );
+            else files.push_back( dir + line );
+        }
+    } else {
+        files.push_back( input );
+    }
+
+    //  Check that both readers agree, and get the total size
+    //  Files that can't be opened or read would make the timing meaningless, so they are counted and reported
+    double total_bytes = 0;
+    int mismatches = 0;
+    int unreadable = 0;
+    vector <string> timed_files;
+    int i;
+    for( i=0; i<files.size(); i++ ) {
+        ifstream f( files[i].c_str(), ios::in | ios::binary | ios::ate );
+        if( ! f ) {
+            cout << "Can't open " << files[i] << endl;
+            unreadable++;
+            continue;
+        }
+        double file_bytes = f.tellg();
+        XRFconditionsInput cond_new, cond_ref;
+        vector <XraySpectrum> spectra_new, spectra_ref;
+        int result_new = read_EMSA_PIXL( files[i], cond_new, spectra_new );
+        int result_ref = read_EMSA_PIXL_reference( files[i], cond_ref, spectra_ref );
+        if( ! same_result( result_new, cond_new, spectra_new, result_ref, cond_ref, spectra_ref ) ) {
+            cout << "Readers do not agree for " << files[i] << "  (result " << result_new << " vs. " << result_ref << ")" << endl;
+            mismatches++;
+        } else if( result_new != 0 || spectra_new.empty() ) {
+            cout << "Can't read " << files[i] << "  (result " << result_new << ", " << spectra_new.size() << " spectra)" << endl;
+            unreadable++;
+            continue;
+        }
+        timed_files.push_back( files[i] );
+        total_bytes += file_bytes;
+    }
+    cout << timed_files.size() << " of " << files.size() << " files, " << total_bytes / 1.0e6 << " MB, repeated " << repeat << " times" << endl;
+    if( unreadable > 0 ) cout << unreadable << " files could not be opened or read" << endl;
+    if( total_bytes <= 0 ) {
+        cout << "Nothing was read, no timing" << endl;
+        return 3;
+    }
+
+    //  Time each reader
+    int reader;
+    double mb_per_sec[2] = { 0, 0 };
+    for( reader=0; reader<2; reader++ ) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        int r;
+        for( r=0; r<repeat; r++ ) {
+            for( i=0; i<timed_files.size(); i++ ) {
+                XRFconditionsInput cond;
+                vector <XraySpectrum> spectra;
+                if( reader == 0 ) read_EMSA_PIXL_reference( timed_files[i], cond, spectra );
+                else read_EMSA_PIXL( timed_files[i], cond, spectra );
+            }
+        }
+        double seconds = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+        mb_per_sec[reader] = seconds > 0 ? total_bytes * repeat / 1.0e6 / seconds : 0;
+        cout << ( reader == 0 ? "getline / istringstream reader:  " : "read_EMSA_PIXL (in place):       " )
+            << fixed << setprecision(1) << mb_per_sec[reader] << " MB/s  (" << setprecision(3) << seconds << " s)" << endl;
+    }
+    if( mb_per_sec[0] > 0 ) cout << "Speedup " << setprecision(2) << mb_per_sec[1] / mb_per_sec[0] << endl;
+    if( mismatches > 0 ) {
+        cout << mismatches << " files read differently" << endl;
+        return 2;
+    }
+    if( unreadable > 0 ) return 3;
+    return 0;
+}
@@ -28,6 +28,7 @@
 # POSSIBILITY OF SUCH DAMAGE.
 
 import unittest
+import re
 
 from helper import *
 
@@ -47,6 +48,54 @@ class PiquantTester(unittest.TestCase):
         log = run_piquant(self, cmd)
         compare_outputs(self, '6map.csv', '6map.csv', log)
 
+    # Anderson mixing of the fit iterations changes the results (by up to a few percent for this map), so it has its own expected output
+    def test_3PMC_map_anderson(self):
+        cmd = make_cmd(self, 'map', './test-data/msa/6files.txt', 'Fe,Ca,Ti,K', '6map_anderson.csv', '-A')
+        log = run_piquant(self, cmd)
+        compare_outputs(self, '6map_anderson.csv', '6map_anderson.csv', log)
+        self.assertIn('Fit iterations use Anderson mixing of the last 2 updates.', log[1])
+        self.assertIn('most fit iterations', log[1])
+        self.assertIn('average time per spectrum', log[1])
+
+    # Turning Anderson mixing off gives the default output
+    def test_3PMC_map_anderson_off(self):
+        cmd = make_cmd(self, 'map', './test-data/msa/6files.txt', 'Fe,Ca,Ti,K', '6map_anderson_off.csv', '-A,0')
+        log = run_piquant(self, cmd)
+        compare_outputs(self, '6map_anderson_off.csv', '6map.csv', log)
+        self.assertNotIn('Anderson mixing', log[1])
+
+    # The same as above, but solving the fits with the Cholesky solver instead of LU (only the last digits can differ)
+    def test_3PMC_map_cholesky(self):
+        cmd = make_cmd(self, 'map', './test-data/msa/6files.txt', 'Fe,Ca,Ti,K', '6map_cholesky.csv', '-L')
+        log = run_piquant(self, cmd)
+        compare_output_csvs(self,
+            make_output_path('6map_cholesky.csv'),
+            './test-data/expected-output/6map.csv',
+            2,
+            HEADER_COMPARE,
+            0.001,
+            [],
+            log)
+
+    # The same as above, but with the cross sections interpolated from the tabulated grids instead of the splines
+    def test_3PMC_map_tabulated(self):
+        cmd = make_cmd(self, 'map', './test-data/msa/6files.txt', 'Fe,Ca,Ti,K', '6map_tabulated.csv', '-X')
+        log = run_piquant(self, cmd)
+        # Grids for every element are checked against the splines, including both sides of every absorption edge
+        check = re.search(r'tabulated for (\d+) elements, largest difference from the splines (\S+)  \(grid error (\S+), tolerance (\S+)\)', log[1])
+        self.assertIsNotNone(check)
+        self.assertEqual(int(check.group(1)), 99)
+        self.assertLessEqual(float(check.group(2)), float(check.group(4)))
+        self.assertLessEqual(float(check.group(3)), float(check.group(4)))
+        compare_output_csvs(self,
+            make_output_path('6map_tabulated.csv'),
+            './test-data/expected-output/6map.csv',
+            2,
+            HEADER_COMPARE,
+            0.001,
+            [],
+            log)
+
     # This test is does the same as test_3PMC_map but with the input source being a PIXLISE binary file. We expect the same output
     def test_using_pmcs_AB(self):
         cmd = make_cmd(self, 'map', './test-data/pixlise-datasets/list.pmcs', 'Fe,Ca,Ti,K', 'multi_pmc_map.csv', '-t,1')
@@ -67,3 +116,9 @@ class PiquantTester(unittest.TestCase):
         cmd = make_cmd(self, 'sum', './test-data/msa/sum.txt', 'Fe,Ca,Ti,K', 'bulksummax.msa', '')
         log = run_piquant(self, cmd)
         compare_outputs(self, 'bulksummax.msa', 'bulksummax.msa', log)
+
+    # The same as above, but with the spectra read on several threads (they are still added in list order)
+    def test_bulksum_mt(self):
+        cmd = make_cmd(self, 'sum', './test-data/msa/sum.txt', 'Fe,Ca,Ti,K', 'bulksummax_mt.msa', '-t,6')
+        log = run_piquant(self, cmd)
+        compare_outputs(self, 'bulksummax_mt.msa', 'bulksummax.msa', log)
@@ -49,3 +49,16 @@ class PiquantCalibrateTester(unittest.TestCase):
             [49, 94, 139], # We ignore these rows, they are SPECTRUM, <path> and the path is different... Do we need to follow the path???
             log)
 
+    # The same as above, but with the standards fitted on several threads
+    def test_cali_mt(self):
+        cmd = [self.piquant, 'cali', self.config_file, self.standards_file, make_output_path('output_calibrate_mt.csv'), 'Ar_I', '-t,6']
+        log = run_piquant(self, cmd)
+        compare_output_csvs(self,
+            make_output_path('output_calibrate_mt.csv'),
+            './test-data/PIQUANT_test_data_May2020/ExpectedOutputs/exp_calibrate.csv',
+            2,
+            HEADER_IGNORE_ALL,
+            0.0,
+            [49, 94, 139],
+            log)
+
@@ -48,3 +48,16 @@ class PiquantEvaluateTester(unittest.TestCase):
             0.0,
             [],
             log)
+
+    # The same as above, but with the standards fitted on several threads
+    def test_eval_mt(self):
+        cmd = [self.piquant, 'eval', self.config_file, self.standards_file, './test-data/PIQUANT_test_data_May2020/Input_files_PIQUANT_test_data_May2020/Calibrate_Master_ECF_new_BB_01_08_2020.csv', 'Ar_I', make_output_path('output_evaluate_mt.csv'), '-t,6']
+        log = run_piquant(self, cmd)
+        compare_output_csvs(self,
+            make_output_path('output_evaluate_mt.csv'),
+            './test-data/PIQUANT_test_data_May2020/ExpectedOutputs/exp_evaluate.csv',
+            2,
+            HEADER_IGNORE_ALL,
+            0.0,
+            [],
+            log)
@@ -0,0 +1,142 @@
+# Copyright (c) 2018-2022 California Institute of Technology (“Caltech”) and
+# University of Washington. U.S. Government sponsorship acknowledged.
+# All rights reserved.
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+# * Redistributions of source code must retain the above copyright notice, this
+#   list of conditions and the following disclaimer.
+# * Redistributions in binary form must reproduce the above copyright notice,
+#   this list of conditions and the following disclaimer in the documentation
+#   and/or other materials provided with the distribution.
+# * Neither the name of Caltech nor its operating division, the Jet Propulsion
+#   Laboratory, nor the names of its contributors may be used to endorse or
+#   promote products derived from this software without specific prior written
+#   permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import unittest
+import struct
+import subprocess
+import shutil
+
+from helper import *
+
+
+# Writes a spectrum store (.pqs) with one PMC and one detector spectrum, laid out as in PIXLISE_spectrum_store.h
+def write_spectrum_store(path, pmc, read_type, detector_id, channels):
+    strings = b'READTYPE' + b'DETECTOR_ID' + read_type.encode() + detector_id.encode()
+    labels = struct.pack('=IIii', 0, 8, 2, 0) + struct.pack('=IIii', 8, 11, 2, 0)
+    locations = struct.pack('=iiffffffII', pmc, 1, 0, 0, 0, 0, 0, 1, 0, 1)
+    pmcs = struct.pack('=iI', pmc, 0)
+    detectors = struct.pack('=QQII', 0, 0, 2, len(channels))
+    metas = struct.pack('=IfqII', 0, 0, 0, 19, len(read_type)) + struct.pack('=IfqII', 1, 0, 0, 19+len(read_type), len(detector_id))
+    channel_data = struct.pack('={}i'.format(len(channels)), *channels)
+
+    sections = [labels, locations, pmcs, detectors, metas, channel_data, strings]
+    offsets = []
+    offset = 120
+    for s in sections:
+        offset = (offset + 7) & ~7
+        offsets.append(offset)
+        offset += len(s)
+    header = struct.pack('=8sIIIIIIQQQ', b'PQSTORE\0', 1, 0x01020304, 2, 1, 1, 1, 2, len(channels), len(strings))
+    header += struct.pack('=8Q', *offsets, offset)
+
+    data = bytearray(offset)
+    data[0:len(header)] = header
+    for s, o in zip(sections, offsets):
+        data[o:o+len(s)] = s
+    with open(path, 'wb') as f:
+        f.write(data)
+
+
+class PiquantPackTester(unittest.TestCase):
+    config_file = './test-data/config/PIXL/Config_PIXL_FM_SurfaceOps_Rev1_Jul2021.msa'
+    calibration_file = './test-data/config/PIXL/Calibration_PIXL_FM_SurfaceOps_5minECFs_Rev1_Jul2021.csv'
+    piquant = './Piquant'
+
+    puck_list = './test-data/PIQUANT_test_data_May2020/Data_files_Pucks_20200210_200210210814/msa_file_list_DetA_BHVO.txt'
+    puck_elements = 'Si_K K_K P_K Ca_K Ti_K Cr_K Mn_K Fe_K Sr_K Ar_I'
+
+    # Pack the puck spectrum list, then map and sum from the pack and expect exactly the outputs from the list
+    def test_pack_msa_list(self):
+        cmd = [self.piquant, 'pack', self.puck_list, make_output_path('puck.pqm')]
+        run_piquant(self, cmd)
+        cmd = make_cmd(self, 'map', make_output_path('puck.pqm'), self.puck_elements, 'output_map_puck_pack.csv', '-t,6')
+        log = run_piquant(self, cmd)
+        self.assertNotIn('Warning: spectrum file', log[1])
+        compare_output_csvs(self,
+            make_output_path('output_map_puck_pack.csv'),
+            './test-data/PIQUANT_test_data_May2020/ExpectedOutputs/exp_map_puck.csv',
+            2,
+            HEADER_IGNORE_ALL,
+            0.0,
+            [],
+            log)
+        cmd = make_cmd(self, 'sum', make_output_path('puck.pqm'), self.puck_elements, 'output_sum_puck_pack.csv', '')
+        log = run_piquant(self, cmd)
+        compare_output_csvs(self,
+            make_output_path('output_sum_puck_pack.csv'),
+            './test-data/PIQUANT_test_data_May2020/ExpectedOutputs/exp_sum_puck.csv',
+            2,
+            HEADER_IGNORE_ALL,
+            0.0,
+            [],
+            log)
+
+    # A pack whose spectrum files have changed since it was written is still used, with a warning for each changed file
+    def test_pack_msa_list_stale(self):
+        with open(self.puck_list) as f:
+            names = [line.strip() for line in f if line.strip().lower().endswith('.msa')][:2]
+        puck_dir = os.path.dirname(self.puck_list)
+        for name in names:
+            shutil.copy(os.path.join(puck_dir, name), make_output_path(name))
+        with open(make_output_path('stale_list.txt'), 'w') as f:
+            f.write('\n'.join(names) + '\n')
+        cmd = [self.piquant, 'pack', make_output_path('stale_list.txt'), make_output_path('stale.pqm')]
+        run_piquant(self, cmd)
+        # Touch the first file (a later modification time)
+        stat = os.stat(make_output_path(names[0]))
+        os.utime(make_output_path(names[0]), (stat.st_atime, stat.st_mtime + 100))
+        cmd = make_cmd(self, 'map', make_output_path('stale.pqm'), self.puck_elements, 'output_map_stale_pack.csv', '')
+        log = run_piquant(self, cmd)
+        self.assertIn('Warning: spectrum file ' + make_output_path(names[0]) + ' has changed since it was packed', log[1])
+        self.assertNotIn('Warning: spectrum file ' + make_output_path(names[1]), log[1])
+        self.assertIn('Warning: 1 of 2 spectrum files in MSA spectrum pack', log[1])
+
+    # Pack the PIXLISE dataset into a spectrum store, map the same PMCs from the store and expect the same output as from the .bin file
+    # (the store and its PMC list are in the output directory, the first line of the list is relative to the list file)
+    def test_pack_pixlise_store(self):
+        cmd = [self.piquant, 'pack', './test-data/pixlise-datasets/5x11dataset.bin', make_output_path('5x11dataset.pqs')]
+        run_piquant(self, cmd)
+        with open('./test-data/pixlise-datasets/list.pmcs') as f:
+            pmcs = f.read().split('\n', 1)[1]
+        with open(make_output_path('list_store.pmcs'), 'w') as f:
+            f.write('5x11dataset.pqs\n' + pmcs)
+        cmd = make_cmd(self, 'map', make_output_path('list_store.pmcs'), 'Fe,Ca,Ti,K', 'multi_pmc_store_map.csv', '-t,1')
+        log = run_piquant(self, cmd)
+        compare_outputs(self, 'multi_pmc_store_map.csv', '6map_pmcsfile_AB.csv', log)
+
+    # A zero run in a spectrum that would go past the maximum number of channels must be rejected, not decoded
+    def test_store_bad_zero_run(self):
+        write_spectrum_store(make_output_path('bad_zero_run.pqs'), 7, 'Normal', 'A', [10, 0, 2000000000, 10])
+        with open(make_output_path('bad_zero_run.pmcs'), 'w') as f:
+            f.write('bad_zero_run.pqs\n7|Normal|A\n')
+        cmd = make_cmd(self, 'map', make_output_path('bad_zero_run.pmcs'), 'Fe,Ca,Ti,K', 'bad_zero_run_map.csv', '-t,1')
+        subprocess.run(cmd, check=False, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        # Each map job writes its messages to the map log
+        with open(make_output_path('bad_zero_run_map.csv_log.txt')) as f:
+            self.assertIn('has a spectrum with a bad zero run', f.read())
@@ -54,3 +54,39 @@ class PiquantPlotTester(unittest.TestCase):
             [],
             log)
 
+    # The background column comes from the SNIP background (snip.cpp), these check it against the backgrounds from
+    # before the stripping passes were done in blocks, at every 32nd channel to keep the expected files small
+    def test_plot_background(self):
+        cmd = [self.piquant, 'plot', './test-data/PIQUANT_test_data_May2020/Input_files_PIQUANT_test_data_May2020/Calibration_box_BHVO-2G_28kV_230uA_03_28_2019_bulk_sum.msa', make_output_path('plot_bkg.csv')]
+        log = run_piquant(self, cmd)
+        keep_every_nth_row(make_output_path('plot_bkg.csv'), make_output_path('plot_bkg_32.csv'), 2, 32)
+        compare_output_csvs(self,
+            make_output_path('plot_bkg_32.csv'),
+            './test-data/expected-output/plot_bkg_32.csv',
+            2,
+            HEADER_IGNORE_PIQUANT_VERSION_DIFF,
+            0.00001,
+            [],
+            log)
+
+    def test_plot_background_2zone(self):
+        cmd = [self.piquant, 'plot', './test-data/PIQUANT_test_data_May2020/Input_files_PIQUANT_test_data_May2020/Calibration_box_BHVO-2G_28kV_230uA_03_28_2019_bulk_sum.msa', make_output_path('plot_bkg_2zone.csv'), '-b,25,12,24,300,900,20']
+        log = run_piquant(self, cmd)
+        keep_every_nth_row(make_output_path('plot_bkg_2zone.csv'), make_output_path('plot_bkg_2zone_32.csv'), 2, 32)
+        compare_output_csvs(self,
+            make_output_path('plot_bkg_2zone_32.csv'),
+            './test-data/expected-output/plot_bkg_2zone_32.csv',
+            2,
+            HEADER_IGNORE_PIQUANT_VERSION_DIFF,
+            0.00001,
+            [],
+            log)
+
+
+# Copies the header rows and every nth data row of a csv file
+def keep_every_nth_row(inPath, outPath, firstDataRowIdx, n):
+    with open(inPath) as f:
+        lines = f.read().splitlines()
+    kept = lines[:firstDataRowIdx] + lines[firstDataRowIdx::n]
+    with open(outPath, 'w') as f:
+        f.write('\n'.join(kept) + '\n')
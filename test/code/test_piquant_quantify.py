@@ -56,3 +56,20 @@ class PiquantQuantifyTester(unittest.TestCase):
             0.0,
             [],
             log)
+
+    # A calibration file that can't be read gives a warning and the spectrum is quantified with all ECFs 1, as before
+    def test_quantify_no_calibration(self):
+        cmd = [
+            self.piquant,
+            'quant',
+            self.config_file,
+            self.config_file,
+            './test-data/PIQUANT_test_data_May2020/Input_files_PIQUANT_test_data_May2020/Calibration_box_BHVO-2G_28kV_230uA_03_28_2019_bulk_sum.msa',
+            'Si_K K_K P_K Ca_K Ti_K Cr_K Mn_K Fe_K Sr_K Ar_I',
+            make_output_path('output_quantify_no_calibration.csv')
+            ]
+        log = run_piquant(self, cmd)
+
+        self.assertIn("*** Warning can't read calibration file", log[1])
+        self.assertIn('Calibration files can only be .txt or .csv', log[1])
+        self.assertTrue(os.path.exists(make_output_path('output_quantify_no_calibration.csv')))